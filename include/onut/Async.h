@@ -1,13 +1,329 @@
 #ifndef ASYNC_H_INCLUDED
 #define ASYNC_H_INCLUDED
 
+// Onut
+#include <onut/Dispatcher.h>
+
 // STL
-#include <future>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(AsyncExecutor)
+
+namespace onut
+{
+    /**
+    Fixed number of threads for blocking work like file or network I/O, fed from one queue.
+    Long waits don't belong on the ThreadPool, they would hold its workers.
+    Queued work is still done when the executor is destroyed.
+    */
+    class AsyncExecutor final
+    {
+    public:
+        static const size_t DEFAULT_THREAD_COUNT = 4;
+
+        struct Stats
+        {
+            size_t queuedCount = 0; // Waiting for a thread
+            size_t runningCount = 0;
+            size_t peakQueuedCount = 0;
+            uint64_t completedCount = 0;
+        };
+
+        static OAsyncExecutorRef create(size_t threadCount = DEFAULT_THREAD_COUNT);
+
+        AsyncExecutor(size_t threadCount);
+        ~AsyncExecutor();
+
+        void run(const std::function<void()>& fn);
+
+        size_t getThreadCount() const { return m_threads.size(); }
+        Stats getStats();
+
+    private:
+        void workerThread();
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_waitForWork;
+        std::deque<std::function<void()>> m_queue;
+        Stats m_stats;
+        bool m_isRunning = true;
+    };
+}
+
+extern OAsyncExecutorRef oAsyncExecutor;
+
+namespace onut
+{
+    template<typename Tresult> class AsyncFuture;
+
+    /**
+    Result of the function, or the exception it threw. get() rethrows it.
+    */
+    template<typename Tresult>
+    class AsyncValue final
+    {
+    public:
+        AsyncValue() = default;
+        AsyncValue(const AsyncValue&) = delete;
+        AsyncValue& operator=(const AsyncValue&) = delete;
+
+        ~AsyncValue()
+        {
+            if (m_hasValue) getPtr()->~Tresult();
+        }
+
+        template<typename Tfn, typename ... Targs>
+        void set(Tfn& fn, Targs&... args)
+        {
+            new(&m_storage) Tresult(fn(args...));
+            m_hasValue = true;
+        }
+
+        void setException(const std::exception_ptr& pException) { m_pException = pException; }
+
+        const Tresult& get() const
+        {
+            if (m_pException) std::rethrow_exception(m_pException);
+            return *getPtr();
+        }
+
+    private:
+        // Tresult doesn't have to be default constructible
+        using Storage = typename std::aligned_storage<sizeof(Tresult), alignof(Tresult)>::type;
+
+        Tresult* getPtr() { return reinterpret_cast<Tresult*>(&m_storage); }
+        const Tresult* getPtr() const { return reinterpret_cast<const Tresult*>(&m_storage); }
+
+        Storage m_storage;
+        bool m_hasValue = false;
+        std::exception_ptr m_pException;
+    };
+
+    template<>
+    class AsyncValue<void> final
+    {
+    public:
+        template<typename Tfn, typename ... Targs>
+        void set(Tfn& fn, Targs&... args) { fn(args...); }
+
+        void setException(const std::exception_ptr& pException) { m_pException = pException; }
+
+        void get() const
+        {
+            if (m_pException) std::rethrow_exception(m_pException);
+        }
+
+    private:
+        std::exception_ptr m_pException;
+    };
+
+    template<typename Tresult>
+    class AsyncState final
+    {
+    public:
+        bool isReady()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_isReady;
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_readyCondition.wait(lock, [this] { return m_isReady; });
+        }
+
+        AsyncValue<Tresult>& getValue() { return m_value; }
+
+        /**
+        Run fn, store what it returns or throws and start the continuations
+        */
+        template<typename Tfn, typename ... Targs>
+        void resolve(Tfn& fn, Targs&... args)
+        {
+            try
+            {
+                m_value.set(fn, args...);
+            }
+            catch (...)
+            {
+                m_value.setException(std::current_exception());
+            }
+            std::vector<std::function<void()>> continuations;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_isReady = true;
+                continuations.swap(m_continuations);
+            }
+            m_readyCondition.notify_all();
+            for (auto& continuation : continuations) continuation();
+        }
+
+        /**
+        Call continuation once ready, right away if it is already
+        */
+        void onReady(const std::function<void()>& continuation)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_isReady)
+                {
+                    m_continuations.push_back(continuation);
+                    return;
+                }
+            }
+            continuation();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_readyCondition;
+        bool m_isReady = false;
+        AsyncValue<Tresult> m_value;
+        std::vector<std::function<void()>> m_continuations;
+    };
+
+    // Result of fn called with the value of a future of Tresult
+    template<typename Tresult, typename Tfn>
+    struct AsyncContinuationResult
+    {
+        using type = decltype(std::declval<Tfn&>()(std::declval<const Tresult&>()));
+    };
+
+    template<typename Tfn>
+    struct AsyncContinuationResult<void, Tfn>
+    {
+        using type = decltype(std::declval<Tfn&>()());
+    };
+
+    // An exception of the previous future is passed on to the next one, fn isn't called
+    template<typename Tresult>
+    struct AsyncResolver
+    {
+        template<typename Tnext, typename Tfn>
+        static void resolve(AsyncState<Tnext>& next, Tfn& fn, AsyncState<Tresult>& state)
+        {
+            auto call = [&fn, &state]() { return fn(state.getValue().get()); };
+            next.resolve(call);
+        }
+    };
+
+    template<>
+    struct AsyncResolver<void>
+    {
+        template<typename Tnext, typename Tfn>
+        static void resolve(AsyncState<Tnext>& next, Tfn& fn, AsyncState<void>& state)
+        {
+            auto call = [&fn, &state]() { state.getValue().get(); return fn(); };
+            next.resolve(call);
+        }
+    };
+
+    /**
+    Result of OAsync. Copies share the same result.
+    */
+    template<typename Tresult>
+    class AsyncFuture final
+    {
+    public:
+        using State = AsyncState<Tresult>;
+
+        AsyncFuture() = default;
+        AsyncFuture(const std::shared_ptr<State>& pState) : m_pState(pState) {}
+
+        bool isValid() const { return m_pState != nullptr; }
+        bool isReady() const { return m_pState && m_pState->isReady(); }
+        void wait() const { m_pState->wait(); }
+
+        /**
+        Wait for the result. Rethrows what the function threw.
+        */
+        auto get() const -> decltype(std::declval<AsyncValue<Tresult>&>().get())
+        {
+            m_pState->wait();
+            return m_pState->getValue().get();
+        }
+
+        /**
+        Call fn with the result on the AsyncExecutor
+        */
+        template<typename Tfn>
+        AsyncFuture<typename AsyncContinuationResult<Tresult, Tfn>::type> then(Tfn fn) const
+        {
+            return chain(fn, [](const std::function<void()>& continuation)
+            {
+                if (oAsyncExecutor) oAsyncExecutor->run(continuation);
+                else continuation();
+            });
+        }
+
+        /**
+        Call fn with the result on the main thread, through oDispatcher
+        */
+        template<typename Tfn>
+        AsyncFuture<typename AsyncContinuationResult<Tresult, Tfn>::type> thenSync(Tfn fn) const
+        {
+            return chain(fn, [](const std::function<void()>& continuation)
+            {
+                if (oDispatcher) oDispatcher->dispatch(continuation);
+                else continuation();
+            });
+        }
+
+    private:
+        template<typename Tfn, typename Tschedule>
+        AsyncFuture<typename AsyncContinuationResult<Tresult, Tfn>::type> chain(Tfn fn, Tschedule schedule) const
+        {
+            using Tnext = typename AsyncContinuationResult<Tresult, Tfn>::type;
+            auto pNext = std::make_shared<AsyncState<Tnext>>();
+            auto pState = m_pState;
+            pState->onReady([pState, pNext, fn, schedule]
+            {
+                schedule([pState, pNext, fn]() mutable
+                {
+                    AsyncResolver<Tresult>::resolve(*pNext, fn, *pState);
+                });
+            });
+            return AsyncFuture<Tnext>(pNext);
+        }
+
+        std::shared_ptr<State> m_pState;
+    };
+}
+
+template<typename Tresult>
+using OAsyncFuture = onut::AsyncFuture<Tresult>;
 
-template<typename ... Targs>
-inline auto OAsync(Targs... args) -> decltype(std::async(std::launch::async, args...))
+/**
+Run a function on oAsyncExecutor, or right away if there is none.
+The returned future doesn't block when dropped, unlike std::async's.
+*/
+template<typename Tfn, typename ... Targs>
+inline auto OAsync(Tfn fn, Targs... args) -> OAsyncFuture<decltype(fn(args...))>
 {
-    return std::async(std::launch::async, args...);
+    using Tresult = decltype(fn(args...));
+    auto pState = std::make_shared<onut::AsyncState<Tresult>>();
+    auto task = [pState, fn, args...]() mutable
+    {
+        pState->resolve(fn, args...);
+    };
+    if (oAsyncExecutor) oAsyncExecutor->run(task);
+    else task();
+    return OAsyncFuture<Tresult>(pState);
 }
 
 #endif
@@ -9,10 +9,14 @@
 // Third parties
 #include <list/List.h>
 
+// STL
+#include <vector>
+
 // Forward Declaration
 #include <onut/ForwardDeclaration.h>
 OForwardDeclare(Collider2DComponent);
 OForwardDeclare(Component);
+OForwardDeclare(ComponentSystem);
 OForwardDeclare(SceneManager);
 
 namespace onut
@@ -27,6 +31,36 @@ namespace onut
             FLAG_UPDATABLE = 2,
             FLAG_RENDERABLE_2D = 4,
             FLAG_BROADCAST_LISTENER = 8,
+            FLAG_PARALLEL_UPDATABLE = 16, // With FLAG_UPDATABLE. onUpdate() can run on a ThreadPool worker, see UpdateAccess.
+        };
+
+        /**
+        What the onUpdate() of a FLAG_PARALLEL_UPDATABLE component touches besides its own members,
+        asked once per class with getUpdateAccess(). Classes that can't conflict are updated at the same time.
+        During that phase, update list changes from setEnabled(), destroy() and messages are deferred until all
+        parallel updates are done. They are then applied in the same order with or without the ThreadPool.
+        Entities and components can't be created from there.
+        */
+        struct UpdateAccess
+        {
+            template<typename Tcomponent>
+            UpdateAccess& read()
+            {
+                reads.push_back(getComponentTypeId<Tcomponent>());
+                return *this;
+            }
+
+            template<typename Tcomponent>
+            UpdateAccess& write()
+            {
+                writes.push_back(getComponentTypeId<Tcomponent>());
+                return *this;
+            }
+
+            std::vector<ComponentTypeId> reads; // Component classes read, on any entity
+            std::vector<ComponentTypeId> writes;
+            bool readsTransforms = false;
+            bool writesTransforms = false;
         };
 
         virtual ~Component();
@@ -43,6 +77,11 @@ namespace onut
             return getEntity()->getComponent<Tcomponent>();
         }
         template<typename Tcomponent>
+        Tcomponent* getComponentPtr() const
+        {
+            return getEntity()->getComponentPtr<Tcomponent>();
+        }
+        template<typename Tcomponent>
         std::shared_ptr<Tcomponent> getParentComponent() const
         {
             return getEntity()->getParentComponent<Tcomponent>();
@@ -56,9 +95,28 @@ namespace onut
         void setLocalTransform(const Matrix& localTransform);
         void setWorldTransform(const Matrix& worldTransform);
 
+        /**
+        World space axis aligned box of what onRender2d() draws. Used to cull 2D renderables.
+        @return false if the component has no bounds. It's then always rendered.
+        */
+        bool getWorldBounds(Rect& worldBounds);
+
     protected:
         Component(int flags = FLAG_NONE);
 
+        /**
+        Local space rectangle drawn by onRender2d(), x, y, width, height.
+        @return false if the component has no bounds. It's then always rendered.
+        */
+        virtual bool getLocalBounds(Rect& localBounds) const { return false; }
+
+        /**
+        Call when the local bounds changed. Transform changes are tracked by the entity.
+        */
+        void dirtyBounds();
+
+        virtual void getUpdateAccess(UpdateAccess& access) const {}
+
         virtual void onCreate() {}
         virtual void onUpdate() {}
         virtual void onRender() {}
@@ -73,6 +131,7 @@ namespace onut
         virtual void onDestroy() {}
 
     private:
+        friend class ComponentSystem;
         friend class Entity;
         friend class SceneManager;
 
@@ -80,6 +139,15 @@ namespace onut
         bool m_isEnabled = true;
         int m_flags = FLAG_NONE;
 
+        // 2D culling
+        int32_t m_render2DProxyId = -1;
+        uint32_t m_render2DSequence = 0; // Registration order, breaks draw index ties
+        bool m_isBoundsDirty = false;
+
+        // Storage, if it was created by a ComponentSystem
+        ComponentSystem* m_pSystem = nullptr;
+        uint32_t m_systemIndex = 0;
+
         // List links
         LIST_LINK(Component) m_updateLink;
         LIST_LINK(Component) m_renderLink;
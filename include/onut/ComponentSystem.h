@@ -0,0 +1,170 @@
+#ifndef COMPONENTSYSTEM_H_INCLUDED
+#define COMPONENTSYSTEM_H_INCLUDED
+
+// STL
+#include <cinttypes>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(Component);
+OForwardDeclare(ComponentSystem);
+
+namespace onut
+{
+    /**
+    Components passed to a system's updateAll(), in memory order
+    */
+    template<typename Tcomponent>
+    class ComponentSpan final
+    {
+    public:
+        ComponentSpan(Tcomponent* const* ppComponents, size_t count)
+            : m_ppComponents(ppComponents)
+            , m_count(count)
+        {
+        }
+
+        Tcomponent* const* begin() const { return m_ppComponents; }
+        Tcomponent* const* end() const { return m_ppComponents + m_count; }
+        size_t size() const { return m_count; }
+        bool empty() const { return m_count == 0; }
+        Tcomponent& operator[](size_t index) const { return *m_ppComponents[index]; }
+
+    private:
+        Tcomponent* const* m_ppComponents;
+        size_t m_count;
+    };
+
+    /**
+    Storage of the components of one type, registered with SceneManager::registerComponentSystem().
+    */
+    class ComponentSystem
+    {
+    public:
+        virtual ~ComponentSystem() {}
+
+        /**
+        @return the number of components that are enabled and updating
+        */
+        virtual size_t getUpdatingCount() const = 0;
+
+    protected:
+        friend class SceneManager;
+
+        virtual void update() = 0;
+        virtual void setUpdating(uint32_t index, bool isUpdating) = 0;
+
+        static void bind(Component* pComponent, ComponentSystem* pSystem, uint32_t index);
+    };
+
+    /**
+    Components of type Tcomponent are created packed in chunks instead of one by one on the heap.
+    Instead of calling onUpdate() on each of them, the scene calls once per frame:
+        static void Tcomponent::updateAll(const OComponentSpan<Tcomponent>& components);
+    with the ones that would have been updated, enabled on an enabled entity, ordered by address.
+    */
+    template<typename Tcomponent>
+    class TComponentSystem final : public ComponentSystem, public std::enable_shared_from_this<TComponentSystem<Tcomponent>>
+    {
+    public:
+        static const uint32_t CHUNK_SIZE = 256;
+
+        std::shared_ptr<Tcomponent> create()
+        {
+            if (m_freeIndices.empty()) grow();
+            auto index = m_freeIndices.back();
+            m_freeIndices.pop_back();
+
+            auto pComponent = new(getSlot(index)) Tcomponent();
+            m_states[index] = STATE_USED;
+            bind(pComponent, this, index);
+
+            // The components keep the storage alive
+            auto pThis = this->shared_from_this();
+            return std::shared_ptr<Tcomponent>(pComponent, [pThis, index](Tcomponent* pComponent)
+            {
+                pComponent->~Tcomponent();
+                pThis->release(index);
+            });
+        }
+
+        size_t getUpdatingCount() const override
+        {
+            size_t count = 0;
+            for (auto state : m_states) count += state == STATE_UPDATING ? 1 : 0;
+            return count;
+        }
+
+    private:
+        using Slot = typename std::aligned_storage<sizeof(Tcomponent), alignof(Tcomponent)>::type;
+
+        enum State : uint8_t
+        {
+            STATE_FREE,
+            STATE_USED,
+            STATE_UPDATING
+        };
+
+        void update() override
+        {
+            if (m_isDirty)
+            {
+                m_updating.clear();
+                for (uint32_t i = 0; i < static_cast<uint32_t>(m_states.size()); ++i)
+                {
+                    if (m_states[i] == STATE_UPDATING) m_updating.push_back(getSlot(i));
+                }
+                m_isDirty = false;
+            }
+            if (m_updating.empty()) return;
+            Tcomponent::updateAll(ComponentSpan<Tcomponent>(m_updating.data(), m_updating.size()));
+        }
+
+        void setUpdating(uint32_t index, bool isUpdating) override
+        {
+            if (m_states[index] == STATE_FREE) return;
+            m_states[index] = isUpdating ? STATE_UPDATING : STATE_USED;
+            m_isDirty = true;
+        }
+
+        void release(uint32_t index)
+        {
+            m_states[index] = STATE_FREE;
+            m_freeIndices.push_back(index);
+            m_isDirty = true;
+        }
+
+        void grow()
+        {
+            auto first = static_cast<uint32_t>(m_states.size());
+            m_chunks.emplace_back(new Slot[CHUNK_SIZE]);
+            m_states.resize(first + CHUNK_SIZE, STATE_FREE);
+
+            // Lowest indices are used first
+            for (auto i = first + CHUNK_SIZE; i > first; --i)
+            {
+                m_freeIndices.push_back(i - 1);
+            }
+        }
+
+        Tcomponent* getSlot(uint32_t index)
+        {
+            return reinterpret_cast<Tcomponent*>(&m_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE]);
+        }
+
+        std::vector<std::unique_ptr<Slot[]>> m_chunks;
+        std::vector<uint8_t> m_states; // By index
+        std::vector<uint32_t> m_freeIndices;
+        std::vector<Tcomponent*> m_updating;
+        bool m_isDirty = false;
+    };
+}
+
+template<typename Tcomponent>
+using OComponentSpan = onut::ComponentSpan<Tcomponent>;
+
+#endif
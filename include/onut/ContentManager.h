@@ -1,7 +1,11 @@
 #ifndef CONTENTMANAGER_H_INCLUDED
 #define CONTENTMANAGER_H_INCLUDED
 
+// Onut
+#include <onut/Point.h>
+
 // STL
+#include <cinttypes>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -11,6 +15,8 @@
 #include <onut/ForwardDeclaration.h>
 OForwardDeclare(ContentManager);
 OForwardDeclare(Resource);
+OForwardDeclare(Texture);
+OForwardDeclare(TextureAtlas);
 
 namespace onut
 {
@@ -40,6 +46,22 @@ namespace onut
         std::string findResourceFile(const std::string& name);
         const SearchPaths& getSearchPaths() const;
 
+        // Texture atlas
+        /**
+        Textures loaded from files with both dimensions up to this size are packed into the texture atlas.
+        0 disables packing (Default).
+        */
+        void setMaxAtlasTextureSize(int size);
+        int getMaxAtlasTextureSize() const;
+        void setTextureAtlas(const OTextureAtlasRef& pTextureAtlas);
+        OTextureAtlasRef getTextureAtlas();
+
+        /**
+        Used by texture loading. Created with default settings if none was set.
+        @return the packed texture, or nullptr if it shouldn't or can't be packed
+        */
+        OTextureRef packTexture(const uint8_t* pData, const Point& size);
+
     private:
         ContentManager();
 
@@ -47,6 +69,8 @@ namespace onut
 
         ResourceMap m_resources;
         SearchPaths m_searchPaths;
+        OTextureAtlasRef m_pTextureAtlas;
+        int m_maxAtlasTextureSize = 0;
         std::mutex m_mutex;
     };
 
@@ -2,9 +2,16 @@
 #define DISPATCHER_H_INCLUDED
 
 // STL
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
@@ -12,28 +19,156 @@ OForwardDeclare(Dispatcher)
 
 namespace onut
 {
+    /**
+    Queue of callbacks, filled from any thread and processed by one.
+    Callbacks are kept in a fixed ring without locking. If it is full they wait in a locked overflow list,
+    so dispatch never fails nor blocks on the processing thread.
+    */
     class Dispatcher
     {
     public:
+        /**
+        Move only void() callable. Captures up to BUFFER_SIZE bytes are stored inline, bigger ones on the heap.
+        */
+        class Callback final
+        {
+        public:
+            static const size_t BUFFER_SIZE = 48;
+
+            Callback() = default;
+
+            template<typename Tfn, typename = typename std::enable_if<!std::is_same<typename std::decay<Tfn>::type, Callback>::value>::type>
+            Callback(Tfn&& fn)
+            {
+                using Tstored = typename std::decay<Tfn>::type;
+                store<Tstored>(std::forward<Tfn>(fn), std::integral_constant<bool, isInline<Tstored>()>());
+            }
+
+            Callback(Callback&& other) noexcept
+            {
+                moveFrom(other);
+            }
+
+            Callback& operator=(Callback&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    reset();
+                    moveFrom(other);
+                }
+                return *this;
+            }
+
+            Callback(const Callback&) = delete;
+            Callback& operator=(const Callback&) = delete;
+
+            ~Callback()
+            {
+                reset();
+            }
+
+            void operator()() { m_pInvoke(m_buffer); }
+            explicit operator bool() const { return m_pInvoke != nullptr; }
+
+            void reset()
+            {
+                if (m_pManage) m_pManage(Operation::Destroy, nullptr, m_buffer);
+                m_pInvoke = nullptr;
+                m_pManage = nullptr;
+            }
+
+        private:
+            enum class Operation
+            {
+                Move, // Move source into destination, then destroy source
+                Destroy
+            };
+
+            using Invoke = void(*)(void* pStorage);
+            using Manage = void(*)(Operation operation, void* pDst, void* pSrc);
+
+            template<typename Tstored>
+            static constexpr bool isInline()
+            {
+                return sizeof(Tstored) <= BUFFER_SIZE &&
+                    alignof(Tstored) <= alignof(std::max_align_t) &&
+                    std::is_nothrow_move_constructible<Tstored>::value;
+            }
+
+            template<typename Tstored, typename Tfn>
+            void store(Tfn&& fn, std::true_type)
+            {
+                new(m_buffer) Tstored(std::forward<Tfn>(fn));
+                m_pInvoke = [](void* pStorage) { (*static_cast<Tstored*>(pStorage))(); };
+                m_pManage = [](Operation operation, void* pDst, void* pSrc)
+                {
+                    auto pFn = static_cast<Tstored*>(pSrc);
+                    if (operation == Operation::Move) new(pDst) Tstored(std::move(*pFn));
+                    pFn->~Tstored();
+                };
+            }
+
+            template<typename Tstored, typename Tfn>
+            void store(Tfn&& fn, std::false_type)
+            {
+                new(m_buffer) Tstored*(new Tstored(std::forward<Tfn>(fn)));
+                m_pInvoke = [](void* pStorage) { (**static_cast<Tstored**>(pStorage))(); };
+                m_pManage = [](Operation operation, void* pDst, void* pSrc)
+                {
+                    auto ppFn = static_cast<Tstored**>(pSrc);
+                    if (operation == Operation::Move) new(pDst) Tstored*(*ppFn);
+                    else delete *ppFn;
+                };
+            }
+
+            void moveFrom(Callback& other)
+            {
+                if (other.m_pManage) other.m_pManage(Operation::Move, m_buffer, other.m_buffer);
+                m_pInvoke = other.m_pInvoke;
+                m_pManage = other.m_pManage;
+                other.m_pInvoke = nullptr;
+                other.m_pManage = nullptr;
+            }
+
+            alignas(std::max_align_t) unsigned char m_buffer[BUFFER_SIZE];
+            Invoke m_pInvoke = nullptr;
+            Manage m_pManage = nullptr;
+        };
+
+        // Callbacks in the lock free ring
+        static const size_t CAPACITY = 1024;
+
+        // Callbacks taken out of the ring at once by processQueue()
+        static const size_t BATCH_SIZE = 32;
+
         static ODispatcherRef create();
 
         Dispatcher();
 
         /**
         Synchronise to the calling thread.
-        The function and arguments passed here, will be queued and called next time invokeQueue() is called.
+        The function and arguments passed here, will be queued and called next time processQueue() is called.
+        Callbacks from one thread are called in the order they were dispatched.
         @param callback Function or your usual lambda
         @param args arguments
         */
-        void dispatch(const std::function<void()>& fn)
+        template<typename Tfn>
+        void dispatch(Tfn&& fn)
         {
-            m_mutex.lock();
-            m_callbackQueue.push(fn);
-            m_mutex.unlock();
+            Callback callback(std::forward<Tfn>(fn));
+            push(callback);
+        }
+
+        template<typename Tfn, typename ... Targs>
+        void dispatch(Tfn&& fn, Targs&&... args)
+        {
+            Callback callback(std::bind(std::forward<Tfn>(fn), std::forward<Targs>(args)...));
+            push(callback);
         }
 
         /**
-        Call all currently queued callbacks set using sync() calls.
+        Call all currently queued callbacks set using dispatch() calls.
+        Only one thread at a time can process the queue.
         */
         void processQueue();
 
@@ -45,17 +180,32 @@ namespace onut
         std::thread::id getThreadId() const;
 
     private:
-        std::mutex m_mutex;
-        std::queue<std::function<void()>> m_callbackQueue;
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            Callback callback;
+        };
+
+        void push(Callback& callback);
+        bool tryPush(Callback& callback);
+        bool tryPop(Callback& callback);
+
+        std::unique_ptr<Cell[]> m_pCells;
+        alignas(64) std::atomic<size_t> m_enqueuePos;
+        alignas(64) std::atomic<size_t> m_dequeuePos;
+        alignas(64) std::atomic<size_t> m_overflowCount;
+        std::mutex m_overflowMutex;
+        std::deque<Callback> m_overflow;
         std::thread::id m_threadId;
     };
 }
 
 extern ODispatcherRef oDispatcher;
 
-inline void OSync(const std::function<void()>& callback)
+template<typename Tfn>
+inline void OSync(Tfn&& callback)
 {
-    oDispatcher->dispatch(callback);
+    oDispatcher->dispatch(std::forward<Tfn>(callback));
 }
 
 #endif
@@ -2,12 +2,16 @@
 #define ENTITY_H_INCLUDED
 
 // Onut includes
+#include <onut/ComponentSystem.h>
 #include <onut/Maths.h>
 
 // Third parties
 #include <list/List.h>
 
 // STL
+#include <cinttypes>
+#include <string>
+#include <typeinfo>
 #include <unordered_map>
 #include <vector>
 
@@ -20,6 +24,37 @@ OForwardDeclare(SceneManager);
 
 namespace onut
 {
+    using ComponentTypeId = uint32_t;
+
+    /**
+    Small sequential id of a component class, from 1. Thread safe.
+    */
+    ComponentTypeId getComponentTypeId(const std::type_info& typeInfo);
+
+    template<typename Tcomponent>
+    ComponentTypeId getComponentTypeId()
+    {
+        static const auto typeId = getComponentTypeId(typeid(Tcomponent));
+        return typeId;
+    }
+
+    /**
+    Entity names and tags are interned, so they are compared and hashed as ids.
+    Interned strings are kept for the whole run.
+    */
+    using EntityNameId = uint32_t;
+
+    /**
+    @return the id of that name or tag, interning it the first time. 0 for the empty string. Thread safe.
+    */
+    EntityNameId getEntityNameId(const std::string& name);
+
+    /**
+    Same as getEntityNameId() without interning
+    @return 0 if that string was never interned
+    */
+    EntityNameId findEntityNameId(const std::string& name);
+
     class Entity final : public std::enable_shared_from_this<Entity>
     {
     public:
@@ -32,11 +67,18 @@ namespace onut
         void destroy();
         OEntityRef copy() const;
 
+        /**
+        Transforms are stored by the scene. Returned references are only valid until entities are
+        created, destroyed or moved in the hierarchy.
+        */
         const Matrix& getLocalTransform() const;
         const Matrix& getWorldTransform();
         void setLocalTransform(const Matrix& localTransform);
         void setWorldTransform(const Matrix& worldTransform);
 
+        /**
+        Entities stay in the scene they were created in. The child must be in the same one.
+        */
         void add(const OEntityRef& pChild);
         void remove(const OEntityRef& pChild);
         void remove();
@@ -50,31 +92,40 @@ namespace onut
         void setStatic(bool isStatic);
 
         const std::string getName() const;
+        EntityNameId getNameId() const { return m_nameId; }
         void setName(const std::string& name);
 
+        void addTag(const std::string& tag);
+        void removeTag(const std::string& tag);
+        bool hasTag(const std::string& tag) const;
+
+        /**
+        Components are indexed by the class they were created as, lookups don't match base classes.
+        */
         template<typename Tcomponent>
         std::shared_ptr<Tcomponent> getComponent() const
         {
-            for (auto& pComponent : m_components)
-            {
-                if (dynamic_cast<Tcomponent*>(pComponent.get()))
-                {
-                    return ODynamicCast<Tcomponent>(pComponent);
-                }
-            }
-            return nullptr;
+            auto index = findComponent(getComponentTypeId<Tcomponent>());
+            if (index < 0) return nullptr;
+            return OStaticCast<Tcomponent>(m_components[index]);
+        }
+
+        /**
+        Same as getComponent() without touching the reference count. For per frame lookups.
+        */
+        template<typename Tcomponent>
+        Tcomponent* getComponentPtr() const
+        {
+            auto index = findComponent(getComponentTypeId<Tcomponent>());
+            if (index < 0) return nullptr;
+            return static_cast<Tcomponent*>(m_components[index].get());
         }
 
         template<typename Tcomponent>
         std::shared_ptr<Tcomponent> getParentComponent() const
         {
-            for (auto& pComponent : m_components)
-            {
-                if (dynamic_cast<Tcomponent*>(pComponent.get()))
-                {
-                    return ODynamicCast<Tcomponent>(pComponent);
-                }
-            }
+            auto index = findComponent(getComponentTypeId<Tcomponent>());
+            if (index >= 0) return OStaticCast<Tcomponent>(m_components[index]);
             auto pParent = getParent();
             if (pParent)
             {
@@ -88,8 +139,17 @@ namespace onut
         {
             auto pComponent = getComponent<Tcomponent>();
             if (pComponent) return pComponent;
-            pComponent = std::shared_ptr<Tcomponent>(new Tcomponent());
-            addComponent(pComponent);
+            auto typeId = getComponentTypeId<Tcomponent>();
+            auto pSystem = findComponentSystem(typeId);
+            if (pSystem)
+            {
+                pComponent = static_cast<TComponentSystem<Tcomponent>*>(pSystem)->create();
+            }
+            else
+            {
+                pComponent = std::shared_ptr<Tcomponent>(new Tcomponent());
+            }
+            addComponent(pComponent, typeId);
             return pComponent;
         }
 
@@ -106,20 +166,52 @@ namespace onut
     private:
         friend class Component;
         friend class SceneManager;
+        friend class TransformSystem;
 
         using Components = std::vector<OComponentRef>;
 
+        struct ComponentIndex
+        {
+            ComponentTypeId typeId;
+            int index; // In m_components
+        };
+        using ComponentIndices = std::vector<ComponentIndex>;
+
         Entity();
 
-        void dirtyWorld();
+        /**
+        @return index in m_components of the first component of that type, or -1
+        */
+        int findComponent(ComponentTypeId typeId) const
+        {
+            // Most lookups are for components the entity doesn't have
+            if (!(m_componentTypeMask & (1ull << (typeId & 63)))) return -1;
+            for (const auto& componentIndex : m_componentIndices)
+            {
+                if (componentIndex.typeId >= typeId)
+                {
+                    return componentIndex.typeId == typeId ? componentIndex.index : -1;
+                }
+            }
+            return -1;
+        }
+
+        void addComponent(const OComponentRef& pComponent, ComponentTypeId typeId);
+
+        /**
+        @return the scene's storage for that type, if one was registered
+        */
+        ComponentSystem* findComponentSystem(ComponentTypeId typeId) const;
+
+        void onWorldChanged();
         void render2d();
         void onTriggerEnter(const OCollider2DComponentRef& pCollider);
         void onTriggerLeave(const OCollider2DComponentRef& pCollider);
 
-        bool m_isWorldDirty = true;
-        Matrix m_localTransform;
-        Matrix m_worldTransform;
+        uint32_t m_transformId = 0xFFFFFFFF; // In the scene's TransformSystem
         Components m_components;
+        ComponentIndices m_componentIndices; // Sorted by type
+        uint64_t m_componentTypeMask = 0; // Bit typeId % 64 of every type in m_componentIndices
         Entities m_children;
         OEntityWeak m_pParent;
         OSceneManagerRef m_pSceneManager;
@@ -128,6 +220,9 @@ namespace onut
         bool m_isStatic = false;
         int m_drawIndex = 0;
         std::string m_name;
+        EntityNameId m_nameId = 0;
+        std::vector<EntityNameId> m_tags;
+        uint32_t m_queryIndex = 0xFFFFFFFF; // In the scene's indices, if it is in them
     };
 };
 
@@ -7,6 +7,7 @@
 
 // STL
 #include <unordered_map>
+#include <vector>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
@@ -22,6 +23,8 @@ namespace onut
     class Font final : public Resource, public std::enable_shared_from_this<Font>
     {
     public:
+        static const int GLYPH_TABLE_SIZE = 256;
+
         static OFontRef createFromFile(const std::string& filename, const OContentManagerRef& pContentManager);
 
         ~Font();
@@ -46,6 +49,8 @@ namespace onut
                           const OSpriteBatchRef& pSpriteBatch = nullptr);
 
     private:
+        friend class TextLayout;
+
         struct fntCommon
         {
             int lineHeight = 0;
@@ -83,10 +88,18 @@ namespace onut
         static int parseInt(const std::string& arg, const std::vector<std::string>& lineSplit);
         static std::string parseString(const std::string& arg, const std::vector<std::string>& lineSplit);
 
+        const fntChar* getGlyph(int charId) const
+        {
+            if (charId >= 0 && charId < GLYPH_TABLE_SIZE) return m_glyphTable[charId];
+            auto it = m_chars.find(charId);
+            return (it == m_chars.end()) ? nullptr : it->second;
+        }
+
         fntCommon m_common;
         fntPage** m_pages = nullptr;
         int m_charsCount = 0;
         std::unordered_map<int, fntChar*> m_chars;
+        fntChar* m_glyphTable[GLYPH_TABLE_SIZE] = {nullptr}; // Direct lookup for the single byte characters
     };
 }
 
@@ -13,8 +13,8 @@ namespace onut
     class IndexBuffer : public Resource
     {
     public:
-        static OIndexBufferRef createStatic(const void* pIndexData, uint32_t size);
-        static OIndexBufferRef createDynamic(uint32_t size);
+        static OIndexBufferRef createStatic(const void* pIndexData, uint32_t size, uint32_t elementSize = 16);
+        static OIndexBufferRef createDynamic(uint32_t size, uint32_t elementSize = 16);
 
         virtual ~IndexBuffer();
 
@@ -23,8 +23,15 @@ namespace onut
         virtual void unmap(uint32_t size) = 0;
         virtual uint32_t size() = 0;
 
+        /**
+        @return Size of one index, in bits. 16 or 32.
+        */
+        uint32_t getElementSize() const { return m_elementSize; }
+
     protected:
         IndexBuffer();
+
+        uint32_t m_elementSize = 16;
     };
 };
 
@@ -11,6 +11,7 @@
 #include <rapidjson/document.h>
 
 // STL
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -49,6 +50,15 @@ namespace onut
         }
     }
 
+    template<typename Ttype>
+    static void pfxReadBool(Ttype& out, const rapidjson::Value& node)
+    {
+        if (!node.IsNull())
+        {
+            out = node.GetBool();
+        }
+    }
+
     template<typename TenumType>
     static void pfxReadEnum(TenumType& out, const rapidjson::Value& node, const std::unordered_map<std::string, TenumType>& enumMap)
     {
@@ -111,21 +121,122 @@ namespace onut
         {
             return randt<Ttype>(from, to);
         }
+
+        Ttype generate(RandomStream& random) const
+        {
+            return random.randt<Ttype>(from, to);
+        }
+    };
+
+    // Interpolation factors are per channel for colors
+    template<typename Ttype>
+    struct sPfxFactor
+    {
+        using Type = float;
+        static float splat(float t) { return t; }
+    };
+
+    template<>
+    struct sPfxFactor<Color>
+    {
+        using Type = Color;
+        static Color splat(float t) { return Color(t, t, t, t); }
+    };
+
+    /**
+    Factors to go from a particle's start value to its final value over its life, baked in a table.
+    Sampled with the normalized age, linearly interpolated between entries without any branch.
+    */
+    template<typename Tfactor>
+    struct sPfxCurve
+    {
+        static const int SIZE = 64;
+
+        Tfactor table[SIZE + 1]; // The last entry is repeated, so the next one is always valid
+
+        template<typename Tfn>
+        void bake(Tfn fn)
+        {
+            for (int i = 0; i < SIZE; ++i)
+            {
+                table[i] = fn(static_cast<float>(i) / static_cast<float>(SIZE - 1));
+            }
+            table[SIZE] = table[SIZE - 1];
+        }
+
+        /**
+        @param t 0 to 1
+        */
+        Tfactor sample(float t) const
+        {
+            auto x = t * static_cast<float>(SIZE - 1);
+            auto i = static_cast<int>(x);
+            return OLerp(table[i], table[i + 1], x - static_cast<float>(i));
+        }
     };
 
+    /**
+    A value animated over the life of a particle. It goes from a start value to a final value following the tween,
+    or, if it has curve keys, the start value is multiplied by the curve.
+    Either way, it is baked in a curve of factors between the two. Call bake() after changing tween or keys.
+    */
     template<typename Ttype>
     struct sPfxValue
     {
+        using Factor = typename sPfxFactor<Ttype>::Type;
+
+        struct Key
+        {
+            float t; // 0 to 1 over the life of the particle
+            Factor value; // Multiplies the start value
+        };
+
+        using Keys = std::vector<Key>;
+
         sPfxRange<Ttype> value;
         sPfxRange<Ttype> finalValue;
         bool finalSpecified = false;
         Tween tween = Tween::Linear;
         PfxFinalValueType finalValueType = PfxFinalValueType::NORMAL;
+        Keys keys; // Sorted by t
+        sPfxCurve<Factor> curve;
 
         sPfxValue(const Ttype& other) :
             value(other),
             finalValue(other)
         {
+            bake();
+        }
+
+        bool isLinear() const { return keys.empty() && tween == Tween::Linear; }
+
+        void bake()
+        {
+            if (keys.empty())
+            {
+                auto tween = this->tween;
+                curve.bake([tween](float t) { return sPfxFactor<Ttype>::splat(applyTween(t, tween)); });
+                return;
+            }
+
+            // The final value is 0, so the factors bring the start value down to start * key
+            const auto& keys = this->keys;
+            curve.bake([&keys](float t)
+            {
+                auto one = sPfxFactor<Ttype>::splat(1.f);
+                if (t <= keys.front().t) return one - keys.front().value;
+                for (size_t i = 1; i < keys.size(); ++i)
+                {
+                    const auto& from = keys[i - 1];
+                    const auto& to = keys[i];
+                    if (t <= to.t)
+                    {
+                        auto keyT = to.t > from.t ? (t - from.t) / (to.t - from.t) : 1.f;
+                        return one - OLerp(from.value, to.value, keyT);
+                    }
+                }
+                return one - keys.back().value;
+            });
         }
 
         sPfxValue<Ttype>& operator=(const Ttype& other)
@@ -165,6 +276,41 @@ namespace onut
             }
         }
 
+        Ttype generateFrom(RandomStream& random) const
+        {
+            return value.generate(random);
+        }
+
+        Ttype generateTo(RandomStream& random) const
+        {
+            return finalValue.generate(random);
+        }
+
+        Ttype generateTo(const Ttype& from, RandomStream& random) const
+        {
+            if (!keys.empty())
+            {
+                return from - from;
+            }
+            if (finalSpecified)
+            {
+                switch (finalValueType)
+                {
+                    case PfxFinalValueType::MULT:
+                        return from * generateTo(random);
+                    case PfxFinalValueType::ADD:
+                        return from + generateTo(random);
+                    case PfxFinalValueType::NORMAL:
+                        return generateTo(random);
+                }
+                return Ttype();
+            }
+            else
+            {
+                return from;
+            }
+        }
+
         sPfxValue<Ttype>& operator=(const rapidjson::Value& node)
         {
             if (!node.IsNull())
@@ -198,7 +344,20 @@ namespace onut
                             });
                         }
                     }
+                    if (node.HasMember("curve"))
+                    {
+                        // [{"t": 0, "value": 1}, {"t": 1, "value": 0}]
+                        const auto& curveNode = node["curve"];
+                        keys.clear();
+                        for (decltype(curveNode.Size()) i = 0; i < curveNode.Size(); ++i)
+                        {
+                            const auto& keyNode = curveNode[i];
+                            keys.push_back({static_cast<float>(keyNode["t"].GetDouble()), sPfxValueUtils<Factor>::getNodeValue(keyNode["value"])});
+                        }
+                        std::stable_sort(keys.begin(), keys.end(), [](const Key& a, const Key& b) { return a.t < b.t; });
+                    }
                 }
+                bake();
             }
             return *this;
         }
@@ -242,15 +401,24 @@ namespace onut
         sPfxValue<float> radialAccel = 0;
         sPfxValue<float> tangentAccel = 0;
         AccelType accelType = AccelType::Gravity;
+        bool sortParticles = false; // Draw back to front along the manager's camera direction, for alpha blended effects
+        float importance = 1.f; // Share of the particle budget compared to other emitters, when it runs out
+        float cullRadius = 0.f; // Reach of the particles around the emitter, for off-screen culling. 0 estimates it.
+
+        /**
+        Bake the curves of the animated values. Loaders and ParticleSystem::create do it.
+        */
+        void bake();
     };
 
     class ParticleSystem final : public Resource
     {
     public:
-        static OParticleSystemRef createFromFile(const std::string& filename, const OContentManagerRef &pContentManager = nullptr);
-
         using Emitters = std::vector<OParticleEmitterDescRef>;
 
+        static OParticleSystemRef create(const Emitters& emitters);
+        static OParticleSystemRef createFromFile(const std::string& filename, const OContentManagerRef &pContentManager = nullptr);
+
         const Emitters& getEmitters() const;
 
     private:
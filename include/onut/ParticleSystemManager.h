@@ -1,6 +1,14 @@
 #ifndef PARTICLESYSTEMMANAGER_H_INCLUDED
 #define PARTICLESYSTEMMANAGER_H_INCLUDED
 
+// Onut
+#include <onut/Maths.h>
+#include <onut/Random.h>
+
+// STL
+#include <cinttypes>
+#include <vector>
+
 // Forward
 #include <onut/ForwardDeclaration.h>
 OForwardDeclare(ParticleSystem)
@@ -9,15 +17,33 @@ OForwardDeclare(Pool)
 
 namespace onut
 {
-    class Particle;
+    class ParticleEmitter;
 
     class ParticleSystemManager : public std::enable_shared_from_this<ParticleSystemManager>
     {
     public:
+        static const float DEFAULT_WARM_UP_TIME;
+
+        struct Stats
+        {
+            uint32_t emitterCount = 0;
+            uint32_t culledEmitterCount = 0; // Off-screen, not simulated
+            uint32_t throttledEmitterCount = 0; // Spawned less than they asked because of the budget
+            uint32_t particleCount = 0;
+            uint32_t requestedCount = 0; // Particles the emitters asked to spawn
+            uint32_t grantedCount = 0;
+            float pressure = 0.f; // Alive plus asked particles over the budget. Above 1, spawn rates are scaled down.
+        };
+
         static OParticleSystemManagerRef create(uintptr_t TmaxPFX = 100, uintptr_t TmaxParticles = 2000, bool TsortEmitters = false);
 
         ParticleSystemManager(uintptr_t TmaxPFX = 100, uintptr_t TmaxParticles = 2000, bool TsortEmitters = false);
 
+        /**
+        Handle to the emitters spawned by one emit() call. It is resolved in constant time.
+        Once all its emitters are dead, the handle goes stale and its methods do nothing,
+        even if its slot was reused by a newer instance.
+        */
         class EmitterInstance
         {
         public:
@@ -32,30 +58,130 @@ namespace onut
         private:
             friend class ParticleSystemManager;
 
-            uint32_t m_id = 0;
+            uint32_t m_index = 0;
+            uint32_t m_generation = 0; // Never 0 for a valid instance
             ParticleSystemManager* m_pParticleSystemManager = nullptr;
             bool m_bStopped = false;
         };
 
         EmitterInstance emit(const OParticleSystemRef& pParticleSystem, const Vector3& pos, const Vector3& dir = Vector3::UnitZ);
         void clear();
+
+        /**
+        Simulate all emitters. Large workloads are split in jobs on oThreadPool.
+        Each emitter has its own random stream, seeded from the manager's seed when emitted,
+        so the result is the same whatever the number of threads.
+        When the emitters' spawn rates would keep more particles alive than the budget, they share it by
+        priority: their desc's importance, lowered by their distance to the view. The most important ones
+        keep their full rate, the others have it scaled down.
+        */
         void update();
+        void setSeed(uint32_t seed) { m_seeds.setSeed(seed); }
+
         bool hasAliveParticles() const;
+
+        /**
+        Draw all emitters. If sorting emitters, they are drawn back to front along the camera direction,
+        so alpha blended effects overlap correctly. Emitters with sortParticles also sort their own particles.
+        */
         void render();
 
-        Particle* allocParticle();
-        void deallocParticle(Particle* pParticle);
-        void renderParticle(Particle* pParticle, const Vector3& camRight, const Vector3& camUp);
+        /**
+        Direction the camera looks at, the depth used for sorting. Defaults to +Z.
+        In 2D, -Y makes what's higher on screen draw first.
+        */
+        void setCameraDir(const Vector3& cameraDir) { m_cameraDir = cameraDir; }
+        const Vector3& getCameraDir() const { return m_cameraDir; }
+
+        /**
+        World rectangle seen by the camera. Emitters whose particles can't reach it are not simulated
+        nor drawn, once they are older than the warm up time. When they come back in view, they catch up
+        in one step. An empty rectangle, the default, disables culling.
+        */
+        void setView(const Rect& view) { m_view = view; }
+        const Rect& getView() const { return m_view; }
+        void setWarmUpTime(float warmUpTime) { m_warmUpTime = warmUpTime; }
+        float getWarmUpTime() const { return m_warmUpTime; }
+
+        /**
+        @return counters of the last update
+        */
+        const Stats& getStats() const { return m_stats; }
+
+        /**
+        Reserve a particle from the global budget. Particles themselves are stored by their emitter.
+        @return false if the budget is used up
+        */
+        bool allocParticle();
+        void deallocParticles(uintptr_t count);
+        uintptr_t getParticleCount() const { return m_particleCount; }
 
     private:
         friend class EmitterInstance;
 
+        struct InstanceSlot
+        {
+            uint32_t generation = 1; // Incremented every time the slot is released
+            std::vector<ParticleEmitter*> emitters;
+        };
+
+        // Particles of an emitter handled by one job
+        struct EmitterRange
+        {
+            ParticleEmitter* pEmitter;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+        struct BudgetItem
+        {
+            float priority;
+            uint32_t index; // In m_activeEmitters
+        };
+
+        struct EmitterSortItem
+        {
+            uint16_t key; // Quantized depth, 0 is the furthest
+            ParticleEmitter* pEmitter;
+        };
+
+        using InstanceSlots = std::vector<InstanceSlot>;
+        using FreeInstanceSlots = std::vector<uint32_t>;
+        using Emitters = std::vector<ParticleEmitter*>;
+        using EmitterRanges = std::vector<EmitterRange>;
+        using SpawnCounts = std::vector<uint32_t>;
+        using EmitterSortItems = std::vector<EmitterSortItem>;
+        using BudgetItems = std::vector<BudgetItem>;
+
         void updateEmitters();
+        void updateEmitter(ParticleEmitter* pEmitter, float dt);
+        uint32_t grantParticles(uint32_t count);
+        void shareBudget();
+        bool isCulled(ParticleEmitter* pEmitter) const;
+        float getPriority(ParticleEmitter* pEmitter) const;
+        void fastForwardEmitter(ParticleEmitter* pEmitter);
+        uint32_t buildEmitterRanges();
+        void sortEmitters();
+        InstanceSlot* getInstanceSlot(const EmitterInstance& instance);
+        void destroyEmitter(ParticleEmitter* pEmitter);
+        void releaseInstanceSlot(uint32_t index);
 
         OPoolRef m_pEmitterPool;
-        OPoolRef m_pParticlePool;
-        Vector3 m_camRight;
-        Vector3 m_camUp;
+        InstanceSlots m_instanceSlots;
+        FreeInstanceSlots m_freeInstanceSlots;
+        uintptr_t m_maxParticles;
+        uintptr_t m_particleCount = 0;
+        RandomStream m_seeds;
+        Emitters m_activeEmitters;
+        EmitterRanges m_emitterRanges;
+        SpawnCounts m_spawnCounts;
+        EmitterSortItems m_emitterSortItems;
+        EmitterSortItems m_emitterSortScratch;
+        Vector3 m_cameraDir = Vector3::UnitZ;
+        BudgetItems m_budgetItems;
+        Rect m_view = Rect(0, 0, 0, 0);
+        float m_warmUpTime = DEFAULT_WARM_UP_TIME;
+        Stats m_stats;
         bool m_sortEmitters;
     };
 }
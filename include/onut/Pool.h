@@ -2,8 +2,14 @@
 #define POOL_H_INCLUDED
 
 // STL
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
@@ -11,141 +17,213 @@ OForwardDeclare(Pool);
 
 namespace onut
 {
+    template<typename Ttype> class TPool;
+
+    /**
+    Fixed size objects allocated in constant time from an intrusive free list: a free slot holds the next free one.
+    Each slot also has a used flag, so the pool can be iterated with size(), at() and isUsed().
+    clear() doesn't destroy the objects.
+    */
     class Pool final
     {
     public:
         enum class FailAction
         {
-            AllocateOnHeap,
+            Grow, // Add a chunk, twice as big as the last one
             ReturnNull,
-            Assert
+            Assert,
+            AllocateOnHeap = Grow // Deprecated. Objects are never allocated outside the pool anymore.
         };
 
-        static OPoolRef create(size_t objSize = 256, size_t objCount = 256, FailAction failAction = FailAction::ReturnNull);
+        // Free slots a thread keeps for itself in a thread safe pool
+        static const size_t MAGAZINE_SIZE = 32;
+
+        /**
+        @param objCount Objects in the first chunk
+        @param isThreadSafe alloc and dealloc can be called from any thread, objects can be freed by another
+               thread than the one that allocated them. Each thread caches free slots in its own magazine
+               and only locks the pool when it is empty or full. clear() is still not thread safe.
+        @param alignment Of the objects, a power of 2
+        */
+        static OPoolRef create(size_t objSize = 256, size_t objCount = 256, FailAction failAction = FailAction::ReturnNull, bool isThreadSafe = false, size_t alignment = sizeof(uintptr_t));
 
-        Pool(size_t objSize = 256, size_t objCount = 256, FailAction failAction = FailAction::ReturnNull);
+        Pool(size_t objSize = 256, size_t objCount = 256, FailAction failAction = FailAction::ReturnNull, bool isThreadSafe = false, size_t alignment = sizeof(uintptr_t));
         ~Pool();
 
         template<typename Ttype, typename ... Targs>
         Ttype* alloc(Targs... args)
         {
-            // Are there still room?
-            if (m_allocCount == m_objCount)
-            {
-                switch (m_failAction)
-                {
-                    case FailAction::AllocateOnHeap:
-                        return new Ttype(args...);
-                    case FailAction::ReturnNull:
-                        return nullptr;
-                    case FailAction::Assert:
-                        assert(false); // No more memory available in the pool. Use bigger pool
-                        return nullptr;
-                }
-            }
-
             // Make sure we are not trying to allocate an object too big
-            auto objSize = sizeof(Ttype);
-            if (objSize > m_objSize)
+            if (sizeof(Ttype) > m_objSize || alignof(Ttype) > m_alignment)
             {
-                switch (m_failAction)
-                {
-                    case FailAction::AllocateOnHeap:
-                        return new Ttype(args...);
-                    case FailAction::ReturnNull:
-                        return nullptr;
-                    case FailAction::Assert:
-                        assert(false); // No more memory available in the pool. Use bigger pool
-                        return nullptr;
-                }
+                assert(m_failAction != FailAction::Assert); // Object too big for this pool
+                return nullptr;
             }
 
-            // Loop the pool from the last time.
-            auto startPoint = m_currentObjIndex;
-            do
-            {
-                ++m_currentObjIndex;
-                // Wrap
-                if (m_currentObjIndex >= m_objCount)
-                {
-                    m_currentObjIndex = 0;
-                }
-                auto pObj = m_pFirstObj + m_currentObjIndex * m_objTotalSize;
-                auto used = pObj + m_objSize;
-
-                if (!*used)
-                {
-                    // Found one!
-                    *used = 1;
-                    Ttype* pRet = new(pObj)Ttype(args...);
-                    ++m_allocCount;
-                    return pRet;
-                }
-            } while (startPoint != m_currentObjIndex);
-
-            switch (m_failAction)
+            auto pSlot = allocSlot();
+            if (!pSlot) return nullptr;
+            return new(pSlot)Ttype(args...);
+        }
+
+        /**
+        @return false if the object is null, already freed or not from this pool
+        */
+        template<typename Ttype>
+        bool dealloc(Ttype* pObj)
+        {
+            auto pSlot = reinterpret_cast<uint8_t*>(pObj);
+            if (!pSlot || !owns(pSlot) || !pSlot[m_usedOffset]) return false;
+            pObj->~Ttype();
+            deallocSlot(pSlot);
+            return true;
+        }
+
+        void clear();
+        size_t getAllocCount() const { return m_allocCount.load(std::memory_order_relaxed); }
+        void* getRawPointer() const { return m_chunks[0]; }
+        bool isUsed(void* pObject) const { return static_cast<uint8_t*>(pObject)[m_usedOffset] != 0; }
+        size_t size() const { return m_capacity.load(std::memory_order_acquire); }
+
+        void* operator[](size_t index) const
+        {
+            size_t chunk = 0;
+            auto chunkSize = m_objCount;
+            while (index >= chunkSize)
             {
-                case FailAction::AllocateOnHeap:
-                    return new Ttype(args...);
-                case FailAction::ReturnNull:
-                    return nullptr;
-                case FailAction::Assert:
-                    assert(false); // No more memory available in the pool. Use bigger pool
-                    return nullptr;
+                index -= chunkSize;
+                chunkSize *= 2;
+                ++chunk;
             }
-
-            return nullptr;
+            return m_chunks[chunk] + index * m_objTotalSize;
         }
 
         template<typename Ttype>
-        bool dealloc(Ttype* pObj)
+        Ttype* at(size_t index) const
+        {
+            return reinterpret_cast<Ttype*>((*this)[index]);
+        }
+
+        /**
+        @return true if the pointer is the start of a slot of this pool, used or not
+        */
+        bool owns(const void* pObject) const;
+
+    private:
+        template<typename Ttype> friend class TPool;
+
+        static const int MAX_CHUNKS = 32;
+
+        struct Magazine;
+        using Magazines = std::vector<std::unique_ptr<Magazine>>;
+
+        uint8_t* allocSlot()
         {
-            if (pObj == nullptr)
+            if (m_isThreadSafe) return allocSlotThreadSafe();
+
+            auto pSlot = m_pFreeList;
+            if (!pSlot)
             {
-                return false;
+                if (!grow()) return nullptr;
+                pSlot = m_pFreeList;
             }
-            auto ptr = reinterpret_cast<uint8_t*>(pObj);
-            if (ptr >= m_pMemory &&
-                ptr < m_pMemory + m_memorySize)
+            m_pFreeList = getNext(pSlot);
+            pSlot[m_usedOffset] = 1;
+            m_allocCount.store(m_allocCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return pSlot;
+        }
+
+        void deallocSlot(uint8_t* pSlot)
+        {
+            if (m_isThreadSafe)
             {
-                pObj->~Ttype();
-                auto used = ptr + m_objSize;
-                if (!*used)
-                {
-                    return false;
-                }
-                *used = 0;
-                --m_allocCount;
-                return true;
+                deallocSlotThreadSafe(pSlot);
+                return;
             }
-            delete pObj;
-            return true;
+
+            pSlot[m_usedOffset] = 0;
+            getNext(pSlot) = m_pFreeList;
+            m_pFreeList = pSlot;
+            m_allocCount.store(m_allocCount.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
         }
 
-        void clear();
-        size_t getAllocCount() const;
-        void* getRawPointer() const;
-        bool isUsed(void* pObject) const;
-        size_t size() const;
-        void* operator[](size_t index) const;
+        static uint8_t*& getNext(uint8_t* pSlot) { return *reinterpret_cast<uint8_t**>(pSlot); }
+
+        uint8_t* allocSlotThreadSafe();
+        void deallocSlotThreadSafe(uint8_t* pSlot);
+        Magazine* getMagazine();
+        bool grow();
+        void addChunk();
+
+        uint64_t m_id;
+        size_t m_objCount;
+        size_t m_objSize;
+        size_t m_alignment;
+        size_t m_usedOffset; // The used flag is after the object
+        size_t m_objTotalSize;
+        FailAction m_failAction;
+        bool m_isThreadSafe;
+        uint8_t* m_pFreeList = nullptr;
+        std::atomic<size_t> m_allocCount;
+        std::atomic<size_t> m_capacity;
+        std::atomic<int> m_chunkCount;
+        uint8_t* m_chunks[MAX_CHUNKS] = {nullptr};
+        uint8_t* m_chunkMemories[MAX_CHUNKS] = {nullptr}; // Before alignment
+        std::mutex m_mutex; // For the free list and the chunks, when thread safe
+        Magazines m_magazines;
+    };
 
-        template<typename Ttype>
-        Ttype* at(size_t index) const
+    /**
+    Pool of one type, aligned for it. clear() destroys the objects still allocated.
+    */
+    template<typename Ttype>
+    class TPool final
+    {
+    public:
+        using FailAction = Pool::FailAction;
+
+        TPool(size_t objCount = 256, FailAction failAction = FailAction::ReturnNull, bool isThreadSafe = false)
+            : m_pool(sizeof(Ttype), objCount, failAction, isThreadSafe, alignof(Ttype))
         {
-            return reinterpret_cast<Ttype*>(m_pFirstObj + index * m_objTotalSize);
         }
 
-    protected:
-        size_t m_allocCount = 0;
-        size_t m_objCount = 0;
-        size_t m_currentObjIndex = 0;
-        uint8_t* m_pFirstObj = nullptr;
-        size_t m_objTotalSize = 0;
-        size_t m_objSize = 0;
-        FailAction m_failAction = FailAction::ReturnNull;
-        uint8_t* m_pMemory = nullptr;
-        size_t m_memorySize = 0;
+        ~TPool()
+        {
+            clear();
+        }
+
+        template<typename ... Targs>
+        Ttype* alloc(Targs&&... args)
+        {
+            auto pSlot = m_pool.allocSlot();
+            if (!pSlot) return nullptr;
+            return new(pSlot)Ttype(std::forward<Targs>(args)...);
+        }
+
+        bool dealloc(Ttype* pObj) { return m_pool.dealloc(pObj); }
+
+        void clear()
+        {
+            auto len = m_pool.size();
+            for (size_t i = 0; i < len; ++i)
+            {
+                auto pObj = m_pool.at<Ttype>(i);
+                if (m_pool.isUsed(pObj)) pObj->~Ttype();
+            }
+            m_pool.clear();
+        }
+
+        size_t getAllocCount() const { return m_pool.getAllocCount(); }
+        size_t size() const { return m_pool.size(); }
+        bool isUsed(Ttype* pObj) const { return m_pool.isUsed(pObj); }
+        bool owns(const Ttype* pObj) const { return m_pool.owns(pObj); }
+        Ttype* at(size_t index) const { return m_pool.at<Ttype>(index); }
+
+    private:
+        Pool m_pool;
     };
 }
 
+template<typename Ttype>
+using OTPool = onut::TPool<Ttype>;
+
 #endif
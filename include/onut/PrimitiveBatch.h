@@ -4,6 +4,7 @@
 // Onut
 #include <onut/Maths.h>
 #include <onut/PrimitiveMode.h>
+#include <onut/VertexFormat.h>
 
 // Forward declares
 #include <onut/ForwardDeclaration.h>
@@ -16,15 +17,20 @@ namespace onut
     class PrimitiveBatch
     {
     public:
-        static OPrimitiveBatchRef create();
+        /**
+        @param vertexFormat Packed halves the vertex size. Use Float for UVs outside -1 to 1 or colors above 1.
+        */
+        static OPrimitiveBatchRef create(VertexFormat vertexFormat = VertexFormat::Float);
 
-        PrimitiveBatch();
+        PrimitiveBatch(VertexFormat vertexFormat = VertexFormat::Float);
         virtual ~PrimitiveBatch();
 
         void begin(PrimitiveMode primitiveType, const OTextureRef& pTexture = nullptr, const Matrix& transform = Matrix::Identity);
         void draw(const Vector2& position, const Color& color = Color::White, const Vector2& texCoord = Vector2::Zero);
         void end();
 
+        VertexFormat getVertexFormat() const { return m_vertexFormat; }
+
     private:
         struct SVertexP2T2C4
         {
@@ -37,8 +43,13 @@ namespace onut
 
         void flush();
 
+        void map();
+
         OVertexBufferRef m_pVertexBuffer;
         SVertexP2T2C4* m_pMappedVertexBuffer = nullptr;
+        PackedVertex2D* m_pMappedPackedVertexBuffer = nullptr;
+        VertexFormat m_vertexFormat = VertexFormat::Float;
+        uint32_t m_vertexSize = sizeof(SVertexP2T2C4);
 
         unsigned int m_vertexCount = 0;
 
@@ -46,6 +57,8 @@ namespace onut
 
         OTextureRef m_pTexWhite;
         OTextureRef m_pTexture;
+        bool m_isAtlased = false;
+        Vector4 m_atlasUVs;
 
         PrimitiveMode m_primitiveType;
     };
@@ -6,6 +6,7 @@
 
 // STL
 #include <algorithm>
+#include <cinttypes>
 #include <vector>
 
 namespace onut
@@ -65,6 +66,27 @@ namespace onut
 
     Vector2 randCircle(const Vector2& center, float radius);
     Vector2 randCircleEdge(const Vector2& center, float radius);
+
+    /**
+    Random sequence independent from the global one. Use it from other threads,
+    or where the sequence must not depend on what else consumed random numbers.
+    */
+    class RandomStream final
+    {
+    public:
+        RandomStream(uint32_t seed = 0) { setSeed(seed); }
+
+        void setSeed(uint32_t seed);
+
+        uint32_t randu();
+        float randf(float min, float max);
+
+        template<typename Ttype>
+        Ttype randt(const Ttype& min, const Ttype& max);
+
+    private:
+        uint64_t m_state = 0;
+    };
 }
 
 #define ORandColor onut::randc
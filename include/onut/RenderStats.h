@@ -0,0 +1,101 @@
+#ifndef RENDERSTATS_H_INCLUDED
+#define RENDERSTATS_H_INCLUDED
+
+// STL
+#include <cinttypes>
+#include <string>
+#include <vector>
+
+namespace onut
+{
+    class RenderStates;
+
+    /**
+    Per-frame counters filled by the renderer and the batches: draw calls, render state changes
+    actually applied and SpriteBatch flushes by cause. The last frames are kept in a rolling history.
+    */
+    class RenderStats final
+    {
+    public:
+        static const int DEFAULT_HISTORY_SIZE = 300;
+
+        enum class FlushReason : uint8_t
+        {
+            BufferFull,
+            TextureChange,
+            BlendChange,
+            FilteringChange,
+            Explicit, // end() or flush()
+            COUNT
+        };
+
+        struct Frame
+        {
+            uint32_t drawCalls = 0;
+            uint32_t indexCount = 0; // Submitted with drawIndexed()
+            uint32_t vertexCount = 0; // Submitted with draw()
+            uint32_t renderTargetChanges = 0;
+            uint32_t textureChanges = 0;
+            uint32_t samplerChanges = 0;
+            uint32_t blendChanges = 0;
+            uint32_t scissorChanges = 0;
+            uint32_t shaderChanges = 0;
+            uint32_t flushes[static_cast<int>(FlushReason::COUNT)] = {0};
+
+            uint32_t getFlushCount() const;
+            uint32_t getFlushCount(FlushReason reason) const { return flushes[static_cast<int>(reason)]; }
+        };
+
+        RenderStats(int historySize = DEFAULT_HISTORY_SIZE);
+
+        // Called by the renderer backends
+        void onApplyRenderStates(const RenderStates& renderStates);
+        void onDraw(uint32_t vertexCount);
+        void onDrawIndexed(uint32_t indexCount);
+        void onFlush(FlushReason reason);
+        void endFrame();
+
+        /**
+        @return counters of the frame being rendered
+        */
+        const Frame& getCurrentFrame() const { return m_currentFrame; }
+
+        /**
+        @param framesAgo 0 is the last completed frame
+        @return a frame from the history, or an empty frame if it's not that far
+        */
+        const Frame& getFrame(int framesAgo = 0) const;
+
+        /**
+        @return the number of completed frames in the history
+        */
+        int getFrameCount() const;
+
+        /**
+        @return the number of completed frames since startup or the last reset
+        */
+        uint64_t getTotalFrameCount() const { return m_totalFrameCount; }
+
+        void setHistorySize(int historySize);
+        int getHistorySize() const { return static_cast<int>(m_history.size()); }
+        void reset();
+
+        /**
+        Write the history to a CSV file, oldest frame first.
+        @return false if the file can't be written
+        */
+        bool saveCSV(const std::string& filename) const;
+
+        static const char* getFlushReasonName(FlushReason reason);
+
+    private:
+        using Frames = std::vector<Frame>;
+
+        Frame m_currentFrame;
+        Frames m_history;
+        size_t m_historyHead = 0; // Next frame to write
+        uint64_t m_totalFrameCount = 0;
+    };
+}
+
+#endif
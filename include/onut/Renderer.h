@@ -6,9 +6,12 @@
 #include <onut/Maths.h>
 #include <onut/Point.h>
 #include <onut/PrimitiveMode.h>
+#include <onut/RenderStats.h>
 #include <onut/SampleMode.h>
+#include <onut/VertexFormat.h>
 
 // STL
+#include <string>
 #include <vector>
 
 // Forward
@@ -131,6 +134,7 @@ namespace onut
         RenderState<PrimitiveMode> primitiveMode;
         RenderState<OShaderRef> vertexShader;
         RenderState<OShaderRef> pixelShader;
+        RenderState<VertexFormat> vertexFormat; // Layout of the 2D pipeline. Custom vertex shaders define their own.
         RenderState<OVertexBufferRef> vertexBuffer;
         RenderState<OIndexBufferRef> indexBuffer;
         RenderState<OTextureRef> renderTarget;
@@ -151,7 +155,7 @@ namespace onut
         };
 
         void setupFor2D();
-        void setupFor2D(const Matrix& transform);
+        void setupFor2D(const Matrix& transform, VertexFormat vertexFormat = VertexFormat::Float);
         void set2DCamera(const CameraMatrices& camera, const Matrix& transform = Matrix::Identity);
         CameraMatrices set2DCamera(const Vector2& position, float zoom = 1.f);
         CameraMatrices set2DCameraOffCenter(const Vector2& position, float zoom = 1.f);
@@ -163,7 +167,7 @@ namespace onut
         virtual void beginFrame() = 0;
         virtual void endFrame() = 0;
         virtual void draw(uint32_t vertexCount) = 0;
-        virtual void drawIndexed(uint32_t indexCount) = 0;
+        virtual void drawIndexed(uint32_t indexCount, uint32_t baseVertex = 0) = 0;
 
         Point getResolution() const;
         virtual Point getTrueResolution() const = 0;
@@ -187,6 +191,23 @@ namespace onut
         virtual void applyRenderStates() = 0;
         virtual void init(const OWindowRef& pWindow);
 
+        /**
+        Capture the last presented frame to a PNG file.
+        @return false if the renderer doesn't support capture
+        */
+        virtual bool savePNG(const std::string& filename);
+
+        /**
+        @return false if index buffers of 32 bits elements can't be drawn
+        */
+        virtual bool supports32BitIndices() const;
+
+        /**
+        @return draw calls, state changes and batch flushes of the current and last frames
+        */
+        RenderStats& getStats() { return m_stats; }
+        const RenderStats& getStats() const { return m_stats; }
+
         RenderStates renderStates;
 
     protected:
@@ -198,6 +219,7 @@ namespace onut
         OVertexBufferRef m_pEffectsVertexBuffer;
 
         OShaderRef m_p2DVertexShader;
+        OShaderRef m_p2DPackedVertexShader;
         OShaderRef m_p2DPixelShader;
         OShaderRef m_pEffectsVertexShader;
         OShaderRef m_pBlurHPixelShader;
@@ -206,6 +228,8 @@ namespace onut
         OShaderRef m_pCRTPixelShader;
         OShaderRef m_pCartoonPixelShader;
         OShaderRef m_pVignettePixelShader;
+
+        RenderStats m_stats;
     };
 }
 
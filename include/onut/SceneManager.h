@@ -1,12 +1,18 @@
 #ifndef SCENEMANAGER_H_INCLUDED
 #define SCENEMANAGER_H_INCLUDED
 
+// Onut includes
+#include <onut/Component.h>
+#include <onut/ComponentSystem.h>
+#include <onut/Entity.h>
 
 // Third parties
 #include <list/List.h>
 
 // STL
+#include <cinttypes>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 // Forward declarations
@@ -18,15 +24,27 @@ OForwardDeclare(Entity);
 OForwardDeclare(SceneManager);
 OForwardDeclare(Updater);
 class b2Contact;
+class b2DynamicTree;
 class b2World;
 
 namespace onut
 {
     class Physic2DContactListener;
+    class TransformSystem;
 
     class SceneManager final : public std::enable_shared_from_this<SceneManager>
     {
     public:
+        /**
+        Order of the 2D renderables. Entities with the same draw index are drawn in the order
+        their components were registered.
+        */
+        enum class DrawOrder : uint8_t
+        {
+            DrawIndex,
+            DrawIndexThenY, // Same draw index sorted by world Y, top first. For top-down games.
+        };
+
         static OSceneManagerRef create();
 
         ~SceneManager();
@@ -36,7 +54,45 @@ namespace onut
 
         void setActiveCamera2D(const OCamera2DComponentRef& pActiveCamera2D);
 
+        // SortMode flags used for the 2D pass. Immediate by default.
+        uint8_t getSpriteSortMode() const;
+        void setSpriteSortMode(uint8_t sortMode);
+
+        DrawOrder getDrawOrder() const;
+        void setDrawOrder(DrawOrder drawOrder);
+
+        /**
+        @return the first entity given that name in this scene, null if there is none
+        */
         OEntityRef findEntity(const std::string& name) const;
+        OEntityRef findEntity(EntityNameId nameId) const;
+
+        /**
+        @return the entities with that tag, in the order they got it in this scene
+        */
+        Entity::Entities findEntitiesWithTag(const std::string& tag) const;
+
+        /**
+        @return the entities that have components of all those types, in no particular order
+        */
+        Entity::Entities findEntitiesWith(const std::vector<ComponentTypeId>& typeIds) const;
+
+        /**
+        Same, only the ones with their world position inside rect
+        */
+        Entity::Entities findEntitiesWith(const std::vector<ComponentTypeId>& typeIds, const Rect& rect) const;
+
+        template<typename ... Tcomponents>
+        Entity::Entities findEntitiesWith() const
+        {
+            return findEntitiesWith({getComponentTypeId<Tcomponents>()...});
+        }
+
+        template<typename ... Tcomponents>
+        Entity::Entities findEntitiesWith(const Rect& rect) const
+        {
+            return findEntitiesWith({getComponentTypeId<Tcomponents>()...}, rect);
+        }
 
         b2World* getPhysic2DWorld() const;
 
@@ -47,14 +103,57 @@ namespace onut
 
         void boardcastMessage(int messageId, void* pData = nullptr);
 
+        /**
+        Opt Tcomponent in dense storage. Its components created from now on by Entity::addComponent<Tcomponent>()
+        in this scene are updated through Tcomponent::updateAll(), see TComponentSystem.
+        Systems are updated before the other updatables.
+        */
+        template<typename Tcomponent>
+        void registerComponentSystem()
+        {
+            auto typeId = getComponentTypeId<Tcomponent>();
+            if (typeId >= m_componentSystems.size()) m_componentSystems.resize(typeId + 1);
+            if (!m_componentSystems[typeId]) m_componentSystems[typeId] = OMake<TComponentSystem<Tcomponent>>();
+        }
+
+        /**
+        @return the number of 2D renderables drawn by the last render(), after culling
+        */
+        int getVisibleRender2DCount() const;
+
+        /**
+        @return the number of 2D renderables in the scene
+        */
+        int getRender2DCount() const;
+
     private:
         friend class Entity;
         friend class Component;
         friend class Physic2DContactListener;
 
         using Components = std::vector<OComponentRef>;
+        using ComponentSystems = std::vector<OComponentSystemRef>;
+        struct Render2DItem
+        {
+            uint64_t key;
+            Component* pComponent;
+        };
+
+        struct Render2DQuery;
+
+        using Render2DItems = std::vector<Render2DItem>;
         using EntitySet = std::set<OEntityRef>;
         using Entities = std::vector<OEntityRef>;
+        using EntityIndex = std::unordered_map<EntityNameId, std::vector<Entity*>>;
+
+        // Entities of the scene, for the queries
+        struct QueryItem
+        {
+            Entity* pEntity;
+            uint64_t componentTypeMask; // Same as the entity's
+        };
+
+        using QueryItems = std::vector<QueryItem>;
 
         struct ComponentAction
         {
@@ -85,16 +184,84 @@ namespace onut
             OCollider2DComponentRef pColliderB;
         };
 
+        // Recorded during the parallel update phase, applied after it
+        struct DeferredCommand
+        {
+            enum class Type
+            {
+                ComponentAction,
+                DestroyEntity,
+                Message,
+                BroadcastMessage
+            };
+
+            Type type;
+            ComponentAction::Action action;
+            OComponentRef pComponent;
+            OEntityRef pEntity;
+            int messageId;
+            void* pData;
+        };
+
+        using DeferredCommands = std::vector<DeferredCommand>;
+
+        // FLAG_PARALLEL_UPDATABLE components of one class
+        struct ParallelType
+        {
+            ComponentTypeId typeId;
+            Component::UpdateAccess access;
+            bool isSelfConflicting; // Its components are updated one after the other
+            std::unique_ptr<TList<Component>> pComponents;
+        };
+
+        // Classes updated at the same time
+        struct ParallelStage
+        {
+            std::vector<uint32_t> types; // In m_parallelTypes
+            uint32_t firstBatch;
+            uint32_t batchCount;
+        };
+
+        // Components updated in order by one job
+        struct ParallelBatch
+        {
+            uint32_t begin; // In m_parallelComponents
+            uint32_t end;
+            DeferredCommands commands;
+        };
+
         using ComponentActions = std::vector<ComponentAction>;
         using Contact2Ds = std::vector<Contact2D>;
 
+        ComponentSystem* findComponentSystem(ComponentTypeId typeId) const;
+
         void addEntity(const OEntityRef& pEntity);
         void removeEntity(const OEntityRef& pEntity);
 
+        void indexEntity(Entity* pEntity);
+        void unindexEntity(Entity* pEntity);
+        static void addToIndex(EntityIndex& index, EntityNameId id, Entity* pEntity);
+        static void removeFromIndex(EntityIndex& index, EntityNameId id, Entity* pEntity);
+        static bool hasComponents(const QueryItem& queryItem, uint64_t mask, const std::vector<ComponentTypeId>& typeIds);
+
+        /**
+        @return where to record commands on this thread, null outside of a parallel update
+        */
+        static DeferredCommands* getDeferredCommands();
+
         void addComponentAction(const OComponentRef& pComponent, ComponentAction::Action action);
         void performComponentActions();
         void performEntityActions();
 
+        ParallelType& getParallelType(Component* pComponent);
+        void buildParallelStages();
+        void updateParallel();
+
+        void addRender2D(Component* pComponent);
+        void removeRender2D(Component* pComponent);
+        void updateRender2DBounds();
+        void sortRender2Ds();
+
         void begin2DContact(b2Contact* pContact);
         void end2DContact(b2Contact* pContact);
         void performContacts();
@@ -102,15 +269,33 @@ namespace onut
         SceneManager();
 
         EntitySet m_entities;
+        EntityIndex m_entitiesByName;
+        EntityIndex m_entitiesByTag;
+        QueryItems m_queryItems; // Unordered
+        TransformSystem* m_pTransforms; // Local and world transforms of m_entities
+        ComponentSystems m_componentSystems; // By ComponentTypeId, null if the type has none
         TList<Component> *m_pComponentUpdates;
+        std::vector<ParallelType> m_parallelTypes;
+        std::vector<ParallelStage> m_parallelStages;
+        std::vector<ParallelBatch> m_parallelBatches;
+        std::vector<Component*> m_parallelComponents; // This frame's, grouped by batch
+        bool m_areParallelStagesDirty = false;
         TList<Component> *m_pComponentRenders;
-        TList<Component> *m_pComponentRender2Ds;
+        TList<Component> *m_pComponentRender2Ds; // Unordered, sorted by draw order after culling
+        b2DynamicTree* m_pRender2DTree; // World bounds of 2D renderables
+        Components m_dirtyRender2DBounds;
+        Render2DItems m_visibleRender2Ds;
+        Render2DItems m_render2DSortScratch;
+        int m_render2DCount = 0;
+        uint32_t m_nextRender2DSequence = 0;
+        DrawOrder m_drawOrder = DrawOrder::DrawIndex;
         Components m_componentJustCreated;
         ComponentActions m_componentActions;
         Contact2Ds m_contact2Ds;
         OCamera2DComponentRef m_pActiveCamera2D;
         Entities m_entitiesToRemove;
         bool m_pause = false;
+        uint8_t m_spriteSortMode = 0;
 
         b2World* m_pPhysic2DWorld;
         Physic2DContactListener* m_pPhysic2DContactListener;
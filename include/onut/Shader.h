@@ -26,10 +26,23 @@ namespace onut
 
         struct VertexElement
         {
+            enum class Format
+            {
+                Float,
+                SNorm16, // 2 or 4 components
+                UNorm8 // 4 components
+            };
+
             uint32_t size;
             std::string semanticName;
+            Format format;
+
+            VertexElement(uint32_t in_size, const std::string& in_semanticName = "ELEMENT", Format in_format = Format::Float);
 
-            VertexElement(uint32_t in_size, const std::string& in_semanticName = "ELEMENT");
+            /**
+            @return the size in bytes
+            */
+            uint32_t getByteSize() const;
         };
         using VertexElements = std::vector<VertexElement>;
 
@@ -44,8 +44,11 @@ namespace onut
     private:
         void onCreate() override;
         void onRender2d() override;
+        bool getLocalBounds(Rect& localBounds) const override;
 
         OSpriteAnimInstanceRef m_pSpriteAnimInstance;
+        Rect m_framesBounds; // Union of all frames, unscaled
+        bool m_hasFramesBounds = false;
         Vector2 m_scale = Vector2(1);
         Color m_color = Color::White;
         OSpriteAnimRef m_pSpriteAnim;
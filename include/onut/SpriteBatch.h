@@ -4,30 +4,69 @@
 // Onut
 #include <onut/BlendMode.h>
 #include <onut/Maths.h>
+#include <onut/RenderStats.h>
 #include <onut/SampleMode.h>
+#include <onut/VertexFormat.h>
 
 // STL
+#include <unordered_map>
 #include <vector>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
 OForwardDeclare(IndexBuffer);
 OForwardDeclare(SpriteBatch);
+OForwardDeclare(SpriteLayers);
 OForwardDeclare(Texture);
 OForwardDeclare(VertexBuffer);
 
 namespace onut
 {
+    /**
+    Sprite sorting flags for SpriteBatch::begin. Anything other than Immediate records
+    the sprites and submits them sorted at end(). The sort is stable.
+    DrawIndex: Sort by the draw index set with SpriteBatch::setDrawIndex. Order is preserved within a draw index.
+    Texture: Group by blend mode, filtering then texture, to minimize draw calls. Only sprites that
+    don't overlap are reordered, so it renders the same as submission order.
+    Combined, sprites are grouped by state within each draw index.
+    */
+    struct SortMode
+    {
+        enum Flag : uint8_t
+        {
+            Immediate = 0x00,
+            Texture = 0x01,
+            DrawIndex = 0x02
+        };
+    };
+
     class SpriteBatch
     {
     public:
-        static OSpriteBatchRef create();
+        static const uint32_t DEFAULT_MAX_SPRITE_COUNT = 300;
 
-        SpriteBatch();
+        struct SVertexP2T2C4
+        {
+            Vector2 position;
+            Vector2 texCoord;
+            Color   color;
+        };
+
+        /**
+        @param maxSpriteCount Maximum sprites per draw call. Above 16384, 32 bits indices are used,
+        or it is clamped to 16384 if the renderer doesn't support them.
+        @param ringSpriteCount Sprite capacity of the streaming vertex buffer. Consecutive batches are
+        written one after the other in it and only wrap around (discard) when it is full. 0 means
+        the same as maxSpriteCount, which discards on every flush.
+        @param vertexFormat Packed halves the vertex size. Use Float for UVs outside -1 to 1 or colors above 1.
+        */
+        static OSpriteBatchRef create(uint32_t maxSpriteCount = DEFAULT_MAX_SPRITE_COUNT, uint32_t ringSpriteCount = 0, VertexFormat vertexFormat = VertexFormat::Float);
+
+        SpriteBatch(uint32_t maxSpriteCount = DEFAULT_MAX_SPRITE_COUNT, uint32_t ringSpriteCount = 0, VertexFormat vertexFormat = VertexFormat::Float);
         virtual ~SpriteBatch();
 
-        void begin(const Matrix& transform = Matrix::Identity, BlendMode blendMode = BlendMode::PreMultiplied);
-        void begin(BlendMode blendMode);
+        void begin(const Matrix& transform = Matrix::Identity, BlendMode blendMode = BlendMode::PreMultiplied, uint8_t sortMode = SortMode::Immediate);
+        void begin(BlendMode blendMode, uint8_t sortMode = SortMode::Immediate);
         void drawAbsoluteRect(const OTextureRef& pTexture, const Rect& rect, const Color& color = Color::White);
         void drawRect(const OTextureRef& pTexture, const Rect& rect, const Color& color = Color::White);
         void drawInclinedRect(const OTextureRef& pTexture, const Rect& rect, float inclinedRatio = -1.f, const Color& color = Color::White);
@@ -47,30 +86,86 @@ namespace onut
         void drawBeam(const OTextureRef& pTexture, const Vector2& from, const Vector2& to, float size, const Color& color, float uOffset = 0.f, float uScale = 1.f);
         void drawCross(const Vector2& position, float size, const Color& color = Color::White, float thickness = 2.f);
         void drawOutterOutlineRect(const Rect& rect, float thickness, const Color& color = Color::White);
+
+        /**
+        Draw sprites built ahead of time, for example on other threads.
+        4 vertices per quad, in the order drawSprite uses: top left, bottom left, bottom right, top right.
+        UVs are relative to the texture, they are remapped if it is in an atlas.
+        Float vertices drawn immediately are copied as is to the vertex buffer.
+        */
+        void drawQuads(const OTextureRef& pTexture, const SVertexP2T2C4* pVertices, uint32_t quadCount);
         void end();
 
         void changeBlendMode(BlendMode blendMode);
         void changeFiltering(sample::Filtering filtering);
 
+        // Used for sorting with SortMode::DrawIndex
+        void setDrawIndex(int drawIndex) { m_drawIndex = drawIndex; }
+        int getDrawIndex() const { return m_drawIndex; }
+        uint8_t getSortMode() const { return m_sortMode; }
+
         const Matrix& getTransform() const { return m_currentTransform; }
+        BlendMode getBlendMode() const { return m_curBlendMode; }
 
         bool isInBatch() const { return m_isDrawing; };
 
         void flush();
 
+        uint32_t getMaxSpriteCount() const { return m_maxSpriteCount; }
+        uint32_t getRingSpriteCount() const { return m_ringSpriteCount; }
+
+        /**
+        @return the number of draw calls issued since creation
+        */
+        uint32_t getFlushCount() const { return m_flushCount; }
+
+        VertexFormat getVertexFormat() const { return m_vertexFormat; }
+
+        /**
+        @return the number of vertex bytes written since creation
+        */
+        uint64_t getUploadedBytes() const { return m_uploadedBytes; }
+
     private:
-        struct SVertexP2T2C4
+        struct SpriteCommand
         {
-            Vector2 position;
-            Vector2 texCoord;
-            Color   color;
+            uint64_t key;
+            uint32_t spriteIndex;
         };
 
-        static const int MAX_SPRITE_COUNT = 300;
+        struct SpriteState
+        {
+            uint32_t textureIndex;
+            BlendMode blendMode;
+            sample::Filtering filtering;
+        };
+
+        using SpriteCommands = std::vector<SpriteCommand>;
+        using SpriteStates = std::vector<SpriteState>;
+        using Vertices = std::vector<SVertexP2T2C4>;
+        using Textures = std::vector<OTextureRef>;
+        using TextureIndices = std::unordered_map<OTexture*, uint32_t>;
+
+        using FlushReason = RenderStats::FlushReason;
+
+        void mapRegion();
+        void end(FlushReason reason);
+        void flushBatch(FlushReason reason);
+        SVertexP2T2C4* beginSprite();
+        void endSprite();
+        void writeSprite(const SVertexP2T2C4* pVerts);
+        void submitDeferred(FlushReason reason);
 
         OVertexBufferRef m_pVertexBuffer;
         OIndexBufferRef m_pIndexBuffer;
-        SVertexP2T2C4* m_pMappedVertexBuffer = nullptr;
+        uint8_t* m_pMappedVertexBuffer = nullptr;
+        VertexFormat m_vertexFormat = VertexFormat::Float;
+        uint32_t m_vertexSize = sizeof(SVertexP2T2C4);
+        uint64_t m_uploadedBytes = 0;
+
+        // Sprite being drawn. Packed sprites are built in floats, then packed by endSprite().
+        SVertexP2T2C4* m_pSpriteVertices = nullptr;
+        SVertexP2T2C4 m_spriteVertices[4];
 
         bool m_isDrawing = false;
 
@@ -79,7 +174,26 @@ namespace onut
         void changeTexture(const OTextureRef& pTexture);
 
         OTextureRef m_pTexture = nullptr;
+        OTextureRef m_pBatchTexture = nullptr; // Texture bound for the batch. The atlas page of m_pTexture if it is packed.
+        bool m_isAtlased = false;
+        Vector4 m_atlasUVs;
         unsigned int m_spriteCount = 0;
+        uint32_t m_maxSpriteCount = DEFAULT_MAX_SPRITE_COUNT;
+        uint32_t m_ringSpriteCount = DEFAULT_MAX_SPRITE_COUNT;
+        uint32_t m_ringOffset = 0;
+        uint32_t m_flushCount = 0;
+
+        // Deferred sorting
+        uint8_t m_sortMode = SortMode::Immediate;
+        int m_drawIndex = 0;
+        uint32_t m_textureIndex = 0;
+        Vertices m_deferredVertices;
+        SpriteCommands m_spriteCommands;
+        SpriteCommands m_sortScratch;
+        SpriteStates m_spriteStates;
+        OSpriteLayersRef m_pSpriteLayers; // Which sprites SortMode::Texture can reorder
+        Textures m_deferredTextures;
+        TextureIndices m_deferredTextureIndices;
         BlendMode m_curBlendMode = BlendMode::PreMultiplied;
         sample::Filtering m_curFiltering = sample::Filtering::Linear;
         Matrix m_currentTransform;
@@ -88,4 +202,8 @@ namespace onut
 
 extern OSpriteBatchRef oSpriteBatch;
 
+#define OSortImmediate onut::SortMode::Immediate
+#define OSortTexture onut::SortMode::Texture
+#define OSortDrawIndex onut::SortMode::DrawIndex
+
 #endif
@@ -32,6 +32,7 @@ namespace onut
 
     private:
         void onRender2d() override;
+        bool getLocalBounds(Rect& localBounds) const override;
 
         OTextureRef m_pTexture;
         Vector2 m_scale = Vector2(1);
@@ -5,6 +5,7 @@
 // Onut includes
 #include <onut/Component.h>
 #include <onut/Maths.h>
+#include <onut/TextLayout.h>
 
 // Forward declarations
 #include <onut/ForwardDeclaration.h>
@@ -37,6 +38,7 @@ namespace onut
         std::string m_text;
         Color m_color = Color::White;
         Vector2 m_origin = OCenter;
+        TextLayout m_layout;
     };
 };
 
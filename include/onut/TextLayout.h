@@ -0,0 +1,71 @@
+#ifndef TEXTLAYOUT_H_INCLUDED
+#define TEXTLAYOUT_H_INCLUDED
+
+// Onut
+#include <onut/Maths.h>
+#include <onut/SpriteBatch.h>
+
+// STL
+#include <string>
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(Font);
+OForwardDeclare(SpriteBatch);
+
+namespace onut
+{
+    /**
+    Glyph quads of a text in a font, kept until the text or the font changes.
+    Drawing it skips the glyph lookups and the measuring Font::draw does on every call.
+    The alignment is applied when drawing, it doesn't invalidate the layout.
+    */
+    class TextLayout final
+    {
+    public:
+        /**
+        Lay out the text, unless it's the same text and font as the last call.
+        @return true if the layout was rebuilt
+        */
+        bool set(const OFontRef& pFont, const std::string& text);
+
+        const OFontRef& getFont() const { return m_pFont; }
+        const std::string& getText() const { return m_text; }
+
+        /**
+        @return the size of the text. Same as Font::measure.
+        */
+        const Vector2& getSize() const { return m_size; }
+
+        /**
+        Same as Font::draw.
+        */
+        Rect draw(const Vector2& pos,
+                  const Vector2& align = Vector2(0.f, 0.f),
+                  const Color& color = Color::White,
+                  bool snapPixels = true,
+                  const OSpriteBatchRef& pSpriteBatch = nullptr) const;
+
+    private:
+        struct Glyph
+        {
+            Rect rect; // Relative to the top left of the text
+            Vector4 UVs;
+            int page;
+            bool isCodeColored; // Colored by a ^RGB code instead of the draw color
+            Vector3 codeColor;
+        };
+
+        using Glyphs = std::vector<Glyph>;
+        using Vertices = std::vector<SpriteBatch::SVertexP2T2C4>;
+
+        OFontRef m_pFont;
+        std::string m_text;
+        Vector2 m_size;
+        Glyphs m_glyphs;
+        mutable Vertices m_vertices; // Glyph quads placed by the last draw()
+    };
+}
+
+#endif
@@ -33,6 +33,19 @@ namespace onut
         bool isRenderTarget() const;
         bool isDynamic() const;
 
+        /**
+        Textures packed by a TextureAtlas are drawn from a shared page, by the batches remapping their UVs.
+        Bound directly, the renderers sample their whole page.
+        @return the page texture, or nullptr if this texture is not packed
+        */
+        const OTextureRef& getAtlasPage() const { return m_pAtlasPage; }
+        bool isAtlased() const { return m_pAtlasPage != nullptr; }
+
+        /**
+        @return UVs of this texture inside its atlas page: left, top, right, bottom
+        */
+        const Vector4& getAtlasUVs() const { return m_atlasUVs; }
+
         virtual void clearRenderTarget(const Color& color) = 0;
 
         // Apply effects. It will only work if the texture is a render target
@@ -45,6 +58,13 @@ namespace onut
         virtual void vignette(float amount = .5f) =0 ; // 0 - 1
 
         virtual void setData(const uint8_t* pData) = 0;
+
+        /**
+        Update a region of a dynamic texture, the rest is kept
+        @param pData Pixels of the whole texture, only the region is read
+        @param rect Region to update, right and bottom excluded
+        */
+        virtual void setSubData(const uint8_t* pData, const iRect& rect) = 0;
         virtual void resizeTarget(const Point& size) = 0;
 
     protected:
@@ -61,6 +81,8 @@ namespace onut
         Point m_size;
         Type m_type;
         bool m_isScreenRenderTarget = false;
+        OTextureRef m_pAtlasPage;
+        Vector4 m_atlasUVs = Vector4(0, 0, 1, 1);
     };
 }
 
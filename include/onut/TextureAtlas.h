@@ -0,0 +1,162 @@
+#ifndef TEXTUREATLAS_H_INCLUDED
+#define TEXTUREATLAS_H_INCLUDED
+
+// Onut
+#include <onut/iRect.h>
+#include <onut/Point.h>
+
+// STL
+#include <cinttypes>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(Texture);
+OForwardDeclare(TextureAtlas);
+
+namespace onut
+{
+    /**
+    Packs rectangles in one page. Each rectangle rests on the lowest spot of the skyline it fits on,
+    with padding pixels around it.
+    */
+    class SkylinePacker final
+    {
+    public:
+        struct Placement
+        {
+            size_t nodeIndex = 0;
+            Point position; // Of the padded rectangle
+            int bottom = std::numeric_limits<int>::max();
+            int width = std::numeric_limits<int>::max(); // Of the node it rests on, narrower is better
+        };
+
+        SkylinePacker(const Point& size, int padding = 0);
+
+        /**
+        Look for a spot better than placement, to compare pages
+        @return true if placement was updated
+        */
+        bool find(const Point& size, Placement& placement) const;
+        void place(const Point& size, const Placement& placement);
+
+        /**
+        @param position Top left of the rectangle, inside its padding
+        @return false if it doesn't fit
+        */
+        bool insert(const Point& size, Point& position);
+
+        const Point& getSize() const { return m_size; }
+        int getPadding() const { return m_padding; }
+
+    private:
+        struct Node
+        {
+            int x;
+            int y;
+            int width;
+        };
+
+        Point m_size;
+        int m_padding;
+        std::vector<Node> m_skyline;
+    };
+
+    /**
+    Packs small textures into large shared pages, so sprites using them can be batched together.
+    Pages are filled with a skyline packer, and new pages are added as textures stream in.
+    Packed textures are drawn from their page by SpriteBatch, PrimitiveBatch and TiledMap. They can't be
+    bound directly, used with wrapping UVs or custom shaders expecting the full 0-1 range.
+    They are static textures: setData() updates their region of the page, they can't be render targets
+    and the render target effects do nothing on them.
+    Space is not reclaimed when packed textures are released.
+    Pixels are kept in system memory, only the regions written since the last upload() are sent to the GPU.
+    Page textures are only created on the thread processing oDispatcher. Other threads get the spare page
+    upload() prepares, or nullptr while there is none.
+    */
+    class TextureAtlas final : public std::enable_shared_from_this<TextureAtlas>
+    {
+    public:
+        static const int DEFAULT_PAGE_SIZE = 2048;
+        static const int DEFAULT_PADDING = 1;
+
+        struct Stats
+        {
+            uint32_t pageCount = 0;
+            uint32_t textureCount = 0;
+            uint32_t rejectedCount = 0; // Textures that can't fit in an empty page
+            uint32_t missedCount = 0; // Textures that needed a new page off the render thread, with no spare ready
+            uint32_t uploadCount = 0; // Region uploads to the GPU
+            uint64_t uploadedPixels = 0;
+            uint64_t usedPixels = 0; // Including padding
+            uint64_t totalPixels = 0;
+
+            /**
+            @return used pixels over the total pixels of all pages, 0 to 1
+            */
+            float getOccupancy() const;
+        };
+
+        /**
+        @param pageSize Size of each page texture
+        @param padding Pixels around each packed texture. Edges are extruded into it to avoid bleeding with linear filtering.
+        */
+        static OTextureAtlasRef create(const Point& pageSize = Point(DEFAULT_PAGE_SIZE, DEFAULT_PAGE_SIZE), int padding = DEFAULT_PADDING);
+
+        TextureAtlas(const Point& pageSize, int padding);
+
+        /**
+        Pack pre-multiplied RGBA pixels. Can be called from any thread.
+        @return a texture referring to its region in a page, or nullptr if it doesn't fit in a page
+                or needs a new page that can't be created from this thread
+        */
+        OTextureRef insert(const uint8_t* pData, const Point& size);
+
+        /**
+        @return true if a texture of that size can be packed
+        */
+        bool canInsert(const Point& size) const;
+
+        /**
+        Upload regions modified since the last call, and prepare a spare page if other threads ran out.
+        Called once per frame before rendering, on the render thread.
+        */
+        void upload();
+
+        Stats getStats();
+        const Point& getPageSize() const { return m_pageSize; }
+        int getPadding() const { return m_padding; }
+
+    private:
+        friend class AtlasTexture;
+
+        struct Page
+        {
+            Page(const Point& size, int padding) : packer(size, padding) {}
+
+            OTextureRef pTexture;
+            std::vector<uint8_t> pixels;
+            SkylinePacker packer;
+            std::vector<iRect> dirtyRects; // Right and bottom excluded
+        };
+
+        using Pages = std::vector<Page>;
+
+        OTextureRef createPageTexture();
+        void copyPixels(Page& page, const uint8_t* pData, const Point& size, const Point& position);
+        void setData(size_t pageIndex, const Point& position, const Point& size, const uint8_t* pData);
+
+        Point m_pageSize;
+        int m_padding;
+        Pages m_pages;
+        OTextureRef m_pSparePage;
+        bool m_needsSparePage = false;
+        Stats m_stats;
+        std::mutex m_mutex;
+    };
+}
+
+#endif
@@ -7,16 +7,65 @@
 // STL
 #include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
+OForwardDeclare(Job)
+OForwardDeclare(JobCounter)
 OForwardDeclare(ThreadPool)
 
 namespace onut
 {
+    /**
+    Counts unfinished jobs. Jobs scheduled with a counter increment it and decrement it once done.
+    Must outlive the jobs using it.
+    */
+    class JobCounter final
+    {
+    public:
+        JobCounter() : m_count(0) {}
+
+        bool isDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+        int getCount() const { return m_count.load(std::memory_order_acquire); }
+
+    private:
+        friend class ThreadPool;
+
+        std::atomic<int> m_count;
+    };
+
+    /**
+    Handle to a scheduled function. Keep it to wait on it or to schedule other jobs after it.
+    */
+    class Job final
+    {
+    public:
+        bool isDone() const { return m_isDone.load(std::memory_order_acquire); }
+
+    private:
+        friend class ThreadPool;
+
+        std::function<void()> m_fn;
+        std::atomic<int> m_dependencyCount; // Unfinished dependencies, +1 while being scheduled
+        std::atomic<bool> m_isDone;
+        std::mutex m_mutex; // For the continuations
+        std::vector<OJobRef> m_continuations;
+        JobCounter* m_pCounter = nullptr;
+        OJobRef m_pSelf; // Keeps the job alive while queued
+    };
+
+    /**
+    Work stealing job scheduler. Each worker thread owns a deque of jobs, pops its own work LIFO and steals
+    from the others when empty. Jobs scheduled from a thread outside the pool go through a shared queue.
+    A thread waiting on a job or a counter runs jobs until it is done, so waits can be nested inside jobs.
+    */
     class ThreadPool final
     {
     public:
@@ -24,36 +73,72 @@ namespace onut
 
         ~ThreadPool();
 
-        template<typename ... Targs>
-        void doWork(Targs ... args)
+        /**
+        Run a function on the pool
+        @return The job, to wait on it or to schedule continuations
+        */
+        OJobRef doWork(const std::function<void()>& fn, JobCounter* pCounter = nullptr);
+
+        /**
+        Run a function once all dependencies are done
+        */
+        OJobRef doWork(const std::function<void()>& fn, const std::vector<OJobRef>& dependencies, JobCounter* pCounter = nullptr);
+
+        /**
+        Run a function with those arguments bound to it, like Dispatcher::dispatch()
+        */
+        template<typename Tfn, typename Targ, typename ... Targs,
+            typename = typename std::enable_if<
+                !std::is_convertible<typename std::decay<Targ>::type, JobCounter*>::value &&
+                !std::is_convertible<typename std::decay<Targ>::type, std::vector<OJobRef>>::value>::type>
+        OJobRef doWork(Tfn&& fn, Targ&& arg, Targs&&... args)
         {
-            auto pWorker = m_workers[m_nextWorker];
-            std::unique_lock<std::mutex> lock(pWorker->mutex);
-            pWorker->pDispatcher->dispatch(args ...);
-            pWorker->waitForWork.notify_one();
-            m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+            return doWork(std::function<void()>(std::bind(std::forward<Tfn>(fn), std::forward<Targ>(arg), std::forward<Targs>(args)...)));
         }
 
+        /**
+        Run a function once the job is done
+        */
+        OJobRef then(const OJobRef& pJob, const std::function<void()>& fn, JobCounter* pCounter = nullptr);
+
+        /**
+        Wait for all the work given to the pool, running jobs in the meantime. Not to be called from a job.
+        */
         void wait();
+        void wait(const OJobRef& pJob);
+        void wait(const JobCounter& counter);
+
+        /**
+        Call fn for every index in [begin, end), on the pool and the calling thread, and wait for all of them.
+        Indices are given out grain at a time to whichever thread is free.
+        */
+        void parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t)>& fn);
+
+        size_t getWorkerCount() const { return m_workers.size(); }
 
     private:
-        struct Worker
-        {
-            std::mutex mutex;
-            std::condition_variable waitForWork;
-            std::thread thread;
-            bool isRunning = true;
-            ODispatcherRef pDispatcher;
-        };
-        using WorkerRef = std::shared_ptr<Worker>;
-        using Workers = std::vector<WorkerRef>;
+        struct Worker;
+        using Workers = std::vector<std::unique_ptr<Worker>>;
 
         ThreadPool();
 
-        static void workerThread(WorkerRef pWorker);
+        void workerThread(Worker* pWorker);
+        void enqueue(Job* pJob);
+        void finish(Job* pJob);
+        void releaseDependency(Job* pJob);
+        Job* findJob(Worker* pWorker);
+        bool runOne();
+        void run(Job* pJob);
 
-        Workers::size_type m_nextWorker;
         Workers m_workers;
+        std::mutex m_sharedMutex;
+        std::deque<Job*> m_sharedQueue; // Jobs scheduled from outside the pool
+        std::atomic<int> m_queuedCount; // Jobs in any queue
+        std::atomic<int> m_sleepingCount;
+        std::mutex m_sleepMutex;
+        std::condition_variable m_wakeUp;
+        bool m_isRunning = true;
+        JobCounter m_allJobs;
     };
 }
 
@@ -61,5 +146,6 @@ extern OThreadPoolRef oThreadPool;
 
 #define OWork(...) oThreadPool->doWork(__VA_ARGS__)
 #define OWait oThreadPool->wait
+#define OParallelFor(...) oThreadPool->parallelFor(__VA_ARGS__)
 
 #endif
@@ -9,18 +9,27 @@
 
 // STL
 #include <unordered_map>
+#include <vector>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
 OForwardDeclare(ContentManager);
+OForwardDeclare(IndexBuffer);
 OForwardDeclare(Texture);
 OForwardDeclare(TiledMap);
+OForwardDeclare(VertexBuffer);
 
 namespace onut
 {
+    /**
+    Tile layers are baked into static geometry, by chunks of CHUNK_SIZE x CHUNK_SIZE tiles.
+    A chunk is baked the first time it's visible, and rebuilt after setTileAt() changed it.
+    Rendering draws the chunks overlapping the view, one draw call per chunk and tileset.
+    */
     class TiledMap final : public Resource
     {
     public:
+        static const int CHUNK_SIZE = 32; // In tiles
         struct Layer
         {
             virtual ~Layer();
@@ -77,6 +86,9 @@ namespace onut
         void renderLayer(int index);
         void renderLayer(const std::string &name);
         void renderLayer(Layer *pLayer);
+        /**
+        Render whole chunks overlapping rect. rect is in tiles, inclusive.
+        */
         void render(const iRect &rect);
         void renderLayer(const iRect &rect, int index);
         void renderLayer(const iRect &rect, const std::string &name);
@@ -104,12 +116,31 @@ namespace onut
             Vector4 UVs;
         };
 
+        struct ChunkBatch
+        {
+            OTextureRef pTexture; // Atlas page if the tileset is atlased
+            OVertexBufferRef pVertexBuffer;
+            uint32_t quadCount = 0;
+        };
+
+        struct Chunk
+        {
+            std::vector<ChunkBatch> batches; // One per tileset used
+            bool isDirty = true;
+        };
+
         struct TileLayerInternal : public TileLayer
         {
             virtual ~TileLayerInternal();
             Tile *tiles = nullptr;
+            Chunk *chunks = nullptr;
+            int chunkCountX = 0;
+            int chunkCountY = 0;
         };
 
+        void resolveTile(TileLayerInternal *pLayer, int index);
+        void bakeChunk(TileLayerInternal *pLayer, int chunkX, int chunkY);
+
         int m_width = 0;
         int m_height = 0;
         int m_tileSize = 1;
@@ -120,6 +151,7 @@ namespace onut
         Matrix m_transform = Matrix::Identity;
         onut::sample::Filtering m_filtering = OFilterNearest;
         OTextureRef m_pMinimap;
+        OIndexBufferRef m_pChunkIndexBuffer;
     };
 };
 
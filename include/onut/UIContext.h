@@ -4,6 +4,7 @@
 // Onut
 #include <onut/Crypto.h>
 #include <onut/Maths.h>
+#include <onut/TextLayout.h>
 #include <onut/UIEvents.h>
 
 // STL
@@ -182,6 +183,13 @@ namespace onut
         using TextCaretStyleMapByType = std::unordered_map<std::type_index, TextCaretStyleMap>;
         using Clips = std::vector<Rect>;
 
+        struct ControlTextLayout
+        {
+            OUIControlWeak pControl; // The layout is dropped once the control is gone
+            TextLayout layout;
+        };
+        using TextLayouts = std::unordered_map<const UIControl*, ControlTextLayout>;
+
         void resolve();
         void dispatchEvents();
         void reset();
@@ -206,6 +214,8 @@ namespace onut
         Writes m_writes;
         Keys m_keyDowns;
 
+        TextLayouts m_textLayouts; // Rebuilt by drawText when the text or font of the control changes
+
         std::chrono::steady_clock::time_point m_clickTimes[3];
         Vector2 m_clicksPos[3];
     };
@@ -21,6 +21,15 @@ namespace onut
         virtual void setData(const void* pVertexData, uint32_t size) = 0;
         virtual void* map() = 0;
         virtual void unmap(uint32_t size) = 0;
+
+        /**
+        Map a region of a dynamic buffer for streaming. Previously written regions
+        are left untouched so the GPU can keep reading them without a stall.
+        Mapping at offset 0 discards the whole buffer (Ring buffer wrap around).
+        @return pointer to the start of the region
+        */
+        virtual void* mapRange(uint32_t offset, uint32_t size) = 0;
+        virtual void unmapRange(uint32_t offset, uint32_t size) = 0;
         virtual uint32_t size() = 0;
 
     protected:
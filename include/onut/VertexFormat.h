@@ -0,0 +1,77 @@
+#ifndef VERTEXFORMAT_H_INCLUDED
+#define VERTEXFORMAT_H_INCLUDED
+
+// Onut
+#include <onut/Maths.h>
+
+// STL
+#include <algorithm>
+#include <cinttypes>
+
+namespace onut
+{
+    /**
+    Vertex layouts of the 2D pipeline, used by SpriteBatch and PrimitiveBatch.
+    Float: float2 position, float2 UV, float4 color. 32 bytes.
+    Packed: float2 position, 16 bits normalized UV, RGBA8 color. 16 bytes.
+    Packed UVs are limited to -1 to 1, and colors to 0 to 1.
+    */
+    enum class VertexFormat : uint8_t
+    {
+        Float,
+        Packed,
+
+        COUNT
+    };
+
+    struct PackedVertex2D
+    {
+        Vector2 position;
+        int16_t texCoord[2];
+        uint32_t color; // Red in the lowest byte
+
+        static int16_t packTexCoord(float texCoord)
+        {
+            texCoord = std::min(std::max(texCoord, -1.f), 1.f);
+            return static_cast<int16_t>(texCoord * 32767.f + (texCoord < 0.f ? -.5f : .5f));
+        }
+
+        static float unpackTexCoord(int16_t texCoord)
+        {
+            return std::max(static_cast<float>(texCoord) / 32767.f, -1.f);
+        }
+
+        static uint32_t packColor(const Color& color)
+        {
+            return
+                (static_cast<uint32_t>(std::min(std::max(color.r, 0.f), 1.f) * 255.f + .5f)) |
+                (static_cast<uint32_t>(std::min(std::max(color.g, 0.f), 1.f) * 255.f + .5f) << 8) |
+                (static_cast<uint32_t>(std::min(std::max(color.b, 0.f), 1.f) * 255.f + .5f) << 16) |
+                (static_cast<uint32_t>(std::min(std::max(color.a, 0.f), 1.f) * 255.f + .5f) << 24);
+        }
+
+        static Color unpackColor(uint32_t color)
+        {
+            return Color(
+                static_cast<float>(color & 0xff) / 255.f,
+                static_cast<float>((color >> 8) & 0xff) / 255.f,
+                static_cast<float>((color >> 16) & 0xff) / 255.f,
+                static_cast<float>((color >> 24) & 0xff) / 255.f);
+        }
+
+        void set(const Vector2& in_position, const Vector2& in_texCoord, const Color& in_color)
+        {
+            position = in_position;
+            texCoord[0] = packTexCoord(in_texCoord.x);
+            texCoord[1] = packTexCoord(in_texCoord.y);
+            color = packColor(in_color);
+        }
+    };
+
+    static_assert(sizeof(PackedVertex2D) == 16, "Packed 2D vertices must be 16 bytes");
+};
+
+#define OVertexFloat onut::VertexFormat::Float
+#define OVertexPacked onut::VertexFormat::Packed
+
+#endif
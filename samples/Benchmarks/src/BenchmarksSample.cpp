@@ -0,0 +1,681 @@
+// Oak Nut include
+#include <onut/Component.h>
+#include <onut/Dispatcher.h>
+#include <onut/Entity.h>
+#include <onut/Log.h>
+#include <onut/Maths.h>
+#include <onut/onut.h>
+#include <onut/ParticleSystem.h>
+#include <onut/ParticleSystemManager.h>
+#include <onut/Random.h>
+#include <onut/Renderer.h>
+#include <onut/SceneManager.h>
+#include <onut/Settings.h>
+#include <onut/SpriteBatch.h>
+#include <onut/SpriteComponent.h>
+#include <onut/Texture.h>
+#include <onut/TextureAtlas.h>
+#include <onut/ThreadPool.h>
+
+// STL
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Each render benchmark runs for that many frames, then the next one starts.
+// Results are logged, and the sample quits when they are all done.
+static const int BENCHMARK_FRAME_COUNT = 120;
+
+struct RenderBenchmark
+{
+    std::string name;
+    std::function<void()> renderFn; // Timed
+    std::function<uint32_t()> getDrawCallsFn; // Total draw calls so far
+    uint32_t quadsPerFrame;
+    std::function<uint64_t()> getUploadedBytesFn; // Total vertex bytes uploaded so far, optional
+    std::function<std::string()> getDetailsFn; // Logged with the results, optional
+};
+
+std::vector<RenderBenchmark> g_benchmarks;
+size_t g_currentBenchmark = 0;
+int g_frame = 0;
+std::chrono::high_resolution_clock::duration g_elapsed;
+uint32_t g_drawCallsAtStart = 0;
+uint64_t g_uploadedBytesAtStart = 0;
+
+//--- SpriteBatch: today's 300 quads batches vs large streaming batches
+static const uint32_t SPRITE_COUNT = 20000;
+
+OTextureRef g_pSpriteTexture;
+OSpriteBatchRef g_pLegacySpriteBatch;
+OSpriteBatchRef g_pStreamingSpriteBatch;
+OSpriteBatchRef g_pPackedSpriteBatch;
+std::vector<Vector2> g_spritePositions;
+
+void drawSprites(const OSpriteBatchRef& pSpriteBatch)
+{
+    pSpriteBatch->begin();
+    for (const auto& position : g_spritePositions)
+    {
+        pSpriteBatch->drawSprite(g_pSpriteTexture, position);
+    }
+    pSpriteBatch->end();
+}
+
+void addSpriteBatchBenchmarks()
+{
+    uint8_t pixels[8 * 8 * 4];
+    for (auto& pixel : pixels) pixel = 255;
+    g_pSpriteTexture = OTexture::createFromData(pixels, {8, 8}, false);
+
+    g_spritePositions.resize(SPRITE_COUNT);
+    for (auto& position : g_spritePositions)
+    {
+        position = ORandVector2(OScreenf);
+    }
+
+    g_pLegacySpriteBatch = OSpriteBatch::create();
+    g_pStreamingSpriteBatch = OSpriteBatch::create(32768, 131072); // 4 MB ring
+    g_pPackedSpriteBatch = OSpriteBatch::create(32768, 131072, OVertexPacked); // 2 MB ring
+
+    g_benchmarks.push_back({"SpriteBatch 300 quads",
+        [] { drawSprites(g_pLegacySpriteBatch); },
+        [] { return g_pLegacySpriteBatch->getFlushCount(); },
+        SPRITE_COUNT,
+        nullptr,
+        nullptr});
+    g_benchmarks.push_back({"SpriteBatch streaming 32k quads",
+        [] { drawSprites(g_pStreamingSpriteBatch); },
+        [] { return g_pStreamingSpriteBatch->getFlushCount(); },
+        SPRITE_COUNT,
+        [] { return g_pStreamingSpriteBatch->getUploadedBytes(); },
+        nullptr});
+    g_benchmarks.push_back({"SpriteBatch streaming 32k quads, packed vertices",
+        [] { drawSprites(g_pPackedSpriteBatch); },
+        [] { return g_pPackedSpriteBatch->getFlushCount(); },
+        SPRITE_COUNT,
+        [] { return g_pPackedSpriteBatch->getUploadedBytes(); },
+        nullptr});
+}
+
+//--- SpriteBatch: interleaved textures, immediate vs sorted by texture
+static const int INTERLEAVED_TEXTURE_COUNT = 4;
+
+OTextureRef g_pInterleavedTextures[INTERLEAVED_TEXTURE_COUNT];
+
+void drawInterleavedSprites(uint8_t sortMode)
+{
+    g_pStreamingSpriteBatch->begin(Matrix::Identity, OBlendPreMultiplied, sortMode);
+    int i = 0;
+    for (const auto& position : g_spritePositions)
+    {
+        g_pStreamingSpriteBatch->drawSprite(g_pInterleavedTextures[i++ % INTERLEAVED_TEXTURE_COUNT], position);
+    }
+    g_pStreamingSpriteBatch->end();
+}
+
+void addSortBenchmarks()
+{
+    for (int i = 0; i < INTERLEAVED_TEXTURE_COUNT; ++i)
+    {
+        uint8_t pixels[8 * 8 * 4];
+        for (auto& pixel : pixels) pixel = static_cast<uint8_t>(64 * (i + 1) - 1);
+        g_pInterleavedTextures[i] = OTexture::createFromData(pixels, {8, 8}, false);
+    }
+
+    g_benchmarks.push_back({"SpriteBatch interleaved textures, immediate",
+        [] { drawInterleavedSprites(OSortImmediate); },
+        [] { return g_pStreamingSpriteBatch->getFlushCount(); },
+        SPRITE_COUNT,
+        nullptr,
+        nullptr});
+    g_benchmarks.push_back({"SpriteBatch interleaved textures, sorted by texture",
+        [] { drawInterleavedSprites(OSortTexture); },
+        [] { return g_pStreamingSpriteBatch->getFlushCount(); },
+        SPRITE_COUNT,
+        nullptr,
+        nullptr});
+}
+
+//--- SpriteBatch: interleaved textures packed in an atlas, immediate
+OTextureAtlasRef g_pTextureAtlas;
+OTextureRef g_pPackedTextures[INTERLEAVED_TEXTURE_COUNT];
+
+void drawPackedSprites()
+{
+    g_pStreamingSpriteBatch->begin();
+    int i = 0;
+    for (const auto& position : g_spritePositions)
+    {
+        g_pStreamingSpriteBatch->drawSprite(g_pPackedTextures[i++ % INTERLEAVED_TEXTURE_COUNT], position);
+    }
+    g_pStreamingSpriteBatch->end();
+}
+
+void addAtlasBenchmarks()
+{
+    g_pTextureAtlas = OTextureAtlas::create({256, 256});
+    for (int i = 0; i < INTERLEAVED_TEXTURE_COUNT; ++i)
+    {
+        uint8_t pixels[8 * 8 * 4];
+        for (auto& pixel : pixels) pixel = static_cast<uint8_t>(64 * (i + 1) - 1);
+        g_pPackedTextures[i] = g_pTextureAtlas->insert(pixels, {8, 8});
+    }
+    g_pTextureAtlas->upload();
+
+    auto stats = g_pTextureAtlas->getStats();
+    std::stringstream ss;
+    ss << "TextureAtlas: " << stats.textureCount << " textures in " << stats.pageCount << " pages, "
+        << (stats.getOccupancy() * 100.f) << "% occupancy";
+    OLog(ss.str());
+
+    g_benchmarks.push_back({"SpriteBatch interleaved textures, atlas",
+        [] { drawPackedSprites(); },
+        [] { return g_pStreamingSpriteBatch->getFlushCount(); },
+        SPRITE_COUNT,
+        nullptr,
+        nullptr});
+}
+
+//--- SceneManager: large level, mostly off-screen entities
+static const int SCENE_ENTITY_COUNT = 50000;
+static const int SPAWN_ENTITY_COUNT = 100000;
+
+OSceneManagerRef g_pScene; // Separate from oSceneManager so it's only rendered when benchmarked
+
+// One shot: a level spawning all its renderables in the same frame
+void logSpawnBenchmark()
+{
+    auto pScene = OSceneManager::create();
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < SPAWN_ENTITY_COUNT; ++i)
+    {
+        auto pEntity = OEntity::create(pScene);
+        auto position = ORandVector2(OScreenf * 12.f);
+        pEntity->setLocalTransform(Matrix::CreateTranslation(position.x, position.y, 0.f));
+        pEntity->setDrawIndex(ORandInt(16));
+        pEntity->addComponent<OSpriteComponent>()->setTexture(g_pSpriteTexture);
+    }
+    auto createdTime = std::chrono::high_resolution_clock::now();
+    pScene->update(); // Registers the components
+    auto registeredTime = std::chrono::high_resolution_clock::now();
+
+    std::stringstream ss;
+    ss << "SceneManager spawn " << SPAWN_ENTITY_COUNT << " renderables: "
+        << (std::chrono::duration<double>(createdTime - startTime).count() * 1000.0) << " ms to create, "
+        << (std::chrono::duration<double>(registeredTime - createdTime).count() * 1000.0) << " ms to register";
+    OLog(ss.str());
+}
+
+//--- SceneManager: 100k moving entities in deep hierarchies
+static const int TRANSFORM_TREE_COUNT = 1000;
+static const int TRANSFORM_TREE_SIZE = 100;
+static const int TRANSFORM_UPDATE_COUNT = 60;
+
+// One shot. Every frame a tenth of the entities move, then the scene propagates them to their subtrees.
+// Each node hangs under one of the few nodes created just before it, so the trees are about 40 deep.
+void logTransformBenchmark(bool useThreadPool)
+{
+    auto pThreadPool = oThreadPool;
+    if (!useThreadPool) oThreadPool = nullptr;
+
+    auto pScene = OSceneManager::create();
+    std::vector<OEntityRef> entities;
+    entities.reserve(TRANSFORM_TREE_COUNT * TRANSFORM_TREE_SIZE);
+    for (int tree = 0; tree < TRANSFORM_TREE_COUNT; ++tree)
+    {
+        auto treeStart = entities.size();
+        for (int i = 0; i < TRANSFORM_TREE_SIZE; ++i)
+        {
+            auto pEntity = OEntity::create(pScene);
+            pEntity->setLocalTransform(Matrix::CreateRotationZ(ORandFloat(0.1f)) * Matrix::CreateTranslation(ORandFloat(10.f), 10.f, 0.f));
+            if (i) entities[treeStart + ORandInt(std::max(0, i - 4), i - 1)]->add(pEntity);
+            entities.push_back(pEntity);
+        }
+    }
+    pScene->update();
+
+    double elapsed = 0.0;
+    auto movedCount = static_cast<int>(entities.size()) / 10;
+    for (int frame = 0; frame < TRANSFORM_UPDATE_COUNT; ++frame)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < movedCount; ++i)
+        {
+            auto& pEntity = entities[ORandInt(static_cast<int>(entities.size()) - 1)];
+            pEntity->setLocalTransform(Matrix::CreateRotationZ(ORandFloat(0.1f)) * Matrix::CreateTranslation(ORandFloat(10.f), 10.f, 0.f));
+        }
+        pScene->update();
+        elapsed += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() * 1000.0;
+    }
+
+    oThreadPool = pThreadPool;
+
+    std::stringstream ss;
+    ss << "SceneManager move " << movedCount << " of " << entities.size() << " entities in hierarchies, "
+        << (useThreadPool && oThreadPool ? std::to_string(oThreadPool->getWorkerCount()) + " workers: " : "serial: ")
+        << (elapsed / static_cast<double>(TRANSFORM_UPDATE_COUNT)) << " ms/frame";
+    OLog(ss.str());
+}
+
+//--- SceneManager: 100k updatable components, virtual onUpdate() or a component system
+static const int UPDATABLE_COMPONENT_COUNT = 100000;
+static const int COMPONENT_UPDATE_COUNT = 120;
+
+class SpinComponent final : public OComponent
+{
+public:
+    SpinComponent() : OComponent(FLAG_UPDATABLE) {}
+
+    static void updateAll(const OComponentSpan<SpinComponent>& components)
+    {
+        for (auto pComponent : components) pComponent->spin();
+    }
+
+protected:
+    void onUpdate() override { spin(); }
+
+private:
+    void spin() { angle += speed; }
+
+    float angle = 0.f;
+    float speed = 1.f;
+};
+
+// One shot. Entities get a name too, so the components are interleaved with other allocations like in a level.
+void logComponentUpdateBenchmark(bool useSystem)
+{
+    auto pScene = OSceneManager::create();
+    if (useSystem) pScene->registerComponentSystem<SpinComponent>();
+    std::vector<OEntityRef> entities;
+    entities.reserve(UPDATABLE_COMPONENT_COUNT);
+    for (int i = 0; i < UPDATABLE_COMPONENT_COUNT; ++i)
+    {
+        auto pEntity = OEntity::create(pScene);
+        pEntity->setName("Spinner " + std::to_string(i));
+        pEntity->addComponent<SpinComponent>();
+        entities.push_back(pEntity);
+    }
+    pScene->update(); // Registers the components
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < COMPONENT_UPDATE_COUNT; ++i)
+    {
+        pScene->update();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() * 1000.0;
+
+    std::stringstream ss;
+    ss << "SceneManager update " << UPDATABLE_COMPONENT_COUNT << " components, "
+        << (useSystem ? "component system: " : "virtual onUpdate(): ")
+        << (elapsed / static_cast<double>(COMPONENT_UPDATE_COUNT)) << " ms/frame";
+    OLog(ss.str());
+}
+
+//--- SceneManager: entity lookups by name, tag and component
+static const int QUERY_ENTITY_COUNT = 50000;
+static const int NAME_LOOKUP_COUNT = 1000;
+static const int ENTITY_QUERY_COUNT = 100;
+
+// Timed against the linear scans findEntity() used to do over the scene's std::set
+void logQueryBenchmark()
+{
+    auto pScene = OSceneManager::create();
+    std::set<OEntityRef> entities;
+    for (int i = 0; i < QUERY_ENTITY_COUNT; ++i)
+    {
+        auto pEntity = OEntity::create(pScene);
+        pEntity->setName("Entity " + std::to_string(i));
+        pEntity->setLocalTransform(Matrix::CreateTranslation(static_cast<float>(i % 500), static_cast<float>(i / 500), 0.f));
+        if (i % 10 == 0) pEntity->addTag("enemy");
+        if (i % 4 == 0) pEntity->addComponent<SpinComponent>();
+        entities.insert(pEntity);
+    }
+    Rect rect(100.f, 20.f, 100.f, 50.f);
+
+    auto time = [](const std::function<size_t()>& query, int count, size_t& found)
+    {
+        auto startTime = std::chrono::high_resolution_clock::now();
+        found = 0;
+        for (int i = 0; i < count; ++i) found += query();
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() * 1000.0 / static_cast<double>(count);
+    };
+    auto log = [](const std::string& name, double linear, double indexed, size_t linearFound, size_t indexedFound)
+    {
+        std::stringstream ss;
+        ss << "SceneManager " << name << " in " << QUERY_ENTITY_COUNT << " entities, linear: " << linear << " ms, indexed: " << indexed << " ms"
+            << (linearFound == indexedFound ? "" : " (results differ)");
+        OLog(ss.str());
+    };
+
+    size_t linearFound, indexedFound;
+    int nameIndex = 0;
+    auto linear = time([&]
+    {
+        auto name = "Entity " + std::to_string((nameIndex++ * 7919) % QUERY_ENTITY_COUNT);
+        for (auto& pEntity : entities)
+        {
+            if (pEntity->getName() == name) return size_t(1);
+        }
+        return size_t(0);
+    }, NAME_LOOKUP_COUNT, linearFound);
+    nameIndex = 0;
+    auto indexed = time([&]
+    {
+        auto name = "Entity " + std::to_string((nameIndex++ * 7919) % QUERY_ENTITY_COUNT);
+        return pScene->findEntity(name) ? size_t(1) : size_t(0);
+    }, NAME_LOOKUP_COUNT, indexedFound);
+    log("findEntity(name)", linear, indexed, linearFound, indexedFound);
+
+    linear = time([&]
+    {
+        size_t count = 0;
+        for (auto& pEntity : entities) count += pEntity->hasTag("enemy") ? 1 : 0;
+        return count;
+    }, ENTITY_QUERY_COUNT, linearFound);
+    indexed = time([&] { return pScene->findEntitiesWithTag("enemy").size(); }, ENTITY_QUERY_COUNT, indexedFound);
+    log("findEntitiesWithTag()", linear, indexed, linearFound, indexedFound);
+
+    linear = time([&]
+    {
+        size_t count = 0;
+        for (auto& pEntity : entities)
+        {
+            if (!pEntity->getComponentPtr<SpinComponent>()) continue;
+            auto position = pEntity->getWorldTransform().Translation();
+            if (position.x >= rect.x && position.y >= rect.y && position.x <= rect.x + rect.z && position.y <= rect.y + rect.w) ++count;
+        }
+        return count;
+    }, ENTITY_QUERY_COUNT, linearFound);
+    indexed = time([&] { return pScene->findEntitiesWith<SpinComponent>(rect).size(); }, ENTITY_QUERY_COUNT, indexedFound);
+    log("findEntitiesWith<T>(rect)", linear, indexed, linearFound, indexedFound);
+}
+
+void addSceneBenchmarks()
+{
+    g_pScene = OSceneManager::create();
+    auto levelSize = OScreenf * 12.f;
+    for (int i = 0; i < SCENE_ENTITY_COUNT; ++i)
+    {
+        auto pEntity = OEntity::create(g_pScene);
+        auto position = ORandVector2(levelSize) - OScreenf * 4.f;
+        pEntity->setLocalTransform(Matrix::CreateTranslation(position.x, position.y, 0.f));
+        pEntity->setDrawIndex(i % 8);
+        auto pSpriteComponent = pEntity->addComponent<OSpriteComponent>();
+        pSpriteComponent->setTexture(g_pSpriteTexture);
+    }
+    g_pScene->update(); // Registers the components
+
+    g_benchmarks.push_back({"SceneManager 50k sprites, culled to the view",
+        [] { g_pScene->setDrawOrder(OSceneManager::DrawOrder::DrawIndex); g_pScene->render(); },
+        [] { return oSpriteBatch->getFlushCount(); },
+        0,
+        nullptr,
+        [] { return std::to_string(g_pScene->getVisibleRender2DCount()) + " of " + std::to_string(g_pScene->getRender2DCount()) + " 2D renderables visited"; }});
+    g_benchmarks.push_back({"SceneManager 50k sprites, culled to the view, y-sorted",
+        [] { g_pScene->setDrawOrder(OSceneManager::DrawOrder::DrawIndexThenY); g_pScene->render(); },
+        [] { return oSpriteBatch->getFlushCount(); },
+        0,
+        nullptr,
+        [] { return std::to_string(g_pScene->getVisibleRender2DCount()) + " of " + std::to_string(g_pScene->getRender2DCount()) + " 2D renderables visited"; }});
+
+    logSpawnBenchmark();
+    logTransformBenchmark(false);
+    logTransformBenchmark(true);
+    logComponentUpdateBenchmark(false);
+    logComponentUpdateBenchmark(true);
+    logQueryBenchmark();
+}
+
+//--- ParticleSystemManager: simulation of 100k live particles
+static const int PARTICLE_COUNT = 100000;
+static const int PARTICLE_EMITTER_COUNT = 16;
+static const int PARTICLE_UPDATE_COUNT = 120;
+
+// One shot: only the simulation is timed, not the rendering.
+// The particles are split between a few emitters, and updated with and without the thread pool.
+void logParticleBenchmark(bool useThreadPool)
+{
+    auto pEmitterDesc = std::make_shared<OParticleEmitterDesc>();
+    pEmitterDesc->type = OParticleEmitterDesc::Type::BURST;
+    pEmitterDesc->count = PARTICLE_COUNT / PARTICLE_EMITTER_COUNT;
+    pEmitterDesc->life = 1000.f; // They all stay alive during the benchmark
+    pEmitterDesc->speed.from = 50.f;
+    pEmitterDesc->speed.to = 200.f;
+    pEmitterDesc->gravity = Vector3(0.f, 100.f, 0.f);
+    pEmitterDesc->radialAccel = 10.f;
+    pEmitterDesc->tangentAccel = 20.f;
+    pEmitterDesc->rotation = 90.f;
+    pEmitterDesc->color.finalValue = Color(1.f, 0.f, 0.f, 0.f);
+    pEmitterDesc->color.finalSpecified = true;
+
+    auto pThreadPool = oThreadPool;
+    if (!useThreadPool) oThreadPool = nullptr;
+
+    auto pParticleSystemManager = OParticleSystemManager::create(PARTICLE_EMITTER_COUNT, PARTICLE_COUNT);
+    auto pParticleSystem = OParticleSystem::create({pEmitterDesc});
+    for (int i = 0; i < PARTICLE_EMITTER_COUNT; ++i)
+    {
+        pParticleSystemManager->emit(pParticleSystem, Vector3(OScreenCenterf, 0.f));
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < PARTICLE_UPDATE_COUNT; ++i)
+    {
+        pParticleSystemManager->update();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() * 1000.0;
+    auto msPerUpdate = elapsed / static_cast<double>(PARTICLE_UPDATE_COUNT);
+
+    oThreadPool = pThreadPool;
+
+    std::stringstream ss;
+    ss << "ParticleSystemManager update " << pParticleSystemManager->getParticleCount() << " live particles, "
+        << (useThreadPool && oThreadPool ? std::to_string(oThreadPool->getWorkerCount()) + " workers: " : "serial: ")
+        << msPerUpdate << " ms/update, "
+        << (static_cast<double>(pParticleSystemManager->getParticleCount()) / msPerUpdate) << " particles/ms";
+    OLog(ss.str());
+}
+
+//--- ParticleSystemManager: back to front sorting of 50k particles
+static const int SORTED_PARTICLE_COUNT = 50000;
+static const int PARTICLE_SORT_COUNT = 60;
+
+// One shot. The emitter has no texture, so render() only does the sorting.
+void logParticleSortBenchmark()
+{
+    auto pEmitterDesc = std::make_shared<OParticleEmitterDesc>();
+    pEmitterDesc->type = OParticleEmitterDesc::Type::BURST;
+    pEmitterDesc->count = SORTED_PARTICLE_COUNT;
+    pEmitterDesc->life = 1000.f;
+    pEmitterDesc->speed.from = 50.f;
+    pEmitterDesc->speed.to = 200.f;
+    pEmitterDesc->spread = 360.f;
+    pEmitterDesc->sortParticles = true;
+
+    auto pParticleSystemManager = OParticleSystemManager::create(1, SORTED_PARTICLE_COUNT, true);
+    pParticleSystemManager->setCameraDir(-Vector3::UnitY);
+    pParticleSystemManager->emit(OParticleSystem::create({pEmitterDesc}), Vector3(OScreenCenterf, 0.f));
+
+    double elapsed = 0.0;
+    for (int i = 0; i < PARTICLE_SORT_COUNT; ++i)
+    {
+        pParticleSystemManager->update(); // Shuffles the depths a bit between sorts
+        auto startTime = std::chrono::high_resolution_clock::now();
+        pParticleSystemManager->render();
+        elapsed += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() * 1000.0;
+    }
+
+    std::stringstream ss;
+    ss << "ParticleSystemManager sort " << pParticleSystemManager->getParticleCount() << " particles back to front: "
+        << (elapsed / static_cast<double>(PARTICLE_SORT_COUNT)) << " ms/sort";
+    OLog(ss.str());
+}
+
+void addParticleBenchmarks()
+{
+    logParticleBenchmark(false);
+    logParticleBenchmark(true);
+    logParticleSortBenchmark();
+}
+
+//--- Dispatcher: OSync from many threads at once
+static const int DISPATCH_PRODUCER_COUNT = 8;
+static const int DISPATCH_CALLBACK_COUNT = 100000; // Per producer
+
+// The dispatcher as it was: a locked queue of std::function
+class LockedDispatcher
+{
+public:
+    void dispatch(const std::function<void()>& fn)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_callbackQueue.push(fn);
+    }
+
+    void processQueue()
+    {
+        m_mutex.lock();
+        while (!m_callbackQueue.empty())
+        {
+            auto callback = m_callbackQueue.front();
+            m_callbackQueue.pop();
+            m_mutex.unlock();
+            callback();
+            m_mutex.lock();
+        }
+        m_mutex.unlock();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::queue<std::function<void()>> m_callbackQueue;
+};
+
+// One shot: producers dispatch callbacks with a 32 bytes capture while this thread processes them
+template<typename Tdispatcher>
+void logDispatcherBenchmark(const std::string& name, Tdispatcher& dispatcher)
+{
+    uint64_t sum = 0;
+    std::atomic<int> doneCount(0);
+    std::vector<std::thread> producers;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    for (int p = 0; p < DISPATCH_PRODUCER_COUNT; ++p)
+    {
+        producers.emplace_back([&dispatcher, &sum, &doneCount]
+        {
+            for (int i = 0; i < DISPATCH_CALLBACK_COUNT; ++i)
+            {
+                uint64_t a = i, b = 1, c = 2;
+                dispatcher.dispatch([&sum, a, b, c] { sum += a + b + c; });
+            }
+            ++doneCount;
+        });
+    }
+    while (doneCount < DISPATCH_PRODUCER_COUNT)
+    {
+        dispatcher.processQueue();
+    }
+    for (auto& producer : producers) producer.join();
+    dispatcher.processQueue();
+    auto elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count() * 1000.0;
+
+    auto callbackCount = DISPATCH_PRODUCER_COUNT * DISPATCH_CALLBACK_COUNT;
+    std::stringstream ss;
+    ss << name << " " << DISPATCH_PRODUCER_COUNT << " producers, " << callbackCount << " callbacks: "
+        << elapsed << " ms, " << (elapsed * 1000000.0 / static_cast<double>(callbackCount)) << " ns/callback"
+        << (sum ? "" : " (nothing called)");
+    OLog(ss.str());
+}
+
+void addDispatcherBenchmarks()
+{
+    LockedDispatcher lockedDispatcher;
+    logDispatcherBenchmark("Locked std::function queue", lockedDispatcher);
+    auto pDispatcher = ODispatcher::create();
+    logDispatcherBenchmark("Dispatcher", *pDispatcher);
+}
+
+//--- Sample callbacks
+void initSettings()
+{
+    oSettings->setGameName("Benchmarks");
+    oSettings->setIsFixedStep(false);
+}
+
+void init()
+{
+    addSpriteBatchBenchmarks();
+    addSortBenchmarks();
+    addAtlasBenchmarks();
+    addSceneBenchmarks();
+    addParticleBenchmarks();
+    addDispatcherBenchmarks();
+}
+
+void update()
+{
+}
+
+void render()
+{
+    oRenderer->clear(Color::Black);
+
+    if (g_currentBenchmark >= g_benchmarks.size())
+    {
+        OQuit();
+        return;
+    }
+
+    auto& benchmark = g_benchmarks[g_currentBenchmark];
+    if (g_frame == 0)
+    {
+        g_elapsed = std::chrono::high_resolution_clock::duration::zero();
+        g_drawCallsAtStart = benchmark.getDrawCallsFn ? benchmark.getDrawCallsFn() : 0;
+        g_uploadedBytesAtStart = benchmark.getUploadedBytesFn ? benchmark.getUploadedBytesFn() : 0;
+    }
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    benchmark.renderFn();
+    g_elapsed += std::chrono::high_resolution_clock::now() - startTime;
+
+    if (++g_frame == BENCHMARK_FRAME_COUNT)
+    {
+        auto seconds = std::chrono::duration<double>(g_elapsed).count();
+        auto drawCalls = benchmark.getDrawCallsFn ? benchmark.getDrawCallsFn() - g_drawCallsAtStart : 0;
+
+        std::stringstream ss;
+        ss << benchmark.name << ": "
+            << (seconds * 1000.0 / static_cast<double>(BENCHMARK_FRAME_COUNT)) << " ms/frame, "
+            << (static_cast<double>(drawCalls) / static_cast<double>(BENCHMARK_FRAME_COUNT)) << " draw calls/frame";
+        if (benchmark.quadsPerFrame && seconds > 0.0)
+        {
+            ss << ", " << (static_cast<double>(benchmark.quadsPerFrame) * static_cast<double>(BENCHMARK_FRAME_COUNT) / seconds) << " quads/s";
+        }
+        if (benchmark.getUploadedBytesFn)
+        {
+            auto uploadedBytes = benchmark.getUploadedBytesFn() - g_uploadedBytesAtStart;
+            ss << ", " << (static_cast<double>(uploadedBytes) / static_cast<double>(BENCHMARK_FRAME_COUNT) / 1024.0) << " KB uploaded/frame";
+        }
+        if (benchmark.getDetailsFn)
+        {
+            ss << ", " << benchmark.getDetailsFn();
+        }
+        OLog(ss.str());
+
+        g_frame = 0;
+        ++g_currentBenchmark;
+    }
+}
+
+void postRender()
+{
+}
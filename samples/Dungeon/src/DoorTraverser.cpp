@@ -16,7 +16,7 @@ void DoorTraverser::onCreate()
 
 void DoorTraverser::onTriggerEnter(const OCollider2DComponentRef& pCollider)
 {
-    auto pDoor = pCollider->getComponent<Door>();
+    auto pDoor = pCollider->getComponentPtr<Door>();
     if (pDoor)
     {
         if (pDoor->getOpen())
@@ -25,7 +25,7 @@ void DoorTraverser::onTriggerEnter(const OCollider2DComponentRef& pCollider)
             auto pTarget = pDoor->getTarget();
             if (pTarget)
             {
-                auto pTargetDoor = pTarget->getComponent<Door>();
+                auto pTargetDoor = pTarget->getComponentPtr<Door>();
                 auto pCollider = getComponent<OCollider2DComponent>();
                 if (pTargetDoor)
                 {
@@ -76,7 +76,7 @@ void DoorTraverser::onTriggerEnter(const OCollider2DComponentRef& pCollider)
                 auto pTarget = pDoor->getTarget();
                 if (pTarget)
                 {
-                    auto pTargetDoor = pTarget->getComponent<Door>();
+                    auto pTargetDoor = pTarget->getComponentPtr<Door>();
                     if (pTargetDoor)
                     {
                         pTargetDoor->setOpen(true);
@@ -6,7 +6,7 @@
 
 void TreasureHunter::onTriggerEnter(const OCollider2DComponentRef& pCollider)
 {
-    auto pChest = pCollider->getComponent<Chest>();
+    auto pChest = pCollider->getComponentPtr<Chest>();
     if (pChest)
     {
         auto gold = pChest->getGold();
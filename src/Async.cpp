@@ -0,0 +1,77 @@
+// Onut
+#include <onut/Async.h>
+
+// STL
+#include <algorithm>
+
+OAsyncExecutorRef oAsyncExecutor;
+
+namespace onut
+{
+    OAsyncExecutorRef AsyncExecutor::create(size_t threadCount)
+    {
+        return OMake<AsyncExecutor>(threadCount);
+    }
+
+    AsyncExecutor::AsyncExecutor(size_t threadCount)
+    {
+        threadCount = std::max<size_t>(1, threadCount);
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            m_threads.emplace_back(&AsyncExecutor::workerThread, this);
+        }
+    }
+
+    AsyncExecutor::~AsyncExecutor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isRunning = false;
+        }
+        m_waitForWork.notify_all();
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    void AsyncExecutor::run(const std::function<void()>& fn)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(fn);
+            m_stats.queuedCount = m_queue.size();
+            m_stats.peakQueuedCount = std::max(m_stats.peakQueuedCount, m_stats.queuedCount);
+        }
+        m_waitForWork.notify_one();
+    }
+
+    AsyncExecutor::Stats AsyncExecutor::getStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    void AsyncExecutor::workerThread()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            // Queued work is finished before stopping
+            m_waitForWork.wait(lock, [this] { return !m_isRunning || !m_queue.empty(); });
+            if (m_queue.empty()) break;
+
+            auto fn = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_stats.queuedCount = m_queue.size();
+            ++m_stats.runningCount;
+            lock.unlock();
+
+            fn();
+
+            lock.lock();
+            --m_stats.runningCount;
+            ++m_stats.completedCount;
+        }
+    }
+}
@@ -5,6 +5,9 @@
 
 // STL
 #include <atomic>
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
 
 namespace onut
 {
@@ -12,6 +15,23 @@ namespace onut
     std::atomic<int> g_componentCount = 0;
 #endif
 
+    ComponentTypeId getComponentTypeId(const std::type_info& typeInfo)
+    {
+        static std::mutex mutex;
+        static std::unordered_map<std::type_index, ComponentTypeId> typeIds;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& typeId = typeIds[std::type_index(typeInfo)];
+        if (!typeId) typeId = static_cast<ComponentTypeId>(typeIds.size());
+        return typeId;
+    }
+
+    void ComponentSystem::bind(Component* pComponent, ComponentSystem* pSystem, uint32_t index)
+    {
+        pComponent->m_pSystem = pSystem;
+        pComponent->m_systemIndex = index;
+    }
+
     Component::Component(int flags)
         : m_flags(flags)
     {
@@ -131,4 +151,33 @@ namespace onut
     {
         getEntity()->setWorldTransform(worldTransform);
     }
+
+    bool Component::getWorldBounds(Rect& worldBounds)
+    {
+        Rect localBounds;
+        if (!getLocalBounds(localBounds)) return false;
+
+        const auto& transform = getWorldTransform();
+        Vector2 corners[4] =
+        {
+            Vector2::Transform(Vector2(localBounds.x, localBounds.y), transform),
+            Vector2::Transform(Vector2(localBounds.x, localBounds.y + localBounds.w), transform),
+            Vector2::Transform(Vector2(localBounds.x + localBounds.z, localBounds.y + localBounds.w), transform),
+            Vector2::Transform(Vector2(localBounds.x + localBounds.z, localBounds.y), transform)
+        };
+        auto minX = onut::min(corners[0].x, corners[1].x, corners[2].x, corners[3].x);
+        auto minY = onut::min(corners[0].y, corners[1].y, corners[2].y, corners[3].y);
+        auto maxX = onut::max(corners[0].x, corners[1].x, corners[2].x, corners[3].x);
+        auto maxY = onut::max(corners[0].y, corners[1].y, corners[2].y, corners[3].y);
+        worldBounds = Rect(minX, minY, maxX - minX, maxY - minY);
+        return true;
+    }
+
+    void Component::dirtyBounds()
+    {
+        // Only renderables in the culling tree need updating
+        if (m_isBoundsDirty || m_render2DProxyId == -1) return;
+        m_isBoundsDirty = true;
+        m_pEntity->m_pSceneManager->m_dirtyRender2DBounds.push_back(OThis);
+    }
 };
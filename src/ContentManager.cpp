@@ -2,6 +2,8 @@
 #include <onut/ContentManager.h>
 #include <onut/Files.h>
 #include <onut/Resource.h>
+#include <onut/Texture.h>
+#include <onut/TextureAtlas.h>
 
 // STL
 #include <cassert>
@@ -92,6 +94,9 @@ namespace onut
     {
         std::unique_lock<std::mutex> locker(m_mutex);
         m_resources.clear();
+
+        // Pages are kept alive by the textures still in use. New ones will start fresh.
+        m_pTextureAtlas = nullptr;
     }
 
     OResourceRef ContentManager::getResource(const std::string& name)
@@ -104,4 +109,45 @@ namespace onut
         }
         return nullptr;
     }
+
+    void ContentManager::setMaxAtlasTextureSize(int size)
+    {
+        m_maxAtlasTextureSize = size;
+    }
+
+    int ContentManager::getMaxAtlasTextureSize() const
+    {
+        return m_maxAtlasTextureSize;
+    }
+
+    void ContentManager::setTextureAtlas(const OTextureAtlasRef& pTextureAtlas)
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        m_pTextureAtlas = pTextureAtlas;
+    }
+
+    OTextureAtlasRef ContentManager::getTextureAtlas()
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        return m_pTextureAtlas;
+    }
+
+    OTextureRef ContentManager::packTexture(const uint8_t* pData, const Point& size)
+    {
+        if (size.x > m_maxAtlasTextureSize || size.y > m_maxAtlasTextureSize)
+        {
+            return nullptr;
+        }
+
+        OTextureAtlasRef pTextureAtlas;
+        {
+            std::unique_lock<std::mutex> locker(m_mutex);
+            if (!m_pTextureAtlas)
+            {
+                m_pTextureAtlas = OTextureAtlas::create();
+            }
+            pTextureAtlas = m_pTextureAtlas;
+        }
+        return pTextureAtlas->insert(pData, size);
+    }
 }
@@ -5,37 +5,126 @@ ODispatcherRef oDispatcher;
 
 namespace onut
 {
+    static_assert((Dispatcher::CAPACITY & (Dispatcher::CAPACITY - 1)) == 0, "Dispatcher capacity must be a power of 2");
+
     ODispatcherRef Dispatcher::create()
     {
         return OMake<Dispatcher>();
     }
 
     Dispatcher::Dispatcher()
+        : m_pCells(new Cell[CAPACITY])
+        , m_enqueuePos(0)
+        , m_dequeuePos(0)
+        , m_overflowCount(0)
     {
         m_threadId = std::this_thread::get_id();
+        for (size_t i = 0; i < CAPACITY; ++i)
+        {
+            m_pCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    void Dispatcher::push(Callback& callback)
+    {
+        // Once callbacks overflowed, the next ones follow them so they keep their order
+        if (!m_overflowCount.load(std::memory_order_acquire) && tryPush(callback)) return;
+
+        std::lock_guard<std::mutex> lock(m_overflowMutex);
+        if (!m_overflowCount.load(std::memory_order_relaxed) && tryPush(callback)) return;
+        m_overflow.push_back(std::move(callback));
+        m_overflowCount.fetch_add(1, std::memory_order_release);
+    }
+
+    bool Dispatcher::tryPush(Callback& callback)
+    {
+        auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+        Cell* pCell;
+        while (true)
+        {
+            pCell = &m_pCells[pos & (CAPACITY - 1)];
+            auto sequence = pCell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            }
+            else if (diff < 0)
+            {
+                return false; // Full
+            }
+            else
+            {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        pCell->callback = std::move(callback);
+        pCell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Dispatcher::tryPop(Callback& callback)
+    {
+        auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+        auto& cell = m_pCells[pos & (CAPACITY - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1) return false; // Empty, or still being written
+        callback = std::move(cell.callback);
+        cell.sequence.store(pos + CAPACITY, std::memory_order_release);
+        m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
     }
 
     void Dispatcher::processQueue()
     {
         m_threadId = std::this_thread::get_id();
-        m_mutex.lock();
-        while (!m_callbackQueue.empty())
+
+        // Callbacks are moved out in batches to free the ring for producers before calling them
+        Callback batch[BATCH_SIZE];
+        while (true)
         {
-            auto callback = m_callbackQueue.front();
-            m_callbackQueue.pop();
-            m_mutex.unlock();
-            callback();
-            m_mutex.lock();
+            size_t count = 0;
+            while (count < BATCH_SIZE && tryPop(batch[count])) ++count;
+
+            if (count)
+            {
+                for (size_t i = 0; i < count; ++i)
+                {
+                    batch[i]();
+                    batch[i].reset();
+                }
+                continue;
+            }
+
+            if (!m_overflowCount.load(std::memory_order_acquire)) break;
+
+            // Overflowed callbacks are newer than everything in the ring. Take them only once the ring is
+            // empty, including slots claimed by producers that are still writing them.
+            std::deque<Callback> overflow;
+            {
+                std::lock_guard<std::mutex> lock(m_overflowMutex);
+                if (m_enqueuePos.load(std::memory_order_acquire) == m_dequeuePos.load(std::memory_order_relaxed))
+                {
+                    overflow.swap(m_overflow);
+                    m_overflowCount.store(0, std::memory_order_release);
+                }
+            }
+            if (overflow.empty())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            for (auto& callback : overflow)
+            {
+                callback();
+            }
         }
-        m_mutex.unlock();
     }
 
     size_t Dispatcher::size()
     {
-        m_mutex.lock();
-        auto ret = m_callbackQueue.size();
-        m_mutex.unlock();
-        return ret;
+        auto dequeuePos = m_dequeuePos.load(std::memory_order_acquire);
+        auto enqueuePos = m_enqueuePos.load(std::memory_order_acquire);
+        return enqueuePos - dequeuePos + m_overflowCount.load(std::memory_order_acquire);
     }
 
     std::thread::id Dispatcher::getThreadId() const
@@ -3,8 +3,15 @@
 #include <onut/Entity.h>
 #include <onut/SceneManager.h>
 
+// Private
+#include "TransformSystem.h"
+
 // STL
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <mutex>
+#include <unordered_map>
 
 namespace onut
 {
@@ -12,6 +19,26 @@ namespace onut
     std::atomic<int> g_entityCount = 0;
 #endif
 
+    static std::mutex g_entityNameMutex;
+    static std::unordered_map<std::string, EntityNameId> g_entityNameIds;
+
+    EntityNameId getEntityNameId(const std::string& name)
+    {
+        if (name.empty()) return 0;
+        std::lock_guard<std::mutex> lock(g_entityNameMutex);
+        auto& nameId = g_entityNameIds[name];
+        if (!nameId) nameId = static_cast<EntityNameId>(g_entityNameIds.size());
+        return nameId;
+    }
+
+    EntityNameId findEntityNameId(const std::string& name)
+    {
+        if (name.empty()) return 0;
+        std::lock_guard<std::mutex> lock(g_entityNameMutex);
+        auto it = g_entityNameIds.find(name);
+        return it == g_entityNameIds.end() ? 0 : it->second;
+    }
+
     OEntityRef Entity::create(const OSceneManagerRef& in_pSceneManager)
     {
         auto pSceneManager = in_pSceneManager;
@@ -30,6 +57,15 @@ namespace onut
 
     Entity::~Entity()
     {
+        if (m_pSceneManager)
+        {
+            auto pTransforms = m_pSceneManager->m_pTransforms;
+            for (auto& pChild : m_children)
+            {
+                pTransforms->setParent(pChild->m_transformId, TransformSystem::INVALID_ID);
+            }
+            pTransforms->destroy(m_transformId);
+        }
 #if defined(_DEBUG)
         --g_entityCount;
 #endif
@@ -37,6 +73,12 @@ namespace onut
 
     void Entity::destroy()
     {
+        if (auto pCommands = SceneManager::getDeferredCommands())
+        {
+            pCommands->push_back({SceneManager::DeferredCommand::Type::DestroyEntity, SceneManager::ComponentAction::Action::AddUpdate, nullptr, OThis, 0, nullptr});
+            return;
+        }
+
         for (auto& pChild : m_children)
         {
             pChild->destroy();
@@ -51,31 +93,17 @@ namespace onut
 
     const Matrix& Entity::getLocalTransform() const
     {
-        return m_localTransform;
+        return m_pSceneManager->m_pTransforms->getLocal(m_transformId);
     }
 
     const Matrix& Entity::getWorldTransform()
     {
-        if (m_isWorldDirty)
-        {
-            auto pParent = getParent();
-            if (pParent)
-            {
-                m_worldTransform = m_localTransform * pParent->getWorldTransform();
-            }
-            else
-            {
-                m_worldTransform = m_localTransform;
-            }
-            m_isWorldDirty = false;
-        }
-        return m_worldTransform;
+        return m_pSceneManager->m_pTransforms->getWorld(m_transformId);
     }
 
     void Entity::setLocalTransform(const Matrix& localTransform)
     {
-        m_localTransform = localTransform;
-        dirtyWorld();
+        m_pSceneManager->m_pTransforms->setLocal(m_transformId, localTransform);
     }
 
     void Entity::setWorldTransform(const Matrix& worldTransform)
@@ -87,29 +115,31 @@ namespace onut
             parentWorld = pParent->getWorldTransform();
         }
         auto invParentWorld = parentWorld.Invert();
-        m_localTransform = worldTransform * invParentWorld;
-        m_isWorldDirty = true;
+        setLocalTransform(worldTransform * invParentWorld);
     }
 
-    void Entity::dirtyWorld()
+    void Entity::onWorldChanged()
     {
-        m_isWorldDirty = true;
-        for (auto& pChild : m_children)
+        for (auto& pComponent : m_components)
         {
-            pChild->dirtyWorld();
+            pComponent->dirtyBounds();
         }
     }
 
     void Entity::add(const OEntityRef& pChild)
     {
+        // The scene computes world transforms, both have to be in it
+        assert(pChild->m_pSceneManager == m_pSceneManager);
+        if (pChild->m_pSceneManager != m_pSceneManager) return;
+
         m_children.push_back(pChild);
         auto pChildParent = pChild->getParent();
         if (pChildParent)
         {
             pChildParent->remove(pChild);
         }
-        pChild->dirtyWorld();
         pChild->m_pParent = OThis;
+        m_pSceneManager->m_pTransforms->setParent(pChild->m_transformId, m_transformId);
         for (auto& pComponent : m_components)
         {
             pComponent->onAddChild(pChild);
@@ -128,7 +158,7 @@ namespace onut
                 }
                 pChild->m_pParent.reset();
                 m_children.erase(it);
-                pChild->dirtyWorld();
+                m_pSceneManager->m_pTransforms->setParent(pChild->m_transformId, TransformSystem::INVALID_ID);
                 return;
             }
         }
@@ -262,12 +292,31 @@ namespace onut
     }
 
     void Entity::addComponent(const OComponentRef& pComponent)
+    {
+        auto& component = *pComponent;
+        addComponent(pComponent, getComponentTypeId(typeid(component)));
+    }
+
+    void Entity::addComponent(const OComponentRef& pComponent, ComponentTypeId typeId)
     {
         pComponent->m_pEntity = OThis;
         if (m_pSceneManager)
         {
             m_pSceneManager->m_componentJustCreated.push_back(pComponent);
         }
+
+        // Index it, the first component of a type wins
+        if (findComponent(typeId) < 0)
+        {
+            auto it = m_componentIndices.begin();
+            while (it != m_componentIndices.end() && it->typeId < typeId) ++it;
+            m_componentIndices.insert(it, {typeId, static_cast<int>(m_components.size())});
+            m_componentTypeMask |= 1ull << (typeId & 63);
+            if (m_queryIndex != 0xFFFFFFFF)
+            {
+                m_pSceneManager->m_queryItems[m_queryIndex].componentTypeMask = m_componentTypeMask;
+            }
+        }
         m_components.push_back(pComponent);
         if (pComponent->isEnabled())
         {
@@ -286,6 +335,12 @@ namespace onut
         }
     }
 
+    ComponentSystem* Entity::findComponentSystem(ComponentTypeId typeId) const
+    {
+        if (!m_pSceneManager) return nullptr;
+        return m_pSceneManager->findComponentSystem(typeId);
+    }
+
     void Entity::render2d()
     {
         for (auto& pComponent : m_components)
@@ -316,11 +371,52 @@ namespace onut
 
     void Entity::setName(const std::string& name)
     {
+        auto nameId = getEntityNameId(name);
+        if (m_queryIndex != 0xFFFFFFFF && nameId != m_nameId)
+        {
+            SceneManager::removeFromIndex(m_pSceneManager->m_entitiesByName, m_nameId, this);
+            SceneManager::addToIndex(m_pSceneManager->m_entitiesByName, nameId, this);
+        }
         m_name = name;
+        m_nameId = nameId;
+    }
+
+    void Entity::addTag(const std::string& tag)
+    {
+        auto tagId = getEntityNameId(tag);
+        if (!tagId || std::find(m_tags.begin(), m_tags.end(), tagId) != m_tags.end()) return;
+        m_tags.push_back(tagId);
+        if (m_queryIndex != 0xFFFFFFFF)
+        {
+            SceneManager::addToIndex(m_pSceneManager->m_entitiesByTag, tagId, this);
+        }
+    }
+
+    void Entity::removeTag(const std::string& tag)
+    {
+        auto it = std::find(m_tags.begin(), m_tags.end(), findEntityNameId(tag));
+        if (it == m_tags.end()) return;
+        if (m_queryIndex != 0xFFFFFFFF)
+        {
+            SceneManager::removeFromIndex(m_pSceneManager->m_entitiesByTag, *it, this);
+        }
+        m_tags.erase(it);
+    }
+
+    bool Entity::hasTag(const std::string& tag) const
+    {
+        auto tagId = findEntityNameId(tag);
+        return tagId && std::find(m_tags.begin(), m_tags.end(), tagId) != m_tags.end();
     }
 
     void Entity::sendMessage(int messageId, void* pData)
     {
+        if (auto pCommands = SceneManager::getDeferredCommands())
+        {
+            pCommands->push_back({SceneManager::DeferredCommand::Type::Message, SceneManager::ComponentAction::Action::AddUpdate, nullptr, OThis, messageId, pData});
+            return;
+        }
+
         auto pThis = OThis; // This way we make sure we don't destroy all our stuff
         for (auto& pComponent : m_components)
         {
@@ -351,57 +447,8 @@ namespace onut
 
     void Entity::setDrawIndex(int drawIndex)
     {
-        if (m_drawIndex == drawIndex) return;
-        auto previousIndex = m_drawIndex;
+        // The scene sorts its 2D renderables when rendering
         m_drawIndex = drawIndex;
-        auto pRenderableList = getSceneManager()->m_pComponentRender2Ds;
-        Component* pOtherComponent;
-        for (auto& pComponentRef : m_components)
-        {
-            auto pComponent = pComponentRef.get();
-            if (pComponent->m_render2DLink.IsLinked())
-            {
-                // Re-order it
-                if (m_drawIndex < previousIndex)
-                {
-                    pOtherComponent = pComponent->m_render2DLink.Prev();
-                    pComponent->m_render2DLink.Unlink();
-                    while (pOtherComponent)
-                    {
-                        auto otherIndex = pOtherComponent->m_pEntity->getDrawIndex();
-                        if (m_drawIndex > otherIndex)
-                        {
-                            pRenderableList->InsertAfter(pComponent, pOtherComponent);
-                            break;
-                        }
-                        pOtherComponent = pOtherComponent->m_render2DLink.Prev();
-                    }
-                    if (!pOtherComponent)
-                    {
-                        pRenderableList->InsertHead(pComponent);
-                    }
-                }
-                else
-                {
-                    pOtherComponent = pComponent->m_render2DLink.Next();
-                    pComponent->m_render2DLink.Unlink();
-                    while (pOtherComponent)
-                    {
-                        auto otherIndex = pOtherComponent->m_pEntity->getDrawIndex();
-                        if (m_drawIndex < otherIndex)
-                        {
-                            pRenderableList->InsertBefore(pComponent, pOtherComponent);
-                            break;
-                        }
-                        pOtherComponent = pOtherComponent->m_render2DLink.Next();
-                    }
-                    if (!pOtherComponent)
-                    {
-                        pRenderableList->InsertTail(pComponent);
-                    }
-                }
-            }
-        }
     }
 
     const Entity::Entities& Entity::getChildren() const
@@ -93,7 +93,13 @@ namespace onut
                 pNewChar->page = parseInt("page", split);
                 pNewChar->chnl = parseInt("chnl", split);
 
-                pFont->m_chars[pNewChar->id] = pNewChar;
+                auto& pChar = pFont->m_chars[pNewChar->id];
+                delete pChar;
+                pChar = pNewChar;
+                if (pNewChar->id >= 0 && pNewChar->id < GLYPH_TABLE_SIZE)
+                {
+                    pFont->m_glyphTable[pNewChar->id] = pNewChar;
+                }
             }
 
             getline(in, line);
@@ -141,12 +147,11 @@ namespace onut
                 i += 3;
                 continue;
             }
-            auto iCharId = static_cast<int>(static_cast<unsigned char>(charId));
-            if (!m_chars.count(iCharId))
+            auto pDatChar = getGlyph(static_cast<int>(static_cast<unsigned char>(charId)));
+            if (!pDatChar)
             {
                 continue;
             }
-            auto pDatChar = m_chars[iCharId];
             if (i == len - 1)
             {
                 curX += static_cast<float>(pDatChar->xoffset) + static_cast<float>(pDatChar->width);
@@ -174,7 +179,7 @@ namespace onut
         int charId;
         for (; pos < len; ++pos)
         {
-            charId = in_text[pos];
+            charId = static_cast<int>(static_cast<unsigned char>(in_text[pos]));
             if (charId == '\n')
             {
                 return pos;
@@ -184,9 +189,8 @@ namespace onut
                 pos += 3;
                 continue;
             }
-            const auto& it = m_chars.find(charId);
-            if (it == m_chars.end()) continue;
-            auto pDatChar = it->second;
+            auto pDatChar = getGlyph(charId);
+            if (!pDatChar) continue;
             auto advance = static_cast<float>(pDatChar->xadvance);
             if (curX + advance * .75f >= at)
             {
@@ -285,13 +289,12 @@ namespace onut
                 i += 4;
                 continue;
             }
-            auto iCharId = static_cast<int>(static_cast<unsigned char>(charId));
-            if (!m_chars.count(iCharId))
+            auto pDatChar = getGlyph(static_cast<int>(static_cast<unsigned char>(charId)));
+            if (!pDatChar)
             {
                 ++i;
                 continue;
             }
-            auto pDatChar = m_chars[iCharId];
             auto& pTexture = m_pages[pDatChar->page]->pTexture;
 
             // Draw it here
@@ -7,16 +7,20 @@
 
 namespace onut
 {
-    OIndexBufferRef IndexBuffer::createStatic(const void* pVertexData, uint32_t size)
+    OIndexBufferRef IndexBuffer::createStatic(const void* pVertexData, uint32_t size, uint32_t elementSize)
     {
+        assert(elementSize == 16 || elementSize == 32);
         auto pRet = OMake<IndexBufferD3D11>();
+        pRet->m_elementSize = elementSize;
         pRet->setData(pVertexData, size);
         return pRet;
     }
 
-    OIndexBufferRef IndexBuffer::createDynamic(uint32_t size)
+    OIndexBufferRef IndexBuffer::createDynamic(uint32_t size, uint32_t elementSize)
     {
+        assert(elementSize == 16 || elementSize == 32);
         auto pRet = OMake<IndexBufferD3D11>();
+        pRet->m_elementSize = elementSize;
         pRet->m_isDynamic = true;
         assert(false);
         return pRet;
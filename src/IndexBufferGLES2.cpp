@@ -1,4 +1,4 @@
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Private
 #include "IndexBufferGLES2.h"
 #include "RendererGLES2.h"
@@ -8,16 +8,20 @@
 
 namespace onut
 {
-    OIndexBufferRef IndexBuffer::createStatic(const void* pVertexData, uint32_t size)
+    OIndexBufferRef IndexBuffer::createStatic(const void* pVertexData, uint32_t size, uint32_t elementSize)
     {
+        assert(elementSize == 16 || elementSize == 32);
         auto pRet = OMake<IndexBufferGLES2>();
+        pRet->m_elementSize = elementSize;
         pRet->setData(pVertexData, size);
         return pRet;
     }
 
-    OIndexBufferRef IndexBuffer::createDynamic(uint32_t size)
+    OIndexBufferRef IndexBuffer::createDynamic(uint32_t size, uint32_t elementSize)
     {
+        assert(elementSize == 16 || elementSize == 32);
         auto pRet = OMake<IndexBufferGLES2>();
+        pRet->m_elementSize = elementSize;
         
         GLuint handle;
         glGenBuffers(1, &handle);
@@ -1,7 +1,7 @@
 #ifndef INDEXBUFFERGLES2_H_INCLUDED
 #define INDEXBUFFERGLES2_H_INCLUDED
 
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/IndexBuffer.h>
 
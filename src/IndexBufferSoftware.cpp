@@ -0,0 +1,64 @@
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Private
+#include "IndexBufferSoftware.h"
+
+// STL
+#include <cassert>
+#include <cstring>
+
+namespace onut
+{
+    OIndexBufferRef IndexBuffer::createStatic(const void* pIndexData, uint32_t size, uint32_t elementSize)
+    {
+        assert(elementSize == 16 || elementSize == 32);
+        auto pRet = OMake<IndexBufferSoftware>();
+        pRet->m_elementSize = elementSize;
+        pRet->setData(pIndexData, size);
+        return pRet;
+    }
+
+    OIndexBufferRef IndexBuffer::createDynamic(uint32_t size, uint32_t elementSize)
+    {
+        assert(elementSize == 16 || elementSize == 32);
+        auto pRet = OMake<IndexBufferSoftware>();
+        pRet->m_elementSize = elementSize;
+        pRet->m_data.resize(size);
+        pRet->m_isDynamic = true;
+        return pRet;
+    }
+
+    IndexBufferSoftware::IndexBufferSoftware()
+    {
+    }
+
+    IndexBufferSoftware::~IndexBufferSoftware()
+    {
+    }
+
+    void IndexBufferSoftware::setData(const void* pIndexData, uint32_t size)
+    {
+        if (!m_isDynamic || size > m_data.size())
+        {
+            m_data.resize(size);
+        }
+        memcpy(m_data.data(), pIndexData, size);
+    }
+
+    void* IndexBufferSoftware::map()
+    {
+        assert(m_isDynamic);
+        return m_data.data();
+    }
+
+    void IndexBufferSoftware::unmap(uint32_t size)
+    {
+        assert(m_isDynamic);
+    }
+
+    uint32_t IndexBufferSoftware::size()
+    {
+        return static_cast<uint32_t>(m_data.size());
+    }
+}
+
+#endif
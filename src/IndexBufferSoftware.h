@@ -0,0 +1,40 @@
+#ifndef INDEXBUFFERSOFTWARE_H_INCLUDED
+#define INDEXBUFFERSOFTWARE_H_INCLUDED
+
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/IndexBuffer.h>
+
+// STL
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(IndexBufferSoftware)
+
+namespace onut
+{
+    class IndexBufferSoftware final : public IndexBuffer
+    {
+    public:
+        IndexBufferSoftware();
+        ~IndexBufferSoftware();
+
+        void setData(const void* pIndexData, uint32_t size) override;
+        void* map() override;
+        void unmap(uint32_t size) override;
+        uint32_t size() override;
+
+        const uint8_t* getData() const { return m_data.data(); }
+
+    private:
+        friend class IndexBuffer;
+
+        bool m_isDynamic = false;
+        std::vector<uint8_t> m_data;
+    };
+};
+
+#endif
+
+#endif
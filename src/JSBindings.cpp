@@ -215,6 +215,28 @@ namespace onut
             duk_set_prototype(ctx, -2);
         }
 
+        static void newRenderStatsFrame(duk_context* ctx, const RenderStats::Frame& frame)
+        {
+            duk_push_object(ctx);
+            duk_push_uint(ctx, frame.drawCalls); duk_put_prop_string(ctx, -2, "drawCalls");
+            duk_push_uint(ctx, frame.indexCount); duk_put_prop_string(ctx, -2, "indexCount");
+            duk_push_uint(ctx, frame.vertexCount); duk_put_prop_string(ctx, -2, "vertexCount");
+            duk_push_uint(ctx, frame.renderTargetChanges); duk_put_prop_string(ctx, -2, "renderTargetChanges");
+            duk_push_uint(ctx, frame.textureChanges); duk_put_prop_string(ctx, -2, "textureChanges");
+            duk_push_uint(ctx, frame.samplerChanges); duk_put_prop_string(ctx, -2, "samplerChanges");
+            duk_push_uint(ctx, frame.blendChanges); duk_put_prop_string(ctx, -2, "blendChanges");
+            duk_push_uint(ctx, frame.scissorChanges); duk_put_prop_string(ctx, -2, "scissorChanges");
+            duk_push_uint(ctx, frame.shaderChanges); duk_put_prop_string(ctx, -2, "shaderChanges");
+            duk_push_uint(ctx, frame.getFlushCount()); duk_put_prop_string(ctx, -2, "flushCount");
+            duk_push_object(ctx);
+            for (int i = 0; i < static_cast<int>(RenderStats::FlushReason::COUNT); ++i)
+            {
+                auto reason = static_cast<RenderStats::FlushReason>(i);
+                duk_push_uint(ctx, frame.getFlushCount(reason)); duk_put_prop_string(ctx, -2, RenderStats::getFlushReasonName(reason));
+            }
+            duk_put_prop_string(ctx, -2, "flushes");
+        }
+
         static Vector2 getVector2(duk_context *ctx, duk_idx_t index, const Vector2& default = Vector2::Zero)
         {
             if (duk_is_object(ctx, index))
@@ -7123,6 +7145,27 @@ namespace onut
                 }
                 JS_INTERFACE_FUNCTION_END("drawIndexed", 1);
 
+                JS_INTERFACE_FUNCTION_BEGIN
+                {
+                    newRenderStatsFrame(ctx, oRenderer->getStats().getFrame(JS_INT(0)));
+                    return 1;
+                }
+                JS_INTERFACE_FUNCTION_END("getStats", 1);
+
+                JS_INTERFACE_FUNCTION_BEGIN
+                {
+                    duk_push_int(ctx, oRenderer->getStats().getFrameCount());
+                    return 1;
+                }
+                JS_INTERFACE_FUNCTION_END("getStatsFrameCount", 0);
+
+                JS_INTERFACE_FUNCTION_BEGIN
+                {
+                    duk_push_boolean(ctx, oRenderer->getStats().saveCSV(JS_STRING(0)));
+                    return 1;
+                }
+                JS_INTERFACE_FUNCTION_END("saveStatsCSV", 1);
+
                 // Render target
                 JS_INTERFACE_FUNCTION_BEGIN
                 {
@@ -0,0 +1,280 @@
+// Private
+#include "ParticleBuffer.h"
+
+// Third party
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ONUT_PARTICLE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ONUT_PARTICLE_NEON
+#include <arm_neon.h>
+#endif
+
+// STL
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // One attribute of 4 consecutive particles
+    struct Float4
+    {
+#if defined(ONUT_PARTICLE_SSE2)
+        __m128 v;
+
+        static Float4 splat(float value) { return {_mm_set1_ps(value)}; }
+        static Float4 load(const float* pValues) { return {_mm_loadu_ps(pValues)}; }
+        void store(float* pValues) const { _mm_storeu_ps(pValues, v); }
+        Float4 operator+(const Float4& other) const { return {_mm_add_ps(v, other.v)}; }
+        Float4 operator-(const Float4& other) const { return {_mm_sub_ps(v, other.v)}; }
+        Float4 operator*(const Float4& other) const { return {_mm_mul_ps(v, other.v)}; }
+        Float4 operator/(const Float4& other) const { return {_mm_div_ps(v, other.v)}; }
+        Float4 operator-() const { return {_mm_sub_ps(_mm_setzero_ps(), v)}; }
+        Float4 sqrt() const { return {_mm_sqrt_ps(v)}; }
+        Float4 max(const Float4& other) const { return {_mm_max_ps(v, other.v)}; }
+        Float4 ifPositive(const Float4& value) const { return {_mm_and_ps(_mm_cmpgt_ps(v, _mm_setzero_ps()), value.v)}; }
+#elif defined(ONUT_PARTICLE_NEON)
+        float32x4_t v;
+
+        static Float4 splat(float value) { return {vdupq_n_f32(value)}; }
+        static Float4 load(const float* pValues) { return {vld1q_f32(pValues)}; }
+        void store(float* pValues) const { vst1q_f32(pValues, v); }
+        Float4 operator+(const Float4& other) const { return {vaddq_f32(v, other.v)}; }
+        Float4 operator-(const Float4& other) const { return {vsubq_f32(v, other.v)}; }
+        Float4 operator*(const Float4& other) const { return {vmulq_f32(v, other.v)}; }
+        Float4 operator/(const Float4& other) const
+        {
+#if defined(__aarch64__) || defined(_M_ARM64)
+            return {vdivq_f32(v, other.v)};
+#else
+            float a[4], b[4];
+            vst1q_f32(a, v);
+            vst1q_f32(b, other.v);
+            for (int i = 0; i < 4; ++i) a[i] /= b[i];
+            return {vld1q_f32(a)};
+#endif
+        }
+        Float4 operator-() const { return {vnegq_f32(v)}; }
+        Float4 sqrt() const
+        {
+#if defined(__aarch64__) || defined(_M_ARM64)
+            return {vsqrtq_f32(v)};
+#else
+            float a[4];
+            vst1q_f32(a, v);
+            for (int i = 0; i < 4; ++i) a[i] = std::sqrt(a[i]);
+            return {vld1q_f32(a)};
+#endif
+        }
+        Float4 max(const Float4& other) const { return {vmaxq_f32(v, other.v)}; }
+        Float4 ifPositive(const Float4& value) const
+        {
+            auto mask = vcgtq_f32(v, vdupq_n_f32(0.f));
+            return {vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(value.v)))};
+        }
+#else
+        float v[4];
+
+        static Float4 splat(float value) { return {{value, value, value, value}}; }
+        static Float4 load(const float* pValues) { return {{pValues[0], pValues[1], pValues[2], pValues[3]}}; }
+        void store(float* pValues) const { memcpy(pValues, v, sizeof(v)); }
+        Float4 operator+(const Float4& other) const { return {{v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3]}}; }
+        Float4 operator-(const Float4& other) const { return {{v[0] - other.v[0], v[1] - other.v[1], v[2] - other.v[2], v[3] - other.v[3]}}; }
+        Float4 operator*(const Float4& other) const { return {{v[0] * other.v[0], v[1] * other.v[1], v[2] * other.v[2], v[3] * other.v[3]}}; }
+        Float4 operator/(const Float4& other) const { return {{v[0] / other.v[0], v[1] / other.v[1], v[2] / other.v[2], v[3] / other.v[3]}}; }
+        Float4 operator-() const { return {{-v[0], -v[1], -v[2], -v[3]}}; }
+        Float4 sqrt() const { return {{std::sqrt(v[0]), std::sqrt(v[1]), std::sqrt(v[2]), std::sqrt(v[3])}}; }
+        Float4 max(const Float4& other) const { return {{std::max(v[0], other.v[0]), std::max(v[1], other.v[1]), std::max(v[2], other.v[2]), std::max(v[3], other.v[3])}}; }
+        Float4 ifPositive(const Float4& value) const
+        {
+            return {{v[0] > 0.f ? value.v[0] : 0.f, v[1] > 0.f ? value.v[1] : 0.f, v[2] > 0.f ? value.v[2] : 0.f, v[3] > 0.f ? value.v[3] : 0.f}};
+        }
+#endif
+    };
+
+    Float4 lerp(const Float4& from, const Float4& to, const Float4& t)
+    {
+        return from + (to - from) * t;
+    }
+
+    // Same as sPfxCurve::sample, a lane at a time. There is no gather before AVX2.
+    Float4 sampleCurve(const float* pCurve, const Float4& t)
+    {
+        if (!pCurve) return t;
+        float values[4];
+        t.store(values);
+        for (auto& value : values)
+        {
+            auto x = value * static_cast<float>(onut::ParticleBuffer::CURVE_SIZE - 1);
+            auto i = static_cast<int>(x);
+            value = pCurve[i] + (pCurve[i + 1] - pCurve[i]) * (x - static_cast<float>(i));
+        }
+        return Float4::load(values);
+    }
+}
+
+namespace onut
+{
+    uint32_t ParticleBuffer::add()
+    {
+        if (m_size == m_capacity) grow();
+        return m_size++;
+    }
+
+    void ParticleBuffer::remove(uint32_t index)
+    {
+        auto last = --m_size;
+        if (index == last) return;
+        for (auto pStream : m_pStreams)
+        {
+            pStream[index] = pStream[last];
+        }
+        m_textureIndices[index] = m_textureIndices[last];
+    }
+
+    void ParticleBuffer::update(const UpdateParams& params, uint32_t begin, uint32_t end)
+    {
+        assert(begin % 4 == 0);
+        // The capacity is padded to 4, the lanes past the end are updated for nothing
+        auto dt = Float4::splat(params.dt);
+        auto one = Float4::splat(1.f);
+        auto zero = Float4::splat(0.f);
+        auto gravityDtX = Float4::splat(params.gravity.x) * dt;
+        auto gravityDtY = Float4::splat(params.gravity.y) * dt;
+        auto gravityDtZ = Float4::splat(params.gravity.z) * dt;
+        auto gravityX = Float4::splat(params.gravity.x);
+        auto gravityY = Float4::splat(params.gravity.y);
+        auto gravityZ = Float4::splat(params.gravity.z);
+        auto emitterX = Float4::splat(params.emitterPosition.x);
+        auto emitterY = Float4::splat(params.emitterPosition.y);
+        auto emitterZ = Float4::splat(params.emitterPosition.z);
+
+        auto pLife = m_pStreams[Life];
+        auto pDelta = m_pStreams[Delta];
+        auto pProgress = m_pStreams[Progress];
+        auto pPositionX = m_pStreams[PositionX];
+        auto pPositionY = m_pStreams[PositionY];
+        auto pPositionZ = m_pStreams[PositionZ];
+        auto pVelocityX = m_pStreams[VelocityX];
+        auto pVelocityY = m_pStreams[VelocityY];
+        auto pVelocityZ = m_pStreams[VelocityZ];
+        auto pAngleFrom = m_pStreams[AngleFrom];
+        auto pAngleTo = m_pStreams[AngleTo];
+        auto pRotationFrom = m_pStreams[RotationFrom];
+        auto pRotationTo = m_pStreams[RotationTo];
+        auto pRadialAccelFrom = m_pStreams[RadialAccelFrom];
+        auto pRadialAccelTo = m_pStreams[RadialAccelTo];
+        auto pTangentAccelFrom = m_pStreams[TangentAccelFrom];
+        auto pTangentAccelTo = m_pStreams[TangentAccelTo];
+
+        end = std::min(end, m_size);
+        for (uint32_t i = begin; i < end; i += 4)
+        {
+            // The animated values used for this step are the ones of the previous step
+            auto t = Float4::load(pProgress + i);
+            auto life = Float4::load(pLife + i);
+            (one - life).store(pProgress + i);
+            (life - Float4::load(pDelta + i) * dt).max(zero).store(pLife + i);
+
+            // Animate position with velocity
+            auto positionX = Float4::load(pPositionX + i);
+            auto positionY = Float4::load(pPositionY + i);
+            auto positionZ = Float4::load(pPositionZ + i);
+            auto velocityX = Float4::load(pVelocityX + i);
+            auto velocityY = Float4::load(pVelocityY + i);
+            auto velocityZ = Float4::load(pVelocityZ + i);
+            positionX = positionX + velocityX * dt;
+            positionY = positionY + velocityY * dt;
+            positionZ = positionZ + velocityZ * dt;
+            velocityX = velocityX + gravityDtX;
+            velocityY = velocityY + gravityDtY;
+            velocityZ = velocityZ + gravityDtZ;
+
+            auto rotationDt = lerp(Float4::load(pRotationFrom + i), Float4::load(pRotationTo + i), sampleCurve(params.pRotationCurve, t)) * dt;
+            (Float4::load(pAngleFrom + i) + rotationDt).store(pAngleFrom + i);
+            (Float4::load(pAngleTo + i) + rotationDt).store(pAngleTo + i);
+
+            // Acceleration
+            if (params.accelerate)
+            {
+                auto radialX = positionX - emitterX;
+                auto radialY = positionY - emitterY;
+                auto radialZ = positionZ - emitterZ;
+                auto len = (radialX * radialX + radialY * radialY + radialZ * radialZ).sqrt();
+                auto invLen = len.ifPositive(one / len);
+                radialX = radialX * invLen;
+                radialY = radialY * invLen;
+                radialZ = radialZ * invLen;
+
+                auto radialAccel = lerp(Float4::load(pRadialAccelFrom + i), Float4::load(pRadialAccelTo + i), sampleCurve(params.pRadialAccelCurve, t));
+                auto tangentAccel = lerp(Float4::load(pTangentAccelFrom + i), Float4::load(pTangentAccelTo + i), sampleCurve(params.pTangentAccelCurve, t));
+
+                // Tangent is (radial.y, -radial.x, 0)
+                velocityX = velocityX + (gravityX + radialX * radialAccel + radialY * tangentAccel) * dt;
+                velocityY = velocityY + (gravityY + radialY * radialAccel + (-radialX) * tangentAccel) * dt;
+                velocityZ = velocityZ + (gravityZ + radialZ * radialAccel) * dt;
+            }
+
+            positionX.store(pPositionX + i);
+            positionY.store(pPositionY + i);
+            positionZ.store(pPositionZ + i);
+            velocityX.store(pVelocityX + i);
+            velocityY.store(pVelocityY + i);
+            velocityZ.store(pVelocityZ + i);
+        }
+    }
+
+    void ParticleBuffer::advance(float time, const Vector3& acceleration, uint32_t begin, uint32_t end)
+    {
+        auto halfTimeSquared = .5f * time * time;
+        end = std::min(end, m_size);
+        for (auto i = begin; i < end; ++i)
+        {
+            auto life = std::max(0.f, m_pStreams[Life][i] - m_pStreams[Delta][i] * time);
+            auto rotation = OLerp(m_pStreams[RotationFrom][i], m_pStreams[RotationTo][i], m_pStreams[Progress][i]) * time;
+            m_pStreams[Life][i] = life;
+            m_pStreams[Progress][i] = 1.f - life;
+            m_pStreams[AngleFrom][i] += rotation;
+            m_pStreams[AngleTo][i] += rotation;
+            m_pStreams[PositionX][i] += m_pStreams[VelocityX][i] * time + acceleration.x * halfTimeSquared;
+            m_pStreams[PositionY][i] += m_pStreams[VelocityY][i] * time + acceleration.y * halfTimeSquared;
+            m_pStreams[PositionZ][i] += m_pStreams[VelocityZ][i] * time + acceleration.z * halfTimeSquared;
+            m_pStreams[VelocityX][i] += acceleration.x * time;
+            m_pStreams[VelocityY][i] += acceleration.y * time;
+            m_pStreams[VelocityZ][i] += acceleration.z * time;
+        }
+    }
+
+    uint32_t ParticleBuffer::removeDead()
+    {
+        auto sizeBefore = m_size;
+        auto pLife = m_pStreams[Life];
+        for (uint32_t i = 0; i < m_size;)
+        {
+            if (pLife[i] > 0.f)
+            {
+                ++i;
+                continue;
+            }
+            remove(i);
+        }
+        return sizeBefore - m_size;
+    }
+
+    void ParticleBuffer::grow()
+    {
+        auto capacity = std::max<uint32_t>(16, m_capacity * 2);
+        std::vector<float> memory(static_cast<size_t>(capacity) * STREAM_COUNT);
+        for (int stream = 0; stream < STREAM_COUNT; ++stream)
+        {
+            auto pStream = memory.data() + static_cast<size_t>(capacity) * stream;
+            if (m_size) memcpy(pStream, m_pStreams[stream], sizeof(float) * m_size);
+            m_pStreams[stream] = pStream;
+        }
+        m_memory.swap(memory);
+        m_textureIndices.resize(capacity);
+        m_capacity = capacity;
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef PARTICLEBUFFER_H_INCLUDED
+#define PARTICLEBUFFER_H_INCLUDED
+
+// Onut
+#include <onut/Curve.h>
+#include <onut/Maths.h>
+
+// STL
+#include <cinttypes>
+#include <vector>
+
+namespace onut
+{
+    /**
+    Particles of an emitter, one array per attribute so they are updated 4 at a time.
+    Values animated over the life of a particle are stored as from/to, and lerped with its progress.
+    Dead particles are replaced by the last one, the order is not kept.
+    */
+    class ParticleBuffer final
+    {
+    public:
+        enum Stream : int
+        {
+            Life,
+            Delta, // Life lost per second
+            Progress, // 0 to 1, lerp factor of the from/to values
+            PositionX,
+            PositionY,
+            PositionZ,
+            VelocityX,
+            VelocityY,
+            VelocityZ,
+            ColorFromR,
+            ColorFromG,
+            ColorFromB,
+            ColorFromA,
+            ColorToR,
+            ColorToG,
+            ColorToB,
+            ColorToA,
+            AngleFrom,
+            AngleTo,
+            SizeFrom,
+            SizeTo,
+            RotationFrom,
+            RotationTo,
+            RadialAccelFrom,
+            RadialAccelTo,
+            TangentAccelFrom,
+            TangentAccelTo,
+
+            STREAM_COUNT
+        };
+
+        static const int CURVE_SIZE = 64;
+
+        struct UpdateParams
+        {
+            float dt;
+            Vector3 gravity;
+            bool accelerate; // Radial and tangential acceleration around the emitter
+            Vector3 emitterPosition;
+
+            // Tables of CURVE_SIZE + 1 factors sampled by progress, like sPfxCurve. Null is linear.
+            const float* pRotationCurve = nullptr;
+            const float* pRadialAccelCurve = nullptr;
+            const float* pTangentAccelCurve = nullptr;
+        };
+
+        uint32_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        void clear() { m_size = 0; }
+
+        /**
+        Add a particle at the end. Its attributes are not initialized.
+        @return the particle index
+        */
+        uint32_t add();
+
+        /**
+        Remove a particle by moving the last one in its place.
+        */
+        void remove(uint32_t index);
+
+        /**
+        Integrate the particles in [begin, end). Doesn't remove the dead ones.
+        Ranges starting on a multiple of 4 can be updated on different threads.
+        */
+        void update(const UpdateParams& params, uint32_t begin, uint32_t end);
+        void update(const UpdateParams& params) { update(params, 0, m_size); }
+
+        /**
+        Move the particles in [begin, end) by time in a single step, with a constant acceleration.
+        Used to catch up on time that wasn't simulated, radial and tangential accelerations are ignored.
+        */
+        void advance(float time, const Vector3& acceleration, uint32_t begin, uint32_t end);
+
+        /**
+        @return the number of particles removed
+        */
+        uint32_t removeDead();
+
+        float* get(Stream stream) { return m_pStreams[stream]; }
+        const float* get(Stream stream) const { return m_pStreams[stream]; }
+        uint32_t* getTextureIndices() { return m_textureIndices.data(); }
+        const uint32_t* getTextureIndices() const { return m_textureIndices.data(); }
+
+        Vector3 getPosition(uint32_t index) const
+        {
+            return {m_pStreams[PositionX][index], m_pStreams[PositionY][index], m_pStreams[PositionZ][index]};
+        }
+
+        float getProgress(uint32_t index) const { return m_pStreams[Progress][index]; }
+
+        /**
+        Animated values, from start to final by a factor sampled from the value's curve at the particle's progress.
+        */
+        Color getColor(uint32_t index, const Color& factor) const
+        {
+            return {
+                OLerp(m_pStreams[ColorFromR][index], m_pStreams[ColorToR][index], factor.r),
+                OLerp(m_pStreams[ColorFromG][index], m_pStreams[ColorToG][index], factor.g),
+                OLerp(m_pStreams[ColorFromB][index], m_pStreams[ColorToB][index], factor.b),
+                OLerp(m_pStreams[ColorFromA][index], m_pStreams[ColorToA][index], factor.a)
+            };
+        }
+
+        float getAngle(uint32_t index, float factor) const
+        {
+            return OLerp(m_pStreams[AngleFrom][index], m_pStreams[AngleTo][index], factor);
+        }
+
+        float getSize(uint32_t index, float factor) const
+        {
+            return OLerp(m_pStreams[SizeFrom][index], m_pStreams[SizeTo][index], factor);
+        }
+
+    private:
+        void grow();
+
+        std::vector<float> m_memory;
+        float* m_pStreams[STREAM_COUNT] = {nullptr};
+        std::vector<uint32_t> m_textureIndices;
+        uint32_t m_size = 0;
+        uint32_t m_capacity = 0; // Always a multiple of 4
+    };
+}
+
+#endif
@@ -1,30 +1,67 @@
 // Onut
 #include <onut/ParticleSystem.h>
 #include <onut/ParticleSystemManager.h>
-#include <onut/Timing.h>
+#include <onut/SpriteBatch.h>
+#include <onut/Texture.h>
 
 // Private
-#include "Particle.h"
 #include "ParticleEmitter.h"
+#include "RadixSort.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+    static_assert(onut::sPfxCurve<float>::SIZE == onut::ParticleBuffer::CURVE_SIZE, "Particle curves must match the buffer's");
+
+    template<typename Ttype>
+    const float* getUpdateCurve(const onut::sPfxValue<Ttype>& value)
+    {
+        return value.isLinear() ? nullptr : value.curve.table;
+    }
+}
 
 namespace onut
 {
     ParticleEmitter::ParticleEmitter(const OParticleEmitterDescRef& pEmitterDesc,
                                      const OParticleSystemManagerRef& pParticleSystemManager,
                                      const Matrix& transform,
-                                     uint32_t instanceId) :
-        m_pDesc(pEmitterDesc),
+                                     uint32_t instanceId,
+                                     uint32_t seed) :
+        m_random(seed),
         m_pParticleSystemManager(pParticleSystemManager),
-        m_transform(transform),
         m_isAlive(true),
+        m_transform(transform),
+        m_pDesc(pEmitterDesc),
         m_instanceId(instanceId)
     {
-        m_duration = m_pDesc->duration.generate();
+        m_duration = m_pDesc->duration.generate(m_random);
+
+        m_cullRadius = m_pDesc->cullRadius;
+        if (m_cullRadius <= 0.f)
+        {
+            // How far the fastest particle can go in its longest life, plus the spawn offset and the biggest size
+            auto maxLife = std::max(m_pDesc->life.from, m_pDesc->life.to);
+            auto maxSpeed = std::max(std::abs(m_pDesc->speed.from), std::abs(m_pDesc->speed.to));
+            auto maxOffset = std::max(m_pDesc->position.from.Length(), m_pDesc->position.to.Length());
+            auto maxSize = std::max(std::max(std::abs(m_pDesc->size.value.from), std::abs(m_pDesc->size.value.to)),
+                                    std::max(std::abs(m_pDesc->size.finalValue.from), std::abs(m_pDesc->size.finalValue.to)));
+            if (m_pDesc->size.finalSpecified && m_pDesc->size.finalValueType != PfxFinalValueType::NORMAL)
+            {
+                maxSize *= 2.f; // Can grow past both values, this is a rough bound
+            }
+            m_cullRadius = maxSpeed * maxLife + .5f * getAcceleration().Length() * maxLife * maxLife + maxOffset + maxSize;
+        }
+
         if (m_pDesc->type == ParticleEmitterDesc::Type::BURST)
         {
             // Spawn them all!
             for (decltype(m_pDesc->count) i = 0; i < m_pDesc->count; ++i)
             {
+                if (!m_pParticleSystemManager->allocParticle()) break;
                 spawnParticle();
             }
         }
@@ -32,10 +69,7 @@ namespace onut
 
     ParticleEmitter::~ParticleEmitter()
     {
-        for (auto pParticle : m_particles)
-        {
-            m_pParticleSystemManager->deallocParticle(pParticle);
-        }
+        m_pParticleSystemManager->deallocParticles(m_particles.size());
         m_particles.clear();
     }
 
@@ -44,51 +78,68 @@ namespace onut
         m_isStopped = true;
     }
 
-    void ParticleEmitter::update()
+    void ParticleEmitter::simulate(float dt, uint32_t begin, uint32_t end)
     {
-        // Update current particles
-        for (decltype(m_particles.size()) i = 0; i < m_particles.size();)
-        {
-            auto pParticle = m_particles[i];
-            pParticle->update();
-            if (!pParticle->isAlive())
-            {
-                m_pParticleSystemManager->deallocParticle(pParticle);
-                m_particles.erase(m_particles.begin() + i);
-                continue;
-            }
-            ++i;
-        }
+        ParticleBuffer::UpdateParams params;
+        params.dt = dt;
+        params.gravity = m_pDesc->gravity;
+        params.accelerate = m_pDesc->accelType == OParticleEmitterDesc::AccelType::Gravity;
+        params.emitterPosition = getPosition();
+        params.pRotationCurve = getUpdateCurve(m_pDesc->rotation);
+        params.pRadialAccelCurve = getUpdateCurve(m_pDesc->radialAccel);
+        params.pTangentAccelCurve = getUpdateCurve(m_pDesc->tangentAccel);
+        m_particles.update(params, begin, end);
+    }
+
+    uint32_t ParticleEmitter::collect(float dt)
+    {
+        m_age += dt;
+        m_particles.removeDead();
 
         // Spawn at rate
+        uint32_t spawnCount = 0;
         if (m_pDesc->type == ParticleEmitterDesc::Type::CONTINOUS && m_pDesc->rate > 0 && !m_isStopped)
         {
-            m_rateProgress += ODT;
+            m_rateProgress += dt;
             auto rate = 1.0f / m_pDesc->rate;
             while (m_rateProgress >= rate)
             {
                 m_rateProgress -= rate;
-                spawnParticle();
+                ++spawnCount;
             }
         }
 
-        if (m_pDesc->type == ParticleEmitterDesc::Type::CONTINOUS && m_isStopped)
-        {
-            if (m_particles.empty()) m_isAlive = false;
-        }
-
         if (m_pDesc->type == ParticleEmitterDesc::Type::FINITE && m_pDesc->rate > 0 && !m_isStopped && m_duration > 0.f)
         {
-            m_duration -= ODT;
-            m_rateProgress += ODT;
+            m_duration -= dt;
+            m_rateProgress += dt;
             auto rate = 1.0f / m_pDesc->rate;
             while (m_rateProgress >= rate)
             {
                 m_rateProgress -= rate;
-                spawnParticle();
+                ++spawnCount;
             }
         }
 
+        return spawnCount;
+    }
+
+    void ParticleEmitter::spawn(uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            spawnParticle();
+        }
+        updateAlive();
+    }
+
+    void ParticleEmitter::updateAlive()
+    {
+        if (m_pDesc->type == ParticleEmitterDesc::Type::CONTINOUS && m_isStopped)
+        {
+            if (m_particles.empty()) m_isAlive = false;
+        }
+
         if (m_pDesc->type == ParticleEmitterDesc::Type::FINITE && (m_isStopped || m_duration <= 0.f))
         {
             if (m_particles.empty()) m_isAlive = false;
@@ -101,83 +152,280 @@ namespace onut
         }
     }
 
-    void ParticleEmitter::render()
+    uint32_t ParticleEmitter::throttle(uint32_t count, float scale)
+    {
+        if (scale >= 1.f)
+        {
+            m_throttleCarry = 0.f;
+            return count;
+        }
+        auto wanted = static_cast<float>(count) * std::max(0.f, scale) + m_throttleCarry;
+        auto granted = std::min(count, static_cast<uint32_t>(wanted));
+        m_throttleCarry = wanted - static_cast<float>(granted);
+        return granted;
+    }
+
+    void ParticleEmitter::skip(float dt)
+    {
+        m_age += dt;
+        m_skippedTime += dt;
+    }
+
+    void ParticleEmitter::fastForward(uint32_t maxSpawnCount)
     {
-        auto camDir = -Vector3::UnitZ;
-        auto camUp = -Vector3::UnitY;
-        auto camRight = camDir.Cross(camUp);
+        auto time = m_skippedTime;
+        m_skippedTime = 0.f;
+        if (time <= 0.f) return;
 
-        for (decltype(m_particles.size()) i = 0; i < m_particles.size(); ++i)
+        auto acceleration = getAcceleration();
+        m_particles.advance(time, acceleration, 0, m_particles.size());
+        m_particles.removeDead();
+
+        // Particles spawned at rate during the skipped time. Only the ones young enough to be alive are spawned,
+        // newest first, then aged by the time since their spawn.
+        bool isSpawning = !m_isStopped && m_pDesc->rate > 0 &&
+            (m_pDesc->type == ParticleEmitterDesc::Type::CONTINOUS ||
+            (m_pDesc->type == ParticleEmitterDesc::Type::FINITE && m_duration > 0.f));
+        if (isSpawning)
         {
-            m_pParticleSystemManager->renderParticle(m_particles[i], camRight, camUp);
+            auto spawnTime = time;
+            if (m_pDesc->type == ParticleEmitterDesc::Type::FINITE)
+            {
+                spawnTime = std::min(time, m_duration);
+                m_duration -= time;
+            }
+            auto rate = 1.0f / m_pDesc->rate;
+            m_rateProgress += spawnTime;
+            auto spawnCount = std::floor(m_rateProgress / rate);
+            m_rateProgress = std::fmod(m_rateProgress, rate);
+
+            auto maxLife = std::max(m_pDesc->life.from, m_pDesc->life.to);
+            auto age = time - spawnTime + m_rateProgress;
+            for (uint32_t i = 0; static_cast<float>(i) < spawnCount && i < maxSpawnCount && age < maxLife; ++i, age += rate)
+            {
+                auto index = spawnParticle();
+                m_particles.advance(age, acceleration, index, index + 1);
+            }
+            m_particles.removeDead();
         }
+
+        updateAlive();
     }
 
-    void ParticleEmitter::setTransform(const Matrix& transform)
+    float ParticleEmitter::getRemainingTime() const
     {
-        m_transform = transform;
+        auto maxLife = std::max(m_pDesc->life.from, m_pDesc->life.to);
+        if (!m_isStopped)
+        {
+            if (m_pDesc->type == ParticleEmitterDesc::Type::CONTINOUS) return std::numeric_limits<float>::infinity();
+            if (m_pDesc->type == ParticleEmitterDesc::Type::FINITE) return std::max(0.f, m_duration) + maxLife;
+        }
+        return maxLife;
     }
 
-    void ParticleEmitter::setRenderEnabled(bool renderEnabled)
+    float ParticleEmitter::getSustainedCount() const
     {
-        m_renderEnabled = renderEnabled;
+        if (m_isStopped || m_pDesc->rate <= 0) return 0.f;
+        if (m_pDesc->type == ParticleEmitterDesc::Type::CONTINOUS ||
+            (m_pDesc->type == ParticleEmitterDesc::Type::FINITE && m_duration > 0.f))
+        {
+            return m_pDesc->rate * (m_pDesc->life.from + m_pDesc->life.to) * .5f;
+        }
+        return 0.f;
     }
 
-    Particle* ParticleEmitter::spawnParticle()
+    Vector3 ParticleEmitter::getAcceleration() const
     {
-        auto pParticle = m_pParticleSystemManager->allocParticle();
-        if (pParticle)
+        // Same as the simulation, which applies gravity twice with gravity acceleration
+        return m_pDesc->accelType == OParticleEmitterDesc::AccelType::Gravity ? m_pDesc->gravity * 2.f : m_pDesc->gravity;
+    }
+
+    void ParticleEmitter::beginRender(const Vector3& cameraDir)
+    {
+        m_vertices.resize(static_cast<size_t>(m_particles.size()) * 4);
+        m_isSorted = m_pDesc->sortParticles && m_particles.size() > 1;
+        if (m_isSorted) sortParticles(cameraDir);
+    }
+
+    void ParticleEmitter::sortParticles(const Vector3& cameraDir)
+    {
+        auto len = m_particles.size();
+        auto pPositionX = m_particles.get(ParticleBuffer::PositionX);
+        auto pPositionY = m_particles.get(ParticleBuffer::PositionY);
+        auto pPositionZ = m_particles.get(ParticleBuffer::PositionZ);
+
+        auto getDepth = [&](uint32_t i)
+        {
+            return pPositionX[i] * cameraDir.x + pPositionY[i] * cameraDir.y + pPositionZ[i] * cameraDir.z;
+        };
+        auto minDepth = std::numeric_limits<float>::max();
+        auto maxDepth = std::numeric_limits<float>::lowest();
+        for (uint32_t i = 0; i < len; ++i)
+        {
+            auto depth = getDepth(i);
+            minDepth = std::min(minDepth, depth);
+            maxDepth = std::max(maxDepth, depth);
+        }
+
+        // 16 bits keys, 2 radix passes. Particles closer than the quantization step keep their order.
+        auto scale = maxDepth > minDepth ? 65535.f / (maxDepth - minDepth) : 0.f;
+        m_sortItems.resize(len);
+        for (uint32_t i = 0; i < len; ++i)
         {
-            Vector3 spawnPos = m_transform.Translation();
-            Vector3 up = m_transform.AxisZ();
-            Vector3 right = m_transform.AxisX();
+            m_sortItems[i] = {static_cast<uint16_t>((maxDepth - getDepth(i)) * scale), i};
+        }
+        radixSort(m_sortItems, m_sortScratch, [](const SortItem& item) { return item.key; });
+    }
 
-            auto randomAngleX = m_pDesc->spread.generateFrom() * .5f;
-            auto randomAngleZ = randf(0, 360.f);
+    void ParticleEmitter::prepareRender(uint32_t begin, uint32_t end)
+    {
+        const auto& textures = m_pDesc->textures;
+        if (textures.empty()) return;
 
-            Matrix rotX = Matrix::CreateFromAxisAngle(right, OConvertToRadians(randomAngleX));
-            Matrix rotZ = Matrix::CreateFromAxisAngle(up, OConvertToRadians(randomAngleZ));
+        auto pTextureIndices = m_particles.getTextureIndices();
+        auto pVerts = m_vertices.data() + static_cast<size_t>(begin) * 4;
+        for (auto renderIndex = begin; renderIndex < end; ++renderIndex, pVerts += 4)
+        {
+            auto i = getRenderIndex(renderIndex);
 
-            up = Vector3::Transform(up, rotX);
-            up = Vector3::Transform(up, rotZ);
-            if (m_pDesc->dir.LengthSquared() != 0)
-            {
-                Matrix rotDir = Matrix::CreateFromAxisAngle(Vector3(m_pDesc->dir.y, m_pDesc->dir.x, 0), OConvertToRadians(90));
-                up = Vector3::Transform(up, rotDir);
-            }
+            // Same as SpriteBatch::drawSprite, centered
+            auto textureSize = textures[pTextureIndices[i]]->getSize();
+            auto sizexf = static_cast<float>(textureSize.x);
+            auto sizeyf = static_cast<float>(textureSize.y);
+            auto t = m_particles.getProgress(i);
+            auto scale = m_particles.getSize(i, m_pDesc->size.curve.sample(t)) / std::max(sizexf, sizeyf);
+            auto hSize = Vector2(sizexf * .5f * scale, sizeyf * .5f * scale);
+            auto radTheta = OConvertToRadians(m_particles.getAngle(i, m_pDesc->angle.curve.sample(t)));
+            auto sinTheta = std::sin(radTheta);
+            auto cosTheta = std::cos(radTheta);
+            Vector2 right{cosTheta * hSize.x, sinTheta * hSize.x};
+            Vector2 down{-sinTheta * hSize.y, cosTheta * hSize.y};
+            Vector2 position = m_particles.getPosition(i);
+            auto color = m_particles.getColor(i, m_pDesc->color.curve.sample(t));
+
+            pVerts[0].position = position - right - down;
+            pVerts[0].texCoord = {0, 0};
+            pVerts[0].color = color;
 
-            pParticle->pDesc = m_pDesc;
-            pParticle->pEmitter = this;
-
-            pParticle->position = spawnPos + m_pDesc->position.generate();
-            pParticle->velocity = up * m_pDesc->speed.generate();
-
-            pParticle->color.to = m_pDesc->color.generateTo(pParticle->color.from = m_pDesc->color.generateFrom());
-            pParticle->angle.to = m_pDesc->angle.generateTo(pParticle->angle.from = m_pDesc->angle.generateFrom());
-            pParticle->size.to = m_pDesc->size.generateTo(pParticle->size.from = m_pDesc->size.generateFrom());
-            pParticle->image_index.to = m_pDesc->image_index.generateTo(pParticle->image_index.from = m_pDesc->image_index.generateFrom());
-            pParticle->rotation.to = m_pDesc->rotation.generateTo(pParticle->rotation.from = m_pDesc->rotation.generateFrom());
-            pParticle->radialAccel.to = m_pDesc->radialAccel.generateTo(pParticle->radialAccel.from = m_pDesc->radialAccel.generateFrom());
-            pParticle->tangentAccel.to = m_pDesc->tangentAccel.generateTo(pParticle->tangentAccel.from = m_pDesc->tangentAccel.generateFrom());
-
-            pParticle->color.update(0);
-            pParticle->angle.update(0);
-            pParticle->size.update(0);
-            pParticle->image_index.update(0);
-            pParticle->rotation.update(0);
-            pParticle->radialAccel.update(0);
-            pParticle->tangentAccel.update(0);
-
-            if (!pParticle->pDesc->textures.empty())
+            pVerts[1].position = position - right + down;
+            pVerts[1].texCoord = {0, 1};
+            pVerts[1].color = color;
+
+            pVerts[2].position = position + right + down;
+            pVerts[2].texCoord = {1, 1};
+            pVerts[2].color = color;
+
+            pVerts[3].position = position + right - down;
+            pVerts[3].texCoord = {1, 0};
+            pVerts[3].color = color;
+        }
+    }
+
+    void ParticleEmitter::submitRender()
+    {
+        const auto& textures = m_pDesc->textures;
+        if (textures.empty()) return;
+
+        // One call per run of particles sharing a texture
+        auto pTextureIndices = m_particles.getTextureIndices();
+        auto len = m_particles.size();
+        uint32_t runStart = 0;
+        auto runTextureIndex = len ? pTextureIndices[getRenderIndex(0)] : 0;
+        for (uint32_t i = 1; i <= len; ++i)
+        {
+            auto textureIndex = i < len ? pTextureIndices[getRenderIndex(i)] : 0;
+            if (i == len || textureIndex != runTextureIndex)
             {
-                pParticle->pTexture = pParticle->pDesc->textures[static_cast<decltype(pParticle->pDesc->textures.size())>(pParticle->image_index.value)];
+                oSpriteBatch->drawQuads(textures[runTextureIndex], m_vertices.data() + static_cast<size_t>(runStart) * 4, i - runStart);
+                runStart = i;
+                runTextureIndex = textureIndex;
             }
+        }
+    }
 
-            pParticle->life = 1.f;
-            pParticle->delta = 1.f / m_pDesc->life.generate();
+    void ParticleEmitter::render(const Vector3& cameraDir)
+    {
+        beginRender(cameraDir);
+        prepareRender(0, m_particles.size());
+        submitRender();
+    }
 
-            m_particles.push_back(pParticle);
+    void ParticleEmitter::setTransform(const Matrix& transform)
+    {
+        m_transform = transform;
+    }
+
+    void ParticleEmitter::setRenderEnabled(bool renderEnabled)
+    {
+        m_renderEnabled = renderEnabled;
+    }
+
+    uint32_t ParticleEmitter::spawnParticle()
+    {
+        Vector3 spawnPos = m_transform.Translation();
+        Vector3 up = m_transform.AxisZ();
+        Vector3 right = m_transform.AxisX();
+
+        auto randomAngleX = m_pDesc->spread.generateFrom(m_random) * .5f;
+        auto randomAngleZ = m_random.randf(0, 360.f);
+
+        Matrix rotX = Matrix::CreateFromAxisAngle(right, OConvertToRadians(randomAngleX));
+        Matrix rotZ = Matrix::CreateFromAxisAngle(up, OConvertToRadians(randomAngleZ));
+
+        up = Vector3::Transform(up, rotX);
+        up = Vector3::Transform(up, rotZ);
+        if (m_pDesc->dir.LengthSquared() != 0)
+        {
+            Matrix rotDir = Matrix::CreateFromAxisAngle(Vector3(m_pDesc->dir.y, m_pDesc->dir.x, 0), OConvertToRadians(90));
+            up = Vector3::Transform(up, rotDir);
         }
-        return pParticle;
+
+        auto position = spawnPos + m_pDesc->position.generate(m_random);
+        auto velocity = up * m_pDesc->speed.generate(m_random);
+        auto colorFrom = m_pDesc->color.generateFrom(m_random);
+        auto colorTo = m_pDesc->color.generateTo(colorFrom, m_random);
+        auto angleFrom = m_pDesc->angle.generateFrom(m_random);
+        auto angleTo = m_pDesc->angle.generateTo(angleFrom, m_random);
+        auto sizeFrom = m_pDesc->size.generateFrom(m_random);
+        auto sizeTo = m_pDesc->size.generateTo(sizeFrom, m_random);
+        auto imageIndex = m_pDesc->image_index.generateFrom(m_random);
+        auto rotationFrom = m_pDesc->rotation.generateFrom(m_random);
+        auto rotationTo = m_pDesc->rotation.generateTo(rotationFrom, m_random);
+        auto radialAccelFrom = m_pDesc->radialAccel.generateFrom(m_random);
+        auto radialAccelTo = m_pDesc->radialAccel.generateTo(radialAccelFrom, m_random);
+        auto tangentAccelFrom = m_pDesc->tangentAccel.generateFrom(m_random);
+        auto tangentAccelTo = m_pDesc->tangentAccel.generateTo(tangentAccelFrom, m_random);
+        auto life = m_pDesc->life.generate(m_random);
+
+        auto i = m_particles.add();
+        m_particles.get(ParticleBuffer::Life)[i] = 1.f;
+        m_particles.get(ParticleBuffer::Delta)[i] = 1.f / life;
+        m_particles.get(ParticleBuffer::Progress)[i] = 0.f;
+        m_particles.get(ParticleBuffer::PositionX)[i] = position.x;
+        m_particles.get(ParticleBuffer::PositionY)[i] = position.y;
+        m_particles.get(ParticleBuffer::PositionZ)[i] = position.z;
+        m_particles.get(ParticleBuffer::VelocityX)[i] = velocity.x;
+        m_particles.get(ParticleBuffer::VelocityY)[i] = velocity.y;
+        m_particles.get(ParticleBuffer::VelocityZ)[i] = velocity.z;
+        m_particles.get(ParticleBuffer::ColorFromR)[i] = colorFrom.r;
+        m_particles.get(ParticleBuffer::ColorFromG)[i] = colorFrom.g;
+        m_particles.get(ParticleBuffer::ColorFromB)[i] = colorFrom.b;
+        m_particles.get(ParticleBuffer::ColorFromA)[i] = colorFrom.a;
+        m_particles.get(ParticleBuffer::ColorToR)[i] = colorTo.r;
+        m_particles.get(ParticleBuffer::ColorToG)[i] = colorTo.g;
+        m_particles.get(ParticleBuffer::ColorToB)[i] = colorTo.b;
+        m_particles.get(ParticleBuffer::ColorToA)[i] = colorTo.a;
+        m_particles.get(ParticleBuffer::AngleFrom)[i] = angleFrom;
+        m_particles.get(ParticleBuffer::AngleTo)[i] = angleTo;
+        m_particles.get(ParticleBuffer::SizeFrom)[i] = sizeFrom;
+        m_particles.get(ParticleBuffer::SizeTo)[i] = sizeTo;
+        m_particles.get(ParticleBuffer::RotationFrom)[i] = rotationFrom;
+        m_particles.get(ParticleBuffer::RotationTo)[i] = rotationTo;
+        m_particles.get(ParticleBuffer::RadialAccelFrom)[i] = radialAccelFrom;
+        m_particles.get(ParticleBuffer::RadialAccelTo)[i] = radialAccelTo;
+        m_particles.get(ParticleBuffer::TangentAccelFrom)[i] = tangentAccelFrom;
+        m_particles.get(ParticleBuffer::TangentAccelTo)[i] = tangentAccelTo;
+        m_particles.getTextureIndices()[i] = m_pDesc->textures.empty() ? 0 : static_cast<uint32_t>(imageIndex);
+        return i;
     }
 }
@@ -3,6 +3,14 @@
 
 // Onut
 #include <onut/Maths.h>
+#include <onut/Random.h>
+#include <onut/SpriteBatch.h>
+
+// Private
+#include "ParticleBuffer.h"
+
+// STL
+#include <vector>
 
 // Forward
 #include <onut/ForwardDeclaration.h>
@@ -11,33 +19,108 @@ OForwardDeclare(ParticleSystemManager);
 
 namespace onut
 {
-    class Particle;
-
     class ParticleEmitter final
     {
     public:
-        ParticleEmitter(const OParticleEmitterDescRef& pEmitterDesc, const OParticleSystemManagerRef& pParticleSystemManager, const Matrix& transform, uint32_t instanceId = 0);
+        ParticleEmitter(const OParticleEmitterDescRef& pEmitterDesc, const OParticleSystemManagerRef& pParticleSystemManager, const Matrix& transform, uint32_t instanceId = 0, uint32_t seed = 0);
         ~ParticleEmitter();
 
         bool isAlive() const { return m_isAlive; }
         void stop();
 
-        void update();
-        void render();
+        /**
+        A step is split in 3 so the particle system manager can run each part in parallel:
+        simulate() on particle ranges, then collect() and spawn() per emitter.
+        Only the emitter's own random stream is used, the result doesn't depend on the threads.
+        */
+        void simulate(float dt, uint32_t begin, uint32_t end);
+
+        /**
+        Remove dead particles and advance the spawn rate.
+        @return the number of particles this emitter wants to spawn
+        */
+        uint32_t collect(float dt);
+
+        /**
+        @param count Particles granted by the manager's budget, at most what collect() asked
+        */
+        void spawn(uint32_t count);
+
+        /**
+        Budget share when the manager can't grant everything asked.
+        Fractions of particles are carried to the next frames, so low rates still spawn.
+        @param scale 0 to 1
+        @return the number of particles to spawn
+        */
+        uint32_t throttle(uint32_t count, float scale);
+
+        /**
+        Off-screen emitters aren't simulated, the time is only accumulated.
+        fastForward() catches up when they come back in view: the particles are moved along
+        their trajectory and those that would have spawned meanwhile are spawned already aged.
+        @param maxSpawnCount Budget left for the particles spawned while skipped
+        */
+        void skip(float dt);
+        void fastForward(uint32_t maxSpawnCount);
+        float getSkippedTime() const { return m_skippedTime; }
+
+        /**
+        @return how long until the emitter is done, as an upper bound. Infinite for continuous emitters still playing.
+        */
+        float getRemainingTime() const;
+
+        /**
+        @return particles alive on average at the current spawn rate, 0 if not spawning at rate
+        */
+        float getSustainedCount() const;
+
+        float getAge() const { return m_age; } // Time since emitted, simulated or not
+        float getCullRadius() const { return m_cullRadius; }
+
+        /**
+        Rendering is split the same way: beginRender() sizes the staging vertices
+        and sorts the particles if the desc asks for it,
+        prepareRender() fills them for a particle range and can run in parallel,
+        then submitRender() sends them to the SpriteBatch.
+        @param cameraDir Particles further along it are drawn first
+        */
+        void beginRender(const Vector3& cameraDir);
+        void prepareRender(uint32_t begin, uint32_t end);
+        void submitRender();
+        void render(const Vector3& cameraDir);
 
         void setTransform(const Matrix& transform);
-        uint32_t getInstanceId() const { return m_instanceId; }
+        uint32_t getInstanceId() const { return m_instanceId; } // Instance slot in the manager
 
         void setRenderEnabled(bool renderEnabled);
         bool getRenderEnabled() const { return m_renderEnabled; }
 
         Vector3 getPosition() const { return m_transform.Translation(); }
         const OParticleEmitterDescRef& getDesc() const { return m_pDesc; }
+        uint32_t getParticleCount() const { return m_particles.size(); }
 
     private:
-        Particle* spawnParticle();
+        struct SortItem
+        {
+            uint16_t key; // Quantized depth, 0 is the furthest
+            uint32_t index;
+        };
+
+        using Vertices = std::vector<SpriteBatch::SVertexP2T2C4>;
+        using SortItems = std::vector<SortItem>;
+
+        uint32_t spawnParticle();
+        void updateAlive();
+        Vector3 getAcceleration() const;
+        void sortParticles(const Vector3& cameraDir);
+        uint32_t getRenderIndex(uint32_t i) const { return m_isSorted ? m_sortItems[i].index : i; }
 
-        std::vector<Particle*> m_particles;
+        ParticleBuffer m_particles;
+        RandomStream m_random;
+        Vertices m_vertices; // Staging for the SpriteBatch, 4 per particle
+        SortItems m_sortItems; // Draw order of the particles, when sorted
+        SortItems m_sortScratch;
+        bool m_isSorted = false;
         OParticleSystemManagerRef m_pParticleSystemManager;
         bool m_isAlive = false;
         Matrix m_transform;
@@ -47,6 +130,10 @@ namespace onut
         bool m_isStopped = false;
         bool m_renderEnabled = true;
         float m_duration = 0.f;
+        float m_age = 0.f;
+        float m_skippedTime = 0.f;
+        float m_throttleCarry = 0.f;
+        float m_cullRadius = 0.f;
     };
 }
 
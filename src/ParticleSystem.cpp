@@ -364,6 +364,27 @@ namespace onut
         return std::move(pex);
     }
 
+    void ParticleEmitterDesc::bake()
+    {
+        color.bake();
+        angle.bake();
+        size.bake();
+        rotation.bake();
+        radialAccel.bake();
+        tangentAccel.bake();
+    }
+
+    OParticleSystemRef ParticleSystem::create(const Emitters& emitters)
+    {
+        auto pRet = std::make_shared<OParticleSystem>();
+        pRet->m_emitters = emitters;
+        for (auto& pEmitter : pRet->m_emitters)
+        {
+            pEmitter->bake();
+        }
+        return pRet;
+    }
+
     OParticleSystemRef ParticleSystem::createFromFile(const std::string& filename, const OContentManagerRef &in_pContentManager)
     {
         OContentManagerRef pContentManager = in_pContentManager;
@@ -412,6 +433,12 @@ namespace onut
                 pEmitter->image_index = jsonEmitter["image_index"];
                 pEmitter->life = jsonEmitter["life"];
                 pEmitter->position = jsonEmitter["position"];
+                pEmitter->rotation = jsonEmitter["rotation"];
+                pEmitter->radialAccel = jsonEmitter["radialAccel"];
+                pEmitter->tangentAccel = jsonEmitter["tangentAccel"];
+                pfxReadBool(pEmitter->sortParticles, jsonEmitter["sortParticles"]);
+                pfxReadFloat(pEmitter->importance, jsonEmitter["importance"]);
+                pfxReadFloat(pEmitter->cullRadius, jsonEmitter["cullRadius"]);
                 const auto& images = jsonEmitter["images"];
                 for (decltype(images.Size()) j = 0; j < images.Size(); ++j)
                 {
@@ -514,6 +541,7 @@ namespace onut
                 pEmitter->rate = (static_cast<float>(pex.maxParticles) / pex.particleLifeSpan);
                 pEmitter->type = ParticleEmitterDesc::Type::FINITE;
             }
+            pEmitter->bake();
 
             return pRet;
         }
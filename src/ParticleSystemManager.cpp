@@ -4,25 +4,56 @@
 #include <onut/Pool.h>
 #include <onut/SpriteBatch.h>
 #include <onut/Texture.h>
+#include <onut/ThreadPool.h>
+#include <onut/Timing.h>
 
 // Private
-#include "Particle.h"
 #include "ParticleEmitter.h"
+#include "RadixSort.h"
+
+// STL
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <limits>
 
 OParticleSystemManagerRef oParticleSystemManager;
 
+namespace
+{
+    // Particles per simulation and render job. A multiple of 4 for the SIMD update.
+    const uint32_t PARTICLES_PER_JOB = 4096;
+
+    // Below that, jobs are run on the calling thread
+    const uint32_t MIN_PARALLEL_PARTICLES = 2 * PARTICLES_PER_JOB;
+
+    // Calls fn for every index in [0, count) on the thread pool, one index at a time, and waits for all of them.
+    // fn must only touch data owned by its index.
+    void parallelFor(uint32_t count, const std::function<void(uint32_t)>& fn, bool isParallel)
+    {
+        if (isParallel && oThreadPool && count > 1)
+        {
+            oThreadPool->parallelFor(0, count, 1, [&fn](size_t i) { fn(static_cast<uint32_t>(i)); });
+            return;
+        }
+        for (uint32_t i = 0; i < count; ++i) fn(i);
+    }
+}
+
 namespace onut
 {
+    const float ParticleSystemManager::DEFAULT_WARM_UP_TIME = 1.f;
+
     OParticleSystemManagerRef ParticleSystemManager::create(uintptr_t TmaxPFX, uintptr_t TmaxParticles, bool TsortEmitters)
     {
-        return OMake<ParticleSystemManager>(TmaxPFX, TmaxParticles, false);
+        return OMake<ParticleSystemManager>(TmaxPFX, TmaxParticles, TsortEmitters);
     }
 
     ParticleSystemManager::ParticleSystemManager(uintptr_t TmaxPFX, uintptr_t TmaxParticles, bool TsortEmitters)
-        : m_sortEmitters(TsortEmitters)
+        : m_maxParticles(TmaxParticles)
+        , m_sortEmitters(TsortEmitters)
     {
-        m_pEmitterPool = OPool::create(sizeof(ParticleEmitter), TmaxPFX);
-        m_pParticlePool = OPool::create(sizeof(Particle), TmaxParticles);
+        m_pEmitterPool = OPool::create(sizeof(ParticleEmitter), TmaxPFX, OPool::FailAction::ReturnNull, false, alignof(ParticleEmitter));
     }
 
     void ParticleSystemManager::EmitterInstance::setTransform(const Vector3& pos, const Vector3& dir, const Vector3& up)
@@ -35,17 +66,12 @@ namespace onut
     {
         if (m_pParticleSystemManager)
         {
-            auto len = m_pParticleSystemManager->m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
+            auto pSlot = m_pParticleSystemManager->getInstanceSlot(*this);
+            if (pSlot)
             {
-                auto pEmitter = m_pParticleSystemManager->m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pParticleSystemManager->m_pEmitterPool->isUsed(pEmitter))
+                for (auto pEmitter : pSlot->emitters)
                 {
-                    if (pEmitter->getInstanceId() == m_id)
-                    {
-                        pEmitter->setRenderEnabled(renderEnabled);
-                        break;
-                    }
+                    pEmitter->setRenderEnabled(renderEnabled);
                 }
             }
         }
@@ -55,17 +81,12 @@ namespace onut
     {
         if (m_pParticleSystemManager)
         {
-            auto len = m_pParticleSystemManager->m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
+            auto pSlot = m_pParticleSystemManager->getInstanceSlot(*this);
+            if (pSlot)
             {
-                auto pEmitter = m_pParticleSystemManager->m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pParticleSystemManager->m_pEmitterPool->isUsed(pEmitter))
+                for (auto pEmitter : pSlot->emitters)
                 {
-                    if (pEmitter->getInstanceId() == m_id)
-                    {
-                        pEmitter->setTransform(transform);
-                        break;
-                    }
+                    pEmitter->setTransform(transform);
                 }
             }
         }
@@ -75,17 +96,12 @@ namespace onut
     {
         if (m_pParticleSystemManager)
         {
-            auto len = m_pParticleSystemManager->m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
+            auto pSlot = m_pParticleSystemManager->getInstanceSlot(*this);
+            if (pSlot)
             {
-                auto pEmitter = m_pParticleSystemManager->m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pParticleSystemManager->m_pEmitterPool->isUsed(pEmitter))
+                for (auto pEmitter : pSlot->emitters)
                 {
-                    if (pEmitter->getInstanceId() == m_id)
-                    {
-                        pEmitter->stop();
-                        break;
-                    }
+                    pEmitter->stop();
                 }
             }
         }
@@ -95,40 +111,19 @@ namespace onut
     bool ParticleSystemManager::EmitterInstance::isPlaying() const
     {
         if (m_bStopped) return false;
-        if (m_pParticleSystemManager)
-        {
-            auto len = m_pParticleSystemManager->m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
-            {
-                auto pEmitter = m_pParticleSystemManager->m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pParticleSystemManager->m_pEmitterPool->isUsed(pEmitter))
-                {
-                    if (pEmitter->getInstanceId() == m_id)
-                    {
-                        if (pEmitter->isAlive()) return true;
-                        break;
-                    }
-                }
-            }
-        }
-        return false;
+        return isAlive();
     }
 
     bool ParticleSystemManager::EmitterInstance::isAlive() const
     {
         if (m_pParticleSystemManager)
         {
-            auto len = m_pParticleSystemManager->m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
+            auto pSlot = m_pParticleSystemManager->getInstanceSlot(*this);
+            if (pSlot)
             {
-                auto pEmitter = m_pParticleSystemManager->m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pParticleSystemManager->m_pEmitterPool->isUsed(pEmitter))
+                for (auto pEmitter : pSlot->emitters)
                 {
-                    if (pEmitter->getInstanceId() == m_id)
-                    {
-                        if (pEmitter->isAlive()) return true;
-                        break;
-                    }
+                    if (pEmitter->isAlive()) return true;
                 }
             }
         }
@@ -139,39 +134,58 @@ namespace onut
     {
         if (m_pParticleSystemManager)
         {
-            bool bManageBatch = !oSpriteBatch->isInBatch();
-            if (bManageBatch) oSpriteBatch->begin();
-            auto len = m_pParticleSystemManager->m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
+            auto pSlot = m_pParticleSystemManager->getInstanceSlot(*this);
+            if (pSlot)
             {
-                auto pEmitter = m_pParticleSystemManager->m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pParticleSystemManager->m_pEmitterPool->isUsed(pEmitter))
+                bool bManageBatch = !oSpriteBatch->isInBatch();
+                if (bManageBatch) oSpriteBatch->begin();
+                for (auto pEmitter : pSlot->emitters)
                 {
-                    if (pEmitter->getInstanceId() == m_id)
-                    {
-                        pEmitter->render();
-                        break;
-                    }
+                    pEmitter->render(m_pParticleSystemManager->m_cameraDir);
                 }
+                if (bManageBatch) oSpriteBatch->end();
             }
-            if (bManageBatch) oSpriteBatch->end();
         }
     }
 
     ParticleSystemManager::EmitterInstance ParticleSystemManager::emit(const OParticleSystemRef& pParticleSystem, const Vector3& pos, const Vector3& dir)
     {
-        static uint32_t nextId = 1;
         EmitterInstance instance;
-        instance.m_id = nextId++;
         instance.m_pParticleSystemManager = this;
 
+        uint32_t index;
+        if (m_freeInstanceSlots.empty())
+        {
+            index = static_cast<uint32_t>(m_instanceSlots.size());
+            m_instanceSlots.resize(m_instanceSlots.size() + 1);
+        }
+        else
+        {
+            index = m_freeInstanceSlots.back();
+            m_freeInstanceSlots.pop_back();
+        }
+        auto& slot = m_instanceSlots[index];
+        instance.m_index = index;
+        instance.m_generation = slot.generation;
+
         Matrix transform = Matrix::CreateBillboard(pos, pos + dir, Vector3::UnitY);
         auto& emitters = pParticleSystem->getEmitters();
         for (auto& emitter : emitters)
         {
-            auto pEmitter = m_pEmitterPool->alloc<ParticleEmitter>(emitter, OThis, transform, instance.m_id);
-            // Update the first frame right away
-            if (pEmitter) pEmitter->update();
+            auto pEmitter = m_pEmitterPool->alloc<ParticleEmitter>(emitter, OThis, transform, index, m_seeds.randu());
+            if (pEmitter)
+            {
+                slot.emitters.push_back(pEmitter);
+
+                // Update the first frame right away
+                updateEmitter(pEmitter, ODT);
+            }
+        }
+
+        // Nothing could be spawned, the instance is already stale
+        if (slot.emitters.empty())
+        {
+            releaseInstanceSlot(index);
         }
 
         return instance;
@@ -179,8 +193,18 @@ namespace onut
 
     void ParticleSystemManager::clear()
     {
+        // Destroy the emitters so they release their particle buffers
+        auto len = m_pEmitterPool->size();
+        for (decltype(len) i = 0; i < len; ++i)
+        {
+            auto pEmitter = m_pEmitterPool->at<ParticleEmitter>(i);
+            if (m_pEmitterPool->isUsed(pEmitter))
+            {
+                destroyEmitter(pEmitter);
+            }
+        }
         m_pEmitterPool->clear();
-        m_pParticlePool->clear();
+        m_particleCount = 0;
     }
 
     void ParticleSystemManager::update()
@@ -204,66 +228,345 @@ namespace onut
 
     void ParticleSystemManager::render()
     {
-        oSpriteBatch->begin();
-        if (m_sortEmitters)
-        {
-        }
-        else
+        m_activeEmitters.clear();
+        auto len = m_pEmitterPool->size();
+        for (decltype(len) i = 0; i < len; ++i)
         {
-            auto len = m_pEmitterPool->size();
-            for (decltype(len) i = 0; i < len; ++i)
+            auto pEmitter = m_pEmitterPool->at<ParticleEmitter>(i);
+            if (m_pEmitterPool->isUsed(pEmitter))
             {
-                auto pEmitter = m_pEmitterPool->at<ParticleEmitter>(i);
-                if (m_pEmitterPool->isUsed(pEmitter))
+                if (pEmitter->getRenderEnabled() && pEmitter->getSkippedTime() <= 0.f)
                 {
-                    if (pEmitter->getRenderEnabled())
-                    {
-                        pEmitter->render();
-                    }
+                    m_activeEmitters.push_back(pEmitter);
                 }
             }
         }
+
+        // Sort and build the sprites in parallel, the SpriteBatch then only copies them
+        auto particleCount = buildEmitterRanges();
+        auto isParallel = particleCount >= MIN_PARALLEL_PARTICLES;
+        parallelFor(static_cast<uint32_t>(m_activeEmitters.size()), [this](uint32_t i)
+        {
+            m_activeEmitters[i]->beginRender(m_cameraDir);
+        }, isParallel);
+        parallelFor(static_cast<uint32_t>(m_emitterRanges.size()), [this](uint32_t i)
+        {
+            const auto& range = m_emitterRanges[i];
+            range.pEmitter->prepareRender(range.begin, range.end);
+        }, isParallel);
+
+        if (m_sortEmitters)
+        {
+            sortEmitters();
+        }
+
+        oSpriteBatch->begin();
+        for (auto pEmitter : m_activeEmitters)
+        {
+            pEmitter->submitRender();
+        }
         oSpriteBatch->end();
     }
 
-    Particle* ParticleSystemManager::allocParticle()
+    bool ParticleSystemManager::allocParticle()
     {
-        return m_pParticlePool->alloc<Particle>();
+        if (m_particleCount >= m_maxParticles) return false;
+        ++m_particleCount;
+        return true;
     }
 
-    void ParticleSystemManager::deallocParticle(Particle* pParticle)
+    void ParticleSystemManager::deallocParticles(uintptr_t count)
     {
-        m_pParticlePool->dealloc(pParticle);
+        assert(count <= m_particleCount);
+        m_particleCount -= count;
     }
 
-    void ParticleSystemManager::renderParticle(Particle* pParticle, const Vector3& camRight, const Vector3& camUp)
+    ParticleSystemManager::InstanceSlot* ParticleSystemManager::getInstanceSlot(const EmitterInstance& instance)
     {
-        float dim = static_cast<float>(std::max<decltype(pParticle->pTexture->getSize().x)>(pParticle->pTexture->getSize().x, pParticle->pTexture->getSize().y));
-        oSpriteBatch->drawSprite(pParticle->pTexture, pParticle->position, pParticle->color.value, pParticle->angle.value, pParticle->size.value / dim);
+        if (instance.m_index >= m_instanceSlots.size()) return nullptr;
+        auto& slot = m_instanceSlots[instance.m_index];
+        if (slot.generation != instance.m_generation) return nullptr;
+        return &slot;
+    }
+
+    void ParticleSystemManager::destroyEmitter(ParticleEmitter* pEmitter)
+    {
+        auto index = pEmitter->getInstanceId();
+        auto& slot = m_instanceSlots[index];
+        auto& emitters = slot.emitters;
+        for (decltype(emitters.size()) i = 0; i < emitters.size(); ++i)
+        {
+            if (emitters[i] == pEmitter)
+            {
+                emitters[i] = emitters.back();
+                emitters.pop_back();
+                break;
+            }
+        }
+        m_pEmitterPool->dealloc(pEmitter);
+
+        // Last emitter of the instance, handles to it are now stale
+        if (emitters.empty())
+        {
+            releaseInstanceSlot(index);
+        }
+    }
+
+    void ParticleSystemManager::releaseInstanceSlot(uint32_t index)
+    {
+        auto& slot = m_instanceSlots[index];
+        if (++slot.generation == 0) slot.generation = 1; // 0 is the invalid generation
+        m_freeInstanceSlots.push_back(index);
     }
 
     void ParticleSystemManager::updateEmitters()
     {
+        auto dt = ODT;
+        m_stats = Stats();
+
+        // Emitters are processed in pool order, off-screen ones are only aged
+        m_activeEmitters.clear();
+        uintptr_t culledParticleCount = 0;
         auto len = m_pEmitterPool->size();
         for (decltype(len) i = 0; i < len; ++i)
         {
             auto pEmitter = m_pEmitterPool->at<ParticleEmitter>(i);
-            if (m_pEmitterPool->isUsed(pEmitter))
+            if (!m_pEmitterPool->isUsed(pEmitter)) continue;
+            if (isCulled(pEmitter))
             {
-                if (pEmitter->isAlive())
+                pEmitter->skip(dt);
+
+                // It would be done before anyone sees it again
+                if (pEmitter->getSkippedTime() >= pEmitter->getRemainingTime())
                 {
-                    pEmitter->update();
-                    if (!pEmitter->isAlive())
-                    {
-                        m_pEmitterPool->dealloc(pEmitter);
-                    }
+                    fastForwardEmitter(pEmitter);
                 }
-                else
+            }
+            else if (pEmitter->getSkippedTime() > 0.f)
+            {
+                // Back in view
+                fastForwardEmitter(pEmitter);
+            }
+
+            if (!pEmitter->isAlive())
+            {
+                destroyEmitter(pEmitter);
+                continue;
+            }
+            ++m_stats.emitterCount;
+            if (pEmitter->getSkippedTime() > 0.f)
+            {
+                ++m_stats.culledEmitterCount;
+                culledParticleCount += pEmitter->getParticleCount();
+                continue;
+            }
+            m_activeEmitters.push_back(pEmitter);
+        }
+        auto emitterCount = static_cast<uint32_t>(m_activeEmitters.size());
+        if (!emitterCount)
+        {
+            m_stats.particleCount = static_cast<uint32_t>(m_particleCount);
+            m_stats.pressure = m_maxParticles ? static_cast<float>(m_particleCount) / static_cast<float>(m_maxParticles) : 1.f;
+            return;
+        }
+
+        // Integrate the particles
+        auto particleCount = buildEmitterRanges();
+        auto isParallel = particleCount >= MIN_PARALLEL_PARTICLES;
+        parallelFor(static_cast<uint32_t>(m_emitterRanges.size()), [this, dt](uint32_t i)
+        {
+            const auto& range = m_emitterRanges[i];
+            range.pEmitter->simulate(dt, range.begin, range.end);
+        }, isParallel);
+
+        // Remove the dead ones and see how many each emitter wants to spawn
+        m_spawnCounts.resize(emitterCount);
+        parallelFor(emitterCount, [this, dt](uint32_t i)
+        {
+            m_spawnCounts[i] = m_activeEmitters[i]->collect(dt);
+        }, isParallel);
+
+        // Share the budget serially, so it doesn't depend on which thread finished first
+        m_particleCount = culledParticleCount;
+        for (auto pEmitter : m_activeEmitters)
+        {
+            m_particleCount += pEmitter->getParticleCount();
+        }
+        shareBudget();
+
+        parallelFor(emitterCount, [this](uint32_t i)
+        {
+            m_activeEmitters[i]->spawn(m_spawnCounts[i]);
+        }, isParallel);
+
+        for (auto pEmitter : m_activeEmitters)
+        {
+            if (!pEmitter->isAlive())
+            {
+                destroyEmitter(pEmitter);
+            }
+        }
+        m_stats.particleCount = static_cast<uint32_t>(m_particleCount);
+    }
+
+    void ParticleSystemManager::shareBudget()
+    {
+        // Compare the population the emitters sustain at their spawn rate to the budget, instead of this frame's
+        // requests. Otherwise the budget fills up in bursts, whoever asks first when particles die wins.
+        auto fixedCount = static_cast<float>(m_particleCount);
+        float sustainedCount = 0.f;
+        float weightedCount = 0.f;
+        m_budgetItems.clear();
+        for (uint32_t i = 0; i < m_activeEmitters.size(); ++i)
+        {
+            auto pEmitter = m_activeEmitters[i];
+            auto emitterSustainedCount = pEmitter->getSustainedCount();
+            if (emitterSustainedCount > 0.f)
+            {
+                fixedCount -= static_cast<float>(pEmitter->getParticleCount());
+                sustainedCount += emitterSustainedCount;
+            }
+            auto priority = getPriority(pEmitter);
+            weightedCount += priority * emitterSustainedCount;
+            m_budgetItems.push_back({priority, i});
+            m_stats.requestedCount += m_spawnCounts[i];
+        }
+        auto budget = static_cast<float>(m_maxParticles) - fixedCount;
+        m_stats.pressure = m_maxParticles ? (fixedCount + sustainedCount) / static_cast<float>(m_maxParticles) : 1.f;
+
+        // Highest priority first, they are granted particles first if the budget is short this frame
+        std::sort(m_budgetItems.begin(), m_budgetItems.end(), [](const BudgetItem& a, const BudgetItem& b)
+        {
+            return a.priority > b.priority || (a.priority == b.priority && a.index < b.index);
+        });
+
+        // Over budget, each emitter's rate is scaled by its priority * k, at most 1. k is such that the budget
+        // is used: emitters important enough to keep their full rate are served first, the rest share what's left.
+        auto isOverBudget = sustainedCount > budget;
+        float k = 0.f;
+        bool isSaturating = true;
+        for (const auto& item : m_budgetItems)
+        {
+            auto pEmitter = m_activeEmitters[item.index];
+            auto requested = m_spawnCounts[item.index];
+            auto scale = 1.f;
+            if (isOverBudget)
+            {
+                auto emitterSustainedCount = pEmitter->getSustainedCount();
+                if (isSaturating)
+                {
+                    k = weightedCount > 0.f ? std::max(0.f, budget) / weightedCount : 0.f;
+                    isSaturating = item.priority * k >= 1.f;
+                }
+                if (isSaturating)
                 {
-                    m_pEmitterPool->dealloc(pEmitter);
+                    budget -= emitterSustainedCount;
+                    weightedCount -= item.priority * emitterSustainedCount;
                 }
+                else if (emitterSustainedCount > 0.f)
+                {
+                    scale = item.priority * k;
+                }
+            }
+            auto granted = grantParticles(pEmitter->throttle(requested, scale));
+            if (scale < 1.f || granted < requested) ++m_stats.throttledEmitterCount;
+            m_stats.grantedCount += granted;
+            m_spawnCounts[item.index] = granted;
+        }
+    }
+
+    bool ParticleSystemManager::isCulled(ParticleEmitter* pEmitter) const
+    {
+        if (m_view.z <= 0.f || m_view.w <= 0.f) return false;
+        if (pEmitter->getAge() < m_warmUpTime) return false;
+
+        auto position = pEmitter->getPosition();
+        auto radius = pEmitter->getCullRadius();
+        return position.x + radius < m_view.x ||
+               position.y + radius < m_view.y ||
+               position.x - radius > m_view.x + m_view.z ||
+               position.y - radius > m_view.y + m_view.w;
+    }
+
+    float ParticleSystemManager::getPriority(ParticleEmitter* pEmitter) const
+    {
+        auto importance = std::max(0.f, pEmitter->getDesc()->importance);
+        if (m_view.z <= 0.f || m_view.w <= 0.f) return importance;
+
+        // Halved at one view diagonal from the view center
+        Vector2 center(m_view.x + m_view.z * .5f, m_view.y + m_view.w * .5f);
+        auto viewSize = Vector2(m_view.z, m_view.w).Length();
+        auto distance = Vector2::Distance(Vector2(pEmitter->getPosition()), center);
+        return importance / (1.f + distance / viewSize);
+    }
+
+    void ParticleSystemManager::fastForwardEmitter(ParticleEmitter* pEmitter)
+    {
+        auto particleCount = pEmitter->getParticleCount();
+        auto available = m_maxParticles - std::min(m_particleCount, m_maxParticles);
+        pEmitter->fastForward(static_cast<uint32_t>(std::min<uintptr_t>(available, 0xFFFFFFFF)));
+        m_particleCount = m_particleCount + pEmitter->getParticleCount() - particleCount;
+    }
+
+    void ParticleSystemManager::updateEmitter(ParticleEmitter* pEmitter, float dt)
+    {
+        auto particleCount = pEmitter->getParticleCount();
+        pEmitter->simulate(dt, 0, particleCount);
+        auto spawnCount = pEmitter->collect(dt);
+        deallocParticles(particleCount - pEmitter->getParticleCount());
+        pEmitter->spawn(grantParticles(spawnCount));
+    }
+
+    uint32_t ParticleSystemManager::grantParticles(uint32_t count)
+    {
+        auto available = m_maxParticles - std::min(m_particleCount, m_maxParticles);
+        auto granted = static_cast<uint32_t>(std::min(static_cast<uintptr_t>(count), available));
+        m_particleCount += granted;
+        return granted;
+    }
+
+    void ParticleSystemManager::sortEmitters()
+    {
+        auto minDepth = std::numeric_limits<float>::max();
+        auto maxDepth = std::numeric_limits<float>::lowest();
+        for (auto pEmitter : m_activeEmitters)
+        {
+            auto depth = pEmitter->getPosition().Dot(m_cameraDir);
+            minDepth = std::min(minDepth, depth);
+            maxDepth = std::max(maxDepth, depth);
+        }
+
+        // Emitters of an instance share a position, the stable sort keeps them in their desc order
+        auto scale = maxDepth > minDepth ? 65535.f / (maxDepth - minDepth) : 0.f;
+        m_emitterSortItems.clear();
+        for (auto pEmitter : m_activeEmitters)
+        {
+            auto depth = pEmitter->getPosition().Dot(m_cameraDir);
+            m_emitterSortItems.push_back({static_cast<uint16_t>((maxDepth - depth) * scale), pEmitter});
+        }
+        radixSort(m_emitterSortItems, m_emitterSortScratch, [](const EmitterSortItem& item) { return item.key; });
+
+        m_activeEmitters.clear();
+        for (const auto& item : m_emitterSortItems)
+        {
+            m_activeEmitters.push_back(item.pEmitter);
+        }
+    }
+
+    uint32_t ParticleSystemManager::buildEmitterRanges()
+    {
+        uint32_t particleCount = 0;
+        m_emitterRanges.clear();
+        for (auto pEmitter : m_activeEmitters)
+        {
+            auto count = pEmitter->getParticleCount();
+            for (uint32_t begin = 0; begin < count; begin += PARTICLES_PER_JOB)
+            {
+                m_emitterRanges.push_back({pEmitter, begin, std::min(begin + PARTICLES_PER_JOB, count)});
             }
+            particleCount += count;
         }
+        return particleCount;
     }
 };
 
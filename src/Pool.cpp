@@ -2,80 +2,217 @@
 #include <onut/Pool.h>
 
 // STL
+#include <algorithm>
 #include <memory.h>
+#include <thread>
+
+namespace
+{
+    // Last magazine used by this thread, per pool. Pools are told apart by an id that is never reused,
+    // so entries of destroyed pools are simply never matched again.
+    struct MagazineCacheEntry
+    {
+        uint64_t poolId = 0;
+        void* pMagazine = nullptr;
+    };
+
+    const uint64_t MAGAZINE_CACHE_SIZE = 8;
+    thread_local MagazineCacheEntry t_magazineCache[MAGAZINE_CACHE_SIZE];
+
+    std::atomic<uint64_t> g_nextPoolId(1);
+}
 
 namespace onut
 {
-    OPoolRef Pool::create(size_t objSize, size_t objCount, FailAction failAction)
+    struct Pool::Magazine
     {
-        return std::make_shared<OPool>(objSize, objCount, failAction);
+        std::thread::id threadId;
+        uint8_t* slots[MAGAZINE_SIZE];
+        size_t count = 0;
+    };
+
+    OPoolRef Pool::create(size_t objSize, size_t objCount, FailAction failAction, bool isThreadSafe, size_t alignment)
+    {
+        return std::make_shared<OPool>(objSize, objCount, failAction, isThreadSafe, alignment);
     }
 
-    Pool::Pool(size_t objSize, size_t objCount, FailAction failAction)
-        : m_objCount(objCount)
+    Pool::Pool(size_t objSize, size_t objCount, FailAction failAction, bool isThreadSafe, size_t alignment)
+        : m_id(g_nextPoolId++)
+        , m_objCount(std::max<size_t>(1, objCount))
         , m_objSize(objSize)
+        , m_alignment(std::max(alignment, alignof(uint8_t*)))
         , m_failAction(failAction)
+        , m_isThreadSafe(isThreadSafe)
+        , m_allocCount(0)
+        , m_capacity(0)
+        , m_chunkCount(0)
     {
-        static const size_t alignment = sizeof(uintptr_t);
-        static const size_t headerSize = 1;
+        assert((m_alignment & (m_alignment - 1)) == 0); // Alignment must be a power of 2
 
-        m_objTotalSize = ((m_objSize + headerSize) % alignment) ? (m_objSize + headerSize) + (alignment - ((m_objSize + headerSize) % alignment)) : (m_objSize + headerSize);
-        m_memorySize = m_objTotalSize * m_objCount + alignment;
+        // A free slot stores the next one where the object goes
+        m_usedOffset = std::max(m_objSize, sizeof(uint8_t*));
+        m_objTotalSize = (m_usedOffset + 1 + m_alignment - 1) & ~(m_alignment - 1);
 
-        // Allocate memory
-        m_pMemory = new uint8_t[m_memorySize];
-        memset(m_pMemory, 0, m_memorySize);
+        addChunk();
+    }
 
-        // Align
-        auto mod = reinterpret_cast<uintptr_t>(m_pMemory) % alignment;
-        if (mod)
+    Pool::~Pool()
+    {
+        for (auto pMemory : m_chunkMemories)
         {
-            m_pFirstObj = m_pMemory + (alignment - mod);
+            delete[] pMemory;
         }
-        else
+    }
+
+    void Pool::addChunk()
+    {
+        auto chunk = m_chunkCount.load(std::memory_order_relaxed);
+        auto objCount = m_objCount << chunk;
+        auto pMemory = new uint8_t[objCount * m_objTotalSize + m_alignment];
+        memset(pMemory, 0, objCount * m_objTotalSize + m_alignment);
+
+        // Align
+        auto mod = reinterpret_cast<uintptr_t>(pMemory) % m_alignment;
+        auto pFirstObj = mod ? pMemory + (m_alignment - mod) : pMemory;
+
+        // Chain the new slots in front of the free list, in order
+        for (size_t i = objCount; i > 0; --i)
         {
-            m_pFirstObj = m_pMemory;
+            auto pSlot = pFirstObj + (i - 1) * m_objTotalSize;
+            getNext(pSlot) = m_pFreeList;
+            m_pFreeList = pSlot;
         }
 
-        m_currentObjIndex = 0;
+        m_chunkMemories[chunk] = pMemory;
+        m_chunks[chunk] = pFirstObj;
+        m_chunkCount.store(chunk + 1, std::memory_order_release);
+        m_capacity.store(m_capacity.load(std::memory_order_relaxed) + objCount, std::memory_order_release);
     }
 
-    Pool::~Pool()
+    bool Pool::grow()
     {
-        delete[] m_pMemory;
+        switch (m_failAction)
+        {
+            case FailAction::Grow:
+                if (m_chunkCount.load(std::memory_order_relaxed) == MAX_CHUNKS) return false;
+                addChunk();
+                return true;
+            case FailAction::ReturnNull:
+                return false;
+            case FailAction::Assert:
+                assert(false); // No more memory available in the pool. Use bigger pool
+                return false;
+        }
+        return false;
     }
 
-    void Pool::clear()
+    bool Pool::owns(const void* pObject) const
     {
-        memset(m_pMemory, 0, m_memorySize);
-        m_currentObjIndex = 0;
-        m_allocCount = 0;
+        auto ptr = static_cast<const uint8_t*>(pObject);
+        auto chunkCount = m_chunkCount.load(std::memory_order_acquire);
+        auto objCount = m_objCount;
+        for (int i = 0; i < chunkCount; ++i, objCount *= 2)
+        {
+            auto pChunk = m_chunks[i];
+            if (ptr >= pChunk && ptr < pChunk + objCount * m_objTotalSize)
+            {
+                return (ptr - pChunk) % m_objTotalSize == 0;
+            }
+        }
+        return false;
     }
 
-    size_t Pool::getAllocCount() const
+    void Pool::clear()
     {
-        return m_allocCount; 
+        // Grown chunks are kept
+        m_pFreeList = nullptr;
+        auto chunkCount = m_chunkCount.load(std::memory_order_relaxed);
+        for (int chunk = chunkCount - 1; chunk >= 0; --chunk)
+        {
+            auto objCount = m_objCount << chunk;
+            for (size_t i = objCount; i > 0; --i)
+            {
+                auto pSlot = m_chunks[chunk] + (i - 1) * m_objTotalSize;
+                pSlot[m_usedOffset] = 0;
+                getNext(pSlot) = m_pFreeList;
+                m_pFreeList = pSlot;
+            }
+        }
+        for (auto& pMagazine : m_magazines)
+        {
+            pMagazine->count = 0;
+        }
+        m_allocCount.store(0, std::memory_order_relaxed);
     }
 
-    void* Pool::getRawPointer() const 
+    Pool::Magazine* Pool::getMagazine()
     {
-        return m_pFirstObj;
-    }
+        auto& entry = t_magazineCache[m_id % MAGAZINE_CACHE_SIZE];
+        if (entry.poolId == m_id) return static_cast<Magazine*>(entry.pMagazine);
 
-    size_t Pool::size() const
-    {
-        return m_objCount;
+        // Find the magazine of this thread, it might have been evicted from the cache by another pool
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto threadId = std::this_thread::get_id();
+        Magazine* pMagazine = nullptr;
+        for (auto& pOther : m_magazines)
+        {
+            if (pOther->threadId == threadId)
+            {
+                pMagazine = pOther.get();
+                break;
+            }
+        }
+        if (!pMagazine)
+        {
+            m_magazines.emplace_back(new Magazine());
+            pMagazine = m_magazines.back().get();
+            pMagazine->threadId = threadId;
+        }
+        entry.poolId = m_id;
+        entry.pMagazine = pMagazine;
+        return pMagazine;
     }
 
-    bool Pool::isUsed(void* pObject) const
+    uint8_t* Pool::allocSlotThreadSafe()
     {
-        auto ptr = static_cast<uint8_t*>(pObject);
-        auto used = ptr + m_objSize;
-        return (*used) ? true : false;
+        auto pMagazine = getMagazine();
+        if (!pMagazine->count)
+        {
+            // Refill half of it, so the next dealloc doesn't have to flush right away
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (pMagazine->count < MAGAZINE_SIZE / 2)
+            {
+                if (!m_pFreeList && !grow()) break;
+                auto pSlot = m_pFreeList;
+                m_pFreeList = getNext(pSlot);
+                pMagazine->slots[pMagazine->count++] = pSlot;
+            }
+            if (!pMagazine->count) return nullptr;
+        }
+
+        auto pSlot = pMagazine->slots[--pMagazine->count];
+        pSlot[m_usedOffset] = 1;
+        m_allocCount.fetch_add(1, std::memory_order_relaxed);
+        return pSlot;
     }
 
-    void* Pool::operator[](size_t index) const
+    void Pool::deallocSlotThreadSafe(uint8_t* pSlot)
     {
-        return m_pFirstObj + index * m_objTotalSize;
+        pSlot[m_usedOffset] = 0;
+        m_allocCount.fetch_sub(1, std::memory_order_relaxed);
+
+        auto pMagazine = getMagazine();
+        if (pMagazine->count == MAGAZINE_SIZE)
+        {
+            // Give half back to the pool
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (pMagazine->count > MAGAZINE_SIZE / 2)
+            {
+                auto pFreeSlot = pMagazine->slots[--pMagazine->count];
+                getNext(pFreeSlot) = m_pFreeList;
+                m_pFreeList = pFreeSlot;
+            }
+        }
+        pMagazine->slots[pMagazine->count++] = pSlot;
     }
 }
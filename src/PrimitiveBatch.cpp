@@ -11,19 +11,22 @@ OPrimitiveBatchRef oPrimitiveBatch;
 
 namespace onut
 {
-    OPrimitiveBatchRef PrimitiveBatch::create()
+    OPrimitiveBatchRef PrimitiveBatch::create(VertexFormat vertexFormat)
     {
-        return OMake<PrimitiveBatch>();
+        return OMake<PrimitiveBatch>(vertexFormat);
     }
 
-    PrimitiveBatch::PrimitiveBatch()
+    PrimitiveBatch::PrimitiveBatch(VertexFormat vertexFormat)
+        : m_vertexFormat(vertexFormat)
     {
+        m_vertexSize = (m_vertexFormat == VertexFormat::Packed) ? sizeof(PackedVertex2D) : sizeof(SVertexP2T2C4);
+
         // Create a white texture for rendering "without" texture
         unsigned char white[4] = {255, 255, 255, 255};
         m_pTexWhite = OTexture::createFromData(white, {1, 1}, false);
 
         // Vertex buffer.
-        m_pVertexBuffer = OVertexBuffer::createDynamic(sizeof(SVertexP2T2C4) * MAX_VERTEX_COUNT);
+        m_pVertexBuffer = OVertexBuffer::createDynamic(m_vertexSize * MAX_VERTEX_COUNT);
     }
 
     PrimitiveBatch::~PrimitiveBatch()
@@ -37,19 +40,45 @@ namespace onut
         if (!pTexture) m_pTexture = m_pTexWhite;
         else m_pTexture = pTexture;
 
+        // Packed textures are drawn from their atlas page
+        m_isAtlased = m_pTexture->isAtlased();
+        m_atlasUVs = m_pTexture->getAtlasUVs();
+        if (m_isAtlased) m_pTexture = m_pTexture->getAtlasPage();
+
         m_primitiveType = primitiveType;
-		oRenderer->setupFor2D(transform);
+		oRenderer->setupFor2D(transform, m_vertexFormat);
         m_isDrawing = true;
 
-        m_pMappedVertexBuffer = reinterpret_cast<SVertexP2T2C4*>(m_pVertexBuffer->map());
+        map();
+    }
+
+    void PrimitiveBatch::map()
+    {
+        auto pMapped = m_pVertexBuffer->map();
+        m_pMappedVertexBuffer = reinterpret_cast<SVertexP2T2C4*>(pMapped);
+        m_pMappedPackedVertexBuffer = reinterpret_cast<PackedVertex2D*>(pMapped);
     }
 
     void PrimitiveBatch::draw(const Vector2& position, const Color& color, const Vector2& texCoord)
     {
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + m_vertexCount;
-        pVerts->position = position;
-        pVerts->texCoord = texCoord;
-        pVerts->color = color;
+        auto finalTexCoord = texCoord;
+        if (m_isAtlased)
+        {
+            finalTexCoord.x = m_atlasUVs.x + texCoord.x * (m_atlasUVs.z - m_atlasUVs.x);
+            finalTexCoord.y = m_atlasUVs.y + texCoord.y * (m_atlasUVs.w - m_atlasUVs.y);
+        }
+
+        if (m_vertexFormat == VertexFormat::Packed)
+        {
+            m_pMappedPackedVertexBuffer[m_vertexCount].set(position, finalTexCoord, color);
+        }
+        else
+        {
+            SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + m_vertexCount;
+            pVerts->position = position;
+            pVerts->texCoord = finalTexCoord;
+            pVerts->color = color;
+        }
 
         ++m_vertexCount;
 
@@ -57,12 +86,19 @@ namespace onut
         {
             if (m_primitiveType == OPrimitiveLineStrip)
             {
-                auto lastVert = *pVerts;
-
-                flush();
-
-                auto pFirstVert = m_pMappedVertexBuffer;
-                *pFirstVert = lastVert;
+                // Continue the strip from the last vertex
+                if (m_vertexFormat == VertexFormat::Packed)
+                {
+                    auto lastVert = m_pMappedPackedVertexBuffer[m_vertexCount - 1];
+                    flush();
+                    m_pMappedPackedVertexBuffer[0] = lastVert;
+                }
+                else
+                {
+                    auto lastVert = m_pMappedVertexBuffer[m_vertexCount - 1];
+                    flush();
+                    m_pMappedVertexBuffer[0] = lastVert;
+                }
                 ++m_vertexCount;
             }
             else
@@ -81,7 +117,7 @@ namespace onut
         {
             flush();
         }
-        m_pVertexBuffer->unmap(sizeof(SVertexP2T2C4) * m_vertexCount);
+        m_pVertexBuffer->unmap(m_vertexSize * m_vertexCount);
     }
 
     void PrimitiveBatch::flush()
@@ -91,14 +127,14 @@ namespace onut
             return; // Nothing to flush
         }
 
-        m_pVertexBuffer->unmap(sizeof(SVertexP2T2C4) * m_vertexCount);
+        m_pVertexBuffer->unmap(m_vertexSize * m_vertexCount);
 
         oRenderer->renderStates.textures[0] = m_pTexture;
         oRenderer->renderStates.primitiveMode = m_primitiveType;
         oRenderer->renderStates.vertexBuffer = m_pVertexBuffer;
         oRenderer->draw(m_vertexCount);
 
-        m_pMappedVertexBuffer = reinterpret_cast<SVertexP2T2C4*>(m_pVertexBuffer->map());
+        map();
 
         m_vertexCount = 0;
     }
@@ -0,0 +1,71 @@
+#ifndef RADIXSORT_H_INCLUDED
+#define RADIXSORT_H_INCLUDED
+
+// STL
+#include <cinttypes>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace onut
+{
+    /**
+    Stable LSD radix sort, 8 bits per pass, on the unsigned integer key returned by keyFn.
+    Passes where every item shares the same byte are skipped, so small keys are cheap.
+    scratch is resized as needed and can be kept between calls to avoid allocations.
+    */
+    template<typename Titem, typename TkeyFn>
+    void radixSort(std::vector<Titem>& items, std::vector<Titem>& scratch, TkeyFn keyFn)
+    {
+        using Key = decltype(keyFn(items[0]));
+        static const size_t PASS_COUNT = sizeof(Key);
+
+        auto count = items.size();
+        if (count < 2) return;
+        scratch.resize(count);
+
+        // Histograms for all passes in one go
+        size_t histograms[PASS_COUNT][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (const auto& item : items)
+        {
+            auto key = keyFn(item);
+            for (size_t pass = 0; pass < PASS_COUNT; ++pass)
+            {
+                ++histograms[pass][(key >> (pass * 8)) & 0xFF];
+            }
+        }
+
+        auto pSrc = items.data();
+        auto pDst = scratch.data();
+        for (size_t pass = 0; pass < PASS_COUNT; ++pass)
+        {
+            auto& histogram = histograms[pass];
+
+            // All keys fall in the same bucket, nothing to do for this byte
+            if (histogram[(keyFn(*pSrc) >> (pass * 8)) & 0xFF] == count) continue;
+
+            size_t offsets[256];
+            size_t offset = 0;
+            for (int i = 0; i < 256; ++i)
+            {
+                offsets[i] = offset;
+                offset += histogram[i];
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                auto& item = pSrc[i];
+                pDst[offsets[(keyFn(item) >> (pass * 8)) & 0xFF]++] = item;
+            }
+            std::swap(pSrc, pDst);
+        }
+
+        // Result ended up in the scratch buffer. Capacities are kept by swapping.
+        if (pSrc != items.data())
+        {
+            items.swap(scratch);
+        }
+    }
+};
+
+#endif
@@ -132,38 +132,38 @@ namespace onut
         return randc(randv(palette), variation);
     }
 
-    int randt(const int& min, const int& max)
+    template<> int randt<int>(const int& min, const int& max)
     {
         return randi(min, max);
     }
 
-    int randt(const int& max)
+    template<> int randt<int>(const int& max)
     {
         return randi(max);
     }
 
-    unsigned int randt(const unsigned int& min, const unsigned int& max)
+    template<> unsigned int randt<unsigned int>(const unsigned int& min, const unsigned int& max)
     {
         auto range = max - min + 1;
         return rand() % range + min;
     }
 
-    unsigned int randt(const unsigned int& max)
+    template<> unsigned int randt<unsigned int>(const unsigned int& max)
     {
         return rand() % (max + 1);
     }
 
-    float randt(const float& min, const float& max)
+    template<> float randt<float>(const float& min, const float& max)
     {
         return randf(min, max);
     }
 
-    float randt(const float& max)
+    template<> float randt<float>(const float& max)
     {
         return randf(max);
     }
 
-    double randt(const double& min, const double& max)
+    template<> double randt<double>(const double& min, const double& max)
     {
         auto rnd = rand();
         auto rndf = static_cast<double>(rnd) / static_cast<double>(RAND_MAX - 1);
@@ -171,7 +171,7 @@ namespace onut
         return rndf + min;
     }
 
-    double randt(const double& max)
+    template<> double randt<double>(const double& max)
     {
         auto rnd = rand();
         auto rndf = static_cast<double>(rnd) / static_cast<double>(RAND_MAX - 1);
@@ -179,43 +179,105 @@ namespace onut
         return rndf;
     }
 
-    Vector2 randt(const Vector2& min, const Vector2& max)
+    template<> Vector2 randt<Vector2>(const Vector2& min, const Vector2& max)
     {
         return rand2f(min, max);
     }
 
-    Vector2 randt(const Vector2& max)
+    template<> Vector2 randt<Vector2>(const Vector2& max)
     {
         return rand2f(max);
     }
 
-    Vector3 randt(const Vector3& min, const Vector3& max)
+    template<> Vector3 randt<Vector3>(const Vector3& min, const Vector3& max)
     {
         return rand3f(min, max);
     }
 
-    Vector3 randt(const Vector3& max)
+    template<> Vector3 randt<Vector3>(const Vector3& max)
     {
         return rand3f(max);
     }
 
-    Vector4 randt(const Vector4& min, const Vector4& max)
+    template<> Vector4 randt<Vector4>(const Vector4& min, const Vector4& max)
     {
         return rand4f(min, max);
     }
 
-    Vector4 randt(const Vector4& max)
+    template<> Vector4 randt<Vector4>(const Vector4& max)
     {
         return rand4f(max);
     }
 
-    Color randt(const Color& min, const Color& max)
+    template<> Color randt<Color>(const Color& min, const Color& max)
     {
         return randc(min, max);
     }
 
-    Color randt(const Color& max)
+    template<> Color randt<Color>(const Color& max)
     {
         return randc(max);
     }
+
+    void RandomStream::setSeed(uint32_t seed)
+    {
+        m_state = 0;
+        randu();
+        m_state += static_cast<uint64_t>(seed);
+        randu();
+    }
+
+    uint32_t RandomStream::randu()
+    {
+        // PCG32
+        auto oldState = m_state;
+        m_state = oldState * 6364136223846793005ULL + 1442695040888963407ULL;
+        auto xorShifted = static_cast<uint32_t>(((oldState >> 18u) ^ oldState) >> 27u);
+        auto rot = static_cast<uint32_t>(oldState >> 59u);
+        return (xorShifted >> rot) | (xorShifted << ((0u - rot) & 31u));
+    }
+
+    float RandomStream::randf(float min, float max)
+    {
+        // 24 bits, so every value is exact in a float. Both ends are included.
+        auto rndf = static_cast<float>(randu() >> 8) / static_cast<float>(0xffffff);
+        return min + (max - min) * rndf;
+    }
+
+    template<> int RandomStream::randt<int>(const int& min, const int& max)
+    {
+        auto range = static_cast<uint32_t>(max - min) + 1;
+        return range ? min + static_cast<int>(randu() % range) : static_cast<int>(randu());
+    }
+
+    template<> unsigned int RandomStream::randt<unsigned int>(const unsigned int& min, const unsigned int& max)
+    {
+        auto range = max - min + 1;
+        return range ? min + randu() % range : randu();
+    }
+
+    template<> float RandomStream::randt<float>(const float& min, const float& max)
+    {
+        return randf(min, max);
+    }
+
+    template<> Vector2 RandomStream::randt<Vector2>(const Vector2& min, const Vector2& max)
+    {
+        return{randf(min.x, max.x), randf(min.y, max.y)};
+    }
+
+    template<> Vector3 RandomStream::randt<Vector3>(const Vector3& min, const Vector3& max)
+    {
+        return{randf(min.x, max.x), randf(min.y, max.y), randf(min.z, max.z)};
+    }
+
+    template<> Vector4 RandomStream::randt<Vector4>(const Vector4& min, const Vector4& max)
+    {
+        return{randf(min.x, max.x), randf(min.y, max.y), randf(min.z, max.z), randf(min.w, max.w)};
+    }
+
+    template<> Color RandomStream::randt<Color>(const Color& min, const Color& max)
+    {
+        return{randf(min.r, max.r), randf(min.g, max.g), randf(min.b, max.b), randf(min.a, max.a)};
+    }
 }
@@ -0,0 +1,142 @@
+// Onut
+#include <onut/Renderer.h>
+#include <onut/RenderStats.h>
+
+// STL
+#include <algorithm>
+#include <fstream>
+
+namespace onut
+{
+    static const RenderStats::Frame EMPTY_FRAME;
+
+    static const char* FLUSH_REASON_NAMES[static_cast<int>(RenderStats::FlushReason::COUNT)] = {
+        "BufferFull",
+        "TextureChange",
+        "BlendChange",
+        "FilteringChange",
+        "Explicit"
+    };
+
+    uint32_t RenderStats::Frame::getFlushCount() const
+    {
+        uint32_t count = 0;
+        for (auto flushCount : flushes)
+        {
+            count += flushCount;
+        }
+        return count;
+    }
+
+    RenderStats::RenderStats(int historySize)
+    {
+        setHistorySize(historySize);
+    }
+
+    void RenderStats::onApplyRenderStates(const RenderStates& renderStates)
+    {
+        if (renderStates.renderTarget.isDirty()) ++m_currentFrame.renderTargetChanges;
+        for (int i = 0; i < RenderStates::MAX_TEXTURES; ++i)
+        {
+            if (renderStates.textures[i].isDirty()) ++m_currentFrame.textureChanges;
+        }
+        if (renderStates.sampleFiltering.isDirty() ||
+            renderStates.sampleAddressMode.isDirty()) ++m_currentFrame.samplerChanges;
+        if (renderStates.blendMode.isDirty()) ++m_currentFrame.blendChanges;
+        if (renderStates.scissorEnabled.isDirty() ||
+            renderStates.scissor.isDirty()) ++m_currentFrame.scissorChanges;
+        if (renderStates.vertexShader.isDirty()) ++m_currentFrame.shaderChanges;
+        if (renderStates.pixelShader.isDirty()) ++m_currentFrame.shaderChanges;
+    }
+
+    void RenderStats::onDraw(uint32_t vertexCount)
+    {
+        ++m_currentFrame.drawCalls;
+        m_currentFrame.vertexCount += vertexCount;
+    }
+
+    void RenderStats::onDrawIndexed(uint32_t indexCount)
+    {
+        ++m_currentFrame.drawCalls;
+        m_currentFrame.indexCount += indexCount;
+    }
+
+    void RenderStats::onFlush(FlushReason reason)
+    {
+        ++m_currentFrame.flushes[static_cast<int>(reason)];
+    }
+
+    void RenderStats::endFrame()
+    {
+        m_history[m_historyHead] = m_currentFrame;
+        m_historyHead = (m_historyHead + 1) % m_history.size();
+        ++m_totalFrameCount;
+        m_currentFrame = Frame();
+    }
+
+    const RenderStats::Frame& RenderStats::getFrame(int framesAgo) const
+    {
+        if (framesAgo < 0 || framesAgo >= getFrameCount()) return EMPTY_FRAME;
+        auto index = (m_historyHead + m_history.size() - 1 - static_cast<size_t>(framesAgo)) % m_history.size();
+        return m_history[index];
+    }
+
+    int RenderStats::getFrameCount() const
+    {
+        return static_cast<int>(std::min(m_totalFrameCount, static_cast<uint64_t>(m_history.size())));
+    }
+
+    void RenderStats::setHistorySize(int historySize)
+    {
+        m_history.resize(static_cast<size_t>(std::max(1, historySize)));
+        reset();
+    }
+
+    void RenderStats::reset()
+    {
+        std::fill(m_history.begin(), m_history.end(), Frame());
+        m_historyHead = 0;
+        m_totalFrameCount = 0;
+        m_currentFrame = Frame();
+    }
+
+    bool RenderStats::saveCSV(const std::string& filename) const
+    {
+        std::ofstream file(filename);
+        if (!file.is_open()) return false;
+
+        file << "frame,drawCalls,indexCount,vertexCount,renderTargetChanges,textureChanges,samplerChanges,blendChanges,scissorChanges,shaderChanges";
+        for (auto reasonName : FLUSH_REASON_NAMES)
+        {
+            file << ",flush" << reasonName;
+        }
+        file << "\n";
+
+        auto frameCount = getFrameCount();
+        for (int framesAgo = frameCount - 1; framesAgo >= 0; --framesAgo)
+        {
+            const auto& frame = getFrame(framesAgo);
+            file << (m_totalFrameCount - 1 - static_cast<uint64_t>(framesAgo)) << ","
+                << frame.drawCalls << ","
+                << frame.indexCount << ","
+                << frame.vertexCount << ","
+                << frame.renderTargetChanges << ","
+                << frame.textureChanges << ","
+                << frame.samplerChanges << ","
+                << frame.blendChanges << ","
+                << frame.scissorChanges << ","
+                << frame.shaderChanges;
+            for (auto flushCount : frame.flushes)
+            {
+                file << "," << flushCount;
+            }
+            file << "\n";
+        }
+        return true;
+    }
+
+    const char* RenderStats::getFlushReasonName(FlushReason reason)
+    {
+        return FLUSH_REASON_NAMES[static_cast<int>(reason)];
+    }
+}
@@ -46,6 +46,7 @@ namespace onut
         primitiveMode = OPrimitiveTriangleList;
         vertexShader = nullptr;
         pixelShader = nullptr;
+        vertexFormat = VertexFormat::Float;
         vertexBuffer = nullptr;
         indexBuffer = nullptr;
         renderTarget = nullptr;
@@ -73,6 +74,7 @@ namespace onut
         primitiveMode = other.primitiveMode;
         vertexShader = other.vertexShader;
         pixelShader = other.pixelShader;
+        vertexFormat = other.vertexFormat;
         vertexBuffer = other.vertexBuffer;
         indexBuffer = other.indexBuffer;
         clearColor = other.clearColor;
@@ -99,6 +101,7 @@ namespace onut
         primitiveMode = other.primitiveMode;
         vertexShader = other.vertexShader;
         pixelShader = other.pixelShader;
+        vertexFormat = other.vertexFormat;
         vertexBuffer = other.vertexBuffer;
         indexBuffer = other.indexBuffer;
         clearColor = other.clearColor;
@@ -127,6 +130,7 @@ namespace onut
         primitiveMode.reset();
         vertexShader.reset();
         pixelShader.reset();
+        vertexFormat.reset();
         vertexBuffer.reset();
         indexBuffer.reset();
         renderTarget.reset();
@@ -157,16 +161,27 @@ namespace onut
 #endif
     }
 
+    bool Renderer::savePNG(const std::string& filename)
+    {
+        return false;
+    }
+
+    bool Renderer::supports32BitIndices() const
+    {
+        return true;
+    }
+
     void Renderer::setupFor2D()
     {
         setupFor2D(Matrix::Identity);
     }
 
-    void Renderer::setupFor2D(const Matrix& transform)
+    void Renderer::setupFor2D(const Matrix& transform, VertexFormat vertexFormat)
     {
         set2DCamera(Vector2::Zero);
         renderStates.world = transform;
-        renderStates.vertexShader = m_p2DVertexShader;
+        renderStates.vertexFormat = vertexFormat;
+        renderStates.vertexShader = (vertexFormat == VertexFormat::Packed) ? m_p2DPackedVertexShader : m_p2DVertexShader;
         renderStates.pixelShader = m_p2DPixelShader;
     }
 
@@ -217,6 +232,12 @@ namespace onut
         // Create 2D shaders
         {
             m_p2DVertexShader = OShader::createFromBinaryData(_2dvs_cso, sizeof(_2dvs_cso), OVertexShader, {{2, "POSITION"}, {2, "TEXCOORD"}, {4, "COLOR"}});
+
+            // Same shader, the packed inputs are expanded to floats by the input layout
+            m_p2DPackedVertexShader = OShader::createFromBinaryData(_2dvs_cso, sizeof(_2dvs_cso), OVertexShader, {
+                {2, "POSITION"},
+                {2, "TEXCOORD", Shader::VertexElement::Format::SNorm16},
+                {4, "COLOR", Shader::VertexElement::Format::UNorm8}});
             m_p2DPixelShader = OShader::createFromBinaryData(_2dps_cso, sizeof(_2dps_cso), OPixelShader);
         }
 
@@ -472,6 +472,8 @@ namespace onut
         {
             m_pSwapChain->Present(1, 0);
         }
+
+        m_stats.endFrame();
     }
 
     ID3D11Device* RendererD3D11::getDevice() const
@@ -584,18 +586,22 @@ namespace onut
 
     void RendererD3D11::draw(uint32_t vertexCount)
     {
+        m_stats.onDraw(vertexCount);
         applyRenderStates();
         m_pDeviceContext->Draw(static_cast<UINT>(vertexCount), 0);
     }
 
-    void RendererD3D11::drawIndexed(uint32_t indexCount)
+    void RendererD3D11::drawIndexed(uint32_t indexCount, uint32_t baseVertex)
     {
+        m_stats.onDrawIndexed(indexCount);
         applyRenderStates();
-        m_pDeviceContext->DrawIndexed(static_cast<UINT>(indexCount), 0, 0);
+        m_pDeviceContext->DrawIndexed(static_cast<UINT>(indexCount), 0, static_cast<INT>(baseVertex));
     }
 
     void RendererD3D11::applyRenderStates()
     {
+        m_stats.onApplyRenderStates(renderStates);
+
         // Render target
         if (renderStates.renderTarget.isDirty())
         {
@@ -626,10 +632,16 @@ namespace onut
             if (pTextureState.isDirty())
             {
                 ID3D11ShaderResourceView* pResourceView = nullptr;
-                m_boundTextures[i] = pTextureState.get();
-                if (pTextureState.get() != nullptr)
+                auto pTexture = pTextureState.get();
+                if (pTexture && pTexture->isAtlased())
+                {
+                    // Packed textures are sampled from their atlas page
+                    pTexture = pTexture->getAtlasPage();
+                }
+                m_boundTextures[i] = pTexture;
+                if (pTexture != nullptr)
                 {
-                    auto pRenderTargetD3D11 = ODynamicCast<OTextureD3D11>(pTextureState.get());
+                    auto pRenderTargetD3D11 = ODynamicCast<OTextureD3D11>(pTexture);
                     pResourceView = pRenderTargetD3D11->getD3DResourceView();
                 }
                 m_pDeviceContext->PSSetShaderResources(static_cast<UINT>(i), 1, &pResourceView);
@@ -795,6 +807,7 @@ namespace onut
                 m_pDeviceContext->VSSetShader(pShaderD3D11->getVertexShader(), nullptr, 0);
                 m_pDeviceContext->IASetInputLayout(pShaderD3D11->getInputLayout());
                 renderStates.vertexShader.resetDirty();
+                renderStates.vertexBuffer.forceDirty(); // The stride comes from the shader
 
                 auto& uniforms = pShaderD3D11->getUniforms();
                 for (UINT i = 0; i < (UINT)uniforms.size(); ++i)
@@ -867,7 +880,8 @@ namespace onut
             {
                 auto pIndexBufferD3D11 = ODynamicCast<OIndexBufferD3D11>(renderStates.indexBuffer.get());
                 auto pD3DBuffer = pIndexBufferD3D11->getBuffer();
-                m_pDeviceContext->IASetIndexBuffer(pD3DBuffer, DXGI_FORMAT_R16_UINT, 0);
+                auto format = (pIndexBufferD3D11->getElementSize() == 32) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+                m_pDeviceContext->IASetIndexBuffer(pD3DBuffer, format, 0);
             }
             renderStates.indexBuffer.resetDirty();
         }
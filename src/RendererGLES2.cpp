@@ -1,4 +1,4 @@
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/IndexBuffer.h>
 #include <onut/Renderer.h>
@@ -19,6 +19,7 @@
 
 // STL
 #include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -37,6 +38,10 @@ namespace onut
     void RendererGLES2::init(const OWindowRef& pWindow)
     {
         createDevice(pWindow);
+
+        auto pExtensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        m_has32BitIndices = pExtensions && strstr(pExtensions, "GL_OES_element_index_uint");
+
         createRenderTarget();
         createRenderStates();
         createUniforms();
@@ -44,6 +49,11 @@ namespace onut
         Renderer::init(pWindow);
     }
 
+    bool RendererGLES2::supports32BitIndices() const
+    {
+        return m_has32BitIndices;
+    }
+
     RendererGLES2::~RendererGLES2()
     { 
         DISPMANX_UPDATE_HANDLE_T dispman_update;
@@ -188,6 +198,8 @@ namespace onut
     {
         // Swap the buffer!
         eglSwapBuffers(m_display, m_surface);
+
+        m_stats.endFrame();
     }
 
     EGLDisplay RendererGLES2::getDisplay() const
@@ -245,6 +257,12 @@ namespace onut
 
     void RendererGLES2::draw(uint32_t vertexCount)
     {
+        m_stats.onDraw(vertexCount);
+        if (m_baseVertex)
+        {
+            m_baseVertex = 0;
+            renderStates.vertexBuffer.forceDirty();
+        }
         applyRenderStates();
         
         GLenum mode = GL_POINTS;
@@ -272,8 +290,14 @@ namespace onut
         glDrawArrays(mode, 0, vertexCount);
     }
 
-    void RendererGLES2::drawIndexed(uint32_t indexCount)
+    void RendererGLES2::drawIndexed(uint32_t indexCount, uint32_t baseVertex)
     {
+        m_stats.onDrawIndexed(indexCount);
+        if (m_baseVertex != baseVertex)
+        {
+            m_baseVertex = baseVertex;
+            renderStates.vertexBuffer.forceDirty();
+        }
         applyRenderStates();
         
         GLenum mode = GL_POINTS;
@@ -298,11 +322,20 @@ namespace onut
                 break;
         }
 
-        glDrawElements(mode, indexCount, GL_UNSIGNED_SHORT, NULL);
+        auto& pIndexBuffer = renderStates.indexBuffer.get();
+        auto indexType = (pIndexBuffer && pIndexBuffer->getElementSize() == 32) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        if (indexType == GL_UNSIGNED_INT && !m_has32BitIndices)
+        {
+            assert(false); // The device can't draw them, see supports32BitIndices()
+            return;
+        }
+        glDrawElements(mode, indexCount, indexType, NULL);
     }
 
     void RendererGLES2::applyRenderStates()
     {
+        m_stats.onApplyRenderStates(renderStates);
+
         // Clear color
         if (renderStates.clearColor.isDirty())
         {
@@ -346,6 +379,8 @@ namespace onut
                 auto pTexture = pTextureState.get().get();
                 if (pTexture != nullptr)
                 {
+                    // Packed textures are sampled from their atlas page
+                    if (pTexture->isAtlased()) pTexture = pTexture->getAtlasPage().get();
                     auto pTextureEGLS2 = static_cast<TextureGLES2*>(pTexture);
                     glActiveTexture(GL_TEXTURE0 + i);
                     glBindTexture(GL_TEXTURE_2D, pTextureEGLS2->getHandle());
@@ -587,6 +622,20 @@ namespace onut
             }
         }
 */
+        // Vertex format. Packed texture coordinates are shorts, scaled back to 0-1 by the texture matrix.
+        if (renderStates.vertexFormat.isDirty())
+        {
+            glMatrixMode(GL_TEXTURE);
+            glLoadIdentity();
+            if (renderStates.vertexFormat.get() == VertexFormat::Packed)
+            {
+                glScalef(1.f / 32767.f, 1.f / 32767.f, 1.f);
+            }
+            glMatrixMode(GL_MODELVIEW);
+            renderStates.vertexFormat.resetDirty();
+            renderStates.vertexBuffer.forceDirty();
+        }
+
         // Vertex/Index buffers
         if (renderStates.vertexBuffer.isDirty())
         {
@@ -595,9 +644,20 @@ namespace onut
                 auto handle = static_cast<OVertexBufferGLES2*>(renderStates.vertexBuffer.get().get())->getHandle();
                 glBindBuffer(GL_ARRAY_BUFFER, handle);
                 
-                glVertexPointer(2, GL_FLOAT, 32, NULL);
-                glTexCoordPointer(2, GL_FLOAT, 32, (float*)(sizeof(GL_FLOAT) * 2));
-                glColorPointer(4, GL_FLOAT, 32, (float*)(sizeof(GL_FLOAT) * 4));
+                if (renderStates.vertexFormat.get() == VertexFormat::Packed)
+                {
+                    auto pBase = reinterpret_cast<uint8_t*>(static_cast<uintptr_t>(m_baseVertex * sizeof(PackedVertex2D)));
+                    glVertexPointer(2, GL_FLOAT, sizeof(PackedVertex2D), pBase);
+                    glTexCoordPointer(2, GL_SHORT, sizeof(PackedVertex2D), pBase + sizeof(GL_FLOAT) * 2);
+                    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(PackedVertex2D), pBase + sizeof(GL_FLOAT) * 3);
+                }
+                else
+                {
+                    auto pBase = reinterpret_cast<uint8_t*>(static_cast<uintptr_t>(m_baseVertex * 32));
+                    glVertexPointer(2, GL_FLOAT, 32, pBase);
+                    glTexCoordPointer(2, GL_FLOAT, 32, pBase + sizeof(GL_FLOAT) * 2);
+                    glColorPointer(4, GL_FLOAT, 32, pBase + sizeof(GL_FLOAT) * 4);
+                }
             }
             renderStates.vertexBuffer.resetDirty();
         }
@@ -1,13 +1,14 @@
 #ifndef RENDERERGLES2_H_INCLUDED
 #define RENDERERGLES2_H_INCLUDED
 
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/Point.h>
 #include <onut/Renderer.h>
 
 // Third party
 #include <GLES/gl.h>
+#include <GLES/glext.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
@@ -30,7 +31,7 @@ namespace onut
         void endFrame();
 
         void draw(uint32_t vertexCount) override;
-        void drawIndexed(uint32_t indexCount) override;
+        void drawIndexed(uint32_t indexCount, uint32_t baseVertex = 0) override;
 
         Point getTrueResolution() const override;
         void onResize(const Point& newSize);
@@ -50,6 +51,7 @@ namespace onut
 
         void applyRenderStates() override;
         void init(const OWindowRef& pWindow) override;
+        bool supports32BitIndices() const override;
 
     private:
         void createDevice(const OWindowRef& pWindow);
@@ -65,9 +67,15 @@ namespace onut
         EGLSurface m_surface;
         EGLContext m_context;
 
+        // GL_OES_element_index_uint, optional in GLES2
+        bool m_has32BitIndices = false;
+
         // Render target
         Point m_resolution;
 
+        // GLES has no base vertex on draw calls, so we offset the vertex pointers instead
+        uint32_t m_baseVertex = 0;
+
         // Render states
 
         // Constant buffers
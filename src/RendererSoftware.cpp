@@ -0,0 +1,881 @@
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/IndexBuffer.h>
+#include <onut/Renderer.h>
+#include <onut/Settings.h>
+#include <onut/Texture.h>
+#include <onut/VertexBuffer.h>
+#include <onut/Window.h>
+
+// Private
+#include "IndexBufferSoftware.h"
+#include "RendererSoftware.h"
+#include "TextureSoftware.h"
+#include "VertexBufferSoftware.h"
+
+// Third party
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ONUT_SOFTWARE_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ONUT_SOFTWARE_NEON
+#include <arm_neon.h>
+#endif
+
+// STL
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    using namespace onut;
+
+    // One RGBA pixel, the 4 channels are processed at once
+    struct Float4
+    {
+#if defined(ONUT_SOFTWARE_SSE2)
+        __m128 v;
+
+        static Float4 splat(float value) { return {_mm_set1_ps(value)}; }
+        static Float4 load(const Color& color) { return {_mm_loadu_ps(&color.r)}; }
+        static Float4 unpack(uint32_t pixel)
+        {
+            auto zero = _mm_setzero_si128();
+            auto bytes = _mm_cvtsi32_si128(static_cast<int>(pixel));
+            auto ints = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+            return {_mm_mul_ps(_mm_cvtepi32_ps(ints), _mm_set1_ps(1.f / 255.f))};
+        }
+        uint32_t pack() const
+        {
+            auto clamped = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.f));
+            auto ints = _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(255.f)));
+            ints = _mm_packs_epi32(ints, ints);
+            ints = _mm_packus_epi16(ints, ints);
+            return static_cast<uint32_t>(_mm_cvtsi128_si32(ints));
+        }
+        float alpha() const { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+        Float4 operator+(const Float4& other) const { return {_mm_add_ps(v, other.v)}; }
+        Float4 operator-(const Float4& other) const { return {_mm_sub_ps(v, other.v)}; }
+        Float4 operator*(const Float4& other) const { return {_mm_mul_ps(v, other.v)}; }
+        Float4 operator*(float scale) const { return {_mm_mul_ps(v, _mm_set1_ps(scale))}; }
+#elif defined(ONUT_SOFTWARE_NEON)
+        float32x4_t v;
+
+        static Float4 splat(float value) { return {vdupq_n_f32(value)}; }
+        static Float4 load(const Color& color) { return {vld1q_f32(&color.r)}; }
+        static Float4 unpack(uint32_t pixel)
+        {
+            auto bytes = vreinterpret_u8_u32(vdup_n_u32(pixel));
+            auto ints = vmovl_u16(vget_low_u16(vmovl_u8(bytes)));
+            return {vmulq_n_f32(vcvtq_f32_u32(ints), 1.f / 255.f)};
+        }
+        uint32_t pack() const
+        {
+            auto clamped = vminq_f32(vmaxq_f32(v, vdupq_n_f32(0.f)), vdupq_n_f32(1.f));
+            auto ints = vcvtq_u32_f32(vmlaq_n_f32(vdupq_n_f32(.5f), clamped, 255.f));
+            auto shorts = vmovn_u32(ints);
+            auto bytes = vmovn_u16(vcombine_u16(shorts, shorts));
+            return vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+        }
+        float alpha() const { return vgetq_lane_f32(v, 3); }
+        Float4 operator+(const Float4& other) const { return {vaddq_f32(v, other.v)}; }
+        Float4 operator-(const Float4& other) const { return {vsubq_f32(v, other.v)}; }
+        Float4 operator*(const Float4& other) const { return {vmulq_f32(v, other.v)}; }
+        Float4 operator*(float scale) const { return {vmulq_n_f32(v, scale)}; }
+#else
+        float v[4];
+
+        static Float4 splat(float value) { return {{value, value, value, value}}; }
+        static Float4 load(const Color& color) { return {{color.r, color.g, color.b, color.a}}; }
+        static Float4 unpack(uint32_t pixel)
+        {
+            uint8_t bytes[4];
+            memcpy(bytes, &pixel, 4);
+            return {{bytes[0] / 255.f, bytes[1] / 255.f, bytes[2] / 255.f, bytes[3] / 255.f}};
+        }
+        uint32_t pack() const
+        {
+            uint8_t bytes[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                bytes[i] = static_cast<uint8_t>(std::min(std::max(v[i], 0.f), 1.f) * 255.f + .5f);
+            }
+            uint32_t pixel;
+            memcpy(&pixel, bytes, 4);
+            return pixel;
+        }
+        float alpha() const { return v[3]; }
+        Float4 operator+(const Float4& other) const { return {{v[0] + other.v[0], v[1] + other.v[1], v[2] + other.v[2], v[3] + other.v[3]}}; }
+        Float4 operator-(const Float4& other) const { return {{v[0] - other.v[0], v[1] - other.v[1], v[2] - other.v[2], v[3] - other.v[3]}}; }
+        Float4 operator*(const Float4& other) const { return {{v[0] * other.v[0], v[1] * other.v[1], v[2] * other.v[2], v[3] * other.v[3]}}; }
+        Float4 operator*(float scale) const { return {{v[0] * scale, v[1] * scale, v[2] * scale, v[3] * scale}}; }
+#endif
+    };
+
+    struct Sampler
+    {
+        const uint32_t* pPixels;
+        int width;
+        int height;
+        float widthf;
+        float heightf;
+        bool wrap;
+    };
+
+    // std::floor is a library call without SSE4.1
+    inline int floorToInt(float value)
+    {
+        auto truncated = static_cast<int>(value);
+        return truncated - (value < static_cast<float>(truncated) ? 1 : 0);
+    }
+
+    inline int addressTexel(int coord, int size, bool wrap)
+    {
+        if (wrap)
+        {
+            coord %= size;
+            return coord < 0 ? coord + size : coord;
+        }
+        return std::min(std::max(coord, 0), size - 1);
+    }
+
+    template<bool Tlinear>
+    inline Float4 sampleTexel(const Sampler& sampler, float u, float v);
+
+    template<>
+    inline Float4 sampleTexel<false>(const Sampler& sampler, float u, float v)
+    {
+        auto x = addressTexel(floorToInt(u * sampler.widthf), sampler.width, sampler.wrap);
+        auto y = addressTexel(floorToInt(v * sampler.heightf), sampler.height, sampler.wrap);
+        return Float4::unpack(sampler.pPixels[y * sampler.width + x]);
+    }
+
+    template<>
+    inline Float4 sampleTexel<true>(const Sampler& sampler, float u, float v)
+    {
+        auto fu = u * sampler.widthf - .5f;
+        auto fv = v * sampler.heightf - .5f;
+        auto x0 = floorToInt(fu);
+        auto y0 = floorToInt(fv);
+        auto fx = fu - static_cast<float>(x0);
+        auto fy = fv - static_cast<float>(y0);
+        auto x1 = addressTexel(x0 + 1, sampler.width, sampler.wrap);
+        auto y1 = addressTexel(y0 + 1, sampler.height, sampler.wrap);
+        x0 = addressTexel(x0, sampler.width, sampler.wrap);
+        y0 = addressTexel(y0, sampler.height, sampler.wrap);
+
+        auto pRow0 = sampler.pPixels + y0 * sampler.width;
+        auto pRow1 = sampler.pPixels + y1 * sampler.width;
+        auto p00 = Float4::unpack(pRow0[x0]);
+        auto p10 = Float4::unpack(pRow0[x1]);
+        auto p01 = Float4::unpack(pRow1[x0]);
+        auto p11 = Float4::unpack(pRow1[x1]);
+        auto top = p00 + (p10 - p00) * fx;
+        auto bottom = p01 + (p11 - p01) * fx;
+        return top + (bottom - top) * fy;
+    }
+
+    // Same equations as the hardware blend states
+    template<BlendMode Tblend>
+    inline Float4 blendPixel(const Float4& src, uint32_t dstPixel);
+
+    template<>
+    inline Float4 blendPixel<BlendMode::Opaque>(const Float4& src, uint32_t dstPixel)
+    {
+        return src;
+    }
+
+    template<>
+    inline Float4 blendPixel<BlendMode::Alpha>(const Float4& src, uint32_t dstPixel)
+    {
+        auto a = src.alpha();
+        return src * a + Float4::unpack(dstPixel) * (1.f - a);
+    }
+
+    template<>
+    inline Float4 blendPixel<BlendMode::Add>(const Float4& src, uint32_t dstPixel)
+    {
+        return src * src.alpha() + Float4::unpack(dstPixel);
+    }
+
+    template<>
+    inline Float4 blendPixel<BlendMode::PreMultiplied>(const Float4& src, uint32_t dstPixel)
+    {
+        return src + Float4::unpack(dstPixel) * (1.f - src.alpha());
+    }
+
+    template<>
+    inline Float4 blendPixel<BlendMode::Multiply>(const Float4& src, uint32_t dstPixel)
+    {
+        auto dst = Float4::unpack(dstPixel);
+        return src * dst + dst * (1.f - src.alpha());
+    }
+
+    template<>
+    inline Float4 blendPixel<BlendMode::ForceWrite>(const Float4& src, uint32_t dstPixel)
+    {
+        return src;
+    }
+
+    struct SpanSetup
+    {
+        float u, v;
+        float dudx, dvdx;
+        Float4 color;
+        Float4 dcolor;
+    };
+
+    template<BlendMode Tblend, bool Tlinear>
+    void fillSpan(uint32_t* pDst, int count, const Sampler& sampler, SpanSetup span)
+    {
+        for (int i = 0; i < count; ++i, ++pDst)
+        {
+            auto src = sampleTexel<Tlinear>(sampler, span.u, span.v) * span.color;
+            *pDst = blendPixel<Tblend>(src, *pDst).pack();
+            span.u += span.dudx;
+            span.v += span.dvdx;
+            span.color = span.color + span.dcolor;
+        }
+    }
+
+    // 1x1 textures, like the white texture used for untextured batches. The texel is the same everywhere.
+    template<BlendMode Tblend>
+    void fillSolidSpan(uint32_t* pDst, int count, const Sampler& sampler, SpanSetup span)
+    {
+        auto texel = Float4::unpack(*sampler.pPixels);
+        for (int i = 0; i < count; ++i, ++pDst)
+        {
+            *pDst = blendPixel<Tblend>(texel * span.color, *pDst).pack();
+            span.color = span.color + span.dcolor;
+        }
+    }
+
+    using FillSpanFn = void(*)(uint32_t*, int, const Sampler&, SpanSetup);
+
+    enum SpanType
+    {
+        SPAN_POINT,
+        SPAN_LINEAR,
+        SPAN_SOLID,
+        SPAN_TYPE_COUNT
+    };
+
+    const FillSpanFn FILL_SPAN_FNS[static_cast<int>(BlendMode::COUNT)][SPAN_TYPE_COUNT] = {
+        {fillSpan<BlendMode::Opaque, false>, fillSpan<BlendMode::Opaque, true>, fillSolidSpan<BlendMode::Opaque>},
+        {fillSpan<BlendMode::Alpha, false>, fillSpan<BlendMode::Alpha, true>, fillSolidSpan<BlendMode::Alpha>},
+        {fillSpan<BlendMode::Add, false>, fillSpan<BlendMode::Add, true>, fillSolidSpan<BlendMode::Add>},
+        {fillSpan<BlendMode::PreMultiplied, false>, fillSpan<BlendMode::PreMultiplied, true>, fillSolidSpan<BlendMode::PreMultiplied>},
+        {fillSpan<BlendMode::Multiply, false>, fillSpan<BlendMode::Multiply, true>, fillSolidSpan<BlendMode::Multiply>},
+        {fillSpan<BlendMode::ForceWrite, false>, fillSpan<BlendMode::ForceWrite, true>, fillSolidSpan<BlendMode::ForceWrite>}
+    };
+
+    // Used when no texture is bound
+    const uint32_t WHITE_PIXEL = 0xFFFFFFFF;
+}
+
+namespace onut
+{
+    ORendererRef Renderer::create(const OWindowRef& pWindow)
+    {
+        return OMake<RendererSoftware>(pWindow);
+    }
+
+    RendererSoftware::RendererSoftware(const OWindowRef& pWindow)
+    {
+        m_nextTile = 0;
+
+        // The calling thread also rasterizes
+        auto threadCount = static_cast<int>(std::thread::hardware_concurrency());
+        for (int i = 1; i < threadCount; ++i)
+        {
+            m_workers.push_back(std::thread([this] { workerThread(); }));
+        }
+    }
+
+    RendererSoftware::~RendererSoftware()
+    {
+        {
+            std::unique_lock<std::mutex> locker(m_workMutex);
+            m_isRunning = false;
+        }
+        m_workCondition.notify_all();
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    void RendererSoftware::init(const OWindowRef& pWindow)
+    {
+        onResize(oSettings->getResolution());
+        Renderer::init(pWindow);
+    }
+
+    void RendererSoftware::onResize(const Point& newSize)
+    {
+        flush();
+        m_resolution = newSize;
+        m_pBackBuffer = ODynamicCast<OTextureSoftware>(OTexture::createRenderTarget(m_resolution));
+        m_pFrontBuffer = ODynamicCast<OTextureSoftware>(OTexture::createRenderTarget(m_resolution));
+        renderStates.renderTarget.forceDirty();
+    }
+
+    Point RendererSoftware::getTrueResolution() const
+    {
+        return m_resolution;
+    }
+
+    void RendererSoftware::beginFrame()
+    {
+        // Bind render target
+        renderStates.reset();
+        renderStates.renderTarget.forceDirty();
+
+        // Set viewport/scissor
+        const auto& res = getResolution();
+        renderStates.viewport = iRect{0, 0, res.x, res.y};
+        renderStates.scissorEnabled = false;
+        renderStates.scissor = renderStates.viewport.get();
+
+        // Reset 2d view
+        set2DCamera(Vector2::Zero);
+    }
+
+    void RendererSoftware::endFrame()
+    {
+        flush();
+
+        // Present
+        std::swap(m_pBackBuffer, m_pFrontBuffer);
+        renderStates.renderTarget.forceDirty();
+
+        m_stats.endFrame();
+    }
+
+    bool RendererSoftware::savePNG(const std::string& filename)
+    {
+        flush();
+        return m_pFrontBuffer->savePNG(filename);
+    }
+
+    void RendererSoftware::clear(const Color& color)
+    {
+        renderStates.clearColor = color;
+        applyRenderStates();
+        flush();
+        if (m_pTargetSoftware)
+        {
+            auto size = m_pTargetSoftware->getSize();
+            std::fill(m_pTargetSoftware->getPixels(), m_pTargetSoftware->getPixels() + size.x * size.y, TextureSoftware::packPixel(color));
+        }
+    }
+
+    void RendererSoftware::clearDepth()
+    {
+    }
+
+    void RendererSoftware::setKernelSize(const Vector2& kernelSize)
+    {
+    }
+
+    void RendererSoftware::setCRT(const Vector2& resolution)
+    {
+    }
+
+    void RendererSoftware::setCartoon(const Vector3& tone)
+    {
+    }
+
+    void RendererSoftware::setVignette(const Vector2& kernelSize, float amount)
+    {
+    }
+
+    void RendererSoftware::setSepia(const Vector3& tone, float saturation, float sepiaAmount)
+    {
+    }
+
+    void RendererSoftware::draw(uint32_t vertexCount)
+    {
+        m_stats.onDraw(vertexCount);
+        applyRenderStates();
+        drawPrimitives(nullptr, 0, vertexCount, 0);
+    }
+
+    void RendererSoftware::drawIndexed(uint32_t indexCount, uint32_t baseVertex)
+    {
+        m_stats.onDrawIndexed(indexCount);
+        applyRenderStates();
+        auto pIndexBuffer = static_cast<OIndexBufferSoftware*>(renderStates.indexBuffer.get().get());
+        if (!pIndexBuffer) return;
+        drawPrimitives(pIndexBuffer->getData(), pIndexBuffer->getElementSize() / 8, indexCount, baseVertex);
+    }
+
+    void RendererSoftware::applyRenderStates()
+    {
+        m_stats.onApplyRenderStates(renderStates);
+
+        // Render target. What was queued for the previous one is drawn first.
+        bool isClipDirty = false;
+        if (renderStates.renderTarget.isDirty())
+        {
+            flush();
+            m_pTarget = renderStates.renderTarget.get();
+            if (!m_pTarget) m_pTarget = m_pBackBuffer;
+            if (!m_pTarget) return; // Not initialized yet
+            m_pTargetSoftware = static_cast<TextureSoftware*>(m_pTarget.get());
+
+            auto size = m_pTarget->getSize();
+            m_tileCountX = (size.x + TILE_SIZE - 1) / TILE_SIZE;
+            m_tileCountY = (size.y + TILE_SIZE - 1) / TILE_SIZE;
+            m_bins.resize(m_tileCountX * m_tileCountY);
+
+            isClipDirty = true;
+            renderStates.renderTarget.resetDirty();
+        }
+
+        // Viewport and scissor are combined into one clip rect
+        if (isClipDirty ||
+            renderStates.viewport.isDirty() ||
+            renderStates.scissorEnabled.isDirty() ||
+            renderStates.scissor.isDirty())
+        {
+            auto size = m_pTarget->getSize();
+            m_clipRect = renderStates.viewport.get();
+            if (renderStates.scissorEnabled.get())
+            {
+                auto& scissor = renderStates.scissor.get();
+                m_clipRect.left = std::max(m_clipRect.left, scissor.left);
+                m_clipRect.top = std::max(m_clipRect.top, scissor.top);
+                m_clipRect.right = std::min(m_clipRect.right, scissor.right);
+                m_clipRect.bottom = std::min(m_clipRect.bottom, scissor.bottom);
+            }
+            m_clipRect.left = std::max(m_clipRect.left, 0);
+            m_clipRect.top = std::max(m_clipRect.top, 0);
+            m_clipRect.right = std::min(m_clipRect.right, size.x);
+            m_clipRect.bottom = std::min(m_clipRect.bottom, size.y);
+            renderStates.viewport.resetDirty();
+            renderStates.scissorEnabled.resetDirty();
+            renderStates.scissor.resetDirty();
+        }
+
+        // World * View * Projection
+        if (renderStates.projection.isDirty() ||
+            renderStates.view.isDirty() ||
+            renderStates.world.isDirty())
+        {
+            m_transform = renderStates.world.get() * renderStates.view.get() * renderStates.projection.get();
+            renderStates.projection.resetDirty();
+            renderStates.view.resetDirty();
+            renderStates.world.resetDirty();
+        }
+
+        // Pixel states, recorded with the triangles
+        if (renderStates.textures[0].isDirty() ||
+            renderStates.blendMode.isDirty() ||
+            renderStates.sampleFiltering.isDirty() ||
+            renderStates.sampleAddressMode.isDirty())
+        {
+            m_isStateDirty = true;
+            renderStates.textures[0].resetDirty();
+            renderStates.blendMode.resetDirty();
+            renderStates.sampleFiltering.resetDirty();
+            renderStates.sampleAddressMode.resetDirty();
+        }
+
+        // The rest is read when drawing, or not used by the fixed 2D pipeline
+        for (int i = 1; i < RenderStates::MAX_TEXTURES; ++i)
+        {
+            renderStates.textures[i].resetDirty();
+        }
+        renderStates.depthEnabled.resetDirty();
+        renderStates.depthWrite.resetDirty();
+        renderStates.backFaceCull.resetDirty();
+        renderStates.primitiveMode.resetDirty();
+        renderStates.vertexShader.resetDirty();
+        renderStates.pixelShader.resetDirty();
+        renderStates.vertexFormat.resetDirty();
+        renderStates.clearColor.resetDirty();
+        renderStates.vertexBuffer.resetDirty();
+        renderStates.indexBuffer.resetDirty();
+    }
+
+    Vector2 RendererSoftware::transformVertex(const Vector2& position) const
+    {
+        const auto& m = m_transform;
+        auto x = position.x * m._11 + position.y * m._21 + m._41;
+        auto y = position.x * m._12 + position.y * m._22 + m._42;
+        auto w = position.x * m._14 + position.y * m._24 + m._44;
+        auto invW = (w != 0.f) ? 1.f / w : 1.f;
+
+        const auto& viewport = renderStates.viewport.get();
+        return Vector2(
+            static_cast<float>(viewport.left) + (x * invW * .5f + .5f) * static_cast<float>(viewport.right - viewport.left),
+            static_cast<float>(viewport.top) + (.5f - y * invW * .5f) * static_cast<float>(viewport.bottom - viewport.top));
+    }
+
+    void RendererSoftware::drawPrimitives(const uint8_t* pIndices, uint32_t indexSize, uint32_t count, uint32_t baseVertex)
+    {
+        auto pVertexBuffer = static_cast<OVertexBufferSoftware*>(renderStates.vertexBuffer.get().get());
+        if (!pVertexBuffer || !m_pTargetSoftware) return;
+        if (m_clipRect.left >= m_clipRect.right || m_clipRect.top >= m_clipRect.bottom) return;
+
+        auto isPacked = renderStates.vertexFormat.get() == VertexFormat::Packed;
+        auto vertexSize = isPacked ? sizeof(PackedVertex2D) : sizeof(Vertex);
+        auto pVertices = pVertexBuffer->getData() + baseVertex * vertexSize;
+        auto vertexCount = pVertexBuffer->size() / vertexSize - baseVertex;
+        auto fetch = [&](uint32_t i) -> Vertex
+        {
+            uint32_t index = i;
+            if (indexSize == 2) index = reinterpret_cast<const uint16_t*>(pIndices)[i];
+            else if (indexSize == 4) index = reinterpret_cast<const uint32_t*>(pIndices)[i];
+            assert(index < vertexCount);
+            (void)vertexCount;
+            if (isPacked)
+            {
+                const auto& packed = reinterpret_cast<const PackedVertex2D*>(pVertices)[index];
+                return {
+                    packed.position,
+                    Vector2(PackedVertex2D::unpackTexCoord(packed.texCoord[0]), PackedVertex2D::unpackTexCoord(packed.texCoord[1])),
+                    PackedVertex2D::unpackColor(packed.color)};
+            }
+            return reinterpret_cast<const Vertex*>(pVertices)[index];
+        };
+
+        switch (renderStates.primitiveMode.get())
+        {
+            case PrimitiveMode::TriangleList:
+                for (uint32_t i = 0; i + 2 < count; i += 3)
+                {
+                    const auto& v0 = fetch(i);
+                    const auto& v1 = fetch(i + 1);
+                    const auto& v2 = fetch(i + 2);
+                    addTriangle(v0, transformVertex(v0.position), v1, transformVertex(v1.position), v2, transformVertex(v2.position));
+                }
+                break;
+            case PrimitiveMode::TriangleStrip:
+                for (uint32_t i = 2; i < count; ++i)
+                {
+                    const auto& v0 = fetch(i - 2);
+                    const auto& v1 = fetch(i - 1);
+                    const auto& v2 = fetch(i);
+                    if (i & 1) addTriangle(v1, transformVertex(v1.position), v0, transformVertex(v0.position), v2, transformVertex(v2.position));
+                    else addTriangle(v0, transformVertex(v0.position), v1, transformVertex(v1.position), v2, transformVertex(v2.position));
+                }
+                break;
+            case PrimitiveMode::LineList:
+                for (uint32_t i = 0; i + 1 < count; i += 2)
+                {
+                    const auto& v0 = fetch(i);
+                    const auto& v1 = fetch(i + 1);
+                    addLine(v0, transformVertex(v0.position), v1, transformVertex(v1.position));
+                }
+                break;
+            case PrimitiveMode::LineStrip:
+                for (uint32_t i = 1; i < count; ++i)
+                {
+                    const auto& v0 = fetch(i - 1);
+                    const auto& v1 = fetch(i);
+                    addLine(v0, transformVertex(v0.position), v1, transformVertex(v1.position));
+                }
+                break;
+            case PrimitiveMode::PointList:
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    const auto& v = fetch(i);
+                    addPoint(v, transformVertex(v.position));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void RendererSoftware::addLine(const Vertex& v0, const Vector2& p0, const Vertex& v1, const Vector2& p1)
+    {
+        // One pixel wide quad
+        auto dir = p1 - p0;
+        auto len = dir.Length();
+        if (len == 0.f)
+        {
+            addPoint(v0, p0);
+            return;
+        }
+        Vector2 offset(-dir.y / len * .5f, dir.x / len * .5f);
+        addTriangle(v0, p0 - offset, v1, p1 - offset, v1, p1 + offset);
+        addTriangle(v0, p0 - offset, v1, p1 + offset, v0, p0 + offset);
+    }
+
+    void RendererSoftware::addPoint(const Vertex& v, const Vector2& p)
+    {
+        // One pixel quad
+        addTriangle(v, p + Vector2(-.5f, -.5f), v, p + Vector2(.5f, -.5f), v, p + Vector2(.5f, .5f));
+        addTriangle(v, p + Vector2(-.5f, -.5f), v, p + Vector2(.5f, .5f), v, p + Vector2(-.5f, .5f));
+    }
+
+    void RendererSoftware::addTriangle(const Vertex& v0, const Vector2& p0, const Vertex& v1, const Vector2& p1, const Vertex& v2, const Vector2& p2)
+    {
+        double x[3] = {p0.x, p1.x, p2.x};
+        double y[3] = {p0.y, p1.y, p2.y};
+
+        // Front faces are counter clockwise on screen
+        auto area2 = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area2 == 0.0) return;
+        if (renderStates.backFaceCull.get() && area2 > 0.0) return;
+
+        // Pixels with their center inside the bounds, clipped
+        Triangle triangle;
+        triangle.left = std::max(m_clipRect.left, static_cast<int>(std::ceil(std::min({x[0], x[1], x[2]}) - .5)));
+        triangle.top = std::max(m_clipRect.top, static_cast<int>(std::ceil(std::min({y[0], y[1], y[2]}) - .5)));
+        triangle.right = std::min(m_clipRect.right - 1, static_cast<int>(std::floor(std::max({x[0], x[1], x[2]}) - .5)));
+        triangle.bottom = std::min(m_clipRect.bottom - 1, static_cast<int>(std::floor(std::max({y[0], y[1], y[2]}) - .5)));
+        if (triangle.left > triangle.right || triangle.top > triangle.bottom) return;
+
+        // Edge functions, positive inside. Edge i is opposite to vertex i.
+        // Pixels exactly on an edge belong to the triangle only on top and left edges,
+        // so triangles sharing an edge never draw a pixel twice.
+        triangle.topLeftMask = 0;
+        auto sign = (area2 > 0.0) ? 1.0 : -1.0;
+        for (int i = 0; i < 3; ++i)
+        {
+            auto a = (i + 1) % 3;
+            auto b = (i + 2) % 3;
+            triangle.edgeA[i] = (y[a] - y[b]) * sign;
+            triangle.edgeB[i] = (x[b] - x[a]) * sign;
+            triangle.edgeC[i] = (x[a] * y[b] - y[a] * x[b]) * sign;
+            if (triangle.edgeA[i] > 0.0 || (triangle.edgeA[i] == 0.0 && triangle.edgeB[i] > 0.0))
+            {
+                triangle.topLeftMask |= static_cast<uint8_t>(1 << i);
+            }
+        }
+
+        // Attribute planes
+        auto dx1 = static_cast<float>(x[1] - x[0]);
+        auto dy1 = static_cast<float>(y[1] - y[0]);
+        auto dx2 = static_cast<float>(x[2] - x[0]);
+        auto dy2 = static_cast<float>(y[2] - y[0]);
+        auto invArea2 = static_cast<float>(1.0 / area2);
+        auto x0 = static_cast<float>(x[0]);
+        auto y0 = static_cast<float>(y[0]);
+        auto plane = [&](float f0, float f1, float f2, float& base, float& dx, float& dy)
+        {
+            dx = ((f1 - f0) * dy2 - (f2 - f0) * dy1) * invArea2;
+            dy = ((f2 - f0) * dx1 - (f1 - f0) * dx2) * invArea2;
+            base = f0 - dx * x0 - dy * y0;
+        };
+        plane(v0.texCoord.x, v1.texCoord.x, v2.texCoord.x, triangle.uvBase[0], triangle.uvDx[0], triangle.uvDy[0]);
+        plane(v0.texCoord.y, v1.texCoord.y, v2.texCoord.y, triangle.uvBase[1], triangle.uvDx[1], triangle.uvDy[1]);
+        plane(v0.color.r, v1.color.r, v2.color.r, triangle.colorBase.r, triangle.colorDx.r, triangle.colorDy.r);
+        plane(v0.color.g, v1.color.g, v2.color.g, triangle.colorBase.g, triangle.colorDx.g, triangle.colorDy.g);
+        plane(v0.color.b, v1.color.b, v2.color.b, triangle.colorBase.b, triangle.colorDx.b, triangle.colorDy.b);
+        plane(v0.color.a, v1.color.a, v2.color.a, triangle.colorBase.a, triangle.colorDx.a, triangle.colorDy.a);
+
+        // Record the pixel states once for all triangles sharing them
+        if (m_isStateDirty)
+        {
+            auto& pTexture = renderStates.textures[0].get();
+            if (pTexture && (m_drawTextures.empty() || m_drawTextures.back() != pTexture))
+            {
+                m_drawTextures.push_back(pTexture);
+            }
+            auto pTextureSoftware = pTexture ? static_cast<TextureSoftware*>(pTexture->isAtlased() ? pTexture->getAtlasPage().get() : pTexture.get()) : nullptr;
+            m_drawStates.push_back({pTextureSoftware, renderStates.blendMode.get(), renderStates.sampleFiltering.get(), renderStates.sampleAddressMode.get()});
+            m_stateIndex = static_cast<uint32_t>(m_drawStates.size() - 1);
+            m_isStateDirty = false;
+        }
+        triangle.stateIndex = m_stateIndex;
+
+        // Bin into the tiles it touches
+        auto triangleIndex = static_cast<uint32_t>(m_triangles.size());
+        m_triangles.push_back(triangle);
+        for (int ty = triangle.top / TILE_SIZE; ty <= triangle.bottom / TILE_SIZE; ++ty)
+        {
+            for (int tx = triangle.left / TILE_SIZE; tx <= triangle.right / TILE_SIZE; ++tx)
+            {
+                auto tileIndex = static_cast<uint32_t>(ty * m_tileCountX + tx);
+                auto& bin = m_bins[tileIndex];
+                if (bin.empty()) m_activeTiles.push_back(tileIndex);
+                bin.push_back(triangleIndex);
+            }
+        }
+    }
+
+    void RendererSoftware::flush()
+    {
+        if (m_triangles.empty()) return;
+
+        rasterizeTiles();
+
+        for (auto tileIndex : m_activeTiles)
+        {
+            m_bins[tileIndex].clear();
+        }
+        m_activeTiles.clear();
+        m_triangles.clear();
+        m_drawStates.clear();
+        m_drawTextures.clear();
+        m_isStateDirty = true;
+    }
+
+    void RendererSoftware::rasterizeTiles()
+    {
+        m_nextTile = 0;
+
+        // Not worth waking up the workers
+        if (m_workers.empty() || m_activeTiles.size() < 2)
+        {
+            for (auto tileIndex : m_activeTiles)
+            {
+                rasterizeTile(tileIndex);
+            }
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> locker(m_workMutex);
+            ++m_workGeneration;
+            m_busyWorkers = static_cast<int>(m_workers.size());
+        }
+        m_workCondition.notify_all();
+
+        // Help out, then wait for the workers to be done with their last tile
+        uint32_t i;
+        while ((i = m_nextTile++) < m_activeTiles.size())
+        {
+            rasterizeTile(m_activeTiles[i]);
+        }
+        std::unique_lock<std::mutex> locker(m_workMutex);
+        m_doneCondition.wait(locker, [this] { return m_busyWorkers == 0; });
+    }
+
+    void RendererSoftware::workerThread()
+    {
+        uint32_t generation = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> locker(m_workMutex);
+                m_workCondition.wait(locker, [&] { return !m_isRunning || m_workGeneration != generation; });
+                if (!m_isRunning) return;
+                generation = m_workGeneration;
+            }
+
+            uint32_t i;
+            while ((i = m_nextTile++) < m_activeTiles.size())
+            {
+                rasterizeTile(m_activeTiles[i]);
+            }
+
+            std::unique_lock<std::mutex> locker(m_workMutex);
+            if (--m_busyWorkers == 0)
+            {
+                m_doneCondition.notify_one();
+            }
+        }
+    }
+
+    void RendererSoftware::rasterizeTile(uint32_t tileIndex)
+    {
+        auto tx = static_cast<int>(tileIndex) % m_tileCountX;
+        auto ty = static_cast<int>(tileIndex) / m_tileCountX;
+        auto size = m_pTargetSoftware->getSize();
+        iRect tileRect{
+            tx * TILE_SIZE,
+            ty * TILE_SIZE,
+            std::min((tx + 1) * TILE_SIZE, size.x) - 1,
+            std::min((ty + 1) * TILE_SIZE, size.y) - 1};
+
+        // Submission order is kept within a tile
+        for (auto triangleIndex : m_bins[tileIndex])
+        {
+            rasterizeTriangle(m_triangles[triangleIndex], tileRect);
+        }
+    }
+
+    void RendererSoftware::rasterizeTriangle(const Triangle& triangle, const iRect& tileRect)
+    {
+        // Inclusive bounds
+        auto left = std::max(triangle.left, tileRect.left);
+        auto top = std::max(triangle.top, tileRect.top);
+        auto right = std::min(triangle.right, tileRect.right);
+        auto bottom = std::min(triangle.bottom, tileRect.bottom);
+        if (left > right || top > bottom) return;
+
+        const auto& state = m_drawStates[triangle.stateIndex];
+        Sampler sampler;
+        if (state.pTexture)
+        {
+            sampler.pPixels = state.pTexture->getPixels();
+            sampler.width = state.pTexture->getSize().x;
+            sampler.height = state.pTexture->getSize().y;
+        }
+        else
+        {
+            sampler.pPixels = &WHITE_PIXEL;
+            sampler.width = 1;
+            sampler.height = 1;
+        }
+        sampler.widthf = static_cast<float>(sampler.width);
+        sampler.heightf = static_cast<float>(sampler.height);
+        sampler.wrap = state.addressMode == sample::AddressMode::Wrap;
+        auto spanType = SPAN_SOLID;
+        if (sampler.width > 1 || sampler.height > 1)
+        {
+            spanType = state.filtering == sample::Filtering::Linear ? SPAN_LINEAR : SPAN_POINT;
+        }
+        auto fillSpanFn = FILL_SPAN_FNS[static_cast<int>(state.blendMode)][spanType];
+
+        auto pTarget = m_pTargetSoftware->getPixels();
+        auto pitch = m_pTargetSoftware->getSize().x;
+
+        SpanSetup span;
+        span.dudx = triangle.uvDx[0];
+        span.dvdx = triangle.uvDx[1];
+        span.dcolor = Float4::load(triangle.colorDx);
+        auto colorBase = Float4::load(triangle.colorBase);
+        auto colorDy = Float4::load(triangle.colorDy);
+
+        for (int y = top; y <= bottom; ++y)
+        {
+            // Find the span where all edge functions are positive at the pixel centers
+            auto yc = static_cast<double>(y) + .5;
+            auto x0 = left;
+            auto x1 = right;
+            bool isEmpty = false;
+            for (int i = 0; i < 3; ++i)
+            {
+                auto a = triangle.edgeA[i];
+                auto k = triangle.edgeB[i] * yc + triangle.edgeC[i];
+                bool isTopLeft = (triangle.topLeftMask & (1 << i)) != 0;
+                if (a > 0.0)
+                {
+                    auto bound = std::min(std::max(-k / a - .5, static_cast<double>(left - 1)), static_cast<double>(right + 1));
+                    auto start = isTopLeft ? static_cast<int>(std::ceil(bound)) : static_cast<int>(std::floor(bound)) + 1;
+                    x0 = std::max(x0, start);
+                }
+                else if (a < 0.0)
+                {
+                    auto bound = std::min(std::max(-k / a - .5, static_cast<double>(left - 1)), static_cast<double>(right + 1));
+                    auto end = isTopLeft ? static_cast<int>(std::floor(bound)) : static_cast<int>(std::ceil(bound)) - 1;
+                    x1 = std::min(x1, end);
+                }
+                else if (k < 0.0 || (k == 0.0 && !isTopLeft))
+                {
+                    isEmpty = true;
+                    break;
+                }
+            }
+            if (isEmpty || x0 > x1) continue;
+
+            auto xc = static_cast<float>(x0) + .5f;
+            auto ycf = static_cast<float>(yc);
+            span.u = triangle.uvBase[0] + triangle.uvDx[0] * xc + triangle.uvDy[0] * ycf;
+            span.v = triangle.uvBase[1] + triangle.uvDx[1] * xc + triangle.uvDy[1] * ycf;
+            span.color = colorBase + span.dcolor * xc + colorDy * ycf;
+            fillSpanFn(pTarget + y * pitch + x0, x1 - x0 + 1, sampler, span);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef RENDERERSOFTWARE_H_INCLUDED
+#define RENDERERSOFTWARE_H_INCLUDED
+
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/Point.h>
+#include <onut/Renderer.h>
+
+// STL
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(RendererSoftware);
+OForwardDeclare(TextureSoftware);
+
+namespace onut
+{
+    /**
+    Headless renderer rasterizing the 2D pipeline on the CPU: textured, colored triangles with
+    blend modes, filtering, address modes, viewport and scissor. Custom shaders and depth are ignored.
+    Triangles are queued and binned into screen tiles, then rasterized by worker threads when
+    flushed: on render target change, texture update, present or capture.
+    */
+    class RendererSoftware final : public Renderer
+    {
+    public:
+        static const int TILE_SIZE = 64;
+
+        RendererSoftware(const OWindowRef& pWindow);
+        ~RendererSoftware();
+
+        void clear(const Color& color = {.25f, .5f, 1, 1}) override;
+        void clearDepth() override;
+
+        void beginFrame() override;
+        void endFrame() override;
+
+        void draw(uint32_t vertexCount) override;
+        void drawIndexed(uint32_t indexCount, uint32_t baseVertex = 0) override;
+
+        Point getTrueResolution() const override;
+        void onResize(const Point& newSize) override;
+
+        // For effects. Not supported.
+        void setKernelSize(const Vector2& kernelSize) override;
+        void setSepia(const Vector3& tone = Vector3(1.40f, 1.10f, 0.90f), // 0 - 2.55
+                      float saturation = .25f, // 0 - 1
+                      float sepiaAmount = .75f) override; // 0 - 1
+        void setCRT(const Vector2& kernelSize) override;
+        void setCartoon(const Vector3& tone) override;
+        void setVignette(const Vector2& kernelSize, float amount = .5f) override;
+
+        void applyRenderStates() override;
+        void init(const OWindowRef& pWindow) override;
+
+        bool savePNG(const std::string& filename) override;
+
+        /**
+        Rasterize all queued triangles.
+        */
+        void flush();
+
+        /**
+        @return the last presented frame
+        */
+        const OTextureSoftwareRef& getFrontBuffer() const { return m_pFrontBuffer; }
+
+        /**
+        @return the number of threads rasterizing tiles, including the calling thread
+        */
+        int getThreadCount() const { return static_cast<int>(m_workers.size()) + 1; }
+
+    private:
+        // Same layout as SpriteBatch and PrimitiveBatch vertices
+        struct Vertex
+        {
+            Vector2 position;
+            Vector2 texCoord;
+            Color color;
+        };
+
+        struct DrawState
+        {
+            TextureSoftware* pTexture;
+            BlendMode blendMode;
+            sample::Filtering filtering;
+            sample::AddressMode addressMode;
+        };
+
+        // Attributes are planes: value = base + dx * x + dy * y, in pixels
+        struct Triangle
+        {
+            double edgeA[3];
+            double edgeB[3];
+            double edgeC[3];
+            uint8_t topLeftMask;
+            int left, top, right, bottom; // Inclusive, clipped
+            float uvBase[2], uvDx[2], uvDy[2];
+            Color colorBase, colorDx, colorDy;
+            uint32_t stateIndex;
+        };
+
+        using Triangles = std::vector<Triangle>;
+        using DrawStates = std::vector<DrawState>;
+        using Textures = std::vector<OTextureRef>;
+        using Bin = std::vector<uint32_t>;
+        using Bins = std::vector<Bin>;
+        using Workers = std::vector<std::thread>;
+
+        void drawPrimitives(const uint8_t* pIndices, uint32_t indexSize, uint32_t count, uint32_t baseVertex);
+        Vector2 transformVertex(const Vector2& position) const;
+        void addTriangle(const Vertex& v0, const Vector2& p0, const Vertex& v1, const Vector2& p1, const Vertex& v2, const Vector2& p2);
+        void addLine(const Vertex& v0, const Vector2& p0, const Vertex& v1, const Vector2& p1);
+        void addPoint(const Vertex& v, const Vector2& p);
+        void rasterizeTiles();
+        void rasterizeTile(uint32_t tileIndex);
+        void rasterizeTriangle(const Triangle& triangle, const iRect& tileRect);
+        void workerThread();
+
+        // Frame buffers
+        Point m_resolution;
+        OTextureSoftwareRef m_pBackBuffer;
+        OTextureSoftwareRef m_pFrontBuffer;
+        OTextureRef m_pTarget; // Back buffer or render target
+        TextureSoftware* m_pTargetSoftware = nullptr;
+
+        // Current draw setup, from render states
+        Matrix m_transform;
+        iRect m_clipRect;
+        uint32_t m_stateIndex = 0;
+        bool m_isStateDirty = true;
+
+        // Queued work
+        Triangles m_triangles;
+        DrawStates m_drawStates;
+        Textures m_drawTextures; // Keeps textures alive until flushed
+        Bins m_bins;
+        std::vector<uint32_t> m_activeTiles;
+        int m_tileCountX = 0;
+        int m_tileCountY = 0;
+
+        // Workers
+        Workers m_workers;
+        std::mutex m_workMutex;
+        std::condition_variable m_workCondition;
+        std::condition_variable m_doneCondition;
+        uint32_t m_workGeneration = 0;
+        int m_busyWorkers = 0;
+        bool m_isRunning = true;
+        std::atomic<uint32_t> m_nextTile;
+    };
+};
+
+#endif
+
+#endif
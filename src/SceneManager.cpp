@@ -7,6 +7,7 @@
 #include <onut/SceneManager.h>
 #include <onut/Renderer.h>
 #include <onut/SpriteBatch.h>
+#include <onut/ThreadPool.h>
 #include <onut/Timing.h>
 #include <onut/Updater.h>
 
@@ -14,7 +15,14 @@
 #include <Box2D/Box2D.h>
 
 // STL
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <cstring>
+
+// Private
+#include "RadixSort.h"
+#include "TransformSystem.h"
 
 OSceneManagerRef oSceneManager;
 
@@ -47,6 +55,75 @@ namespace onut
         SceneManager* m_pSceneManager;
     };
 
+    // Parallel updatables per job. Fixed, so the batches and their deferred commands don't depend on the worker count.
+    static const uint32_t PARALLEL_BATCH_SIZE = 64;
+
+    // DeferredCommands of the parallel batch running on this thread
+    static thread_local void* t_pDeferredCommands = nullptr;
+
+    static bool contains(const std::vector<ComponentTypeId>& typeIds, ComponentTypeId typeId)
+    {
+        return std::find(typeIds.begin(), typeIds.end(), typeId) != typeIds.end();
+    }
+
+    static bool isWritingAnyOf(const Component::UpdateAccess& access, const std::vector<ComponentTypeId>& typeIds)
+    {
+        for (auto typeId : access.writes)
+        {
+            if (contains(typeIds, typeId)) return true;
+        }
+        return false;
+    }
+
+    // Components without bounds are always visible
+    static const float UNBOUNDED_EXTENT = 1e18f;
+
+    static b2AABB toAABB(const Rect& rect)
+    {
+        b2AABB aabb;
+        aabb.lowerBound.Set(rect.x, rect.y);
+        aabb.upperBound.Set(rect.x + rect.z, rect.y + rect.w);
+        return aabb;
+    }
+
+    static b2AABB getRender2DAABB(Component* pComponent)
+    {
+        Rect worldBounds;
+        if (!pComponent->getWorldBounds(worldBounds))
+        {
+            b2AABB aabb;
+            aabb.lowerBound.Set(-UNBOUNDED_EXTENT, -UNBOUNDED_EXTENT);
+            aabb.upperBound.Set(UNBOUNDED_EXTENT, UNBOUNDED_EXTENT);
+            return aabb;
+        }
+        return toAABB(worldBounds);
+    }
+
+    // Signed values mapped to unsigned ones sorting the same way
+    static uint32_t toSortable(int32_t value)
+    {
+        return static_cast<uint32_t>(value) ^ 0x80000000;
+    }
+
+    static uint32_t toSortable(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+    }
+
+    struct SceneManager::Render2DQuery
+    {
+        const b2DynamicTree* pTree;
+        Render2DItems* pVisibles;
+
+        bool QueryCallback(int32 proxyId)
+        {
+            pVisibles->push_back({0, static_cast<Component*>(pTree->GetUserData(proxyId))});
+            return true;
+        }
+    };
+
     OSceneManagerRef SceneManager::create()
     {
         return std::shared_ptr<SceneManager>(new SceneManager());
@@ -61,30 +138,79 @@ namespace onut
         m_pComponentUpdates = new TList<Component>(offsetOf(&Component::m_updateLink));
         m_pComponentRenders = new TList<Component>(offsetOf(&Component::m_renderLink));
         m_pComponentRender2Ds = new TList<Component>(offsetOf(&Component::m_render2DLink));
+        m_pRender2DTree = new b2DynamicTree();
+        m_pTransforms = new TransformSystem();
     }
 
     SceneManager::~SceneManager()
     {
+        delete m_pTransforms;
+        delete m_pRender2DTree;
         delete m_pPhysic2DWorld;
         delete m_pPhysic2DContactListener;
     }
 
+    ComponentSystem* SceneManager::findComponentSystem(ComponentTypeId typeId) const
+    {
+        if (typeId >= m_componentSystems.size()) return nullptr;
+        return m_componentSystems[typeId].get();
+    }
+
     void SceneManager::addEntity(const OEntityRef& pEntity)
     {
-        if (pEntity->m_pSceneManager)
+        // Transforms, components and their systems belong to the scene, they can't follow an entity to another one
+        assert(!pEntity->m_pSceneManager);
+        pEntity->m_pSceneManager = OThis;
+        pEntity->m_transformId = m_pTransforms->create(pEntity.get());
+        m_entities.insert(pEntity);
+        indexEntity(pEntity.get());
+    }
+
+    void SceneManager::indexEntity(Entity* pEntity)
+    {
+        pEntity->m_queryIndex = static_cast<uint32_t>(m_queryItems.size());
+        m_queryItems.push_back({pEntity, pEntity->m_componentTypeMask});
+        addToIndex(m_entitiesByName, pEntity->m_nameId, pEntity);
+        for (auto tagId : pEntity->m_tags)
         {
-            auto pEntityRef = pEntity;
-            pEntityRef->m_pSceneManager->removeEntity(pEntityRef);
-            pEntityRef->m_pSceneManager = OThis;
-            m_entities.insert(pEntityRef);
+            addToIndex(m_entitiesByTag, tagId, pEntity);
         }
-        else
+    }
+
+    void SceneManager::unindexEntity(Entity* pEntity)
+    {
+        if (pEntity->m_queryIndex == 0xFFFFFFFF) return;
+
+        // Swap with the last one
+        auto& queryItem = m_queryItems[pEntity->m_queryIndex];
+        queryItem = m_queryItems.back();
+        queryItem.pEntity->m_queryIndex = pEntity->m_queryIndex;
+        m_queryItems.pop_back();
+        pEntity->m_queryIndex = 0xFFFFFFFF;
+
+        removeFromIndex(m_entitiesByName, pEntity->m_nameId, pEntity);
+        for (auto tagId : pEntity->m_tags)
         {
-            pEntity->m_pSceneManager = OThis;
-            m_entities.insert(pEntity);
+            removeFromIndex(m_entitiesByTag, tagId, pEntity);
         }
     }
 
+    void SceneManager::addToIndex(EntityIndex& index, EntityNameId id, Entity* pEntity)
+    {
+        if (id) index[id].push_back(pEntity);
+    }
+
+    void SceneManager::removeFromIndex(EntityIndex& index, EntityNameId id, Entity* pEntity)
+    {
+        if (!id) return;
+        auto it = index.find(id);
+        if (it == index.end()) return;
+        auto& entities = it->second;
+        auto entityIt = std::find(entities.begin(), entities.end(), pEntity);
+        if (entityIt != entities.end()) entities.erase(entityIt); // Keeps the others in the order they were indexed
+        if (entities.empty()) index.erase(it);
+    }
+
     void SceneManager::removeEntity(const OEntityRef& pEntity)
     {
         auto pRawEntity = pEntity.get();
@@ -119,8 +245,18 @@ namespace onut
         m_entitiesToRemove.push_back(pEntity);
     }
 
+    SceneManager::DeferredCommands* SceneManager::getDeferredCommands()
+    {
+        return static_cast<DeferredCommands*>(t_pDeferredCommands);
+    }
+
     void SceneManager::addComponentAction(const OComponentRef& pComponent, ComponentAction::Action action)
     {
+        if (auto pCommands = getDeferredCommands())
+        {
+            pCommands->push_back({DeferredCommand::Type::ComponentAction, action, pComponent, nullptr, 0, nullptr});
+            return;
+        }
         m_componentActions.push_back({action, pComponent});
     }
 
@@ -136,10 +272,28 @@ namespace onut
             switch (componentAction.action)
             {
                 case ComponentAction::Action::AddUpdate:
-                    m_pComponentUpdates->InsertTail(componentAction.pComponent.get());
+                    if (componentAction.pComponent->m_pSystem)
+                    {
+                        componentAction.pComponent->m_pSystem->setUpdating(componentAction.pComponent->m_systemIndex, true);
+                    }
+                    else if (componentAction.pComponent->m_flags & Component::FLAG_PARALLEL_UPDATABLE)
+                    {
+                        getParallelType(componentAction.pComponent.get()).pComponents->InsertTail(componentAction.pComponent.get());
+                    }
+                    else
+                    {
+                        m_pComponentUpdates->InsertTail(componentAction.pComponent.get());
+                    }
                     break;
                 case ComponentAction::Action::RemoveUpdate:
-                    componentAction.pComponent->m_updateLink.Unlink();
+                    if (componentAction.pComponent->m_pSystem)
+                    {
+                        componentAction.pComponent->m_pSystem->setUpdating(componentAction.pComponent->m_systemIndex, false);
+                    }
+                    else
+                    {
+                        componentAction.pComponent->m_updateLink.Unlink();
+                    }
                     break;
                 case ComponentAction::Action::AddRender:
                     m_pComponentRenders->InsertTail(componentAction.pComponent.get());
@@ -148,27 +302,267 @@ namespace onut
                     componentAction.pComponent->m_renderLink.Unlink();
                     break;
                 case ComponentAction::Action::AddRender2D:
+                    addRender2D(componentAction.pComponent.get());
+                    break;
+                case ComponentAction::Action::RemoveRender2D:
+                    removeRender2D(componentAction.pComponent.get());
+                    break;
+            }
+        }
+        m_componentActions.clear();
+    }
+
+    SceneManager::ParallelType& SceneManager::getParallelType(Component* pComponent)
+    {
+        auto typeId = getComponentTypeId(typeid(*pComponent));
+        for (auto& parallelType : m_parallelTypes)
+        {
+            if (parallelType.typeId == typeId) return parallelType;
+        }
+
+        ParallelType parallelType;
+        parallelType.typeId = typeId;
+        pComponent->getUpdateAccess(parallelType.access);
+
+        // Components can always touch their own members. Others writing the same thing could be doing it
+        // on the same entity.
+        auto& access = parallelType.access;
+        parallelType.isSelfConflicting = !access.writes.empty() || access.writesTransforms || contains(access.reads, typeId);
+
+        parallelType.pComponents.reset(new TList<Component>(offsetOf(&Component::m_updateLink)));
+        m_parallelTypes.push_back(std::move(parallelType));
+        m_areParallelStagesDirty = true;
+        return m_parallelTypes.back();
+    }
+
+    void SceneManager::buildParallelStages()
+    {
+        auto conflicts = [](const ParallelType& a, const ParallelType& b)
+        {
+            if (a.access.writesTransforms && (b.access.readsTransforms || b.access.writesTransforms)) return true;
+            if (b.access.writesTransforms && a.access.readsTransforms) return true;
+
+            // What a class writes includes its own components
+            if (contains(a.access.reads, b.typeId) || contains(b.access.reads, a.typeId)) return true;
+            if (contains(a.access.writes, b.typeId) || contains(b.access.writes, a.typeId)) return true;
+            return isWritingAnyOf(a.access, b.access.reads) || isWritingAnyOf(a.access, b.access.writes) ||
+                isWritingAnyOf(b.access, a.access.reads);
+        };
+
+        // Each class goes in the first stage it doesn't conflict with, in the order they were first seen
+        m_parallelStages.clear();
+        for (uint32_t i = 0; i < static_cast<uint32_t>(m_parallelTypes.size()); ++i)
+        {
+            ParallelStage* pStage = nullptr;
+            for (auto& stage : m_parallelStages)
+            {
+                bool isConflicting = false;
+                for (auto type : stage.types)
                 {
-                    auto drawIndex = componentAction.pComponent->getEntity()->getDrawIndex();
-                    Component* pComponent;
-                    for (pComponent = m_pComponentRender2Ds->Head(); pComponent; pComponent = pComponent->m_render2DLink.Next())
+                    if (conflicts(m_parallelTypes[type], m_parallelTypes[i]))
                     {
-                        auto otherDrawIndex = pComponent->getEntity()->getDrawIndex();
-                        if (drawIndex < otherDrawIndex)
-                        {
-                            m_pComponentRender2Ds->InsertBefore(componentAction.pComponent.get(), pComponent);
-                            break;
-                        }
+                        isConflicting = true;
+                        break;
                     }
-                    if (!pComponent) m_pComponentRender2Ds->InsertTail(componentAction.pComponent.get());
-                    break;
                 }
-                case ComponentAction::Action::RemoveRender2D:
-                    componentAction.pComponent->m_render2DLink.Unlink();
+                if (!isConflicting)
+                {
+                    pStage = &stage;
                     break;
+                }
+            }
+            if (!pStage)
+            {
+                m_parallelStages.push_back({});
+                pStage = &m_parallelStages.back();
             }
+            pStage->types.push_back(i);
         }
-        m_componentActions.clear();
+        m_areParallelStagesDirty = false;
+    }
+
+    void SceneManager::updateParallel()
+    {
+        if (m_parallelTypes.empty()) return;
+        if (m_areParallelStagesDirty) buildParallelStages();
+
+        // Split this frame's components in batches
+        m_parallelComponents.clear();
+        uint32_t batchCount = 0;
+        auto addBatch = [this, &batchCount](uint32_t begin, uint32_t end)
+        {
+            if (batchCount == m_parallelBatches.size()) m_parallelBatches.push_back({});
+            auto& batch = m_parallelBatches[batchCount++];
+            batch.begin = begin;
+            batch.end = end;
+        };
+        for (auto& stage : m_parallelStages)
+        {
+            stage.firstBatch = batchCount;
+            for (auto type : stage.types)
+            {
+                auto& parallelType = m_parallelTypes[type];
+                auto begin = static_cast<uint32_t>(m_parallelComponents.size());
+                for (auto pComponent = parallelType.pComponents->Head(); pComponent; pComponent = pComponent->m_updateLink.Next())
+                {
+                    m_parallelComponents.push_back(pComponent);
+                }
+                auto end = static_cast<uint32_t>(m_parallelComponents.size());
+                if (parallelType.isSelfConflicting)
+                {
+                    if (end > begin) addBatch(begin, end);
+                    continue;
+                }
+                for (auto batchBegin = begin; batchBegin < end; batchBegin += PARALLEL_BATCH_SIZE)
+                {
+                    addBatch(batchBegin, std::min(batchBegin + PARALLEL_BATCH_SIZE, end));
+                }
+            }
+            stage.batchCount = batchCount - stage.firstBatch;
+        }
+
+        auto runBatch = [this](size_t batchIndex)
+        {
+            auto& batch = m_parallelBatches[batchIndex];
+            t_pDeferredCommands = &batch.commands;
+            for (auto i = batch.begin; i < batch.end; ++i)
+            {
+                m_parallelComponents[i]->onUpdate();
+            }
+            t_pDeferredCommands = nullptr;
+        };
+        for (auto& stage : m_parallelStages)
+        {
+            if (!stage.batchCount) continue;
+
+            // Clean world transforms are only read, so they can be read from many threads
+            m_pTransforms->update();
+
+            if (oThreadPool && stage.batchCount > 1)
+            {
+                OParallelFor(stage.firstBatch, stage.firstBatch + stage.batchCount, 1, runBatch);
+            }
+            else
+            {
+                for (auto i = stage.firstBatch; i < stage.firstBatch + stage.batchCount; ++i) runBatch(i);
+            }
+        }
+
+        // Apply what was deferred in batch order, it doesn't depend on which thread ran what
+        for (uint32_t i = 0; i < batchCount; ++i)
+        {
+            auto& commands = m_parallelBatches[i].commands;
+            for (auto& command : commands)
+            {
+                switch (command.type)
+                {
+                    case DeferredCommand::Type::ComponentAction:
+                        addComponentAction(command.pComponent, command.action);
+                        break;
+                    case DeferredCommand::Type::DestroyEntity:
+                        command.pEntity->destroy();
+                        break;
+                    case DeferredCommand::Type::Message:
+                        command.pEntity->sendMessage(command.messageId, command.pData);
+                        break;
+                    case DeferredCommand::Type::BroadcastMessage:
+                        boardcastMessage(command.messageId, command.pData);
+                        break;
+                }
+            }
+            commands.clear();
+        }
+    }
+
+    void SceneManager::addRender2D(Component* pComponent)
+    {
+        if (pComponent->m_render2DLink.IsLinked()) return;
+
+        m_pComponentRender2Ds->InsertTail(pComponent);
+        pComponent->m_render2DSequence = m_nextRender2DSequence++;
+        ++m_render2DCount;
+
+        pComponent->m_render2DProxyId = m_pRender2DTree->CreateProxy(getRender2DAABB(pComponent), pComponent);
+        pComponent->m_isBoundsDirty = false;
+    }
+
+    void SceneManager::removeRender2D(Component* pComponent)
+    {
+        if (!pComponent->m_render2DLink.IsLinked()) return;
+
+        pComponent->m_render2DLink.Unlink();
+        --m_render2DCount;
+
+        // A pending bounds update is skipped, the proxy is gone
+        m_pRender2DTree->DestroyProxy(pComponent->m_render2DProxyId);
+        pComponent->m_render2DProxyId = -1;
+    }
+
+    void SceneManager::updateRender2DBounds()
+    {
+        for (auto& pComponent : m_dirtyRender2DBounds)
+        {
+            if (!pComponent->m_isBoundsDirty) continue;
+            pComponent->m_isBoundsDirty = false;
+            if (pComponent->m_render2DProxyId == -1) continue;
+
+            // The displacement lets the tree enlarge the box in the direction of motion
+            auto aabb = getRender2DAABB(pComponent.get());
+            const auto& fatAABB = m_pRender2DTree->GetFatAABB(pComponent->m_render2DProxyId);
+            auto displacement = aabb.GetCenter() - fatAABB.GetCenter();
+            m_pRender2DTree->MoveProxy(pComponent->m_render2DProxyId, aabb, displacement);
+        }
+        m_dirtyRender2DBounds.clear();
+    }
+
+    void SceneManager::sortRender2Ds()
+    {
+        // Draw index in the high bits, tie breaker in the low bits
+        switch (m_drawOrder)
+        {
+            case DrawOrder::DrawIndex:
+                for (auto& item : m_visibleRender2Ds)
+                {
+                    item.key =
+                        (static_cast<uint64_t>(toSortable(item.pComponent->getEntity()->getDrawIndex())) << 32) |
+                        static_cast<uint64_t>(item.pComponent->m_render2DSequence);
+                }
+                break;
+            case DrawOrder::DrawIndexThenY:
+            {
+                // Registration order first, so the stable sort on Y keeps it for equal Y
+                radixSort(m_visibleRender2Ds, m_render2DSortScratch, [](const Render2DItem& item) { return item.pComponent->m_render2DSequence; });
+                for (auto& item : m_visibleRender2Ds)
+                {
+                    const auto& pEntity = item.pComponent->getEntity();
+                    item.key =
+                        (static_cast<uint64_t>(toSortable(pEntity->getDrawIndex())) << 32) |
+                        static_cast<uint64_t>(toSortable(pEntity->getWorldTransform()._42));
+                }
+                break;
+            }
+        }
+        radixSort(m_visibleRender2Ds, m_render2DSortScratch, [](const Render2DItem& item) { return item.key; });
+    }
+
+    SceneManager::DrawOrder SceneManager::getDrawOrder() const
+    {
+        return m_drawOrder;
+    }
+
+    void SceneManager::setDrawOrder(DrawOrder drawOrder)
+    {
+        m_drawOrder = drawOrder;
+    }
+
+    int SceneManager::getVisibleRender2DCount() const
+    {
+        return static_cast<int>(m_visibleRender2Ds.size());
+    }
+
+    int SceneManager::getRender2DCount() const
+    {
+        return m_render2DCount;
     }
 
     void SceneManager::setActiveCamera2D(const OCamera2DComponentRef& pActiveCamera2D)
@@ -176,6 +570,16 @@ namespace onut
         m_pActiveCamera2D = pActiveCamera2D;
     }
 
+    uint8_t SceneManager::getSpriteSortMode() const
+    {
+        return m_spriteSortMode;
+    }
+
+    void SceneManager::setSpriteSortMode(uint8_t sortMode)
+    {
+        m_spriteSortMode = sortMode;
+    }
+
     void SceneManager::performContacts()
     {
         auto contacts = m_contact2Ds;
@@ -213,6 +617,10 @@ namespace onut
                 pParent->remove(pEntity);
             }
             pEntity->m_components.clear();
+            pEntity->m_componentIndices.clear();
+            pEntity->m_componentTypeMask = 0;
+
+            unindexEntity(pEntity.get());
             m_entities.erase(pEntity);
         }
         m_entitiesToRemove.clear();
@@ -237,6 +645,15 @@ namespace onut
             // Send physic contact messages
             performContacts();
 
+            // Update component systems, one call per type
+            for (auto& pSystem : m_componentSystems)
+            {
+                if (pSystem) pSystem->update();
+            }
+
+            // Update the thread safe updatables, on the ThreadPool
+            updateParallel();
+
             // Update updatables
             for (auto pComponent = m_pComponentUpdates->Head(); pComponent; pComponent = pComponent->m_updateLink.Next())
             {
@@ -247,6 +664,9 @@ namespace onut
             performComponentActions();
             performEntityActions();
         }
+
+        // Propagate the transforms that moved this frame, in one pass
+        m_pTransforms->update();
     }
 
     void SceneManager::render()
@@ -277,15 +697,36 @@ namespace onut
         }
         transform._41 = std::roundf(transform._41);
         transform._42 = std::roundf(transform._42);
-        oSpriteBatch->begin(transform);
-#if defined(_DEBUG)
-        int render2DCount = 0;
-#endif
-        for (auto pComponent = m_pComponentRender2Ds->Head(); pComponent; pComponent = pComponent->m_render2DLink.Next())
+
+        // Only visit the 2D renderables overlapping the view, in draw order
+        m_pTransforms->update();
+        updateRender2DBounds();
         {
-#if defined(_DEBUG)
-            ++render2DCount;
-#endif
+            auto invTransform = transform.Invert();
+            Vector2 viewCorners[4] =
+            {
+                Vector2::Transform(Vector2::Zero, invTransform),
+                Vector2::Transform(Vector2(0.f, OScreenHf), invTransform),
+                Vector2::Transform(OScreenf, invTransform),
+                Vector2::Transform(Vector2(OScreenWf, 0.f), invTransform)
+            };
+            b2AABB viewAABB;
+            viewAABB.lowerBound.Set(onut::min(viewCorners[0].x, viewCorners[1].x, viewCorners[2].x, viewCorners[3].x),
+                                    onut::min(viewCorners[0].y, viewCorners[1].y, viewCorners[2].y, viewCorners[3].y));
+            viewAABB.upperBound.Set(onut::max(viewCorners[0].x, viewCorners[1].x, viewCorners[2].x, viewCorners[3].x),
+                                    onut::max(viewCorners[0].y, viewCorners[1].y, viewCorners[2].y, viewCorners[3].y));
+
+            m_visibleRender2Ds.clear();
+            Render2DQuery query = {m_pRender2DTree, &m_visibleRender2Ds};
+            m_pRender2DTree->Query(&query, viewAABB);
+            sortRender2Ds();
+        }
+
+        oSpriteBatch->begin(transform, OBlendPreMultiplied, m_spriteSortMode);
+        for (const auto& item : m_visibleRender2Ds)
+        {
+            auto pComponent = item.pComponent;
+            oSpriteBatch->setDrawIndex(pComponent->getEntity()->getDrawIndex());
             pComponent->onRender2d();
         }
 
@@ -334,6 +775,7 @@ namespace onut
 #endif
 
         oSpriteBatch->end();
+        oSpriteBatch->setDrawIndex(0);
 
 #if defined(_DEBUG)
         int updateCount = 0;
@@ -341,6 +783,17 @@ namespace onut
         {
             ++updateCount;
         }
+        for (auto& pSystem : m_componentSystems)
+        {
+            if (pSystem) updateCount += static_cast<int>(pSystem->getUpdatingCount());
+        }
+        for (auto& parallelType : m_parallelTypes)
+        {
+            for (auto pComponent = parallelType.pComponents->Head(); pComponent; pComponent = pComponent->m_updateLink.Next())
+            {
+                ++updateCount;
+            }
+        }
         auto pFont = OGetFont("font.fnt");
         if (pFont)
         {
@@ -348,7 +801,7 @@ namespace onut
             oSpriteBatch->drawRect(nullptr, {0, 16, 200, 100}, Color(0, 0, 0, .75f));
             pFont->draw("Updatables: " + std::to_string(updateCount), {0, 20});
             pFont->draw("Renderables: " + std::to_string(renderCount), {0, 40});
-            pFont->draw("Renderables 2D: " + std::to_string(render2DCount), {0, 60});
+            pFont->draw("Renderables 2D: " + std::to_string(getVisibleRender2DCount()) + " / " + std::to_string(m_render2DCount), {0, 60});
             pFont->draw("Components: " + std::to_string(g_componentCount), {0, 80});
             pFont->draw("Entities: " + std::to_string(g_entityCount), {0, 100});
             oSpriteBatch->end();
@@ -358,11 +811,76 @@ namespace onut
 
     OEntityRef SceneManager::findEntity(const std::string& name) const
     {
-        for (auto& pEntity : m_entities)
+        return findEntity(findEntityNameId(name));
+    }
+
+    OEntityRef SceneManager::findEntity(EntityNameId nameId) const
+    {
+        if (!nameId) return nullptr;
+        auto it = m_entitiesByName.find(nameId);
+        if (it == m_entitiesByName.end()) return nullptr;
+        return it->second.front()->shared_from_this();
+    }
+
+    Entity::Entities SceneManager::findEntitiesWithTag(const std::string& tag) const
+    {
+        Entity::Entities entities;
+        auto tagId = findEntityNameId(tag);
+        if (!tagId) return entities;
+        auto it = m_entitiesByTag.find(tagId);
+        if (it == m_entitiesByTag.end()) return entities;
+        entities.reserve(it->second.size());
+        for (auto pEntity : it->second)
         {
-            if (pEntity->getName() == name) return pEntity;
+            entities.push_back(pEntity->shared_from_this());
         }
-        return nullptr;
+        return entities;
+    }
+
+    static uint64_t getComponentTypeMask(const std::vector<ComponentTypeId>& typeIds)
+    {
+        uint64_t mask = 0;
+        for (auto typeId : typeIds) mask |= 1ull << (typeId & 63);
+        return mask;
+    }
+
+    bool SceneManager::hasComponents(const QueryItem& queryItem, uint64_t mask, const std::vector<ComponentTypeId>& typeIds)
+    {
+        // The mask rules most of them out without touching the entity
+        if ((queryItem.componentTypeMask & mask) != mask) return false;
+        auto pEntity = queryItem.pEntity;
+        for (auto typeId : typeIds)
+        {
+            if (pEntity->findComponent(typeId) == -1) return false;
+        }
+        return true;
+    }
+
+    Entity::Entities SceneManager::findEntitiesWith(const std::vector<ComponentTypeId>& typeIds) const
+    {
+        Entity::Entities entities;
+        auto mask = getComponentTypeMask(typeIds);
+        for (const auto& queryItem : m_queryItems)
+        {
+            if (!hasComponents(queryItem, mask, typeIds)) continue;
+            entities.push_back(queryItem.pEntity->shared_from_this());
+        }
+        return entities;
+    }
+
+    Entity::Entities SceneManager::findEntitiesWith(const std::vector<ComponentTypeId>& typeIds, const Rect& rect) const
+    {
+        Entity::Entities entities;
+        auto mask = getComponentTypeMask(typeIds);
+        for (const auto& queryItem : m_queryItems)
+        {
+            if (!hasComponents(queryItem, mask, typeIds)) continue;
+            auto position = queryItem.pEntity->getWorldTransform().Translation();
+            if (position.x < rect.x || position.y < rect.y ||
+                position.x > rect.x + rect.z || position.y > rect.y + rect.w) continue;
+            entities.push_back(queryItem.pEntity->shared_from_this());
+        }
+        return entities;
     }
 
     b2World* SceneManager::getPhysic2DWorld() const
@@ -469,6 +987,11 @@ namespace onut
 
     void SceneManager::boardcastMessage(int messageId, void* pData)
     {
+        if (auto pCommands = getDeferredCommands())
+        {
+            pCommands->push_back({DeferredCommand::Type::BroadcastMessage, ComponentAction::Action::AddUpdate, nullptr, nullptr, messageId, pData});
+            return;
+        }
         for (auto& pEntity : m_entities)
         {
             pEntity->sendMessage(messageId, pData);
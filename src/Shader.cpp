@@ -9,12 +9,26 @@
 
 namespace onut
 {
-    Shader::VertexElement::VertexElement(uint32_t in_size, const std::string& in_semanticName)
+    Shader::VertexElement::VertexElement(uint32_t in_size, const std::string& in_semanticName, Format in_format)
         : size(in_size)
         , semanticName(in_semanticName)
+        , format(in_format)
     {
     }
 
+    uint32_t Shader::VertexElement::getByteSize() const
+    {
+        switch (format)
+        {
+            case Format::SNorm16:
+                return size * 2;
+            case Format::UNorm8:
+                return size;
+            default:
+                return size * 4;
+        }
+    }
+
     Shader::Shader()
     {
     }
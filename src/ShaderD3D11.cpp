@@ -331,26 +331,39 @@ namespace onut
                 std::unordered_map<std::string, UINT> semanticIndexes;
                 for (auto& element : vertexElements)
                 {
-                    DXGI_FORMAT format;
-                    switch (element.size)
+                    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+                    switch (element.format)
                     {
-                        case 1:
-                            format = DXGI_FORMAT_R32_FLOAT;
+                        case VertexElement::Format::Float:
+                            switch (element.size)
+                            {
+                                case 1:
+                                    format = DXGI_FORMAT_R32_FLOAT;
+                                    break;
+                                case 2:
+                                    format = DXGI_FORMAT_R32G32_FLOAT;
+                                    break;
+                                case 3:
+                                    format = DXGI_FORMAT_R32G32B32_FLOAT;
+                                    break;
+                                case 4:
+                                    format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+                                    break;
+                                default:
+                                    assert(false);
+                            }
                             break;
-                        case 2:
-                            format = DXGI_FORMAT_R32G32_FLOAT;
+                        case VertexElement::Format::SNorm16:
+                            assert(element.size == 2 || element.size == 4);
+                            format = element.size == 2 ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R16G16B16A16_SNORM;
                             break;
-                        case 3:
-                            format = DXGI_FORMAT_R32G32B32_FLOAT;
+                        case VertexElement::Format::UNorm8:
+                            assert(element.size == 4);
+                            format = DXGI_FORMAT_R8G8B8A8_UNORM;
                             break;
-                        case 4:
-                            format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-                            break;
-                        default:
-                            assert(false);
                     }
 
-                    pRet->m_vertexSize += element.size * 4;
+                    pRet->m_vertexSize += element.getByteSize();
                     
                     D3D11_INPUT_ELEMENT_DESC inputElement = {
                         element.semanticName.c_str(), semanticIndexes[element.semanticName], 
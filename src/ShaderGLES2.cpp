@@ -1,4 +1,4 @@
-#if defined(__linux__)
+#if defined(__linux__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/ContentManager.h>
 #include <onut/Files.h>
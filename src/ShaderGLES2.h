@@ -1,7 +1,7 @@
 #ifndef SHADERGLES2_H_INCLUDED
 #define SHADERGLES2_H_INCLUDED
 
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/Shader.h>
 
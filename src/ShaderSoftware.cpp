@@ -0,0 +1,127 @@
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/Files.h>
+
+// Private
+#include "ShaderSoftware.h"
+
+namespace onut
+{
+    OShaderRef Shader::createFromFile(const std::string& filename, const OContentManagerRef& pContentManager)
+    {
+        auto pRet = std::make_shared<OShaderSoftware>();
+        auto ext = onut::getExtension(filename);
+        if (ext == "VS")
+        {
+            pRet->m_type = Type::Vertex;
+            for (const auto& uniform : parseVertexShader(filename).uniforms)
+            {
+                pRet->m_uniformNames.push_back(uniform.name);
+            }
+        }
+        else
+        {
+            pRet->m_type = Type::Pixel;
+            for (const auto& uniform : parsePixelShader(filename).uniforms)
+            {
+                pRet->m_uniformNames.push_back(uniform.name);
+            }
+        }
+        return pRet;
+    }
+
+    OShaderRef Shader::createFromBinaryFile(const std::string& filename, Type in_type, const VertexElements& vertexElements)
+    {
+        auto pRet = std::make_shared<OShaderSoftware>();
+        pRet->m_type = in_type;
+        return pRet;
+    }
+
+    OShaderRef Shader::createFromSourceFile(const std::string& filename, Type in_type, const VertexElements& vertexElements)
+    {
+        auto pRet = std::make_shared<OShaderSoftware>();
+        pRet->m_type = in_type;
+        return pRet;
+    }
+
+    OShaderRef Shader::createFromBinaryData(const uint8_t* pData, uint32_t size, Type in_type, const VertexElements& vertexElements)
+    {
+        auto pRet = std::make_shared<OShaderSoftware>();
+        pRet->m_type = in_type;
+        return pRet;
+    }
+
+    OShaderRef Shader::createFromSource(const std::string& source, Type in_type, const VertexElements& vertexElements)
+    {
+        auto pRet = std::make_shared<OShaderSoftware>();
+        pRet->m_type = in_type;
+        return pRet;
+    }
+
+    ShaderSoftware::ShaderSoftware()
+    {
+    }
+
+    ShaderSoftware::~ShaderSoftware()
+    {
+    }
+
+    int ShaderSoftware::getUniformId(const std::string& varName) const
+    {
+        for (int i = 0; i < (int)m_uniformNames.size(); ++i)
+        {
+            if (m_uniformNames[i] == varName)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void ShaderSoftware::setFloat(int varId, float value)
+    {
+    }
+
+    void ShaderSoftware::setVector2(int varId, const Vector2& value)
+    {
+    }
+
+    void ShaderSoftware::setVector3(int varId, const Vector3& value)
+    {
+    }
+
+    void ShaderSoftware::setVector4(int varId, const Vector4& value)
+    {
+    }
+
+    void ShaderSoftware::setMatrix(int varId, const Matrix& value)
+    {
+    }
+
+    void ShaderSoftware::setFloat(const std::string& varName, float value)
+    {
+        setFloat(getUniformId(varName), value);
+    }
+
+    void ShaderSoftware::setVector2(const std::string& varName, const Vector2& value)
+    {
+        setVector2(getUniformId(varName), value);
+    }
+
+    void ShaderSoftware::setVector3(const std::string& varName, const Vector3& value)
+    {
+        setVector3(getUniformId(varName), value);
+    }
+
+    void ShaderSoftware::setVector4(const std::string& varName, const Vector4& value)
+    {
+        setVector4(getUniformId(varName), value);
+    }
+
+    void ShaderSoftware::setMatrix(const std::string& varName, const Matrix& value)
+    {
+        setMatrix(getUniformId(varName), value);
+    }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SHADERSOFTWARE_H_INCLUDED
+#define SHADERSOFTWARE_H_INCLUDED
+
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/Shader.h>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(ShaderSoftware)
+
+namespace onut
+{
+    /**
+    The software renderer only has the fixed 2D pipeline. Shaders are kept so content and
+    render states work the same, but they are not executed.
+    */
+    class ShaderSoftware final : public Shader
+    {
+    public:
+        ShaderSoftware();
+        ~ShaderSoftware();
+
+        int getUniformId(const std::string& varName) const override;
+        void setFloat(int varId, float value) override;
+        void setVector2(int varId, const Vector2& value) override;
+        void setVector3(int varId, const Vector3& value) override;
+        void setVector4(int varId, const Vector4& value) override;
+        void setMatrix(int varId, const Matrix& value) override;
+        void setFloat(const std::string& varName, float value) override;
+        void setVector2(const std::string& varName, const Vector2& value) override;
+        void setVector3(const std::string& varName, const Vector3& value) override;
+        void setVector4(const std::string& varName, const Vector4& value) override;
+        void setMatrix(const std::string& varName, const Matrix& value) override;
+
+    private:
+        friend class Shader;
+
+        std::vector<std::string> m_uniformNames;
+    };
+};
+
+#endif
+
+#endif
@@ -18,6 +18,39 @@ namespace onut
     {
         m_pSpriteAnim = pSpriteAnim;
         m_pSpriteAnimInstance = OMake<OSpriteAnimInstance>(m_pSpriteAnim);
+
+        // Frames change without notice, bound them all
+        m_hasFramesBounds = false;
+        if (m_pSpriteAnim)
+        {
+            Vector2 boundsMin, boundsMax;
+            for (const auto& animName : m_pSpriteAnim->getAnimNames())
+            {
+                auto pAnim = m_pSpriteAnim->getAnim(animName);
+                for (const auto& frame : pAnim->frames)
+                {
+                    if (!frame.pTexture) continue;
+                    auto sizef = frame.pTexture->getSizef();
+                    sizef.x *= std::abs(frame.UVs.z - frame.UVs.x);
+                    sizef.y *= std::abs(frame.UVs.w - frame.UVs.y);
+                    Vector2 frameMin(-sizef.x * frame.origin.x, -sizef.y * frame.origin.y);
+                    Vector2 frameMax = frameMin + sizef;
+                    if (m_hasFramesBounds)
+                    {
+                        boundsMin = Vector2::Min(boundsMin, frameMin);
+                        boundsMax = Vector2::Max(boundsMax, frameMax);
+                    }
+                    else
+                    {
+                        boundsMin = frameMin;
+                        boundsMax = frameMax;
+                        m_hasFramesBounds = true;
+                    }
+                }
+            }
+            m_framesBounds = Rect(boundsMin.x, boundsMin.y, boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y);
+        }
+        dirtyBounds();
     }
 
     const OSpriteAnimRef& SpriteAnimComponent::getSpriteAnim() const
@@ -28,6 +61,7 @@ namespace onut
     void SpriteAnimComponent::setScale(const Vector2& scale)
     {
         m_scale = scale;
+        dirtyBounds();
     }
 
     const Vector2& SpriteAnimComponent::getScale() const
@@ -90,6 +124,17 @@ namespace onut
         oSpriteBatch->drawSpriteWithUVs(pTexture, transform, Vector2(m_scale), uvs, m_color, origin);
     }
 
+    bool SpriteAnimComponent::getLocalBounds(Rect& localBounds) const
+    {
+        if (!m_hasFramesBounds) return false;
+        auto boundsMin = Vector2(m_framesBounds.x, m_framesBounds.y) * m_scale;
+        auto boundsMax = Vector2(m_framesBounds.x + m_framesBounds.z, m_framesBounds.y + m_framesBounds.w) * m_scale;
+        auto minCorner = Vector2::Min(boundsMin, boundsMax);
+        auto maxCorner = Vector2::Max(boundsMin, boundsMax);
+        localBounds = Rect(minCorner.x, minCorner.y, maxCorner.x - minCorner.x, maxCorner.y - minCorner.y);
+        return true;
+    }
+
     void SpriteAnimComponent::play(const std::string& animName, float framePerSecond)
     {
         if (m_pSpriteAnimInstance)
@@ -7,81 +7,221 @@
 #include <onut/VertexBuffer.h>
 
 // STL
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <vector>
+
+// Private
+#include "RadixSort.h"
+#include "SpriteLayers.h"
 
 OSpriteBatchRef oSpriteBatch;
 
 namespace onut
 {
-    OSpriteBatchRef SpriteBatch::create()
+    OSpriteBatchRef SpriteBatch::create(uint32_t maxSpriteCount, uint32_t ringSpriteCount, VertexFormat vertexFormat)
     {
-        return OMake<SpriteBatch>();
+        return OMake<SpriteBatch>(maxSpriteCount, ringSpriteCount, vertexFormat);
     }
 
-    SpriteBatch::SpriteBatch()
+    template<typename Tindex>
+    static OIndexBufferRef createQuadIndexBuffer(uint32_t spriteCount)
     {
+        std::vector<Tindex> indices(spriteCount * 6);
+        for (uint32_t i = 0; i < spriteCount; ++i)
+        {
+            indices[i * 6 + 0] = static_cast<Tindex>(i * 4 + 0);
+            indices[i * 6 + 1] = static_cast<Tindex>(i * 4 + 1);
+            indices[i * 6 + 2] = static_cast<Tindex>(i * 4 + 2);
+            indices[i * 6 + 3] = static_cast<Tindex>(i * 4 + 2);
+            indices[i * 6 + 4] = static_cast<Tindex>(i * 4 + 3);
+            indices[i * 6 + 5] = static_cast<Tindex>(i * 4 + 0);
+        }
+        return OIndexBuffer::createStatic(indices.data(), static_cast<uint32_t>(sizeof(Tindex) * indices.size()), sizeof(Tindex) * 8);
+    }
+
+    SpriteBatch::SpriteBatch(uint32_t maxSpriteCount, uint32_t ringSpriteCount, VertexFormat vertexFormat)
+        : m_vertexFormat(vertexFormat)
+        , m_maxSpriteCount(std::max<uint32_t>(1, maxSpriteCount))
+    {
+        if (m_maxSpriteCount * 4 > 0x10000 && oRenderer && !oRenderer->supports32BitIndices())
+        {
+            // Larger batches are split in draw calls that 16 bits indices can address
+            m_maxSpriteCount = 0x10000 / 4;
+        }
+        m_ringSpriteCount = std::max(m_maxSpriteCount, ringSpriteCount);
+        m_vertexSize = (m_vertexFormat == VertexFormat::Packed) ? sizeof(PackedVertex2D) : sizeof(SVertexP2T2C4);
+        m_pSpriteLayers = OMake<SpriteLayers>();
+
         // Create a white texture for rendering "without" texture
         unsigned char white[4] = {255, 255, 255, 255};
         m_pTexWhite = Texture::createFromData(white, {1, 1}, false);
 
-        // Create dynamic vertex buffer
-        m_pVertexBuffer = OVertexBuffer::createDynamic(sizeof(SVertexP2T2C4) * MAX_SPRITE_COUNT * 4);
+        // Create dynamic vertex buffer. Batches are streamed one after the other into it.
+        m_pVertexBuffer = OVertexBuffer::createDynamic(m_vertexSize * m_ringSpriteCount * 4);
 
-        // Create index buffer
-        unsigned short indices[MAX_SPRITE_COUNT * 6];
-        for (unsigned int i = 0; i < MAX_SPRITE_COUNT; ++i)
+        // Create index buffer. Each batch is drawn with a base vertex, so indices only have
+        // to cover one batch.
+        if (m_maxSpriteCount * 4 > 0x10000)
         {
-            indices[i * 6 + 0] = i * 4 + 0;
-            indices[i * 6 + 1] = i * 4 + 1;
-            indices[i * 6 + 2] = i * 4 + 2;
-            indices[i * 6 + 3] = i * 4 + 2;
-            indices[i * 6 + 4] = i * 4 + 3;
-            indices[i * 6 + 5] = i * 4 + 0;
+            m_pIndexBuffer = createQuadIndexBuffer<uint32_t>(m_maxSpriteCount);
+        }
+        else
+        {
+            m_pIndexBuffer = createQuadIndexBuffer<uint16_t>(m_maxSpriteCount);
         }
-        m_pIndexBuffer = OIndexBuffer::createStatic(indices, sizeof(indices));
     }
 
     SpriteBatch::~SpriteBatch()
     {
     }
 
-    void SpriteBatch::begin(BlendMode blendMode)
+    void SpriteBatch::begin(BlendMode blendMode, uint8_t sortMode)
     {
-        begin(Matrix::Identity, blendMode);
+        begin(Matrix::Identity, blendMode, sortMode);
     }
 
-    void SpriteBatch::begin(const Matrix& transform, BlendMode blendMode)
+    void SpriteBatch::begin(const Matrix& transform, BlendMode blendMode, uint8_t sortMode)
     {
         assert(!m_isDrawing); // Cannot call begin() twice without calling end()
 
-        oRenderer->setupFor2D(transform);
+        oRenderer->setupFor2D(transform, m_vertexFormat);
 
         m_currentTransform = transform;
         m_curBlendMode = blendMode;
+        m_sortMode = sortMode;
         m_pTexture = nullptr;
+        m_pBatchTexture = nullptr;
         m_isDrawing = true;
 
-        m_pMappedVertexBuffer = reinterpret_cast<SVertexP2T2C4*>(m_pVertexBuffer->map());
+        mapRegion();
+    }
+
+    void SpriteBatch::mapRegion()
+    {
+        // Not enough room left for a full batch, wrap around. This discards the buffer.
+        if (m_ringOffset + m_maxSpriteCount > m_ringSpriteCount)
+        {
+            m_ringOffset = 0;
+        }
+        m_pMappedVertexBuffer = reinterpret_cast<uint8_t*>(m_pVertexBuffer->mapRange(
+            m_vertexSize * m_ringOffset * 4,
+            m_vertexSize * m_maxSpriteCount * 4));
     }
 
     void SpriteBatch::changeBlendMode(BlendMode blendMode)
     {
         if (!isInBatch()) return;
         if (m_curBlendMode == blendMode) return;
-        end();
+        if (m_sortMode != SortMode::Immediate)
+        {
+            // Recorded per sprite
+            m_curBlendMode = blendMode;
+            return;
+        }
+        end(FlushReason::BlendChange);
         begin(m_currentTransform, blendMode);
     }
 
     void SpriteBatch::changeFiltering(sample::Filtering filtering)
     {
         if (m_curFiltering == filtering) return;
-        auto bManageBatch = isInBatch();
-        if (bManageBatch) end();
+        auto bManageBatch = isInBatch() && m_sortMode == SortMode::Immediate;
+        if (bManageBatch) end(FlushReason::FilteringChange);
         m_curFiltering = filtering;
         if (bManageBatch) begin(m_currentTransform, m_curBlendMode);
     }
 
+    SpriteBatch::SVertexP2T2C4* SpriteBatch::beginSprite()
+    {
+        if (m_sortMode == SortMode::Immediate)
+        {
+            if (m_vertexFormat == VertexFormat::Float)
+            {
+                m_pSpriteVertices = reinterpret_cast<SVertexP2T2C4*>(m_pMappedVertexBuffer) + (m_spriteCount * 4);
+            }
+            else
+            {
+                m_pSpriteVertices = m_spriteVertices;
+            }
+            return m_pSpriteVertices;
+        }
+        auto offset = m_deferredVertices.size();
+        m_deferredVertices.resize(offset + 4);
+        m_pSpriteVertices = m_deferredVertices.data() + offset;
+        return m_pSpriteVertices;
+    }
+
+    void SpriteBatch::endSprite()
+    {
+        // Packed textures use a region of their atlas page
+        if (m_isAtlased)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                auto& texCoord = m_pSpriteVertices[i].texCoord;
+                texCoord.x = m_atlasUVs.x + texCoord.x * (m_atlasUVs.z - m_atlasUVs.x);
+                texCoord.y = m_atlasUVs.y + texCoord.y * (m_atlasUVs.w - m_atlasUVs.y);
+            }
+        }
+
+        if (m_sortMode == SortMode::Immediate)
+        {
+            if (m_vertexFormat == VertexFormat::Packed)
+            {
+                writeSprite(m_pSpriteVertices);
+            }
+            ++m_spriteCount;
+            if (m_spriteCount == m_maxSpriteCount)
+            {
+                flushBatch(FlushReason::BufferFull);
+            }
+            return;
+        }
+
+        // Key, from most to least significant: draw index, layer, blend, filtering, texture.
+        // Bits for the modes not requested stay at 0 so the stable sort keeps submission order.
+        uint64_t key = 0;
+        if (m_sortMode & SortMode::DrawIndex)
+        {
+            key |= static_cast<uint64_t>(static_cast<uint32_t>(m_drawIndex) ^ 0x80000000) << 32;
+        }
+        if (m_sortMode & SortMode::Texture)
+        {
+            Vector4 bounds(m_pSpriteVertices[0].position.x, m_pSpriteVertices[0].position.y,
+                           m_pSpriteVertices[0].position.x, m_pSpriteVertices[0].position.y);
+            for (int i = 1; i < 4; ++i)
+            {
+                const auto& position = m_pSpriteVertices[i].position;
+                bounds.x = std::min(bounds.x, position.x);
+                bounds.y = std::min(bounds.y, position.y);
+                bounds.z = std::max(bounds.z, position.x);
+                bounds.w = std::max(bounds.w, position.y);
+            }
+            auto state = m_textureIndex |
+                (static_cast<uint32_t>(m_curBlendMode) << 28) |
+                (static_cast<uint32_t>(m_curFiltering) << 27);
+            auto group = (m_sortMode & SortMode::DrawIndex) ? m_drawIndex : 0;
+            auto layer = m_pSpriteLayers->add(group, bounds, state);
+            key |= static_cast<uint64_t>(layer) << 20;
+
+            // Past those, sprites stay in submission order
+            if (layer < SpriteLayers::MAX_LAYER && m_textureIndex <= 0xFFFF)
+            {
+                key |= static_cast<uint64_t>(m_curBlendMode) << 17;
+                key |= static_cast<uint64_t>(m_curFiltering) << 16;
+                key |= static_cast<uint64_t>(m_textureIndex);
+            }
+        }
+        auto spriteIndex = static_cast<uint32_t>(m_spriteCommands.size());
+        m_spriteCommands.push_back({key, spriteIndex});
+
+        // State is also needed at submission, even when it's not part of the key
+        m_spriteStates.push_back({m_textureIndex, m_curBlendMode, m_curFiltering});
+    }
+
     void SpriteBatch::drawRectWithColors(const OTextureRef& pTexture, const Rect& rect, const std::vector<Color>& colors)
     {
         assert(m_isDrawing); // Should call begin() before calling draw()
@@ -89,7 +229,7 @@ namespace onut
 
         changeTexture(pTexture);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = {rect.x, rect.y};
         pVerts[0].texCoord = {0, 0};
         pVerts[0].color = colors[0];
@@ -106,12 +246,7 @@ namespace onut
         pVerts[3].texCoord = {1, 0};
         pVerts[3].color = colors[3];
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawAbsoluteRect(const OTextureRef& pTexture, const Rect& rect, const Color& color)
@@ -135,7 +270,7 @@ namespace onut
 
         changeTexture(pTexture);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = {rect.x, rect.y};
         pVerts[0].texCoord = {0, 0};
         pVerts[0].color = color;
@@ -152,12 +287,7 @@ namespace onut
         pVerts[3].texCoord = {1, 0};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawRectScaled9(const OTextureRef& pTexture, const Rect& rect, const Vector4& padding, const Color& color)
@@ -286,7 +416,7 @@ namespace onut
 
         changeTexture(pTexture);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = {rect.x, rect.y};
         pVerts[0].texCoord = {0, 0};
         pVerts[0].color = color;
@@ -303,12 +433,7 @@ namespace onut
         pVerts[3].texCoord = {1, 0};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawRectWithUVs(const OTextureRef& pTexture, const Rect& rect, const Vector4& uvs, const Color& color)
@@ -317,7 +442,7 @@ namespace onut
 
         changeTexture(pTexture);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = {rect.x, rect.y};
         pVerts[0].texCoord = {uvs.x, uvs.y};
         pVerts[0].color = color;
@@ -334,12 +459,7 @@ namespace onut
         pVerts[3].texCoord = {uvs.z, uvs.y};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawRectWithUVsColors(const OTextureRef& pTexture, const Rect& rect, const Vector4& uvs, const std::vector<Color>& colors)
@@ -349,7 +469,7 @@ namespace onut
 
         changeTexture(pTexture);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = {rect.x, rect.y};
         pVerts[0].texCoord = {uvs.x, uvs.y};
         pVerts[0].color = colors[0];
@@ -366,24 +486,41 @@ namespace onut
         pVerts[3].texCoord = {uvs.z, uvs.y};
         pVerts[3].color = colors[3];
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::changeTexture(const OTextureRef& pTexture)
     {
-        if (!pTexture && m_pTexture == m_pTexWhite) return;
-        if (pTexture != m_pTexture)
+        const auto& pNewTexture = pTexture ? pTexture : m_pTexWhite;
+        if (pNewTexture == m_pTexture) return;
+
+        // Textures sharing an atlas page don't break the batch
+        m_isAtlased = pNewTexture->isAtlased();
+        m_atlasUVs = pNewTexture->getAtlasUVs();
+        const auto& pNewBatchTexture = m_isAtlased ? pNewTexture->getAtlasPage() : pNewTexture;
+        if (pNewBatchTexture != m_pBatchTexture)
         {
-            flush();
-            if (!pTexture) m_pTexture = m_pTexWhite;
-            else m_pTexture = pTexture;
+            if (m_sortMode == SortMode::Immediate)
+            {
+                flushBatch(FlushReason::TextureChange);
+            }
+            else
+            {
+                auto it = m_deferredTextureIndices.find(pNewBatchTexture.get());
+                if (it == m_deferredTextureIndices.end())
+                {
+                    m_textureIndex = static_cast<uint32_t>(m_deferredTextures.size());
+                    m_deferredTextureIndices[pNewBatchTexture.get()] = m_textureIndex;
+                    m_deferredTextures.push_back(pNewBatchTexture);
+                }
+                else
+                {
+                    m_textureIndex = it->second;
+                }
+            }
+            m_pBatchTexture = pNewBatchTexture;
         }
-        if (!m_pTexture) m_pTexture = m_pTexWhite;
+        m_pTexture = pNewTexture;
     }
 
     void SpriteBatch::draw4Corner(const OTextureRef& pTexture, const Rect& rect, const Color& color)
@@ -417,7 +554,7 @@ namespace onut
 
         auto invOrigin = Vector2(1.f - origin.x, 1.f - origin.y);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = Vector2::Transform(Vector2(-sizef.x * origin.x, -sizef.y * origin.y), transform);
         pVerts[0].texCoord = {0, 0};
         pVerts[0].color = color;
@@ -434,12 +571,7 @@ namespace onut
         pVerts[3].texCoord = {1, 0};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
     void SpriteBatch::drawSprite(const OTextureRef& pTexture, const Matrix& transform, const Vector2& scale, const Color& color, const Vector2& origin)
     {
@@ -448,7 +580,7 @@ namespace onut
 
         auto invOrigin = Vector2(1.f - origin.x, 1.f - origin.y);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = Vector2::Transform(Vector2(-sizef.x * origin.x, -sizef.y * origin.y), transform);
         pVerts[0].texCoord = {0, 0};
         pVerts[0].color = color;
@@ -465,12 +597,7 @@ namespace onut
         pVerts[3].texCoord = {1, 0};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawSpriteWithUVs(const OTextureRef& pTexture, const Matrix& transform, const Vector4& uvs, const Color& color, const Vector2& origin)
@@ -482,7 +609,7 @@ namespace onut
 
         auto invOrigin = Vector2(1.f - origin.x, 1.f - origin.y);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = Vector2::Transform(Vector2(-sizef.x * origin.x, -sizef.y * origin.y), transform);
         pVerts[0].texCoord = {uvs.x, uvs.y};
         pVerts[0].color = color;
@@ -499,12 +626,7 @@ namespace onut
         pVerts[3].texCoord = {uvs.z, uvs.y};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawSpriteWithUVs(const OTextureRef& pTexture, const Matrix& transform, const Vector2& scale, const Vector4& uvs, const Color& color, const Vector2& origin)
@@ -518,7 +640,7 @@ namespace onut
 
         auto invOrigin = Vector2(1.f - origin.x, 1.f - origin.y);
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = Vector2::Transform(Vector2(-sizef.x * origin.x, -sizef.y * origin.y), transform);
         pVerts[0].texCoord = {uvs.x, uvs.y};
         pVerts[0].color = color;
@@ -535,12 +657,7 @@ namespace onut
         pVerts[3].texCoord = {uvs.z, uvs.y};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawSpriteWithUVs(const OTextureRef& pTexture, const Vector2& position, const Vector4& uvs, const Color& color, float rotation, float scale, const Vector2& origin)
@@ -560,7 +677,7 @@ namespace onut
         Vector2 right{cosTheta * hSize.x, sinTheta * hSize.x};
         Vector2 down{-sinTheta * hSize.y, cosTheta * hSize.y};
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = position;
         pVerts[0].position -= right * origin.x * 2.f;
         pVerts[0].position -= down * origin.y * 2.f;
@@ -585,12 +702,7 @@ namespace onut
         pVerts[3].texCoord = {uvs.z, uvs.y};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawBeam(const OTextureRef& pTexture, const Vector2& from, const Vector2& to, float size, const Color& color, float uOffset, float uScale)
@@ -605,7 +717,7 @@ namespace onut
         Vector2 right{-dir.y, dir.x};
         right *= size * .5f;
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = Vector2(from.x - right.x, from.y - right.y);
         pVerts[0].texCoord = {uOffset, 0};
         pVerts[0].color = color;
@@ -622,12 +734,7 @@ namespace onut
         pVerts[3].texCoord = {uOffset + len * uScale / texSize.x, 0};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
-
-        if (m_spriteCount == MAX_SPRITE_COUNT)
-        {
-            flush();
-        }
+        endSprite();
     }
 
     void SpriteBatch::drawCross(const Vector2& position, float size, const Color& color, float thickness)
@@ -652,7 +759,7 @@ namespace onut
         Vector2 right{cosTheta * hSize.x, sinTheta * hSize.x};
         Vector2 down{-sinTheta * hSize.y, cosTheta * hSize.y};
 
-        SVertexP2T2C4* pVerts = m_pMappedVertexBuffer + (m_spriteCount * 4);
+        SVertexP2T2C4* pVerts = beginSprite();
         pVerts[0].position = position;
         pVerts[0].position -= right * origin.x * 2.f;
         pVerts[0].position -= down * origin.y * 2.f;
@@ -677,46 +784,162 @@ namespace onut
         pVerts[3].texCoord = {1, 0};
         pVerts[3].color = color;
 
-        ++m_spriteCount;
+        endSprite();
+    }
 
-        if (m_spriteCount == MAX_SPRITE_COUNT)
+    void SpriteBatch::drawQuads(const OTextureRef& pTexture, const SVertexP2T2C4* pVertices, uint32_t quadCount)
+    {
+        assert(m_isDrawing); // Should call begin() before calling draw()
+
+        changeTexture(pTexture);
+
+        if (m_sortMode == SortMode::Immediate && m_vertexFormat == VertexFormat::Float && !m_isAtlased)
+        {
+            while (quadCount)
+            {
+                auto count = std::min(quadCount, m_maxSpriteCount - m_spriteCount);
+                memcpy(m_pMappedVertexBuffer + m_vertexSize * m_spriteCount * 4, pVertices, sizeof(SVertexP2T2C4) * 4 * count);
+                pVertices += count * 4;
+                quadCount -= count;
+                m_spriteCount += count;
+                if (m_spriteCount == m_maxSpriteCount)
+                {
+                    flushBatch(FlushReason::BufferFull);
+                    changeTexture(pTexture); // The flush unbinds it
+                }
+            }
+            return;
+        }
+
+        for (uint32_t i = 0; i < quadCount; ++i, pVertices += 4)
         {
-            flush();
+            auto pVerts = beginSprite();
+            std::copy(pVertices, pVertices + 4, pVerts);
+            endSprite();
+            if (!m_pTexture) changeTexture(pTexture); // A full batch was flushed
         }
     }
 
     void SpriteBatch::end()
+    {
+        end(FlushReason::Explicit);
+    }
+
+    void SpriteBatch::end(FlushReason reason)
     {
         assert(m_isDrawing); // Should call begin() before calling end()
 
+        if (m_sortMode != SortMode::Immediate)
+        {
+            submitDeferred(reason);
+        }
         m_isDrawing = false;
         if (m_spriteCount)
         {
-            flush();
+            flushBatch(reason);
         }
 
-        m_pVertexBuffer->unmap(sizeof(SVertexP2T2C4) * m_spriteCount * 4);
+        m_pVertexBuffer->unmapRange(m_vertexSize * m_ringOffset * 4, 0);
     }
 
     void SpriteBatch::flush()
+    {
+        if (m_sortMode != SortMode::Immediate)
+        {
+            // Acts as a sorting barrier, what was recorded so far is drawn
+            submitDeferred(FlushReason::Explicit);
+        }
+        flushBatch(FlushReason::Explicit);
+    }
+
+    void SpriteBatch::submitDeferred(FlushReason reason)
+    {
+        if (m_spriteCommands.empty()) return;
+
+        radixSort(m_spriteCommands, m_sortScratch, [](const SpriteCommand& command) { return command.key; });
+
+        // Replay in sorted order, breaking batches only on state changes
+        auto userBlendMode = m_curBlendMode;
+        auto userFiltering = m_curFiltering;
+
+        m_pTexture = nullptr;
+        m_pBatchTexture = nullptr;
+        for (const auto& command : m_spriteCommands)
+        {
+            const auto& state = m_spriteStates[command.spriteIndex];
+            const auto& pTexture = m_deferredTextures[state.textureIndex];
+            if (m_spriteCount)
+            {
+                if (pTexture != m_pBatchTexture) flushBatch(FlushReason::TextureChange);
+                else if (state.blendMode != m_curBlendMode) flushBatch(FlushReason::BlendChange);
+                else if (state.filtering != m_curFiltering) flushBatch(FlushReason::FilteringChange);
+            }
+            m_pBatchTexture = pTexture;
+            m_curBlendMode = state.blendMode;
+            m_curFiltering = state.filtering;
+
+            writeSprite(m_deferredVertices.data() + (command.spriteIndex * 4));
+            ++m_spriteCount;
+            if (m_spriteCount == m_maxSpriteCount)
+            {
+                flushBatch(FlushReason::BufferFull);
+            }
+        }
+        flushBatch(reason); // This also resets the textures, so they will be registered again on next draw
+
+        m_curBlendMode = userBlendMode;
+        m_curFiltering = userFiltering;
+
+        m_spriteCommands.clear();
+        m_spriteStates.clear();
+        m_pSpriteLayers->clear();
+        m_deferredVertices.clear();
+        m_deferredTextures.clear();
+        m_deferredTextureIndices.clear();
+    }
+
+    void SpriteBatch::writeSprite(const SVertexP2T2C4* pVerts)
+    {
+        auto pDst = m_pMappedVertexBuffer + m_vertexSize * m_spriteCount * 4;
+        if (m_vertexFormat == VertexFormat::Packed)
+        {
+            auto pPackedVerts = reinterpret_cast<PackedVertex2D*>(pDst);
+            for (int i = 0; i < 4; ++i)
+            {
+                pPackedVerts[i].set(pVerts[i].position, pVerts[i].texCoord, pVerts[i].color);
+            }
+        }
+        else
+        {
+            memcpy(pDst, pVerts, sizeof(SVertexP2T2C4) * 4);
+        }
+    }
+
+    void SpriteBatch::flushBatch(FlushReason reason)
     {
         if (!m_spriteCount)
         {
             return; // Nothing to flush
         }
-        m_pVertexBuffer->unmap(sizeof(SVertexP2T2C4) * m_spriteCount * 4);
+        m_pVertexBuffer->unmapRange(m_vertexSize * m_ringOffset * 4, m_vertexSize * m_spriteCount * 4);
+        m_uploadedBytes += m_vertexSize * m_spriteCount * 4;
 
-        oRenderer->renderStates.textures[0] = m_pTexture;
+        oRenderer->renderStates.textures[0] = m_pBatchTexture;
         oRenderer->renderStates.blendMode = m_curBlendMode;
         oRenderer->renderStates.sampleFiltering = m_curFiltering;
         oRenderer->renderStates.primitiveMode = OPrimitiveTriangleList;
         oRenderer->renderStates.indexBuffer = m_pIndexBuffer;
         oRenderer->renderStates.vertexBuffer = m_pVertexBuffer;
-        oRenderer->drawIndexed(6 * m_spriteCount);
+        oRenderer->drawIndexed(6 * m_spriteCount, m_ringOffset * 4);
+        ++m_flushCount;
+        oRenderer->getStats().onFlush(reason);
 
-        m_pMappedVertexBuffer = reinterpret_cast<SVertexP2T2C4*>(m_pVertexBuffer->map());
+        // Move on to the next free region of the ring
+        m_ringOffset += m_spriteCount;
+        mapRegion();
 
         m_spriteCount = 0;
         m_pTexture = nullptr;
+        m_pBatchTexture = nullptr;
     }
 }
@@ -14,6 +14,7 @@ namespace onut
     void SpriteComponent::setTexture(const OTextureRef& pTexture)
     {
         m_pTexture = pTexture;
+        dirtyBounds();
     }
 
     const OTextureRef& SpriteComponent::getTexture() const
@@ -24,6 +25,7 @@ namespace onut
     void SpriteComponent::setScale(const Vector2& scale)
     {
         m_scale = scale;
+        dirtyBounds();
     }
 
     const Vector2& SpriteComponent::getScale() const
@@ -44,6 +46,7 @@ namespace onut
     void SpriteComponent::setOrigin(const Vector2& origin)
     {
         m_origin = origin;
+        dirtyBounds();
     }
 
     const Vector2& SpriteComponent::getOrigin() const
@@ -56,4 +59,15 @@ namespace onut
         auto& transform = getEntity()->getWorldTransform();
         oSpriteBatch->drawSprite(m_pTexture, transform, Vector2(m_scale), m_color, m_origin);
     }
+
+    bool SpriteComponent::getLocalBounds(Rect& localBounds) const
+    {
+        // No texture draws a 1x1 white sprite
+        auto sizef = (m_pTexture ? m_pTexture->getSizef() : Vector2(1.f)) * m_scale;
+        auto topLeft = Vector2(-sizef.x * m_origin.x, -sizef.y * m_origin.y);
+        auto minCorner = Vector2::Min(topLeft, topLeft + sizef);
+        auto maxCorner = Vector2::Max(topLeft, topLeft + sizef);
+        localBounds = Rect(minCorner.x, minCorner.y, maxCorner.x - minCorner.x, maxCorner.y - minCorner.y);
+        return true;
+    }
 };
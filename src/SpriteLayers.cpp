@@ -0,0 +1,107 @@
+// Private
+#include "SpriteLayers.h"
+
+// STL
+#include <algorithm>
+#include <cmath>
+
+namespace onut
+{
+    const uint32_t SpriteLayers::MAX_LAYER;
+
+    static int getCell(float position)
+    {
+        // Far away sprites share the border cells, they are only kept apart less often
+        auto cell = std::floor(position / static_cast<float>(SpriteLayers::CELL_SIZE));
+        return static_cast<int>(std::min(std::max(cell, -1000000.f), 1000000.f));
+    }
+
+    uint32_t SpriteLayers::getLayerAbove(const Layer& layer, uint32_t state)
+    {
+        // MIXED_STATE never matches, one of those sprites has another state
+        return layer.layer + (layer.state == state ? 0 : 1);
+    }
+
+    void SpriteLayers::merge(Layer& layer, uint32_t newLayer, uint32_t state)
+    {
+        if (newLayer > layer.layer)
+        {
+            layer.layer = newLayer;
+            layer.state = state;
+        }
+        else if (newLayer == layer.layer && layer.state != state)
+        {
+            layer.state = MIXED_STATE;
+        }
+    }
+
+    uint32_t SpriteLayers::add(int group, const Vector4& bounds, uint32_t state)
+    {
+        auto left = getCell(std::min(bounds.x, bounds.z));
+        auto top = getCell(std::min(bounds.y, bounds.w));
+        auto right = getCell(std::max(bounds.x, bounds.z));
+        auto bottom = getCell(std::max(bounds.y, bounds.w));
+        auto isBig = static_cast<int64_t>(right - left + 1) * static_cast<int64_t>(bottom - top + 1) > MAX_CELLS;
+        auto groupKey = static_cast<uint64_t>(static_cast<uint32_t>(group)) * 0x9E3779B97F4A7C15ull;
+        auto getCellKey = [groupKey](int x, int y)
+        {
+            return groupKey ^ ((static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y));
+        };
+
+        auto it = m_groups.find(group);
+        auto isFirst = it == m_groups.end();
+        if (isFirst) it = m_groups.insert({group, Group()}).first;
+        auto& groupLayers = it->second;
+
+        // Above everything it might overlap
+        uint32_t layer = 0;
+        if (!isFirst)
+        {
+            if (isBig)
+            {
+                layer = getLayerAbove(groupLayers.all, state);
+            }
+            else
+            {
+                if (groupLayers.hasBig) layer = getLayerAbove(groupLayers.big, state);
+                for (auto y = top; y <= bottom; ++y)
+                {
+                    for (auto x = left; x <= right; ++x)
+                    {
+                        auto cellIt = m_cells.find(getCellKey(x, y));
+                        if (cellIt != m_cells.end()) layer = std::max(layer, getLayerAbove(cellIt->second, state));
+                    }
+                }
+            }
+            layer = std::min(layer, MAX_LAYER);
+        }
+
+        if (isFirst) groupLayers.all = {layer, state};
+        else merge(groupLayers.all, layer, state);
+        if (isBig)
+        {
+            if (groupLayers.hasBig) merge(groupLayers.big, layer, state);
+            else groupLayers.big = {layer, state};
+            groupLayers.hasBig = true;
+        }
+        else
+        {
+            for (auto y = top; y <= bottom; ++y)
+            {
+                for (auto x = left; x <= right; ++x)
+                {
+                    auto cellIt = m_cells.find(getCellKey(x, y));
+                    if (cellIt == m_cells.end()) m_cells[getCellKey(x, y)] = {layer, state};
+                    else merge(cellIt->second, layer, state);
+                }
+            }
+        }
+        return layer;
+    }
+
+    void SpriteLayers::clear()
+    {
+        m_groups.clear();
+        m_cells.clear();
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SPRITELAYERS_H_INCLUDED
+#define SPRITELAYERS_H_INCLUDED
+
+// Onut
+#include <onut/Maths.h>
+
+// STL
+#include <cinttypes>
+#include <unordered_map>
+
+namespace onut
+{
+    /**
+    Tells SpriteBatch which sprites it can reorder when grouping them by state.
+    Each sprite gets a layer above the earlier sprites it overlaps that have another state, and not below
+    the ones with its state. Sorting by layer, then state, then submission keeps every overlapping pair in
+    submission order. Overlaps are tested on a grid, so sprites close to each other can be kept apart.
+    Sprites covering many cells are considered to overlap everything.
+    */
+    class SpriteLayers final
+    {
+    public:
+        static const uint32_t MAX_LAYER = 0xFFF; // Sprites are not grouped by state on that one
+        static const int CELL_SIZE = 64;
+        static const int MAX_CELLS = 16;
+
+        /**
+        @param group Sprites of different groups are never reordered between each other, like draw indices
+        @param bounds left, top, right, bottom
+        @param state Texture, blend and filtering of the sprite, equal when they can be drawn together
+        @return the layer of the sprite, up to MAX_LAYER
+        */
+        uint32_t add(int group, const Vector4& bounds, uint32_t state);
+
+        void clear();
+
+    private:
+        static const uint32_t MIXED_STATE = 0xFFFFFFFF;
+
+        // Highest layer of some sprites, and their state if they all share it
+        struct Layer
+        {
+            uint32_t layer;
+            uint32_t state;
+        };
+
+        struct Group
+        {
+            Layer all; // Every sprite
+            Layer big; // Sprites too big for the cells
+            bool hasBig = false;
+        };
+
+        static uint32_t getLayerAbove(const Layer& layer, uint32_t state);
+        static void merge(Layer& layer, uint32_t newLayer, uint32_t state);
+
+        std::unordered_map<int, Group> m_groups;
+        std::unordered_map<uint64_t, Layer> m_cells; // By group and cell, collisions only add layers
+    };
+}
+
+#endif
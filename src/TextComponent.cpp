@@ -56,7 +56,8 @@ namespace onut
         auto& transform = getEntity()->getWorldTransform();
         oSpriteBatch->end();
         oSpriteBatch->begin(transform);
-        m_pFont->draw(m_text, Vector2::Zero, m_origin, m_color);
+        m_layout.set(m_pFont, m_text);
+        m_layout.draw(Vector2::Zero, m_origin, m_color);
         oSpriteBatch->end();
         oSpriteBatch->begin();
     }
@@ -0,0 +1,144 @@
+// Onut
+#include <onut/Font.h>
+#include <onut/SpriteBatch.h>
+#include <onut/TextLayout.h>
+#include <onut/Texture.h>
+
+namespace onut
+{
+    bool TextLayout::set(const OFontRef& pFont, const std::string& text)
+    {
+        if (pFont == m_pFont && text == m_text) return false;
+
+        m_pFont = pFont;
+        m_text = text;
+        m_glyphs.clear();
+        m_size = Vector2::Zero;
+        if (!m_pFont) return true;
+
+        m_size = m_pFont->measure(m_text);
+
+        const auto& common = m_pFont->m_common;
+        auto scaleW = static_cast<float>(common.scaleW);
+        auto scaleH = static_cast<float>(common.scaleH);
+        Vector2 curPos;
+        bool isCodeColored = false;
+        Vector3 codeColor;
+        unsigned int len = m_text.length();
+        for (unsigned int i = 0; i < len; )
+        {
+            char charId = m_text[i];
+            if (charId == '\n')
+            {
+                curPos.x = 0.f;
+                curPos.y += static_cast<float>(common.lineHeight);
+                i += 1;
+                continue;
+            }
+            if (charId == '^' && i + 3 < len)
+            {
+                // Colored text!
+                codeColor.x = (static_cast<float>(m_text[i + 1]) - static_cast<float>('0')) / 9.0f;
+                codeColor.y = (static_cast<float>(m_text[i + 2]) - static_cast<float>('0')) / 9.0f;
+                codeColor.z = (static_cast<float>(m_text[i + 3]) - static_cast<float>('0')) / 9.0f;
+                isCodeColored = true;
+                i += 4;
+                continue;
+            }
+            auto pDatChar = m_pFont->getGlyph(static_cast<int>(static_cast<unsigned char>(charId)));
+            if (!pDatChar)
+            {
+                ++i;
+                continue;
+            }
+
+            Glyph glyph;
+            glyph.rect = {
+                curPos.x + static_cast<float>(pDatChar->xoffset), curPos.y + static_cast<float>(pDatChar->yoffset),
+                static_cast<float>(pDatChar->width), static_cast<float>(pDatChar->height)
+            };
+            glyph.UVs = {
+                static_cast<float>(pDatChar->x) / scaleW,
+                static_cast<float>(pDatChar->y) / scaleH,
+                static_cast<float>(pDatChar->x + pDatChar->width) / scaleW,
+                static_cast<float>(pDatChar->y + pDatChar->height) / scaleH
+            };
+            glyph.page = pDatChar->page;
+            glyph.isCodeColored = isCodeColored;
+            glyph.codeColor = codeColor;
+            m_glyphs.push_back(glyph);
+
+            curPos.x += static_cast<float>(pDatChar->xadvance);
+            ++i;
+        }
+
+        return true;
+    }
+
+    Rect TextLayout::draw(const Vector2& in_pos, const Vector2& align, const Color& color, bool snapPixels, const OSpriteBatchRef& in_pSpriteBatch) const
+    {
+        if (!m_pFont) return Rect(in_pos, Vector2::Zero);
+
+        OSpriteBatchRef pSpriteBatch = in_pSpriteBatch;
+        if (!pSpriteBatch) pSpriteBatch = oSpriteBatch;
+
+        const auto& common = m_pFont->m_common;
+        Vector2 posFrom = {in_pos.x, in_pos.y - (common.lineHeight - common.base)};
+        Vector2 posTo = {in_pos.x - m_size.x, in_pos.y - m_size.y + (common.lineHeight - common.base)};
+
+        Vector2 pos;
+        pos.x = posFrom.x + (posTo.x - posFrom.x) * align.x;
+        pos.y = posFrom.y + (posTo.y - posFrom.y) * align.y;
+        if (snapPixels)
+        {
+            pos = {std::round(pos.x), std::round(pos.y)};
+        }
+
+        m_vertices.resize(m_glyphs.size() * 4);
+        auto pVerts = m_vertices.data();
+        for (const auto& glyph : m_glyphs)
+        {
+            Color glyphColor = color;
+            if (glyph.isCodeColored)
+            {
+                glyphColor = {glyph.codeColor.x, glyph.codeColor.y, glyph.codeColor.z, color.a};
+                glyphColor.Premultiply();
+            }
+            Rect rect(pos.x + glyph.rect.x, pos.y + glyph.rect.y, glyph.rect.z, glyph.rect.w);
+
+            pVerts[0].position = {rect.x, rect.y};
+            pVerts[0].texCoord = {glyph.UVs.x, glyph.UVs.y};
+            pVerts[0].color = glyphColor;
+
+            pVerts[1].position = {rect.x, rect.y + rect.w};
+            pVerts[1].texCoord = {glyph.UVs.x, glyph.UVs.w};
+            pVerts[1].color = glyphColor;
+
+            pVerts[2].position = {rect.x + rect.z, rect.y + rect.w};
+            pVerts[2].texCoord = {glyph.UVs.z, glyph.UVs.w};
+            pVerts[2].color = glyphColor;
+
+            pVerts[3].position = {rect.x + rect.z, rect.y};
+            pVerts[3].texCoord = {glyph.UVs.z, glyph.UVs.y};
+            pVerts[3].color = glyphColor;
+
+            pVerts += 4;
+        }
+
+        // One call per run of glyphs on the same page
+        bool bHandleBatch = !pSpriteBatch->isInBatch();
+        if (bHandleBatch) pSpriteBatch->begin();
+        size_t runStart = 0;
+        for (size_t i = 1; i <= m_glyphs.size(); ++i)
+        {
+            if (i == m_glyphs.size() || m_glyphs[i].page != m_glyphs[runStart].page)
+            {
+                pSpriteBatch->drawQuads(m_pFont->m_pages[m_glyphs[runStart].page]->pTexture, m_vertices.data() + runStart * 4, static_cast<uint32_t>(i - runStart));
+                runStart = i;
+            }
+        }
+        if (bHandleBatch) pSpriteBatch->end();
+
+        return Rect(pos, m_size);
+    }
+}
@@ -37,6 +37,8 @@ namespace onut
     void Texture::bind(int slot)
     {
         assert(slot >= 0 && slot < RenderStates::MAX_TEXTURES);
+        // Its UVs would have to be remapped to the page. Only the batches know to do that.
+        assert(!m_pAtlasPage && "Packed textures can't be bound, draw them with SpriteBatch, PrimitiveBatch or TiledMap");
         oRenderer->renderStates.textures[slot] = shared_from_this();
     }
 }
@@ -0,0 +1,302 @@
+// Onut
+#include <onut/Dispatcher.h>
+#include <onut/Texture.h>
+#include <onut/TextureAtlas.h>
+
+// STL
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace onut
+{
+    // Region of an atlas page. It has no GPU resource of its own, it is drawn from the page.
+    class AtlasTexture final : public Texture
+    {
+    public:
+        AtlasTexture(const OTextureAtlasRef& pAtlas, size_t pageIndex, const Point& position, const Vector4& uvs, const Point& size)
+            : m_pAtlas(pAtlas)
+            , m_pageIndex(pageIndex)
+            , m_position(position)
+        {
+            m_pAtlasPage = pAtlas->m_pages[pageIndex].pTexture;
+            m_atlasUVs = uvs;
+            m_size = size;
+            m_type = Type::Static;
+        }
+
+        void setData(const uint8_t* pData) override
+        {
+            auto pAtlas = m_pAtlas.lock();
+            if (pAtlas) pAtlas->setData(m_pageIndex, m_position, m_size, pData);
+        }
+
+        void setSubData(const uint8_t* /* pData */, const iRect& /* rect */) override { assert(isDynamic()); }
+
+        // Packed textures are never render targets, like other static textures
+        void clearRenderTarget(const Color& /* color */) override { assert(isRenderTarget()); }
+        void resizeTarget(const Point& /* size */) override { assert(isRenderTarget()); }
+        void blur(float /* amount */) override {}
+        void sepia(const Vector3& /* tone */, float /* saturation */, float /* sepiaAmount */) override {}
+        void crt() override {}
+        void cartoon(const Vector3& /* tone */) override {}
+        void vignette(float /* amount */) override {}
+
+    private:
+        std::weak_ptr<TextureAtlas> m_pAtlas;
+        size_t m_pageIndex;
+        Point m_position; // Of the padded region
+    };
+
+    SkylinePacker::SkylinePacker(const Point& size, int padding)
+        : m_size(size)
+        , m_padding(std::max(0, padding))
+    {
+        m_skyline.push_back({0, 0, size.x});
+    }
+
+    bool SkylinePacker::find(const Point& in_size, Placement& placement) const
+    {
+        Point size(in_size.x + m_padding * 2, in_size.y + m_padding * 2);
+        bool found = false;
+        for (size_t i = 0; i < m_skyline.size(); ++i)
+        {
+            int x = m_skyline[i].x;
+            if (x + size.x > m_size.x) break;
+
+            // Rest on the highest node spanned
+            int y = 0;
+            int widthLeft = size.x;
+            for (size_t j = i; widthLeft > 0; ++j)
+            {
+                y = std::max(y, m_skyline[j].y);
+                widthLeft -= m_skyline[j].width;
+            }
+            if (y + size.y > m_size.y) continue;
+
+            int bottom = y + size.y;
+            if (bottom < placement.bottom || (bottom == placement.bottom && m_skyline[i].width < placement.width))
+            {
+                placement.bottom = bottom;
+                placement.width = m_skyline[i].width;
+                placement.nodeIndex = i;
+                placement.position = Point(x, y);
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    void SkylinePacker::place(const Point& in_size, const Placement& placement)
+    {
+        Point size(in_size.x + m_padding * 2, in_size.y + m_padding * 2);
+        const auto& position = placement.position;
+        auto nodeIndex = placement.nodeIndex;
+        m_skyline.insert(m_skyline.begin() + nodeIndex, {position.x, position.y + size.y, size.x});
+
+        // Shrink or remove the nodes now covered by the new one
+        int right = position.x + size.x;
+        for (size_t i = nodeIndex + 1; i < m_skyline.size();)
+        {
+            auto& node = m_skyline[i];
+            if (node.x >= right) break;
+            int shrink = right - node.x;
+            if (node.width <= shrink)
+            {
+                m_skyline.erase(m_skyline.begin() + i);
+                continue;
+            }
+            node.x += shrink;
+            node.width -= shrink;
+            break;
+        }
+
+        // Merge neighbours at the same height
+        for (size_t i = 0; i + 1 < m_skyline.size();)
+        {
+            if (m_skyline[i].y == m_skyline[i + 1].y)
+            {
+                m_skyline[i].width += m_skyline[i + 1].width;
+                m_skyline.erase(m_skyline.begin() + i + 1);
+                continue;
+            }
+            ++i;
+        }
+    }
+
+    bool SkylinePacker::insert(const Point& size, Point& position)
+    {
+        Placement placement;
+        if (!find(size, placement)) return false;
+        place(size, placement);
+        position = Point(placement.position.x + m_padding, placement.position.y + m_padding);
+        return true;
+    }
+
+    float TextureAtlas::Stats::getOccupancy() const
+    {
+        if (!totalPixels) return 0.f;
+        return static_cast<float>(static_cast<double>(usedPixels) / static_cast<double>(totalPixels));
+    }
+
+    OTextureAtlasRef TextureAtlas::create(const Point& pageSize, int padding)
+    {
+        return OMake<TextureAtlas>(pageSize, padding);
+    }
+
+    TextureAtlas::TextureAtlas(const Point& pageSize, int padding)
+        : m_pageSize(pageSize)
+        , m_padding(std::max(0, padding))
+    {
+    }
+
+    // Rendering, and so GPU resource creation, happens on the thread processing the dispatcher
+    static bool isRenderThread()
+    {
+        return !oDispatcher || oDispatcher->getThreadId() == std::this_thread::get_id();
+    }
+
+    bool TextureAtlas::canInsert(const Point& size) const
+    {
+        return
+            size.x > 0 && size.y > 0 &&
+            size.x + m_padding * 2 <= m_pageSize.x &&
+            size.y + m_padding * 2 <= m_pageSize.y;
+    }
+
+    OTextureRef TextureAtlas::insert(const uint8_t* pData, const Point& size)
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+
+        if (!canInsert(size))
+        {
+            ++m_stats.rejectedCount;
+            return nullptr;
+        }
+
+        Point paddedSize(size.x + m_padding * 2, size.y + m_padding * 2);
+
+        // Best fit across all pages, lowest resulting skyline first
+        Page* pBestPage = nullptr;
+        SkylinePacker::Placement placement;
+        for (auto& page : m_pages)
+        {
+            if (page.packer.find(size, placement)) pBestPage = &page;
+        }
+
+        // Nothing fits, start a new page
+        if (!pBestPage)
+        {
+            OTextureRef pPageTexture;
+            if (m_pSparePage)
+            {
+                pPageTexture = m_pSparePage;
+                m_pSparePage = nullptr;
+                m_needsSparePage = !isRenderThread(); // Others are streaming, have the next one ready
+            }
+            else if (isRenderThread())
+            {
+                pPageTexture = createPageTexture();
+            }
+            else
+            {
+                ++m_stats.missedCount;
+                m_needsSparePage = true;
+                return nullptr;
+            }
+
+            m_pages.emplace_back(m_pageSize, m_padding);
+            auto& page = m_pages.back();
+            page.pTexture = pPageTexture;
+            page.pixels.resize(m_pageSize.x * m_pageSize.y * 4, 0);
+            ++m_stats.pageCount;
+            m_stats.totalPixels += static_cast<uint64_t>(m_pageSize.x) * static_cast<uint64_t>(m_pageSize.y);
+
+            pBestPage = &page;
+            placement = SkylinePacker::Placement();
+            auto found = page.packer.find(size, placement);
+            assert(found); // canInsert() guarantees it fits an empty page
+            (void)found;
+        }
+
+        auto pageIndex = static_cast<size_t>(pBestPage - m_pages.data());
+        auto bestPosition = placement.position;
+        pBestPage->packer.place(size, placement);
+        copyPixels(*pBestPage, pData, size, bestPosition);
+
+        ++m_stats.textureCount;
+        m_stats.usedPixels += static_cast<uint64_t>(paddedSize.x) * static_cast<uint64_t>(paddedSize.y);
+
+        Vector4 uvs(
+            static_cast<float>(bestPosition.x + m_padding) / static_cast<float>(m_pageSize.x),
+            static_cast<float>(bestPosition.y + m_padding) / static_cast<float>(m_pageSize.y),
+            static_cast<float>(bestPosition.x + m_padding + size.x) / static_cast<float>(m_pageSize.x),
+            static_cast<float>(bestPosition.y + m_padding + size.y) / static_cast<float>(m_pageSize.y));
+        return OMake<AtlasTexture>(shared_from_this(), pageIndex, bestPosition, uvs, size);
+    }
+
+    OTextureRef TextureAtlas::createPageTexture()
+    {
+        assert(isRenderThread()); // GPU resources are created on the render thread
+        return OTexture::createDynamic(m_pageSize);
+    }
+
+    void TextureAtlas::copyPixels(Page& page, const uint8_t* pData, const Point& size, const Point& position)
+    {
+        // Edges are extruded into the padding
+        auto pitch = m_pageSize.x * 4;
+        for (int y = -m_padding; y < size.y + m_padding; ++y)
+        {
+            auto srcY = std::min(std::max(y, 0), size.y - 1);
+            auto pSrcRow = pData + srcY * size.x * 4;
+            auto pDstRow = page.pixels.data() + (position.y + m_padding + y) * pitch + (position.x + m_padding) * 4;
+            memcpy(pDstRow, pSrcRow, size.x * 4);
+            for (int x = 1; x <= m_padding; ++x)
+            {
+                memcpy(pDstRow - x * 4, pSrcRow, 4);
+                memcpy(pDstRow + (size.x - 1 + x) * 4, pSrcRow + (size.x - 1) * 4, 4);
+            }
+        }
+
+        iRect rect{position.x, position.y, position.x + size.x + m_padding * 2, position.y + size.y + m_padding * 2};
+        if (std::find(page.dirtyRects.begin(), page.dirtyRects.end(), rect) == page.dirtyRects.end())
+        {
+            page.dirtyRects.push_back(rect);
+        }
+    }
+
+    void TextureAtlas::setData(size_t pageIndex, const Point& position, const Point& size, const uint8_t* pData)
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        copyPixels(m_pages[pageIndex], pData, size, position);
+    }
+
+    void TextureAtlas::upload()
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        for (auto& page : m_pages)
+        {
+            for (const auto& rect : page.dirtyRects)
+            {
+                page.pTexture->setSubData(page.pixels.data(), rect);
+                ++m_stats.uploadCount;
+                m_stats.uploadedPixels += static_cast<uint64_t>(rect.right - rect.left) * static_cast<uint64_t>(rect.bottom - rect.top);
+            }
+            page.dirtyRects.clear();
+        }
+
+        if (m_needsSparePage && !m_pSparePage)
+        {
+            m_pSparePage = createPageTexture();
+        }
+        m_needsSparePage = false;
+    }
+
+    TextureAtlas::Stats TextureAtlas::getStats()
+    {
+        std::unique_lock<std::mutex> locker(m_mutex);
+        return m_stats;
+    }
+}
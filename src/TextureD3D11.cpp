@@ -66,9 +66,9 @@ namespace onut
         desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
         desc.SampleDesc.Count = 1;
         desc.SampleDesc.Quality = 0;
-        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.Usage = D3D11_USAGE_DEFAULT; // Not DYNAMIC, those can only be mapped whole
         desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        desc.CPUAccessFlags = 0;
         desc.MiscFlags = 0;
 
         auto pRendererD3D11 = std::dynamic_pointer_cast<ORendererD3D11>(oRenderer);
@@ -106,6 +106,17 @@ namespace onut
             pImageData[2] = pImageData[2] * pImageData[3] / 255;
         }
 
+        // Small textures are packed together so they can be batched
+        if (pContentManager)
+        {
+            auto pPacked = pContentManager->packTexture(image.data(), size);
+            if (pPacked)
+            {
+                pPacked->setName(onut::getFilename(filename));
+                return pPacked;
+            }
+        }
+
         auto pRet = createFromData(image.data(), size, generateMipmaps);
         pRet->setName(onut::getFilename(filename));
         pRet->m_type = Type::Static;
@@ -267,13 +278,25 @@ namespace onut
         auto pRendererD3D11 = std::dynamic_pointer_cast<ORendererD3D11>(oRenderer);
         auto pDeviceContext = pRendererD3D11->getDeviceContext();
 
-        D3D11_MAPPED_SUBRESOURCE data;
-        pDeviceContext->Map(m_pTexture, 0, D3D11_MAP_WRITE_DISCARD, 0, &data);
-        for (int y = 0; y < m_size.y; ++y)
-        {
-            memcpy(reinterpret_cast<uint8_t*>(data.pData) + y * data.RowPitch, pData + y * m_size.x * 4, m_size.x * 4);
-        }
-        pDeviceContext->Unmap(m_pTexture, 0);
+        pDeviceContext->UpdateSubresource(m_pTexture, 0, NULL, pData, m_size.x * 4, 0);
+    }
+
+    void TextureD3D11::setSubData(const uint8_t* pData, const iRect& rect)
+    {
+        assert(isDynamic()); // Only dynamic texture can be set data
+
+        auto pRendererD3D11 = std::dynamic_pointer_cast<ORendererD3D11>(oRenderer);
+        auto pDeviceContext = pRendererD3D11->getDeviceContext();
+
+        D3D11_BOX box;
+        box.left = static_cast<UINT>(rect.left);
+        box.top = static_cast<UINT>(rect.top);
+        box.front = 0;
+        box.right = static_cast<UINT>(rect.right);
+        box.bottom = static_cast<UINT>(rect.bottom);
+        box.back = 1;
+        auto pitch = m_size.x * 4;
+        pDeviceContext->UpdateSubresource(m_pTexture, 0, &box, pData + rect.top * pitch + rect.left * 4, pitch, 0);
     }
 
     TextureD3D11::~TextureD3D11()
@@ -37,6 +37,7 @@ namespace onut
         void vignette(float amount = .5f) override; // 0 - 1
 
         void setData(const uint8_t* pData) override;
+        void setSubData(const uint8_t* pData, const iRect& rect) override;
         void resizeTarget(const Point& size) override;
 
     protected:
@@ -1,4 +1,4 @@
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/ContentManager.h>
 #include <onut/Files.h>
@@ -13,6 +13,7 @@
 
 // STL
 #include <cassert>
+#include <cstring>
 #include <vector>
 
 namespace onut
@@ -56,6 +57,9 @@ namespace onut
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+        // Storage is allocated now so regions can be set before the whole texture
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         
         // Because opengl uses a global state and its dumb as fuck
         oRenderer->renderStates.textures[0].forceDirty();
@@ -85,6 +89,17 @@ namespace onut
             pImageData[2] = pImageData[2] * pImageData[3] / 255;
         }
 
+        // Small textures are packed together so they can be batched
+        if (pContentManager)
+        {
+            auto pPacked = pContentManager->packTexture(image.data(), size);
+            if (pPacked)
+            {
+                pPacked->setName(onut::getFilename(filename));
+                return pPacked;
+            }
+        }
+
         auto pRet = createFromData(image.data(), size, generateMipmaps);
         pRet->setName(onut::getFilename(filename));
         pRet->m_type = Type::Static;
@@ -149,6 +164,27 @@ namespace onut
         oRenderer->renderStates.textures[0].forceDirty();
     }
 
+    void TextureGLES2::setSubData(const uint8_t* pData, const iRect& rect)
+    {
+        assert(isDynamic()); // Only dynamic texture can be set data (But this can actually work in OpenGL)
+
+        // GLES2 has no unpack row length, rows of the region are made contiguous first
+        auto width = rect.right - rect.left;
+        auto height = rect.bottom - rect.top;
+        std::vector<uint8_t> region(width * height * 4);
+        for (int y = 0; y < height; ++y)
+        {
+            memcpy(region.data() + y * width * 4, pData + ((rect.top + y) * m_size.x + rect.left) * 4, width * 4);
+        }
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_handle);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.left, rect.top, width, height, GL_RGBA, GL_UNSIGNED_BYTE, region.data());
+
+        // Because opengl uses a global state and its dumb as fuck
+        oRenderer->renderStates.textures[0].forceDirty();
+    }
+
     TextureGLES2::~TextureGLES2()
     {
         if (m_handle)
@@ -1,7 +1,7 @@
 #ifndef TEXTUREGLES2_H_INCLUDED
 #define TEXTUREGLES2_H_INCLUDED
 
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/SampleMode.h>
 #include <onut/Texture.h>
@@ -36,6 +36,7 @@ namespace onut
         void vignette(float amount = .5f) override; // 0 - 1
 
         void setData(const uint8_t* pData) override;
+        void setSubData(const uint8_t* pData, const iRect& rect) override;
         void resizeTarget(const Point& size) override;
         
         GLuint getHandle() const;
@@ -0,0 +1,228 @@
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/ContentManager.h>
+#include <onut/Files.h>
+#include <onut/Settings.h>
+
+// Private
+#include "RendererSoftware.h"
+#include "TextureSoftware.h"
+
+// Third party
+#include <lodepng/LodePNG.h>
+
+// STL
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+
+namespace onut
+{
+    // Queued triangles might still read from or draw into this texture
+    static void flushRenderer()
+    {
+        auto pRendererSoftware = ODynamicCast<ORendererSoftware>(oRenderer);
+        if (pRendererSoftware)
+        {
+            pRendererSoftware->flush();
+        }
+    }
+
+    OTextureRef Texture::createRenderTarget(const Point& size, bool willUseFX)
+    {
+        auto pRet = std::shared_ptr<TextureSoftware>(new TextureSoftware());
+        pRet->m_size = size;
+        pRet->m_pixels.resize(size.x * size.y, 0);
+        pRet->m_type = Type::RenderTarget;
+        return pRet;
+    }
+
+    OTextureRef Texture::createScreenRenderTarget(bool willBeUsedInEffects)
+    {
+        Point res = oRenderer->getTrueResolution();
+        if (oSettings->getIsRetroMode())
+        {
+            res = oSettings->getRetroResolution();
+        }
+
+        auto pRet = createRenderTarget(res, willBeUsedInEffects);
+        if (pRet)
+        {
+            pRet->m_isScreenRenderTarget = true;
+        }
+        pRet->m_type = Type::ScreenRenderTarget;
+        return pRet;
+    }
+
+    OTextureRef Texture::createDynamic(const Point& size)
+    {
+        auto pRet = std::shared_ptr<TextureSoftware>(new TextureSoftware());
+        pRet->m_size = size;
+        pRet->m_pixels.resize(size.x * size.y, 0);
+        pRet->m_type = Type::Dynamic;
+        return pRet;
+    }
+
+    OTextureRef Texture::createFromFile(const std::string& filename, const OContentManagerRef& pContentManager, bool generateMipmaps)
+    {
+        std::vector<uint8_t> image; //the raw pixels (holy crap that must be slow)
+        unsigned int w, h;
+        auto ret = lodepng::decode(image, w, h, filename);
+        assert(!ret);
+        Point size{static_cast<int>(w), static_cast<int>(h)};
+
+        // Pre multiplied
+        uint8_t* pImageData = &(image[0]);
+        auto len = size.x * size.y;
+        for (decltype(len) i = 0; i < len; ++i, pImageData += 4)
+        {
+            pImageData[0] = pImageData[0] * pImageData[3] / 255;
+            pImageData[1] = pImageData[1] * pImageData[3] / 255;
+            pImageData[2] = pImageData[2] * pImageData[3] / 255;
+        }
+
+        // Small textures are packed together so they can be batched
+        if (pContentManager)
+        {
+            auto pPacked = pContentManager->packTexture(image.data(), size);
+            if (pPacked)
+            {
+                pPacked->setName(onut::getFilename(filename));
+                return pPacked;
+            }
+        }
+
+        auto pRet = createFromData(image.data(), size, generateMipmaps);
+        pRet->setName(onut::getFilename(filename));
+        pRet->m_type = Type::Static;
+        return pRet;
+    }
+
+    OTextureRef Texture::createFromFileData(const uint8_t* pData, uint32_t dataSize, bool generateMipmaps)
+    {
+        std::vector<uint8_t> image; //the raw pixels (holy crap that must be slow)
+        unsigned int w, h;
+        lodepng::State state;
+        auto ret = lodepng::decode(image, w, h, state, pData, dataSize);
+        assert(!ret);
+        Point size{static_cast<int>(w), static_cast<int>(h)};
+
+        // Pre multiplied
+        uint8_t* pImageData = image.data();
+        auto len = size.x * size.y;
+        for (int i = 0; i < len; ++i, pImageData += 4)
+        {
+            pImageData[0] = pImageData[0] * pImageData[3] / 255;
+            pImageData[1] = pImageData[1] * pImageData[3] / 255;
+            pImageData[2] = pImageData[2] * pImageData[3] / 255;
+        }
+
+        return createFromData(image.data(), size, generateMipmaps);
+    }
+
+    OTextureRef Texture::createFromData(const uint8_t* pData, const Point& size, bool generateMipmaps)
+    {
+        // No mipmaps, sampling is always from the top level
+        auto pRet = std::shared_ptr<TextureSoftware>(new TextureSoftware());
+        pRet->m_size = size;
+        pRet->m_pixels.resize(size.x * size.y);
+        memcpy(pRet->m_pixels.data(), pData, size.x * size.y * 4);
+        pRet->m_type = Type::Static;
+        return pRet;
+    }
+
+    uint32_t TextureSoftware::packPixel(const Color& color)
+    {
+        auto toByte = [](float value) { return static_cast<uint32_t>(std::min(std::max(value, 0.f), 1.f) * 255.f + .5f); };
+        uint8_t rgba[4] = {
+            static_cast<uint8_t>(toByte(color.r)),
+            static_cast<uint8_t>(toByte(color.g)),
+            static_cast<uint8_t>(toByte(color.b)),
+            static_cast<uint8_t>(toByte(color.a))};
+        uint32_t packed;
+        memcpy(&packed, rgba, 4);
+        return packed;
+    }
+
+    TextureSoftware::~TextureSoftware()
+    {
+    }
+
+    void TextureSoftware::setData(const uint8_t* pData)
+    {
+        assert(isDynamic()); // Only dynamic texture can be set data
+        flushRenderer();
+        memcpy(m_pixels.data(), pData, m_pixels.size() * 4);
+    }
+
+    void TextureSoftware::setSubData(const uint8_t* pData, const iRect& rect)
+    {
+        assert(isDynamic()); // Only dynamic texture can be set data
+        flushRenderer();
+        auto width = rect.right - rect.left;
+        for (int y = rect.top; y < rect.bottom; ++y)
+        {
+            auto offset = y * m_size.x + rect.left;
+            memcpy(m_pixels.data() + offset, pData + offset * 4, width * 4);
+        }
+    }
+
+    void TextureSoftware::resizeTarget(const Point& size)
+    {
+        if (m_size == size) return;
+        flushRenderer();
+        m_size = size;
+        m_pixels.assign(size.x * size.y, 0);
+    }
+
+    void TextureSoftware::clearRenderTarget(const Color& color)
+    {
+        assert(isRenderTarget());
+        flushRenderer();
+        std::fill(m_pixels.begin(), m_pixels.end(), packPixel(color));
+    }
+
+    void TextureSoftware::blur(float amount)
+    {
+    }
+
+    void TextureSoftware::sepia(const Vector3& tone, float saturation, float sepiaAmount)
+    {
+    }
+
+    void TextureSoftware::crt()
+    {
+    }
+
+    void TextureSoftware::cartoon(const Vector3& tone)
+    {
+    }
+
+    void TextureSoftware::vignette(float amount)
+    {
+    }
+
+    bool TextureSoftware::savePNG(const std::string& filename) const
+    {
+        std::vector<uint8_t> image(m_pixels.size() * 4);
+        memcpy(image.data(), m_pixels.data(), image.size());
+
+        // Un-pre multiplied
+        uint8_t* pImageData = image.data();
+        for (size_t i = 0; i < m_pixels.size(); ++i, pImageData += 4)
+        {
+            auto a = pImageData[3];
+            if (a && a < 255)
+            {
+                pImageData[0] = static_cast<uint8_t>(std::min(255, pImageData[0] * 255 / a));
+                pImageData[1] = static_cast<uint8_t>(std::min(255, pImageData[1] * 255 / a));
+                pImageData[2] = static_cast<uint8_t>(std::min(255, pImageData[2] * 255 / a));
+            }
+        }
+
+        return lodepng::encode(filename, image, static_cast<unsigned>(m_size.x), static_cast<unsigned>(m_size.y)) == 0;
+    }
+}
+
+#endif
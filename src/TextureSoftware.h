@@ -0,0 +1,68 @@
+#ifndef TEXTURESOFTWARE_H_INCLUDED
+#define TEXTURESOFTWARE_H_INCLUDED
+
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/Texture.h>
+
+// STL
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(TextureSoftware);
+
+extern bool oGenerateMipmaps;
+
+namespace onut
+{
+    /**
+    Pre-multiplied RGBA8 pixels in system memory. Render targets are drawn into by RendererSoftware.
+    */
+    class TextureSoftware final : public Texture
+    {
+    public:
+        ~TextureSoftware();
+
+        void clearRenderTarget(const Color& color) override;
+
+        // Effects are not supported by the software renderer, these leave the texture untouched
+        void blur(float amount = 16.f) override;
+        void sepia(const Vector3& tone = Vector3(1.40f, 1.10f, 0.90f),
+                   float saturation = 0,
+                   float sepiaAmount = .75f) override;
+        void crt() override;
+        void cartoon(const Vector3& tone = Vector3(2, 5, 1)) override;
+        void vignette(float amount = .5f) override;
+
+        void setData(const uint8_t* pData) override;
+        void setSubData(const uint8_t* pData, const iRect& rect) override;
+        void resizeTarget(const Point& size) override;
+
+        /**
+        @return color as a pixel in memory order: R, G, B, A
+        */
+        static uint32_t packPixel(const Color& color);
+
+        uint32_t* getPixels() { return m_pixels.data(); }
+        const uint32_t* getPixels() const { return m_pixels.data(); }
+
+        /**
+        Save to a PNG file. Pixels are un-premultiplied.
+        @return true on success
+        */
+        bool savePNG(const std::string& filename) const;
+
+    protected:
+        TextureSoftware() {}
+
+    private:
+        friend Texture;
+
+        std::vector<uint32_t> m_pixels;
+    };
+}
+
+#endif
+
+#endif
@@ -1,61 +1,270 @@
 // onut
 #include <onut/ThreadPool.h>
 
+// Private
+#include "WorkStealingQueue.h"
+
+// STL
+#include <algorithm>
+
 OThreadPoolRef oThreadPool;
 
+namespace
+{
+    // Worker of the pool running on this thread, if any
+    thread_local void* t_pWorker = nullptr;
+    thread_local onut::ThreadPool* t_pWorkerPool = nullptr;
+}
+
 namespace onut
 {
+    struct ThreadPool::Worker
+    {
+        std::thread thread;
+        WorkStealingQueue<Job> queue;
+        size_t index;
+    };
+
     OThreadPoolRef OThreadPool::create()
     {
         return std::shared_ptr<ThreadPool>(new ThreadPool());
     }
 
-    void ThreadPool::workerThread(ThreadPool::WorkerRef pWorker)
+    ThreadPool::ThreadPool()
+        : m_queuedCount(0)
+        , m_sleepingCount(0)
+    {
+        auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (decltype(threadCount) i = 0; i < threadCount; ++i)
+        {
+            m_workers.emplace_back(new Worker());
+            m_workers.back()->index = i;
+        }
+
+        // Start them once they all exist, they steal from each other
+        for (auto& pWorker : m_workers)
+        {
+            pWorker->thread = std::thread(&ThreadPool::workerThread, this, pWorker.get());
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        wait();
+        {
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            m_isRunning = false;
+            m_wakeUp.notify_all();
+        }
+        for (auto& pWorker : m_workers)
+        {
+            pWorker->thread.join();
+        }
+    }
+
+    void ThreadPool::workerThread(Worker* pWorker)
     {
-        std::unique_lock<std::mutex> lock(pWorker->mutex);
-        while (pWorker->isRunning)
+        t_pWorker = pWorker;
+        t_pWorkerPool = this;
+
+        while (true)
         {
-            pWorker->waitForWork.wait(lock);
-            if (!pWorker->isRunning)
+            auto pJob = findJob(pWorker);
+            if (pJob)
             {
-                break;
+                run(pJob);
+                continue;
             }
-            pWorker->pDispatcher->processQueue();
+
+            // Nothing to do. Sleeping is announced before checking for work, so enqueue() either
+            // sees us sleeping and notifies, or we see its job.
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            ++m_sleepingCount;
+            m_wakeUp.wait(lock, [this] { return !m_isRunning || m_queuedCount.load() > 0; });
+            --m_sleepingCount;
+            if (!m_isRunning) break;
         }
+
+        t_pWorker = nullptr;
+        t_pWorkerPool = nullptr;
     }
 
-    ThreadPool::ThreadPool()
-        : m_nextWorker(0)
+    OJobRef ThreadPool::doWork(const std::function<void()>& fn, JobCounter* pCounter)
     {
-        auto threadCount = std::thread::hardware_concurrency();
-        for (decltype(threadCount) i = 0; i < threadCount; ++i)
+        return doWork(fn, {}, pCounter);
+    }
+
+    OJobRef ThreadPool::doWork(const std::function<void()>& fn, const std::vector<OJobRef>& dependencies, JobCounter* pCounter)
+    {
+        auto pJob = OMake<Job>();
+        pJob->m_fn = fn;
+        pJob->m_dependencyCount = 1;
+        pJob->m_isDone = false;
+        pJob->m_pCounter = pCounter;
+        pJob->m_pSelf = pJob;
+        if (pCounter) pCounter->m_count.fetch_add(1, std::memory_order_relaxed);
+        m_allJobs.m_count.fetch_add(1, std::memory_order_relaxed);
+
+        for (auto& pDependency : dependencies)
         {
-            WorkerRef pWorker = OMake<Worker>();
-            pWorker->pDispatcher = OMake<ODispatcher>();
-            pWorker->thread = std::thread(workerThread, pWorker);
-            m_workers.push_back(pWorker);
+            if (!pDependency) continue;
+            std::lock_guard<std::mutex> lock(pDependency->m_mutex);
+            if (pDependency->isDone()) continue;
+            pJob->m_dependencyCount.fetch_add(1, std::memory_order_relaxed);
+            pDependency->m_continuations.push_back(pJob);
         }
+
+        // Dependencies might all be done already
+        releaseDependency(pJob.get());
+        return pJob;
     }
 
-    ThreadPool::~ThreadPool()
+    OJobRef ThreadPool::then(const OJobRef& pJob, const std::function<void()>& fn, JobCounter* pCounter)
     {
-        for (auto& pWorker : m_workers)
+        return doWork(fn, {pJob}, pCounter);
+    }
+
+    void ThreadPool::releaseDependency(Job* pJob)
+    {
+        if (pJob->m_dependencyCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            enqueue(pJob);
+        }
+    }
+
+    void ThreadPool::enqueue(Job* pJob)
+    {
+        if (t_pWorkerPool == this)
+        {
+            static_cast<Worker*>(t_pWorker)->queue.push(pJob);
+        }
+        else
         {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            m_sharedQueue.push_back(pJob);
+        }
+
+        ++m_queuedCount;
+        if (m_sleepingCount.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wakeUp.notify_one();
+        }
+    }
+
+    Job* ThreadPool::findJob(Worker* pWorker)
+    {
+        Job* pJob = nullptr;
+        if (pWorker) pJob = pWorker->queue.pop();
+
+        if (!pJob)
+        {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            if (!m_sharedQueue.empty())
             {
-                std::unique_lock<std::mutex> lock(pWorker->mutex);
-                pWorker->isRunning = false;
-                pWorker->waitForWork.notify_all();
+                pJob = m_sharedQueue.front();
+                m_sharedQueue.pop_front();
             }
-            pWorker->thread.join();
         }
+
+        if (!pJob)
+        {
+            // Steal, starting after our own queue so thieves spread out
+            auto workerCount = m_workers.size();
+            auto start = pWorker ? pWorker->index + 1 : 0;
+            for (size_t i = 0; i < workerCount && !pJob; ++i)
+            {
+                auto pVictim = m_workers[(start + i) % workerCount].get();
+                if (pVictim != pWorker) pJob = pVictim->queue.steal();
+            }
+        }
+
+        if (pJob) --m_queuedCount;
+        return pJob;
+    }
+
+    void ThreadPool::run(Job* pJob)
+    {
+        pJob->m_fn();
+        pJob->m_fn = nullptr;
+        finish(pJob);
+    }
+
+    void ThreadPool::finish(Job* pJob)
+    {
+        std::vector<OJobRef> continuations;
+        {
+            std::lock_guard<std::mutex> lock(pJob->m_mutex);
+            pJob->m_isDone.store(true, std::memory_order_release);
+            continuations.swap(pJob->m_continuations);
+        }
+        for (auto& pContinuation : continuations)
+        {
+            releaseDependency(pContinuation.get());
+        }
+
+        if (pJob->m_pCounter) pJob->m_pCounter->m_count.fetch_sub(1, std::memory_order_release);
+        m_allJobs.m_count.fetch_sub(1, std::memory_order_release);
+
+        // Might be the last reference
+        OJobRef pSelf;
+        pSelf.swap(pJob->m_pSelf);
+    }
+
+    bool ThreadPool::runOne()
+    {
+        auto pJob = findJob(t_pWorkerPool == this ? static_cast<Worker*>(t_pWorker) : nullptr);
+        if (!pJob) return false;
+        run(pJob);
+        return true;
     }
 
     void ThreadPool::wait()
     {
-        for (auto& pWorker : m_workers)
+        wait(m_allJobs);
+    }
+
+    void ThreadPool::wait(const OJobRef& pJob)
+    {
+        if (!pJob) return;
+        while (!pJob->isDone())
+        {
+            if (!runOne()) std::this_thread::yield();
+        }
+    }
+
+    void ThreadPool::wait(const JobCounter& counter)
+    {
+        while (!counter.isDone())
+        {
+            if (!runOne()) std::this_thread::yield();
+        }
+    }
+
+    void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain, const std::function<void(size_t)>& fn)
+    {
+        if (end <= begin) return;
+        grain = std::max<size_t>(1, grain);
+        auto chunkCount = (end - begin + grain - 1) / grain;
+
+        std::atomic<size_t> nextChunk(0);
+        auto work = [&]
+        {
+            for (auto chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+            {
+                auto chunkEnd = std::min(end, begin + (chunk + 1) * grain);
+                for (auto i = begin + chunk * grain; i < chunkEnd; ++i) fn(i);
+            }
+        };
+
+        // One helper per worker at most, each takes chunks until there are none left
+        JobCounter counter;
+        auto helperCount = std::min(chunkCount - 1, m_workers.size());
+        for (size_t i = 0; i < helperCount; ++i)
         {
-            std::unique_lock<std::mutex> lock(pWorker->mutex);
+            doWork(work, &counter);
         }
-        m_nextWorker = 0;
+        work();
+        wait(counter);
     }
 }
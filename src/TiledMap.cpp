@@ -2,11 +2,13 @@
 #include <onut/ContentManager.h>
 #include <onut/Crypto.h>
 #include <onut/Files.h>
+#include <onut/IndexBuffer.h>
 #include <onut/Renderer.h>
 #include <onut/SpriteBatch.h>
 #include <onut/Strings.h>
 #include <onut/Texture.h>
 #include <onut/TiledMap.h>
+#include <onut/VertexBuffer.h>
 
 // Third party
 #include <tinyxml2/tinyxml2.h>
@@ -17,6 +19,14 @@
 
 namespace onut
 {
+    // Same layout as SpriteBatch vertices
+    struct ChunkVertex
+    {
+        Vector2 position;
+        Vector2 texCoord;
+        Color color;
+    };
+
     TiledMap::Layer::~Layer()
     {
     }
@@ -34,6 +44,7 @@ namespace onut
     TiledMap::TileLayerInternal::~TileLayerInternal()
     {
         if (tiles) delete[] tiles;
+        if (chunks) delete[] chunks;
     }
 
     OTiledMapRef TiledMap::createFromFile(const std::string &filename, const OContentManagerRef& in_pContentManager)
@@ -209,32 +220,14 @@ namespace onut
                 pLayer.tiles = new Tile[len];
                 for (int i = 0; i < len; ++i)
                 {
-                    auto pTile = pLayer.tiles + i;
-                    auto tileId = pLayer.tileIds[i];
-                    if (tileId == 0)
-                    {
-                        continue;
-                    }
-                    auto pTileSet = pRet->m_tileSets;
-                    for (int j = 0; j < pRet->m_tilesetCount; ++j, pTileSet)
-                    {
-                        if (pTileSet->firstId > static_cast<int>(tileId)) break;
-                    }
-                    pTile->pTileset = pTileSet;
-                    auto texSize = pTileSet->pTexture->getSize();
-                    auto fitW = texSize.x / pTile->pTileset->tileWidth;
-                    auto fitH = texSize.y / pTile->pTileset->tileHeight;
-                    auto onTextureId = tileId - pTileSet->firstId;
-                    pTile->UVs.x = static_cast<float>((onTextureId % fitW) * pTileSet->tileWidth) / static_cast<float>(texSize.x);
-                    pTile->UVs.y = static_cast<float>((onTextureId / fitW) * pTileSet->tileHeight) / static_cast<float>(texSize.y);
-                    pTile->UVs.z = static_cast<float>((onTextureId % fitW + 1) * pTileSet->tileWidth) / static_cast<float>(texSize.x);
-                    pTile->UVs.w = static_cast<float>((onTextureId / fitW + 1) * pTileSet->tileHeight) / static_cast<float>(texSize.y);
-                    pTile->rect.x = static_cast<float>((i % pLayer.width) * pTileSet->tileWidth);
-                    pTile->rect.y = static_cast<float>((i / pLayer.width) * pTileSet->tileHeight);
-                    pTile->rect.z = static_cast<float>(pTileSet->tileWidth);
-                    pTile->rect.w = static_cast<float>(pTileSet->tileHeight);
+                    pRet->resolveTile(&pLayer, i);
                 }
 
+                // Chunks are baked when first rendered
+                pLayer.chunkCountX = (pLayer.width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+                pLayer.chunkCountY = (pLayer.height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+                pLayer.chunks = new Chunk[pLayer.chunkCountX * pLayer.chunkCountY];
+
                 pRet->m_layerCount++;
             }
             else if (!strcmp(pXMLLayer->Name(), "objectgroup"))
@@ -285,7 +278,6 @@ namespace onut
             }
         }
 
-        //TODO: Compile the graphics by batch of 16x16 terrain chunks
         return pRet;
     }
 
@@ -407,31 +399,152 @@ namespace onut
         auto pLayer = dynamic_cast<TileLayerInternal*>(in_pLayer);
         if (!pLayer) return;
 
-        iRect rect = in_rect;
-        rect.left = std::max<>(0, rect.left);
-        rect.top = std::max<>(0, rect.top);
-        rect.right = std::min<>((m_width - 1), rect.right);
-        rect.bottom = std::min<>((m_height - 1), rect.bottom);
-
-        bool manageSB = !oSpriteBatch->isInBatch();
-        if (manageSB)
+        // Chunks overlapping the rect
+        iRect chunkRect;
+        chunkRect.left = std::max<>(0, in_rect.left) / CHUNK_SIZE;
+        chunkRect.top = std::max<>(0, in_rect.top) / CHUNK_SIZE;
+        chunkRect.right = std::min<>(pLayer->width - 1, in_rect.right) / CHUNK_SIZE;
+        chunkRect.bottom = std::min<>(pLayer->height - 1, in_rect.bottom) / CHUNK_SIZE;
+        if (in_rect.right < 0 || in_rect.bottom < 0 ||
+            chunkRect.left > chunkRect.right || chunkRect.top > chunkRect.bottom) return;
+
+        // Draw after what was batched so far, with the same transform
+        bool isInBatch = oSpriteBatch->isInBatch();
+        Matrix transform;
+        if (isInBatch)
         {
-            auto transform = getTransform();
+            oSpriteBatch->changeFiltering(m_filtering);
+            oSpriteBatch->flush();
+            transform = oSpriteBatch->getTransform();
+        }
+        else
+        {
+            transform = getTransform();
             transform._41 = std::roundf(transform._41);
             transform._42 = std::roundf(transform._42);
-            oSpriteBatch->begin(transform);
         }
-        oSpriteBatch->changeFiltering(m_filtering);
-        for (int y = rect.top; y <= rect.bottom; ++y)
+
+        oRenderer->setupFor2D(transform);
+        auto& renderStates = oRenderer->renderStates;
+        renderStates.blendMode = isInBatch ? oSpriteBatch->getBlendMode() : OBlendPreMultiplied;
+        renderStates.sampleFiltering = m_filtering;
+        renderStates.primitiveMode = OPrimitiveTriangleList;
+
+        for (int chunkY = chunkRect.top; chunkY <= chunkRect.bottom; ++chunkY)
+        {
+            for (int chunkX = chunkRect.left; chunkX <= chunkRect.right; ++chunkX)
+            {
+                auto& chunk = pLayer->chunks[chunkY * pLayer->chunkCountX + chunkX];
+                if (chunk.isDirty) bakeChunk(pLayer, chunkX, chunkY);
+                for (const auto& batch : chunk.batches)
+                {
+                    renderStates.textures[0] = batch.pTexture;
+                    renderStates.vertexBuffer = batch.pVertexBuffer;
+                    renderStates.indexBuffer = m_pChunkIndexBuffer;
+                    oRenderer->drawIndexed(batch.quadCount * 6);
+                }
+            }
+        }
+
+        // Give the renderer back to the batch
+        if (isInBatch) oRenderer->setupFor2D(transform, oSpriteBatch->getVertexFormat());
+    }
+
+    void TiledMap::resolveTile(TileLayerInternal *pLayer, int index)
+    {
+        auto pTile = pLayer->tiles + index;
+        auto tileId = pLayer->tileIds[index];
+        if (tileId == 0)
+        {
+            pTile->pTileset = nullptr;
+            return;
+        }
+
+        // Tilesets are sorted by first id, the tile belongs to the last one starting before it
+        auto pTileSet = m_tileSets;
+        for (int j = 1; j < m_tilesetCount; ++j)
+        {
+            if (m_tileSets[j].firstId > static_cast<int>(tileId)) break;
+            pTileSet = m_tileSets + j;
+        }
+        pTile->pTileset = pTileSet;
+        auto texSize = pTileSet->pTexture->getSize();
+        auto fitW = texSize.x / pTileSet->tileWidth;
+        auto onTextureId = static_cast<int>(tileId) - pTileSet->firstId;
+        pTile->UVs.x = static_cast<float>((onTextureId % fitW) * pTileSet->tileWidth) / static_cast<float>(texSize.x);
+        pTile->UVs.y = static_cast<float>((onTextureId / fitW) * pTileSet->tileHeight) / static_cast<float>(texSize.y);
+        pTile->UVs.z = static_cast<float>((onTextureId % fitW + 1) * pTileSet->tileWidth) / static_cast<float>(texSize.x);
+        pTile->UVs.w = static_cast<float>((onTextureId / fitW + 1) * pTileSet->tileHeight) / static_cast<float>(texSize.y);
+        pTile->rect.x = static_cast<float>((index % pLayer->width) * pTileSet->tileWidth);
+        pTile->rect.y = static_cast<float>((index / pLayer->width) * pTileSet->tileHeight);
+        pTile->rect.z = static_cast<float>(pTileSet->tileWidth);
+        pTile->rect.w = static_cast<float>(pTileSet->tileHeight);
+    }
+
+    void TiledMap::bakeChunk(TileLayerInternal *pLayer, int chunkX, int chunkY)
+    {
+        // Shared by all chunks. A full chunk has 4096 vertices, 16 bits indices are enough.
+        if (!m_pChunkIndexBuffer)
+        {
+            std::vector<uint16_t> indices(CHUNK_SIZE * CHUNK_SIZE * 6);
+            for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+            {
+                indices[i * 6 + 0] = static_cast<uint16_t>(i * 4 + 0);
+                indices[i * 6 + 1] = static_cast<uint16_t>(i * 4 + 1);
+                indices[i * 6 + 2] = static_cast<uint16_t>(i * 4 + 2);
+                indices[i * 6 + 3] = static_cast<uint16_t>(i * 4 + 2);
+                indices[i * 6 + 4] = static_cast<uint16_t>(i * 4 + 3);
+                indices[i * 6 + 5] = static_cast<uint16_t>(i * 4 + 0);
+            }
+            m_pChunkIndexBuffer = OIndexBuffer::createStatic(indices.data(), static_cast<uint32_t>(sizeof(uint16_t) * indices.size()));
+        }
+
+        auto& chunk = pLayer->chunks[chunkY * pLayer->chunkCountX + chunkX];
+        chunk.batches.clear();
+        chunk.isDirty = false;
+
+        // Group the quads by tileset
+        std::vector<std::vector<ChunkVertex>> verticesByTileSet(m_tilesetCount);
+        auto right = std::min<>(pLayer->width, (chunkX + 1) * CHUNK_SIZE);
+        auto bottom = std::min<>(pLayer->height, (chunkY + 1) * CHUNK_SIZE);
+        for (int y = chunkY * CHUNK_SIZE; y < bottom; ++y)
         {
-            Tile *pTile = pLayer->tiles + y * m_width + rect.left;
-            for (int x = rect.left; x <= rect.right; ++x, ++pTile)
+            Tile *pTile = pLayer->tiles + y * pLayer->width + chunkX * CHUNK_SIZE;
+            for (int x = chunkX * CHUNK_SIZE; x < right; ++x, ++pTile)
             {
                 if (!pTile->pTileset) continue;
-                oSpriteBatch->drawRectWithUVs(pTile->pTileset->pTexture, pTile->rect, pTile->UVs);
+
+                auto& vertices = verticesByTileSet[pTile->pTileset - m_tileSets];
+                const auto& rect = pTile->rect;
+                auto uvs = pTile->UVs;
+                const auto& pTexture = pTile->pTileset->pTexture;
+                if (pTexture->isAtlased())
+                {
+                    const auto& atlasUVs = pTexture->getAtlasUVs();
+                    uvs.x = atlasUVs.x + uvs.x * (atlasUVs.z - atlasUVs.x);
+                    uvs.y = atlasUVs.y + uvs.y * (atlasUVs.w - atlasUVs.y);
+                    uvs.z = atlasUVs.x + uvs.z * (atlasUVs.z - atlasUVs.x);
+                    uvs.w = atlasUVs.y + uvs.w * (atlasUVs.w - atlasUVs.y);
+                }
+                vertices.push_back({{rect.x, rect.y}, {uvs.x, uvs.y}, Color::White});
+                vertices.push_back({{rect.x, rect.y + rect.w}, {uvs.x, uvs.w}, Color::White});
+                vertices.push_back({{rect.x + rect.z, rect.y + rect.w}, {uvs.z, uvs.w}, Color::White});
+                vertices.push_back({{rect.x + rect.z, rect.y}, {uvs.z, uvs.y}, Color::White});
             }
         }
-        if (manageSB) oSpriteBatch->end();
+
+        for (int i = 0; i < m_tilesetCount; ++i)
+        {
+            const auto& vertices = verticesByTileSet[i];
+            if (vertices.empty()) continue;
+
+            const auto& pTexture = m_tileSets[i].pTexture;
+            ChunkBatch batch;
+            batch.pTexture = pTexture->isAtlased() ? pTexture->getAtlasPage() : pTexture;
+            batch.pVertexBuffer = OVertexBuffer::createStatic(vertices.data(), static_cast<uint32_t>(sizeof(ChunkVertex) * vertices.size()));
+            batch.quadCount = static_cast<uint32_t>(vertices.size() / 4);
+            chunk.batches.push_back(batch);
+        }
     }
 
     const OTextureRef& TiledMap::getMinimap()
@@ -471,32 +584,13 @@ namespace onut
         if (x < 0 || y < 0 || x >= pLayer->width || y >= pLayer->height) return;
 
         auto pInternalLayer = (TileLayerInternal*)pLayer;
-        pLayer->tileIds[y * pInternalLayer->width + x] = tileId;
         auto i = (y * pInternalLayer->width + x);
-        auto pTile = pInternalLayer->tiles + i;
-        if (tileId == 0)
-        {
-            pTile->pTileset = nullptr;
-            return;
-        }
-        auto pTileSet = m_tileSets;
-        for (int j = 0; j < m_tilesetCount; ++j, pTileSet)
-        {
-            if (pTileSet->firstId > static_cast<int>(tileId)) break;
-        }
-        pTile->pTileset = pTileSet;
-        auto texSize = pTileSet->pTexture->getSize();
-        auto fitW = texSize.x / pTile->pTileset->tileWidth;
-        auto fitH = texSize.y / pTile->pTileset->tileHeight;
-        auto onTextureId = tileId - pTileSet->firstId;
-        pTile->UVs.x = static_cast<float>((onTextureId % fitW) * pTileSet->tileWidth) / static_cast<float>(texSize.x);
-        pTile->UVs.y = static_cast<float>((onTextureId / fitH) * pTileSet->tileHeight) / static_cast<float>(texSize.y);
-        pTile->UVs.z = static_cast<float>((onTextureId % fitW + 1) * pTileSet->tileWidth) / static_cast<float>(texSize.x);
-        pTile->UVs.w = static_cast<float>((onTextureId / fitH + 1) * pTileSet->tileHeight) / static_cast<float>(texSize.y);
-        pTile->rect.x = static_cast<float>((i % pLayer->width) * pTileSet->tileWidth);
-        pTile->rect.y = static_cast<float>((i / pLayer->height) * pTileSet->tileHeight);
-        pTile->rect.z = static_cast<float>(pTileSet->tileWidth);
-        pTile->rect.w = static_cast<float>(pTileSet->tileHeight);
+        if (pLayer->tileIds[i] == tileId) return;
+        pLayer->tileIds[i] = tileId;
+        resolveTile(pInternalLayer, i);
+
+        // Only the chunk containing the tile is rebuilt
+        pInternalLayer->chunks[(y / CHUNK_SIZE) * pInternalLayer->chunkCountX + x / CHUNK_SIZE].isDirty = true;
     }
 
     void TiledMap::setFiltering(onut::sample::Filtering filtering)
@@ -0,0 +1,277 @@
+// Onut
+#include <onut/Entity.h>
+#include <onut/ThreadPool.h>
+
+// Private
+#include "TransformSystem.h"
+
+// STL
+#include <algorithm>
+
+namespace onut
+{
+    const TransformSystem::Id TransformSystem::INVALID_ID;
+    const int32_t TransformSystem::NO_PARENT;
+
+    static const uint32_t UNKNOWN_DEPTH = 0xFFFFFFFF;
+
+    // Nodes per job when a depth is updated on the thread pool
+    static const uint32_t PARALLEL_CHUNK_SIZE = 2048;
+
+    TransformSystem::Id TransformSystem::create(Entity* pEntity)
+    {
+        Id id;
+        if (!m_freeIds.empty())
+        {
+            id = m_freeIds.back();
+            m_freeIds.pop_back();
+        }
+        else
+        {
+            id = static_cast<Id>(m_orders.size());
+            m_orders.push_back(0);
+        }
+
+        // Roots can go anywhere, the end keeps the sorted part intact
+        m_orders[id] = static_cast<uint32_t>(m_entities.size());
+        m_locals.push_back(Matrix::Identity);
+        m_worlds.push_back(Matrix::Identity);
+        m_parents.push_back(NO_PARENT);
+        m_flags.push_back(0);
+        m_entities.push_back(pEntity);
+        m_ids.push_back(id);
+        return id;
+    }
+
+    void TransformSystem::destroy(Id id)
+    {
+        auto order = m_orders[id];
+        m_parents[order] = NO_PARENT;
+        m_flags[order] = FLAG_DEAD;
+        m_entities[order] = nullptr;
+        m_freeIds.push_back(id);
+
+        // Dead nodes are skipped until the next sort compacts them away
+        ++m_deadCount;
+        if (m_deadCount * 4 > m_entities.size()) m_needsSort = true;
+    }
+
+    void TransformSystem::setParent(Id id, Id parentId)
+    {
+        auto order = m_orders[id];
+        auto parentOrder = parentId == INVALID_ID ? NO_PARENT : static_cast<int32_t>(m_orders[parentId]);
+        if (m_parents[order] == parentOrder) return;
+        m_parents[order] = parentOrder;
+        flag(order);
+
+        if (parentOrder != NO_PARENT && static_cast<uint32_t>(parentOrder) > order)
+        {
+            // Its subtree has to move after the new parent
+            m_needsSort = true;
+        }
+        else if (order < m_sortedCount)
+        {
+            // The depth of the subtree changed. It is all at or after the node's depth, the depths
+            // before are still right. The rest is updated serially until the next sort.
+            auto it = std::upper_bound(m_depthEnds.begin(), m_depthEnds.end(), order);
+            m_sortedCount = it == m_depthEnds.begin() ? 0 : *(it - 1);
+            m_depthEnds.erase(it, m_depthEnds.end());
+        }
+    }
+
+    void TransformSystem::setLocal(Id id, const Matrix& local)
+    {
+        auto order = m_orders[id];
+        m_locals[order] = local;
+        flag(order);
+    }
+
+    const Matrix& TransformSystem::getWorld(Id id)
+    {
+        auto order = m_orders[id];
+
+        // Nodes before the first flagged one have no flagged ancestor either
+        if (order >= m_firstDirty) refresh(order);
+        return m_worlds[order];
+    }
+
+    void TransformSystem::flag(uint32_t order)
+    {
+        m_flags[order] |= FLAG_DIRTY;
+        m_firstDirty = std::min(m_firstDirty, order);
+    }
+
+    bool TransformSystem::refresh(uint32_t order)
+    {
+        // Flags are left for update() so it still notifies the entities
+        bool isStale = (m_flags[order] & FLAG_DIRTY) != 0;
+        auto parent = m_parents[order];
+        if (parent != NO_PARENT && static_cast<uint32_t>(parent) >= m_firstDirty)
+        {
+            isStale = refresh(static_cast<uint32_t>(parent)) || isStale;
+        }
+        if (isStale)
+        {
+            m_worlds[order] = parent == NO_PARENT ? m_locals[order] : m_locals[order] * m_worlds[parent];
+        }
+        return isStale;
+    }
+
+    void TransformSystem::updateRange(uint32_t begin, uint32_t end)
+    {
+        auto pLocals = m_locals.data();
+        auto pWorlds = m_worlds.data();
+        auto pParents = m_parents.data();
+        auto pFlags = m_flags.data();
+        for (auto i = begin; i < end; ++i)
+        {
+            auto parent = pParents[i];
+            if (parent == NO_PARENT)
+            {
+                if (pFlags[i] & FLAG_DIRTY) pWorlds[i] = pLocals[i];
+            }
+            else if ((pFlags[i] | pFlags[parent]) & FLAG_DIRTY)
+            {
+                pFlags[i] |= FLAG_DIRTY;
+                pWorlds[i] = pLocals[i] * pWorlds[parent];
+            }
+        }
+    }
+
+    void TransformSystem::update()
+    {
+        if (m_firstDirty == 0xFFFFFFFF) return;
+
+        auto count = static_cast<uint32_t>(m_entities.size());
+        if (m_needsSort || (oThreadPool && count - m_sortedCount >= MIN_PARALLEL_NODES))
+        {
+            sort();
+            count = static_cast<uint32_t>(m_entities.size());
+        }
+
+        // Each depth only reads the ones before, its nodes can be updated in any order
+        auto begin = m_firstDirty;
+        uint32_t depthBegin = 0;
+        for (auto depthEnd : m_depthEnds)
+        {
+            if (depthEnd > begin)
+            {
+                auto rangeBegin = std::max(depthBegin, begin);
+                auto rangeCount = depthEnd - rangeBegin;
+                if (oThreadPool && rangeCount >= MIN_PARALLEL_NODES)
+                {
+                    auto chunkCount = (rangeCount + PARALLEL_CHUNK_SIZE - 1) / PARALLEL_CHUNK_SIZE;
+                    OParallelFor(0, chunkCount, 1, [this, rangeBegin, depthEnd](size_t chunk)
+                    {
+                        auto chunkBegin = rangeBegin + static_cast<uint32_t>(chunk) * PARALLEL_CHUNK_SIZE;
+                        updateRange(chunkBegin, std::min(chunkBegin + PARALLEL_CHUNK_SIZE, depthEnd));
+                    });
+                }
+                else
+                {
+                    updateRange(rangeBegin, depthEnd);
+                }
+            }
+            depthBegin = depthEnd;
+        }
+        updateRange(std::max(m_sortedCount, begin), count);
+
+        // Entities react on the main thread. They must not move transforms from there.
+        m_firstDirty = 0xFFFFFFFF;
+        for (auto i = begin; i < count; ++i)
+        {
+            if (m_flags[i] & FLAG_DIRTY)
+            {
+                m_flags[i] &= ~FLAG_DIRTY;
+                m_entities[i]->onWorldChanged();
+            }
+        }
+    }
+
+    void TransformSystem::sort()
+    {
+        auto count = static_cast<uint32_t>(m_entities.size());
+
+        // Parents can be after their children here, if one was just moved under a newer node
+        std::vector<uint32_t> depths(count, UNKNOWN_DEPTH);
+        std::vector<uint32_t> chain;
+        uint32_t maxDepth = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (m_flags[i] & FLAG_DEAD) continue;
+            auto j = i;
+            while (depths[j] == UNKNOWN_DEPTH)
+            {
+                auto parent = m_parents[j];
+                if (parent == NO_PARENT || (m_flags[parent] & FLAG_DEAD))
+                {
+                    depths[j] = 0;
+                    break;
+                }
+                chain.push_back(j);
+                j = static_cast<uint32_t>(parent);
+            }
+            auto depth = depths[j];
+            while (!chain.empty())
+            {
+                depths[chain.back()] = ++depth;
+                chain.pop_back();
+            }
+            maxDepth = std::max(maxDepth, depths[i]);
+        }
+
+        // Counting sort by depth, stable so siblings keep their relative order
+        std::vector<uint32_t> depthStarts(maxDepth + 2, 0);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (depths[i] != UNKNOWN_DEPTH) ++depthStarts[depths[i] + 1];
+        }
+        for (uint32_t depth = 1; depth < depthStarts.size(); ++depth)
+        {
+            depthStarts[depth] += depthStarts[depth - 1];
+        }
+        m_depthEnds.assign(depthStarts.begin() + 1, depthStarts.end());
+
+        auto liveCount = count - m_deadCount;
+        std::vector<uint32_t> newOrders(count);
+        std::vector<Matrix> locals(liveCount);
+        std::vector<Matrix> worlds(liveCount);
+        std::vector<int32_t> parents(liveCount);
+        std::vector<uint8_t> flags(liveCount);
+        std::vector<Entity*> entities(liveCount);
+        std::vector<Id> ids(liveCount);
+        m_firstDirty = 0xFFFFFFFF;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (depths[i] == UNKNOWN_DEPTH) continue;
+            auto newOrder = depthStarts[depths[i]]++;
+            newOrders[i] = newOrder;
+            locals[newOrder] = m_locals[i];
+            worlds[newOrder] = m_worlds[i];
+            flags[newOrder] = m_flags[i];
+            entities[newOrder] = m_entities[i];
+            ids[newOrder] = m_ids[i];
+            m_orders[m_ids[i]] = newOrder;
+            if (m_flags[i] & FLAG_DIRTY) m_firstDirty = std::min(m_firstDirty, newOrder);
+        }
+
+        // Parents were placed in a lower depth, so their new order is known
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (depths[i] == UNKNOWN_DEPTH) continue;
+            auto parent = m_parents[i];
+            auto isRoot = parent == NO_PARENT || (m_flags[parent] & FLAG_DEAD);
+            parents[newOrders[i]] = isRoot ? NO_PARENT : static_cast<int32_t>(newOrders[parent]);
+        }
+
+        m_locals.swap(locals);
+        m_worlds.swap(worlds);
+        m_parents.swap(parents);
+        m_flags.swap(flags);
+        m_entities.swap(entities);
+        m_ids.swap(ids);
+        m_sortedCount = liveCount;
+        m_deadCount = 0;
+        m_needsSort = false;
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef TRANSFORMSYSTEM_H_INCLUDED
+#define TRANSFORMSYSTEM_H_INCLUDED
+
+// Onut
+#include <onut/Maths.h>
+
+// STL
+#include <cinttypes>
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(Entity);
+
+namespace onut
+{
+    /**
+    Local and world transforms of a scene's entities, in arrays sorted parents before children.
+    Setting a local transform only flags it. update() then recomputes the world transforms of the flagged
+    nodes and of their descendants in one pass over the arrays, and tells the entities which ones moved.
+    World transforms asked for before that are computed on demand from the nearest clean ancestor.
+
+    Nodes keep their id for their whole life, their place in the arrays changes when the hierarchy does.
+    After a structural change the arrays are re-sorted by depth, so each depth can be updated in parallel.
+    */
+    class TransformSystem final
+    {
+    public:
+        using Id = uint32_t;
+        static const Id INVALID_ID = 0xFFFFFFFF;
+
+        // Depths with at least that many nodes are updated on the thread pool
+        static const uint32_t MIN_PARALLEL_NODES = 8192;
+
+        Id create(Entity* pEntity);
+        void destroy(Id id);
+
+        /**
+        @param parentId INVALID_ID to make it a root
+        */
+        void setParent(Id id, Id parentId);
+
+        const Matrix& getLocal(Id id) const { return m_locals[m_orders[id]]; }
+        void setLocal(Id id, const Matrix& local);
+
+        /**
+        Up to date world transform. The reference is valid until the next structural change.
+        */
+        const Matrix& getWorld(Id id);
+
+        /**
+        Propagate the flagged transforms to the world transforms and their descendants'.
+        Entities that moved get Entity::onWorldChanged().
+        */
+        void update();
+
+        uint32_t size() const { return static_cast<uint32_t>(m_entities.size()) - m_deadCount; }
+
+    private:
+        static const int32_t NO_PARENT = -1;
+
+        enum Flag : uint8_t
+        {
+            FLAG_DIRTY = 1, // World transform has to be recomputed
+            FLAG_DEAD = 2
+        };
+
+        void flag(uint32_t order);
+        bool refresh(uint32_t order);
+        void updateRange(uint32_t begin, uint32_t end);
+        void sort();
+
+        // By order, parents before children
+        std::vector<Matrix> m_locals;
+        std::vector<Matrix> m_worlds;
+        std::vector<int32_t> m_parents; // Order of the parent
+        std::vector<uint8_t> m_flags;
+        std::vector<Entity*> m_entities;
+        std::vector<Id> m_ids;
+
+        // By id
+        std::vector<uint32_t> m_orders;
+        std::vector<Id> m_freeIds;
+
+        // Orders where each depth ends, for the nodes sorted by depth. The ones after were added since.
+        std::vector<uint32_t> m_depthEnds;
+        uint32_t m_sortedCount = 0;
+
+        uint32_t m_deadCount = 0;
+        uint32_t m_firstDirty = 0xFFFFFFFF; // Nothing before needs updating
+        bool m_needsSort = false;
+    };
+}
+
+#endif
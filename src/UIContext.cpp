@@ -351,6 +351,12 @@ namespace onut
         m_pLastHoverControl = m_pHoverControl;
         for (int i = 0; i < 3; ++i) m_pLastDownControls[i] = m_pDownControls[i];
         m_pLastFocus = m_pFocus;
+
+        for (auto it = m_textLayouts.begin(); it != m_textLayouts.end();)
+        {
+            if (it->second.pControl.expired()) it = m_textLayouts.erase(it);
+            else ++it;
+        }
     }
 
     void UIContext::write(char c)
@@ -496,6 +502,14 @@ namespace onut
 
         if (pFont)
         {
+            // A new control can get the address of one that was destroyed
+            auto& textLayout = m_textLayouts[pControl.get()];
+            if (textLayout.pControl.expired())
+            {
+                textLayout.pControl = pControl;
+                textLayout.layout = TextLayout();
+            }
+
             if (pControl->getStyleName() == "password")
             {
                 std::string pwd;
@@ -504,12 +518,13 @@ namespace onut
                 {
                     pwd.back() = '_';
                 }
-                pFont->draw(pwd, ORectAlign(oRect, align), Vector2(align), oColor);
+                textLayout.layout.set(pFont, pwd);
             }
             else
             {
-                pFont->draw(textComponent.text, ORectAlign(oRect, align), Vector2(align), oColor);
+                textLayout.layout.set(pFont, textComponent.text);
             }
+            textLayout.layout.draw(ORectAlign(oRect, align), Vector2(align), oColor);
         }
     };
 };
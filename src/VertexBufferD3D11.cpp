@@ -33,6 +33,7 @@ namespace onut
 
         auto ret = pDevice->CreateBuffer(&vertexBufferDesc, nullptr, &pRet->m_pBuffer);
         assert(ret == S_OK);
+        pRet->m_size = size;
 
         return pRet;
     }
@@ -116,6 +117,33 @@ namespace onut
         }
     }
 
+    void* VertexBufferD3D11::mapRange(uint32_t offset, uint32_t size)
+    {
+        assert(m_isDynamic);
+        assert(offset + size <= m_size);
+        if (m_isDynamic)
+        {
+            auto pRendererD3D11 = std::dynamic_pointer_cast<ORendererD3D11>(oRenderer);
+            auto mapType = (offset == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+            pRendererD3D11->getDeviceContext()->Map(m_pBuffer, 0, mapType, 0, &m_mappedVertexBuffer);
+            return reinterpret_cast<uint8_t*>(m_mappedVertexBuffer.pData) + offset;
+        }
+        return nullptr;
+    }
+
+    void VertexBufferD3D11::unmapRange(uint32_t offset, uint32_t size)
+    {
+        assert(m_isDynamic);
+        assert(offset + size <= m_size);
+        if (m_isDynamic)
+        {
+            // mapRange() returned the mapped buffer at offset, so the range was written in place.
+            // The rest of the buffer was mapped without overwrite and is untouched.
+            auto pRendererD3D11 = std::dynamic_pointer_cast<ORendererD3D11>(oRenderer);
+            pRendererD3D11->getDeviceContext()->Unmap(m_pBuffer, 0);
+        }
+    }
+
     uint32_t VertexBufferD3D11::size()
     {
         return m_size;
@@ -25,6 +25,8 @@ namespace onut
         void setData(const void* pVertexData, uint32_t size) override;
         void* map() override;
         void unmap(uint32_t size) override;
+        void* mapRange(uint32_t offset, uint32_t size) override;
+        void unmapRange(uint32_t offset, uint32_t size) override;
         uint32_t size() override;
 
     private:
@@ -1,4 +1,4 @@
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Private
 #include "VertexBufferGLES2.h"
 #include "RendererGLES2.h"
@@ -90,6 +90,32 @@ namespace onut
         }
     }
 
+    void* VertexBufferGLES2::mapRange(uint32_t offset, uint32_t size)
+    {
+        assert(m_isDynamic);
+        assert(offset + size <= m_size);
+        if (offset == 0)
+        {
+            // Orphan the previous storage so the driver doesn't wait
+            // on draws still reading from it
+            glBindBuffer(GL_ARRAY_BUFFER, m_handle);
+            glBufferData(GL_ARRAY_BUFFER, m_size, NULL, GL_DYNAMIC_DRAW);
+            oRenderer->renderStates.vertexBuffer.forceDirty();
+        }
+        return m_pData + offset;
+    }
+
+    void VertexBufferGLES2::unmapRange(uint32_t offset, uint32_t size)
+    {
+        assert(m_isDynamic);
+        if (m_isDynamic && size)
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, m_handle);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, m_pData + offset);
+            oRenderer->renderStates.vertexBuffer.forceDirty();
+        }
+    }
+
     uint32_t VertexBufferGLES2::size()
     {
         return m_size;
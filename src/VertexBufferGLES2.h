@@ -1,7 +1,7 @@
 #ifndef VERTEXBUFFERGLES2_H_INCLUDED
 #define VERTEXBUFFERGLES2_H_INCLUDED
 
-#if defined(__unix__)
+#if defined(__unix__) && !defined(ONUT_RENDERER_SOFTWARE)
 // Onut
 #include <onut/VertexBuffer.h>
 
@@ -25,6 +25,8 @@ namespace onut
         void setData(const void* pVertexData, uint32_t size) override;
         void* map() override;
         void unmap(uint32_t size) override;
+        void* mapRange(uint32_t offset, uint32_t size) override;
+        void unmapRange(uint32_t offset, uint32_t size) override;
         uint32_t size() override;
         
         GLuint getHandle() const;
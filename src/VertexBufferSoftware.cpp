@@ -0,0 +1,73 @@
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Private
+#include "VertexBufferSoftware.h"
+
+// STL
+#include <cassert>
+#include <cstring>
+
+namespace onut
+{
+    OVertexBufferRef VertexBuffer::createStatic(const void* pVertexData, uint32_t size)
+    {
+        auto pRet = OMake<VertexBufferSoftware>();
+        pRet->setData(pVertexData, size);
+        return pRet;
+    }
+
+    OVertexBufferRef VertexBuffer::createDynamic(uint32_t size)
+    {
+        auto pRet = OMake<VertexBufferSoftware>();
+        pRet->m_data.resize(size);
+        pRet->m_isDynamic = true;
+        return pRet;
+    }
+
+    VertexBufferSoftware::VertexBufferSoftware()
+    {
+    }
+
+    VertexBufferSoftware::~VertexBufferSoftware()
+    {
+    }
+
+    void VertexBufferSoftware::setData(const void* pVertexData, uint32_t size)
+    {
+        // Vertices are fetched at draw time, so the data can change right away
+        if (!m_isDynamic || size > m_data.size())
+        {
+            m_data.resize(size);
+        }
+        memcpy(m_data.data(), pVertexData, size);
+    }
+
+    void* VertexBufferSoftware::map()
+    {
+        assert(m_isDynamic);
+        return m_data.data();
+    }
+
+    void VertexBufferSoftware::unmap(uint32_t size)
+    {
+        assert(m_isDynamic);
+    }
+
+    void* VertexBufferSoftware::mapRange(uint32_t offset, uint32_t size)
+    {
+        assert(m_isDynamic);
+        assert(offset + size <= m_data.size());
+        return m_data.data() + offset;
+    }
+
+    void VertexBufferSoftware::unmapRange(uint32_t offset, uint32_t size)
+    {
+        assert(m_isDynamic);
+    }
+
+    uint32_t VertexBufferSoftware::size()
+    {
+        return static_cast<uint32_t>(m_data.size());
+    }
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef VERTEXBUFFERSOFTWARE_H_INCLUDED
+#define VERTEXBUFFERSOFTWARE_H_INCLUDED
+
+#if defined(ONUT_RENDERER_SOFTWARE)
+// Onut
+#include <onut/VertexBuffer.h>
+
+// STL
+#include <vector>
+
+// Forward
+#include <onut/ForwardDeclaration.h>
+OForwardDeclare(VertexBufferSoftware)
+
+namespace onut
+{
+    class VertexBufferSoftware final : public VertexBuffer
+    {
+    public:
+        VertexBufferSoftware();
+        ~VertexBufferSoftware();
+
+        void setData(const void* pVertexData, uint32_t size) override;
+        void* map() override;
+        void unmap(uint32_t size) override;
+        void* mapRange(uint32_t offset, uint32_t size) override;
+        void unmapRange(uint32_t offset, uint32_t size) override;
+        uint32_t size() override;
+
+        const uint8_t* getData() const { return m_data.data(); }
+
+    private:
+        friend class VertexBuffer;
+
+        bool m_isDynamic = false;
+        std::vector<uint8_t> m_data;
+    };
+};
+
+#endif
+
+#endif
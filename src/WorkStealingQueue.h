@@ -0,0 +1,147 @@
+#ifndef WORKSTEALINGQUEUE_H_INCLUDED
+#define WORKSTEALINGQUEUE_H_INCLUDED
+
+// STL
+#include <atomic>
+#include <cinttypes>
+#include <cstddef>
+
+namespace onut
+{
+    /**
+    Chase-Lev deque of pointers. The owner thread pushes and pops at the bottom, LIFO, without locking.
+    Any other thread can steal from the top, FIFO. The buffer doubles when full, old buffers are kept
+    until the queue is destroyed because a thief might still be reading them.
+    */
+    template<typename Titem>
+    class WorkStealingQueue final
+    {
+    public:
+        WorkStealingQueue(int64_t capacity = 256)
+            : m_top(0)
+            , m_bottom(0)
+            , m_pBuffer(new Buffer(capacity, nullptr))
+        {
+        }
+
+        ~WorkStealingQueue()
+        {
+            auto pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+            while (pBuffer)
+            {
+                auto pPrevious = pBuffer->pPrevious;
+                delete pBuffer;
+                pBuffer = pPrevious;
+            }
+        }
+
+        /**
+        Owner thread only
+        */
+        void push(Titem* pItem)
+        {
+            auto b = m_bottom.load(std::memory_order_relaxed);
+            auto t = m_top.load(std::memory_order_acquire);
+            auto pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+            if (b - t > pBuffer->capacity - 1)
+            {
+                pBuffer = pBuffer->grow(b, t);
+                m_pBuffer.store(pBuffer, std::memory_order_release);
+            }
+            pBuffer->put(b, pItem);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+
+        /**
+        Owner thread only
+        @return nullptr if empty
+        */
+        Titem* pop()
+        {
+            auto b = m_bottom.load(std::memory_order_relaxed) - 1;
+            auto pBuffer = m_pBuffer.load(std::memory_order_relaxed);
+            m_bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto t = m_top.load(std::memory_order_relaxed);
+            if (t > b)
+            {
+                // Empty
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            auto pItem = pBuffer->get(b);
+            if (t == b)
+            {
+                // Last item, race the thieves for it
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    pItem = nullptr;
+                }
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return pItem;
+        }
+
+        /**
+        Any thread
+        @return nullptr if empty or if another thread took the item first
+        */
+        Titem* steal()
+        {
+            auto t = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto b = m_bottom.load(std::memory_order_acquire);
+            if (t >= b) return nullptr;
+
+            auto pItem = m_pBuffer.load(std::memory_order_acquire)->get(t);
+            if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return nullptr;
+            }
+            return pItem;
+        }
+
+        bool empty() const
+        {
+            return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Buffer
+        {
+            Buffer(int64_t in_capacity, Buffer* in_pPrevious)
+                : capacity(in_capacity)
+                , pItems(new std::atomic<Titem*>[in_capacity])
+                , pPrevious(in_pPrevious)
+            {
+            }
+
+            ~Buffer()
+            {
+                delete[] pItems;
+            }
+
+            Titem* get(int64_t i) const { return pItems[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, Titem* pItem) { pItems[i & (capacity - 1)].store(pItem, std::memory_order_relaxed); }
+
+            Buffer* grow(int64_t b, int64_t t)
+            {
+                auto pBuffer = new Buffer(capacity * 2, this);
+                for (auto i = t; i < b; ++i) pBuffer->put(i, get(i));
+                return pBuffer;
+            }
+
+            int64_t capacity; // Power of 2
+            std::atomic<Titem*>* pItems;
+            Buffer* pPrevious;
+        };
+
+        std::atomic<int64_t> m_top;
+        std::atomic<int64_t> m_bottom;
+        std::atomic<Buffer*> m_pBuffer;
+    };
+}
+
+#endif
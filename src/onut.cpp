@@ -1,5 +1,6 @@
 // Onut includes
 #include <onut/ActionManager.h>
+#include <onut/Async.h>
 #if !defined(__unix__)
 #include <onut/AudioEngine.h>
 #endif // __unix__
@@ -19,6 +20,7 @@
 #include <onut/Settings.h>
 #include <onut/SpriteBatch.h>
 #include <onut/Texture.h>
+#include <onut/TextureAtlas.h>
 #include <onut/ThreadPool.h>
 #include <onut/Timing.h>
 #include <onut/UIContext.h>
@@ -92,6 +94,9 @@ namespace onut
         // Thread pool
         oThreadPool = OThreadPool::create();
 
+        // Blocking work from OAsync
+        oAsyncExecutor = OAsyncExecutor::create();
+
         // Dispatcher
         oDispatcher = ODispatcher::create();
 
@@ -157,6 +162,7 @@ namespace onut
 
         g_pMainRenderTarget = nullptr;
 #endif // __unix__
+        oAsyncExecutor = nullptr; // Finishes its work, which might still use the other services
         oActionManager = nullptr;
         oSceneManager = nullptr;
         oComponentFactory = nullptr;
@@ -289,6 +295,11 @@ namespace onut
 
             // Render
             oTiming->render();
+            auto pTextureAtlas = oContentManager->getTextureAtlas();
+            if (pTextureAtlas)
+            {
+                pTextureAtlas->upload(); // Textures packed since last frame
+            }
 #if !defined(__unix__)
             oRenderer->renderStates.renderTarget = g_pMainRenderTarget;
 #endif // __unix__
@@ -600,6 +600,27 @@ declare class IndexBuffer {
     getCount(): number;
 }
 
+// RenderStats, counters of one frame
+declare class RenderStats {
+    drawCalls: number;
+    indexCount: number;
+    vertexCount: number;
+    renderTargetChanges: number;
+    textureChanges: number;
+    samplerChanges: number;
+    blendChanges: number;
+    scissorChanges: number;
+    shaderChanges: number;
+    flushCount: number;
+    flushes: {
+        BufferFull: number;
+        TextureChange: number;
+        BlendChange: number;
+        FilteringChange: number;
+        Explicit: number;
+    };
+}
+
 // Renderer
 declare namespace Renderer {
     function clear(color: Color);
@@ -608,6 +629,11 @@ declare namespace Renderer {
     function draw(vertexCount: number);
     function drawIndexed(indexCount: number);
 
+    // Stats
+    function getStats(framesAgo: number): RenderStats;
+    function getStatsFrameCount(): number;
+    function saveStatsCSV(filename: string): boolean;
+
     // States
     function setRenderTarget(renderTarget: Texture);
     function pushRenderTarget(renderTarget: Texture);
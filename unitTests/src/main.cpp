@@ -1,20 +1,36 @@
 ﻿#include <direct.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
 #include <future>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifdef WIN32
 #include <Windows.h>
 #endif
 
+#include <onut/Async.h>
+#include <onut/Component.h>
 #include <onut/ContentManager.h>
+#include <onut/Entity.h>
 #include <onut/Dispatcher.h>
 #include <onut/Files.h>
 #include <onut/Pool.h>
 #include <onut/Resource.h>
+#include <onut/SceneManager.h>
 #include <onut/Settings.h>
 #include <onut/Strings.h>
+#include <onut/TextureAtlas.h>
+#include <onut/ThreadPool.h>
+#include <onut/Timing.h>
+
+#include "SpriteLayers.h"
 
 using namespace std;
 
@@ -189,6 +205,118 @@ bool testRandomPool()
     return i == TloopCount;
 }
 
+struct alignas(32) CAligned
+{
+    CAligned(int _a) : a(_a) { ++aliveCount; }
+    ~CAligned() { --aliveCount; }
+    int a;
+    static int aliveCount;
+};
+int CAligned::aliveCount = 0;
+
+class TestComponentA : public OComponent
+{
+public:
+    int a = 1;
+};
+
+class TestComponentB : public OComponent
+{
+public:
+    int b = 2;
+};
+
+class TestSystemComponent : public OComponent
+{
+public:
+    TestSystemComponent() : OComponent(FLAG_UPDATABLE) {}
+
+    static void updateAll(const OComponentSpan<TestSystemComponent>& components)
+    {
+        ++updateAllCount;
+        for (auto pComponent : components) ++pComponent->updateCount;
+    }
+
+    int updateCount = 0;
+    static int updateAllCount;
+
+protected:
+    void onUpdate() override { ++updateCount; }
+};
+int TestSystemComponent::updateAllCount = 0;
+
+// Parallel updatables, each touching something different
+class TestHealthComponent : public OComponent
+{
+public:
+    TestHealthComponent() : OComponent(FLAG_UPDATABLE | FLAG_PARALLEL_UPDATABLE) {}
+
+    int health = 100;
+    int messageSum = 0;
+
+protected:
+    void onUpdate() override
+    {
+        health += 1;
+        if (health <= 0) destroy();
+    }
+
+    void onMessage(int messageId, void* pData) override
+    {
+        messageSum = messageSum * 31 + messageId;
+    }
+};
+
+class TestMoverComponent : public OComponent
+{
+public:
+    TestMoverComponent() : OComponent(FLAG_UPDATABLE | FLAG_PARALLEL_UPDATABLE) {}
+
+    float speed = 1.f;
+
+protected:
+    void getUpdateAccess(UpdateAccess& access) const override
+    {
+        access.writesTransforms = true;
+    }
+
+    void onUpdate() override
+    {
+        auto position = getLocalTransform().Translation();
+        setLocalTransform(Matrix::CreateTranslation(position.x + speed, position.y, 0.f));
+    }
+};
+
+class TestAttackComponent : public OComponent
+{
+public:
+    TestAttackComponent() : OComponent(FLAG_UPDATABLE | FLAG_PARALLEL_UPDATABLE) {}
+
+    OEntityRef pTarget;
+    OComponentRef pToggled;
+    uint32_t seed = 1;
+
+protected:
+    void getUpdateAccess(UpdateAccess& access) const override
+    {
+        access.write<TestHealthComponent>().readsTransforms = true;
+    }
+
+    void onUpdate() override
+    {
+        seed = seed * 1664525u + 1013904223u;
+        auto roll = seed >> 24;
+        auto pHealth = pTarget->getComponentPtr<TestHealthComponent>();
+        if (pHealth)
+        {
+            pHealth->health -= 1 + static_cast<int>(roll % 3) + static_cast<int>(getWorldTransform().Translation().x) % 2;
+        }
+        if (roll % 8 == 0) pTarget->sendMessage(static_cast<int>(roll % 5) + 1);
+        if (roll % 32 == 1) pToggled->setEnabled(!pToggled->isEnabled());
+        if (roll == 7) boardcastMessage(9);
+    }
+};
+
 void foo() {}
 
 bool foob()
@@ -333,6 +461,64 @@ void runSynchronousTests()
 
         cout << setColor(7) << endl;
     }
+
+    subTest("Overflow and 8 producers");
+    {
+        auto pDispatcher = ODispatcher::create();
+
+        // More than the ring holds, the rest overflows and must still come in order
+        std::vector<int> order;
+        for (int i = 0; i < static_cast<int>(ODispatcher::CAPACITY) * 3; ++i)
+        {
+            pDispatcher->dispatch([&order, i] { order.push_back(i); });
+        }
+        checkTest(pDispatcher->size() == ODispatcher::CAPACITY * 3, "Queue size = 3 times the capacity");
+        pDispatcher->processQueue();
+        bool isInOrder = order.size() == ODispatcher::CAPACITY * 3;
+        for (size_t i = 0; isInOrder && i < order.size(); ++i) isInOrder = order[i] == static_cast<int>(i);
+        checkTest(isInOrder, "Overflowed callbacks called in order");
+
+        // Captures bigger than the inline buffer
+        struct BigCapture
+        {
+            char data[ODispatcher::Callback::BUFFER_SIZE * 2];
+        };
+        BigCapture big;
+        big.data[0] = 42;
+        int bigValue = 0;
+        pDispatcher->dispatch([big, &bigValue] { bigValue = big.data[0]; });
+        pDispatcher->processQueue();
+        checkTest(bigValue == 42, "Capture bigger than the inline buffer");
+
+        const int PRODUCER_COUNT = 8;
+        const int CALLBACK_COUNT = 20000;
+        std::vector<int> lastValues(PRODUCER_COUNT, -1);
+        bool isPerProducerInOrder = true;
+        std::atomic<int> doneCount(0);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCER_COUNT; ++p)
+        {
+            producers.emplace_back([&, p]
+            {
+                for (int i = 0; i < CALLBACK_COUNT; ++i)
+                {
+                    pDispatcher->dispatch([&, p, i]
+                    {
+                        isPerProducerInOrder = isPerProducerInOrder && lastValues[p] == i - 1;
+                        lastValues[p] = i;
+                    });
+                }
+                ++doneCount;
+            });
+        }
+        while (doneCount < PRODUCER_COUNT) pDispatcher->processQueue();
+        for (auto& producer : producers) producer.join();
+        pDispatcher->processQueue();
+        checkTest(std::count(lastValues.begin(), lastValues.end(), CALLBACK_COUNT - 1) == PRODUCER_COUNT, "All callbacks from 8 threads called");
+        checkTest(isPerProducerInOrder, "Callbacks of each thread called in order");
+
+        cout << setColor(7) << endl;
+    }
 }
 
 class TestResource1 : public onut::Resource
@@ -469,9 +655,638 @@ int main(int argc, char** args)
 
             cout << setColor(7) << endl;
         }
+
+        subTest("Growing and typed pools");
+        {
+            auto pPool = OPool::create(16, 4, OPool::FailAction::Grow);
+            std::vector<int*> objs;
+            for (int i = 0; i < 100; ++i)
+            {
+                objs.push_back(pPool->alloc<int>(i));
+            }
+            bool allAllocated = true;
+            for (int i = 0; i < 100; ++i)
+            {
+                allAllocated = allAllocated && objs[i] && *objs[i] == i;
+            }
+            checkTest(allAllocated, "Alloc 100 objs in a pool of 4 that grows");
+            checkTest(pPool->getAllocCount() == 100 && pPool->size() >= 100, "Alloc count is 100");
+
+            int notFromPool = 0;
+            checkTest(!pPool->dealloc(&notFromPool), "Dealloc an object not from the pool");
+            checkTest(!pPool->dealloc(reinterpret_cast<int*>(reinterpret_cast<uint8_t*>(objs[1]) + 4)), "Dealloc inside a slot");
+
+            checkTest(pPool->dealloc(objs[50]), "Dealloc objs[50]");
+            checkTest(!pPool->dealloc(objs[50]), "Dealloc objs[50] twice");
+
+            {
+                OTPool<CAligned> typedPool(8, OTPool<CAligned>::FailAction::Grow);
+                bool isAligned = true;
+                for (int i = 0; i < 20; ++i)
+                {
+                    auto pObj = typedPool.alloc(i);
+                    isAligned = isAligned && pObj && reinterpret_cast<uintptr_t>(pObj) % 32 == 0 && pObj->a == i;
+                }
+                checkTest(isAligned, "TPool objects are aligned on 32");
+                checkTest(CAligned::aliveCount == 20, "TPool constructed 20 objects");
+                typedPool.clear();
+                checkTest(CAligned::aliveCount == 0 && typedPool.getAllocCount() == 0, "TPool::clear() destroys the objects");
+                typedPool.alloc(1);
+            }
+            checkTest(CAligned::aliveCount == 0, "~TPool destroys the objects");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Thread safe pool, objects freed by another thread");
+        {
+            const int THREAD_COUNT = 4;
+            const int OBJ_COUNT = 10000;
+            auto pPool = OPool::create(sizeof(int), 64, OPool::FailAction::Grow, true);
+            std::vector<std::vector<int*>> objs(THREAD_COUNT);
+            std::vector<std::thread> threads;
+            for (int t = 0; t < THREAD_COUNT; ++t)
+            {
+                threads.emplace_back([&, t]
+                {
+                    for (int i = 0; i < OBJ_COUNT; ++i) objs[t].push_back(pPool->alloc<int>(i));
+                });
+            }
+            for (auto& thread : threads) thread.join();
+            threads.clear();
+            checkTest(pPool->getAllocCount() == THREAD_COUNT * OBJ_COUNT, "Alloc from 4 threads");
+
+            // Each thread frees what the next one allocated
+            std::atomic<int> failCount(0);
+            for (int t = 0; t < THREAD_COUNT; ++t)
+            {
+                threads.emplace_back([&, t]
+                {
+                    auto& toFree = objs[(t + 1) % THREAD_COUNT];
+                    for (int i = 0; i < OBJ_COUNT; ++i)
+                    {
+                        if (!toFree[i] || *toFree[i] != i || !pPool->dealloc(toFree[i])) ++failCount;
+                    }
+                });
+            }
+            for (auto& thread : threads) thread.join();
+            checkTest(failCount == 0 && pPool->getAllocCount() == 0, "Dealloc from other threads");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Performance, random alloc/dealloc in a full pool of 100000");
+        {
+            // allocCount is null when the allocator doesn't count
+            auto benchmark = [](const char* name, std::function<void*()> alloc, std::function<void(void*)> dealloc, std::function<size_t()> allocCount)
+            {
+                const int OBJ_COUNT = 100000;
+                const int OP_COUNT = 1000000;
+                int failCount = 0;
+                std::vector<void*> objs(OBJ_COUNT);
+                for (auto& pObj : objs)
+                {
+                    pObj = alloc();
+                    if (!pObj) ++failCount;
+                }
+                srand(0);
+                auto startTime = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < OP_COUNT; ++i)
+                {
+                    auto& pObj = objs[rand() % OBJ_COUNT];
+                    dealloc(pObj);
+                    pObj = alloc();
+                    if (!pObj) ++failCount;
+                }
+                auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - startTime).count();
+                if (allocCount && allocCount() != static_cast<size_t>(OBJ_COUNT)) ++failCount;
+                for (auto pObj : objs) dealloc(pObj);
+                if (allocCount && allocCount() != 0) ++failCount;
+                stringstream ss;
+                ss << name << ": every alloc succeeds and the count is kept (" << elapsed / (OP_COUNT * 2) << " ns per alloc or dealloc)";
+                checkTest(failCount == 0, ss.str());
+            };
+
+            struct CObj
+            {
+                float values[8];
+            };
+            auto pPool = OPool::create(sizeof(CObj), 100001);
+            benchmark("Pool", [&] { return pPool->alloc<CObj>(); }, [&](void* pObj) { pPool->dealloc(static_cast<CObj*>(pObj)); }, [&] { return pPool->getAllocCount(); });
+            OTPool<CObj> typedPool(100001);
+            benchmark("TPool", [&] { return typedPool.alloc(); }, [&](void* pObj) { typedPool.dealloc(static_cast<CObj*>(pObj)); }, [&] { return typedPool.getAllocCount(); });
+            auto pGrowPool = OPool::create(sizeof(CObj), 256, OPool::FailAction::Grow);
+            benchmark("Growing pool", [&] { return pGrowPool->alloc<CObj>(); }, [&](void* pObj) { pGrowPool->dealloc(static_cast<CObj*>(pObj)); }, [&] { return pGrowPool->getAllocCount(); });
+            auto pThreadSafePool = OPool::create(sizeof(CObj), 100001, OPool::FailAction::ReturnNull, true);
+            benchmark("Thread safe pool", [&] { return pThreadSafePool->alloc<CObj>(); }, [&](void* pObj) { pThreadSafePool->dealloc(static_cast<CObj*>(pObj)); }, [&] { return pThreadSafePool->getAllocCount(); });
+            benchmark("new/delete", [] { return new CObj(); }, [](void* pObj) { delete static_cast<CObj*>(pObj); }, nullptr);
+
+            cout << setColor(7) << endl;
+        }
         cout << setColor(7) << endl;
     }
     
+    majorTest("onut::SkylinePacker");
+    {
+        subTest("Fit");
+        {
+            onut::SkylinePacker packer(Point(128, 128));
+            Point positions[4];
+            bool isFitting = true;
+            for (auto& position : positions) isFitting = packer.insert(Point(64, 64), position) && isFitting;
+            checkTest(isFitting, "4 quarters fit");
+            checkTest(positions[0] == Point(0, 0) && positions[1] == Point(64, 0) && positions[2] == Point(0, 64) && positions[3] == Point(64, 64), "Lowest spots are filled first");
+            Point position;
+            checkTest(!packer.insert(Point(1, 1), position), "Nothing fits in a full page");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Overflow to a new page");
+        {
+            onut::SkylinePacker fullPage(Point(64, 64));
+            onut::SkylinePacker halfPage(Point(64, 64));
+            Point position;
+            fullPage.insert(Point(64, 64), position);
+            halfPage.insert(Point(64, 32), position);
+
+            // How TextureAtlas::insert() picks a page
+            onut::SkylinePacker::Placement placement;
+            checkTest(!fullPage.find(Point(32, 32), placement), "A full page is skipped");
+            checkTest(halfPage.find(Point(32, 32), placement) && placement.position == Point(0, 32), "It goes in the page with room");
+
+            placement = onut::SkylinePacker::Placement();
+            checkTest(!halfPage.find(Point(64, 48), placement) && onut::SkylinePacker(Point(64, 64)).find(Point(64, 48), placement), "Too big for the others, it goes in a new page");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Padding");
+        {
+            onut::SkylinePacker packer(Point(64, 64), 2);
+            Point positions[3];
+            for (auto& position : positions) packer.insert(Point(28, 28), position);
+            checkTest(positions[0] == Point(2, 2) && positions[1] == Point(34, 2) && positions[2] == Point(2, 34), "Rectangles are inside their padding");
+
+            Point position;
+            checkTest(onut::SkylinePacker(Point(64, 64), 2).insert(Point(60, 60), position), "Exact fit with the padding");
+            checkTest(!onut::SkylinePacker(Point(64, 64), 2).insert(Point(61, 60), position), "The padding has to fit too");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::SpriteLayers");
+    {
+        subTest("Overlapping sprites");
+        {
+            // A button's background, its text, then another background on top
+            onut::SpriteLayers layers;
+            auto background = layers.add(0, Vector4(0, 0, 100, 30), 1);
+            auto text = layers.add(0, Vector4(10, 5, 90, 25), 2);
+            auto cover = layers.add(0, Vector4(50, 0, 150, 30), 1);
+            checkTest(background < text && text < cover, "Each goes above the one it covers");
+            checkTest(layers.add(0, Vector4(20, 10, 30, 20), 2) == cover + 1, "Above everything under it");
+            checkTest(layers.add(0, Vector4(-1000, -1000, 1000, 1000), 3) == cover + 2, "A big sprite goes above everything");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Separate sprites");
+        {
+            // Two buttons, their backgrounds and their texts can be drawn together
+            onut::SpriteLayers layers;
+            auto background1 = layers.add(0, Vector4(0, 0, 100, 30), 1);
+            auto text1 = layers.add(0, Vector4(10, 5, 90, 25), 2);
+            auto background2 = layers.add(0, Vector4(200, 0, 300, 30), 1);
+            auto text2 = layers.add(0, Vector4(210, 5, 290, 25), 2);
+            checkTest(background1 == background2 && text1 == text2 && background1 < text1, "Same layer when they don't overlap");
+            checkTest(layers.add(0, Vector4(20, 10, 80, 20), 2) == text1, "Same layer when they have the same state");
+            checkTest(layers.add(1, Vector4(0, 0, 100, 30), 2) == 0, "Groups don't overlap each other");
+
+            layers.clear();
+            checkTest(layers.add(0, Vector4(10, 5, 90, 25), 2) == 0, "Nothing is left after clear");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::ThreadPool");
+    {
+        auto pThreadPool = OThreadPool::create();
+
+        subTest("Jobs, dependencies and waits");
+        {
+            std::atomic<int> count(0);
+            for (int i = 0; i < 10000; ++i)
+            {
+                pThreadPool->doWork([&count] { ++count; });
+            }
+            pThreadPool->wait();
+            checkTest(count == 10000, "wait() waits for 10000 jobs");
+
+            std::mutex mutex;
+            std::vector<int> order;
+            auto push = [&](int value)
+            {
+                return [&, value]
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    order.push_back(value);
+                };
+            };
+            auto pA = pThreadPool->doWork(push(1));
+            auto pB = pThreadPool->doWork(push(1));
+            auto pC = pThreadPool->doWork(push(2), {pA, pB});
+            auto pD = pThreadPool->then(pC, push(3));
+            pThreadPool->wait(pD);
+            checkTest(pD->isDone() && order == std::vector<int>({1, 1, 2, 3}), "Jobs run after their dependencies");
+
+            OJobCounter counter;
+            std::vector<long long> sums(16);
+            for (int i = 0; i < 16; ++i)
+            {
+                pThreadPool->doWork([&, i]
+                {
+                    std::vector<int> values(10000);
+                    pThreadPool->parallelFor(0, values.size(), 256, [&](size_t j) { values[j] = static_cast<int>(j); });
+                    for (auto value : values) sums[i] += value;
+                }, &counter);
+            }
+            pThreadPool->wait(counter);
+            checkTest(counter.isDone() && std::count(sums.begin(), sums.end(), 49995000LL) == 16, "parallelFor nested in jobs");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("OAsync");
+    {
+        oAsyncExecutor = OAsyncExecutor::create(2);
+        auto pDispatcher = ODispatcher::create();
+        auto pPreviousDispatcher = oDispatcher;
+        oDispatcher = pDispatcher;
+
+        subTest("Futures and continuations");
+        {
+            auto future = OAsync([](int a, int b) { return a + b; }, 3, 4);
+            checkTest(future.get() == 7, "get() waits for the result");
+
+            auto mainThreadId = std::this_thread::get_id();
+            std::atomic<bool> isThenOnWorker(false);
+            bool isThenSyncOnMain = false;
+            std::atomic<int> result(0);
+            auto chained = OAsync([] { return std::string("Hello"); })
+                .then([&](const std::string& value)
+                {
+                    isThenOnWorker = std::this_thread::get_id() != mainThreadId;
+                    return static_cast<int>(value.size());
+                })
+                .thenSync([&](int size)
+                {
+                    isThenSyncOnMain = std::this_thread::get_id() == mainThreadId;
+                    result = size;
+                });
+            auto startTime = std::chrono::steady_clock::now();
+            while (!chained.isReady() && std::chrono::steady_clock::now() - startTime < std::chrono::seconds(5))
+            {
+                pDispatcher->processQueue();
+            }
+            checkTest(result == 5, "then() and thenSync() called with the results");
+            checkTest(isThenOnWorker, "then() called on an executor thread");
+            checkTest(isThenSyncOnMain, "thenSync() called on the dispatcher's thread");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Exceptions and results");
+        {
+            auto failed = OAsync([]() -> int { throw std::runtime_error("failed"); });
+            bool isThrown = false;
+            try { failed.get(); }
+            catch (const std::runtime_error&) { isThrown = true; }
+            checkTest(isThrown, "get() rethrows the exception");
+
+            bool isCalled = false;
+            auto next = failed.then([&isCalled](int) { isCalled = true; return 0; });
+            isThrown = false;
+            try { next.get(); }
+            catch (const std::runtime_error&) { isThrown = true; }
+            checkTest(isThrown && !isCalled, "Continuations get the exception instead of being called");
+
+            struct NoDefault
+            {
+                NoDefault(int in_value) : value(in_value) {}
+                int value;
+            };
+            checkTest(OAsync([] { return NoDefault(42); }).get().value == 42, "Results don't need a default constructor");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Queue depth with 2 threads");
+        {
+            std::mutex blockMutex;
+            blockMutex.lock();
+            std::vector<OAsyncFuture<void>> futures;
+            for (int i = 0; i < 10; ++i)
+            {
+                futures.push_back(OAsync([&blockMutex] { std::lock_guard<std::mutex> lock(blockMutex); }));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            auto stats = oAsyncExecutor->getStats();
+            checkTest(stats.runningCount == 2 && stats.queuedCount == 8, "2 running, 8 queued");
+            blockMutex.unlock();
+            for (auto& future : futures) future.wait();
+            checkTest(oAsyncExecutor->getStats().peakQueuedCount >= 8, "Peak queue depth is kept");
+
+            cout << setColor(7) << endl;
+        }
+
+        oDispatcher = pPreviousDispatcher;
+        oAsyncExecutor = nullptr;
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::Entity components");
+    {
+        subTest("Lookup by type");
+        {
+            auto pSceneManager = OSceneManager::create();
+            auto pParent = OEntity::create(pSceneManager);
+            auto pChild = OEntity::create(pSceneManager);
+            pParent->add(pChild);
+
+            pParent->addComponent<TestComponentB>();
+            auto pComponentA = pChild->addComponent<TestComponentA>();
+            checkTest(pChild->getComponent<TestComponentA>() == pComponentA, "getComponent() finds the component");
+            checkTest(pChild->getComponentPtr<TestComponentA>() == pComponentA.get(), "getComponentPtr() finds the component");
+            checkTest(pChild->addComponent<TestComponentA>() == pComponentA, "addComponent() returns the existing one");
+            checkTest(!pChild->getComponent<TestComponentB>(), "getComponent() of a missing type is null");
+            checkTest(pChild->getParentComponent<TestComponentB>() == pParent->getComponent<TestComponentB>(), "getParentComponent() finds it in the parent");
+
+            OComponentRef pUntyped = OMake<TestComponentB>();
+            pChild->addComponent(pUntyped);
+            checkTest(pChild->getComponent<TestComponentB>() == pUntyped, "Components added as OComponentRef are indexed by their class");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::Entity transforms");
+    {
+        subTest("Propagation");
+        {
+            auto pSceneManager = OSceneManager::create();
+            pSceneManager->setPause(true); // Only entity actions and transforms are updated, no timing needed
+            auto pRoot = OEntity::create(pSceneManager);
+            auto pChild = OEntity::create(pSceneManager);
+            auto pGrandChild = OEntity::create(pSceneManager);
+            pChild->add(pGrandChild); // Created before its parent is attached
+            pRoot->add(pChild);
+            pChild->setLocalTransform(Matrix::CreateTranslation(0.f, 2.f, 0.f));
+            pGrandChild->setLocalTransform(Matrix::CreateTranslation(0.f, 0.f, 3.f));
+
+            pRoot->setLocalTransform(Matrix::CreateTranslation(1.f, 0.f, 0.f));
+            checkTest(pGrandChild->getWorldTransform().Translation() == Vector3(1.f, 2.f, 3.f), "World transform is right before the scene update");
+            pSceneManager->update();
+            checkTest(pGrandChild->getWorldTransform().Translation() == Vector3(1.f, 2.f, 3.f), "World transform is right after the scene update");
+
+            pRoot->setLocalTransform(Matrix::CreateTranslation(5.f, 0.f, 0.f));
+            pSceneManager->update();
+            checkTest(pGrandChild->getWorldTransform().Translation() == Vector3(5.f, 2.f, 3.f), "Moving the root moves the whole subtree");
+
+            auto pNewParent = OEntity::create(pSceneManager);
+            pNewParent->setLocalTransform(Matrix::CreateTranslation(0.f, 10.f, 0.f));
+            pNewParent->add(pChild);
+            checkTest(pGrandChild->getWorldTransform().Translation() == Vector3(0.f, 12.f, 3.f), "Moving under a newer entity");
+            pSceneManager->update();
+            checkTest(pGrandChild->getWorldTransform().Translation() == Vector3(0.f, 12.f, 3.f), "Moving under a newer entity, after the scene update");
+
+            pChild->remove();
+            pGrandChild->setWorldTransform(Matrix::CreateTranslation(7.f, 7.f, 7.f));
+            pSceneManager->update();
+            checkTest(pGrandChild->getLocalTransform().Translation() == Vector3(7.f, 5.f, 7.f), "setWorldTransform() sets the local relative to the parent");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Moving a parented subtree");
+        {
+            auto pSceneManager = OSceneManager::create();
+            pSceneManager->setPause(true);
+            auto pOldParent = OEntity::create(pSceneManager);
+            auto pSibling = OEntity::create(pSceneManager);
+            auto pMoved = OEntity::create(pSceneManager);
+            auto pChild1 = OEntity::create(pSceneManager);
+            auto pChild2 = OEntity::create(pSceneManager);
+            auto pNewParent = OEntity::create(pSceneManager);
+            pOldParent->add(pSibling);
+            pOldParent->add(pMoved);
+            pMoved->add(pChild1);
+            pMoved->add(pChild2);
+            pOldParent->setLocalTransform(Matrix::CreateTranslation(1.f, 0.f, 0.f));
+            pSibling->setLocalTransform(Matrix::CreateTranslation(0.f, 1.f, 0.f));
+            pMoved->setLocalTransform(Matrix::CreateTranslation(0.f, 2.f, 0.f));
+            pChild1->setLocalTransform(Matrix::CreateTranslation(0.f, 0.f, 3.f));
+            pChild2->setLocalTransform(Matrix::CreateTranslation(0.f, 0.f, 4.f));
+            pNewParent->setLocalTransform(Matrix::CreateTranslation(10.f, 0.f, 0.f));
+            pSceneManager->update();
+
+            pNewParent->add(pMoved);
+            pSceneManager->update();
+            checkTest(pMoved->getParent() == pNewParent && pOldParent->getChildren().size() == 1, "The subtree changed parent");
+            checkTest(pMoved->getWorldTransform().Translation() == Vector3(10.f, 2.f, 0.f), "The moved entity follows its new parent");
+            checkTest(pChild1->getWorldTransform().Translation() == Vector3(10.f, 2.f, 3.f) &&
+                      pChild2->getWorldTransform().Translation() == Vector3(10.f, 2.f, 4.f), "Its children follow it");
+
+            pOldParent->setLocalTransform(Matrix::CreateTranslation(5.f, 0.f, 0.f));
+            pNewParent->setLocalTransform(Matrix::CreateTranslation(20.f, 0.f, 0.f));
+            pSceneManager->update();
+            checkTest(pSibling->getWorldTransform().Translation() == Vector3(5.f, 1.f, 0.f), "The children left behind keep their parent");
+            checkTest(pChild2->getWorldTransform().Translation() == Vector3(20.f, 2.f, 4.f), "The subtree follows its new parent after the move");
+
+            pOldParent->destroy();
+            pSceneManager->update();
+            checkTest(pChild1->getWorldTransform().Translation() == Vector3(20.f, 2.f, 3.f), "Destroying the old parent doesn't affect the subtree");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::ComponentSystem");
+    {
+        subTest("Dense storage");
+        {
+            if (!oTiming) oTiming = OTiming::create(); // For the scene updates
+            auto pSceneManager = OSceneManager::create();
+            auto pVirtual = OEntity::create(pSceneManager)->addComponent<TestSystemComponent>();
+            pSceneManager->registerComponentSystem<TestSystemComponent>();
+
+            std::vector<OEntityRef> entities;
+            std::vector<std::shared_ptr<TestSystemComponent>> components;
+            for (int i = 0; i < 300; ++i)
+            {
+                entities.push_back(OEntity::create(pSceneManager));
+                components.push_back(entities.back()->addComponent<TestSystemComponent>());
+            }
+            checkTest(components[1].get() == components[0].get() + 1, "Components are packed");
+
+            pSceneManager->update();
+            checkTest(TestSystemComponent::updateAllCount == 1, "updateAll() called once");
+            checkTest(components[0]->updateCount == 1 && components[299]->updateCount == 1, "All components updated");
+            checkTest(pVirtual->updateCount == 1, "Components created before registering use onUpdate()");
+
+            components[0]->setEnabled(false);
+            entities[1]->setEnabled(false);
+            entities[2]->destroy();
+            pSceneManager->update();
+            checkTest(components[0]->updateCount == 1 && components[1]->updateCount == 1 && components[2]->updateCount == 1, "Disabled and destroyed components are skipped");
+            checkTest(components[3]->updateCount == 2, "Others are still updated");
+
+            auto pDestroyed = components[2].get();
+            components[2].reset();
+            entities[2].reset();
+            auto pNew = OEntity::create(pSceneManager)->addComponent<TestSystemComponent>();
+            checkTest(pNew.get() == pDestroyed, "Freed slots are reused");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::SceneManager parallel updates");
+    {
+        subTest("Same results as serial");
+        {
+            if (!oTiming) oTiming = OTiming::create(); // For the scene updates
+
+            // Attackers hurt, message and toggle random entities, some of them die
+            auto simulate = [](bool useThreadPool)
+            {
+                auto pThreadPool = oThreadPool;
+                if (!useThreadPool) oThreadPool = nullptr;
+                else if (!oThreadPool) oThreadPool = OThreadPool::create();
+
+                srand(1234);
+                auto pSceneManager = OSceneManager::create();
+                std::vector<OEntityRef> entities;
+                for (int i = 0; i < 2000; ++i)
+                {
+                    auto pEntity = OEntity::create(pSceneManager);
+                    pEntity->setLocalTransform(Matrix::CreateTranslation(static_cast<float>(i), 0.f, 0.f));
+                    pEntity->addComponent<TestHealthComponent>()->health = 50 + rand() % 100;
+                    pEntity->addComponent<TestMoverComponent>()->speed = static_cast<float>(rand() % 3);
+                    entities.push_back(pEntity);
+                }
+                for (int i = 0; i < 2000; ++i)
+                {
+                    auto pAttack = entities[i]->addComponent<TestAttackComponent>();
+                    pAttack->pTarget = entities[rand() % entities.size()];
+                    pAttack->pToggled = entities[rand() % entities.size()]->getComponent<TestMoverComponent>();
+                    pAttack->seed = static_cast<uint32_t>(rand());
+                }
+                for (int frame = 0; frame < 100; ++frame)
+                {
+                    pSceneManager->update();
+                }
+
+                std::vector<float> state;
+                for (auto& pEntity : entities)
+                {
+                    auto pHealth = pEntity->getComponent<TestHealthComponent>();
+                    state.push_back(pHealth ? static_cast<float>(pHealth->health) : -1.f);
+                    state.push_back(pHealth ? static_cast<float>(pHealth->messageSum) : -1.f);
+                    state.push_back(pEntity->getWorldTransform().Translation().x);
+                }
+                for (auto& pEntity : entities) pEntity->destroy(); // Attackers keep their targets alive
+                pSceneManager->update();
+
+                oThreadPool = pThreadPool;
+                return state;
+            };
+
+            auto serialState = simulate(false);
+            int deadCount = 0;
+            for (size_t i = 0; i < serialState.size(); i += 3) deadCount += serialState[i] < 0.f ? 1 : 0;
+            checkTest(deadCount > 0 && deadCount < 2000, "Some entities were destroyed during the updates");
+
+            bool isSame = true;
+            for (int run = 0; run < 5; ++run)
+            {
+                isSame = isSame && simulate(true) == serialState;
+            }
+            checkTest(isSame, "ThreadPool updates match serial updates");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
+    majorTest("onut::SceneManager queries");
+    {
+        subTest("Names and tags");
+        {
+            auto pSceneManager = OSceneManager::create();
+            pSceneManager->setPause(true); // Only entity actions and transforms are updated, no timing needed
+            auto pPlayer = OEntity::create(pSceneManager);
+            auto pEnemy = OEntity::create(pSceneManager);
+            auto pOther = OEntity::create(pSceneManager);
+            pPlayer->setName("player");
+            pEnemy->addTag("enemy");
+            pOther->addTag("enemy");
+            checkTest(pSceneManager->findEntity("player") == pPlayer, "findEntity() finds the named entity");
+            checkTest(pSceneManager->findEntity(onut::getEntityNameId("player")) == pPlayer, "findEntity() by name id");
+            checkTest(!pSceneManager->findEntity("nobody"), "findEntity() of an unknown name is null");
+            checkTest(pSceneManager->findEntitiesWithTag("enemy").size() == 2, "findEntitiesWithTag() finds all tagged entities");
+
+            pPlayer->setName("hero");
+            checkTest(!pSceneManager->findEntity("player") && pSceneManager->findEntity("hero") == pPlayer, "Renaming updates the index");
+            pOther->removeTag("enemy");
+            checkTest(pSceneManager->findEntitiesWithTag("enemy").size() == 1 && !pOther->hasTag("enemy"), "Removing a tag updates the index");
+
+            auto pGuard1 = OEntity::create(pSceneManager);
+            auto pGuard2 = OEntity::create(pSceneManager);
+            auto pGuard3 = OEntity::create(pSceneManager);
+            pGuard1->setName("guard");
+            pGuard2->setName("guard");
+            pGuard3->setName("guard");
+            pGuard1->setName("captain");
+            checkTest(pSceneManager->findEntity("guard") == pGuard2, "findEntity() finds the first one named");
+
+            pPlayer->destroy();
+            pSceneManager->update();
+            checkTest(!pSceneManager->findEntity("hero"), "Destroyed entities are not found");
+
+            cout << setColor(7) << endl;
+        }
+
+        subTest("Components in a rect");
+        {
+            auto pSceneManager = OSceneManager::create();
+            pSceneManager->setPause(true);
+            for (int i = 0; i < 10; ++i)
+            {
+                auto pEntity = OEntity::create(pSceneManager);
+                pEntity->setLocalTransform(Matrix::CreateTranslation((float)i * 10.f, 0.f, 0.f));
+                pEntity->addComponent<TestComponentA>();
+                if (i % 2 == 0) pEntity->addComponent<TestComponentB>();
+            }
+            checkTest(pSceneManager->findEntitiesWith<TestComponentA>().size() == 10, "findEntitiesWith() one type");
+            checkTest(pSceneManager->findEntitiesWith<TestComponentA, TestComponentB>().size() == 5, "findEntitiesWith() needs all the types");
+            checkTest(pSceneManager->findEntitiesWith<TestComponentB>(Rect(-5.f, -5.f, 30.f, 10.f)).size() == 2, "findEntitiesWith() in a rect");
+            checkTest(pSceneManager->findEntitiesWith<TestSystemComponent>().empty(), "findEntitiesWith() a type nobody has");
+
+            cout << setColor(7) << endl;
+        }
+        cout << setColor(7) << endl;
+    }
+
     majorTest("onut::Synchronous");
     {
         runSynchronousTests();